@@ -8,3 +8,7 @@
 #include <libcompute/Engine.hpp>
 #include <libcompute/Parameter.hpp>
 #include <libcompute/Program.hpp>
+#include <libcompute/Kernel.hpp>
+#include <libcompute/KernelRegistry.hpp>
+#include <libcompute/ThreadPool.hpp>
+#include <libcompute/Random.hpp>
\ No newline at end of file
@@ -3,6 +3,8 @@
 
 #include <any>
 #include <memory>
+#include <set>
+#include <stdint.h>
 
 namespace libcompute
 {
@@ -20,8 +22,30 @@ public:
 	 * Classes that derive from Engine should provide the \a name parameter
 	 * in their constructor.
 	 */
-	Engine( const char* name )
-	: Plugin(name, "compute") {}
+	Engine( const char* name );
+
+	/**
+	 * @brief Tells when work an Engine has been given is done.
+	 *
+	 * Engines that queue their work, like the GLSLComputeEngine, return one
+	 * from every run that can be waited on once the host needs the results.
+	 * The base class is work that is already done, which engines that run
+	 * their programs before returning hand out.
+	 */
+	class Completion
+	{
+	public:
+		/** Reference counting shared_ptr for this class. */
+		typedef std::shared_ptr<Completion> Ptr;
+
+		virtual ~Completion() {}
+
+		/** Gets whether the work is done, without waiting for it. */
+		virtual bool isComplete() { return true; }
+
+		/** Waits until the work is done. */
+		virtual void wait() {}
+	};
 
 	/** Class that manages engine specific data storage */
 	class DataStorage
@@ -154,12 +178,63 @@ public:
 		 */
 		virtual void toArray( void* array ) = 0;
 
+		/**
+		 * @brief Fills a float storage with sparse random values, see libcompute::fillRandomSparse().
+		 *
+		 * The default fills an array on the host and copies it in with
+		 * fromArray(); engines that keep their storages in host memory can fill
+		 * them in place instead.
+		 */
+		virtual void fillRandomSparse( float density, float min, float max, uint64_t seed, unsigned int channel );
+
+		/**
+		 * @brief Starts copying the storage towards the host without waiting for it.
+		 *
+		 * A toArray() made once the copy is done, like a frame later, then
+		 * does not stall on the GPU.  Writing the storage again drops the
+		 * copy.  The default does nothing, for engines whose storages are
+		 * already in host memory.
+		 */
+		virtual void requestRead() {}
+
+		/**
+		 * @brief Records the run still writing this storage.
+		 *
+		 * This method is really only of interest to Engine developers, whose
+		 * toArray() calls waitForWrite() so only reads the host makes wait.
+		 */
+		void setPendingWrite( const Completion::Ptr& completion ) { pendingWrite_ = completion; }
+
+		/** Waits for the run set by setPendingWrite(), if it is not done yet. */
+		void waitForWrite()
+		{
+			if( pendingWrite_ )
+			{
+				pendingWrite_->wait();
+				pendingWrite_.reset();
+			}
+		}
+
+		/**
+		 * @brief Keeps something of the user's alive for exactly as long as this storage.
+		 *
+		 * Lets a host pair its own resources with a storage, like the texture
+		 * a storage in host memory is drawn through, and have them freed with
+		 * it rather than tracking storages it does not own.
+		 */
+		void setAttachment( const std::shared_ptr<void>& attachment ) { attachment_ = attachment; }
+
+		/** Gets what setAttachment() was given, or an empty pointer. */
+		const std::shared_ptr<void>& getAttachment() const { return attachment_; }
+
 	private:
 
 		friend class Information;
 		unsigned int dataStorage_;
 		Info info_;
 		bool infoSet_;
+		Completion::Ptr pendingWrite_;
+		std::shared_ptr<void> attachment_;
 
 		static std::map<std::string, DataType> dataTypeNameTable_;
 		static std::map<std::string, DataType> initDataTypeNameTable()
@@ -187,8 +262,34 @@ public:
 	virtual void* bindProgram( Program* const ) = 0;
 	virtual void unbindProgram( Program* const) = 0;
 
-	virtual void runProgram( Program* const) = 0;
-	virtual ~Engine() {};
+	/**
+	 * @brief Runs a program, or queues it to run.
+	 * @return When the run is done.  Synchronous engines return work that
+	 *         is already done.
+	 */
+	virtual Completion::Ptr runProgram( Program* const) = 0;
+	virtual ~Engine();
+
+	/**
+	 * @brief Tells every engine that a texture is about to be deleted by its owner.
+	 *
+	 * Hosts that wrap their own textures in storages, like fromTexture does,
+	 * call this before freeing one, so no engine keeps anything bound to a
+	 * texture name GL may hand out again.
+	 */
+	static void forgetTexture( unsigned int texture );
+
+	/**
+	 * @brief Sets whether runs are only queued, for engines that queue their work.
+	 *
+	 * Asynchronous runs return as soon as the work is queued, so a chain of
+	 * programs is queued in one go and only reading a storage back waits for
+	 * it.  Synchronous runs wait for every run to finish before returning,
+	 * which is slower but makes timing a single pass easy.  Engines start
+	 * out asynchronous.
+	 */
+	void setAsynchronous( bool asynchronous ) { asynchronous_ = asynchronous; }
+	bool isAsynchronous() const { return asynchronous_; }
 
 
 	enum ReductionType
@@ -200,8 +301,84 @@ public:
 	
 	virtual vec4 reduce( const DataStorage::Ptr& storage, ReductionType type ) = 0;
 
+	/**
+	 * @brief The minimum, maximum and a histogram of a storage, gathered in one pass.
+	 *
+	 * The histogram counts the elements whose first component falls in each
+	 * of Bins equal parts of [histogramMin, histogramMax).  Elements outside
+	 * that range are not counted in any bin.
+	 */
+	struct Statistics
+	{
+		/** The number of bins in the histogram. */
+		static const int Bins = 16;
+
+		bool ready; ///< Whether the rest of the struct holds a result.
+		vec4 minimum; ///< The smallest value of each component.
+		vec4 maximum; ///< The largest value of each component.
+		float histogramMin; ///< The start of the range the histogram covers.
+		float histogramMax; ///< The end of the range the histogram covers.
+		unsigned int histogram[Bins]; ///< The number of elements in each bin.
+		unsigned int count; ///< The number of elements in the storage.
+
+		Statistics() : ready(false), histogramMin(0), histogramMax(0), count(0)
+		{
+			for( int i = 0; i < Bins; i++ )
+				histogram[i] = 0;
+		}
+
+		/** Gets the number of elements in a bin, or 0 for a bin outside the histogram. */
+		unsigned int getBin( int bin ) const
+		{
+			return (bin >= 0 && bin < Bins)? histogram[bin]: 0;
+		}
+	};
+
+	/**
+	 * @brief Starts gathering the Statistics of a storage.
+	 * @param storage The storage to look at.
+	 * @param histogramMin The start of the range the histogram covers.
+	 * @param histogramMax The end of the range the histogram covers.
+	 * @return False if the last request has not been collected yet, in which
+	 *         case nothing is started.
+	 *
+	 * Unlike reduce() this does not wait for the result, which an engine may
+	 * still be working on when it returns.  Collect it with collectStatistics(),
+	 * typically on the next frame.
+	 */
+	virtual bool requestStatistics( const DataStorage::Ptr& storage, float histogramMin, float histogramMax ) = 0;
+
+	/**
+	 * @brief Gets the result of the last requestStatistics(), if it is ready.
+	 * @return The statistics, with ready set once per request.  While the
+	 *         result is still on its way ready is false, and the request stays
+	 *         pending.
+	 */
+	virtual Statistics collectStatistics() = 0;
+
+	/** How many programs bindProgram() found already built in an engine's program cache, and how many it had to build. */
+	struct ProgramCacheCounts
+	{
+		unsigned int hits; ///< Programs loaded from the cache.
+		unsigned int misses; ///< Programs built and added to it.
+
+		ProgramCacheCounts() : hits(0), misses(0) {}
+	};
+
+	/** Gets the counts of the program cache, all zero for engines without one. */
+	virtual ProgramCacheCounts getProgramCacheCounts() const { return ProgramCacheCounts(); }
+
 	virtual DataStorage::Ptr allocateStorage( const DataStorage::Info& type, int width, int height ) = 0;
 	virtual DataStorage::Ptr emptyStorage() = 0;
+
+protected:
+	/** Drops whatever the engine keeps for \a texture, see forgetTexture().  The default keeps nothing. */
+	virtual void textureFreed( unsigned int texture ) {}
+
+private:
+	bool asynchronous_;
+
+	static std::set<Engine*>& engines();
 };
 
 };
@@ -0,0 +1,111 @@
+#ifndef LIBCOMPUTE_KERNEL_HPP
+#define LIBCOMPUTE_KERNEL_HPP
+
+#include <functional>
+
+namespace libcompute
+{
+
+/** A rectangular block of a Program's output, in storage elements. */
+struct Tile
+{
+	unsigned int x; ///< The left edge of the block
+	unsigned int y; ///< The bottom edge of the block
+	unsigned int width; ///< The width of the block
+	unsigned int height; ///< The height of the block
+};
+
+/** Host memory views of a Program's storages handed to a Kernel while it runs. */
+struct KernelArguments
+{
+	Program* program; ///< The Program being run
+	unsigned int width; ///< The width of the output storages
+	unsigned int height; ///< The height of the output storages
+	std::vector<void*> inputs; ///< The data of each input storage
+	std::vector<Engine::DataStorage::Info> inputInfo; ///< Information about each input storage
+	std::vector<void*> outputs; ///< The data of each output storage
+	std::vector<Parameter*> parameters; ///< The Parameters the Kernel was registered with, in that order
+
+	/**
+	 * @brief Gets the value of one of the Parameters the Kernel was registered with.
+	 * @param index The position of its name in the list given to the KernelRegistry.
+	 *
+	 * Engines resolve the Parameters once per run, on the thread that ran the
+	 * Program, so Kernels on other threads read them without looking anything
+	 * up or marking them written.  \a T has to be the type of the Parameter;
+	 * arrays give their first element.
+	 */
+	template<typename T> const T& parameter( unsigned int index ) const
+	{
+		return *(const T*) parameters[index]->data();
+	}
+
+	/** Gets the number of elements of one of the Parameters the Kernel was registered with. */
+	unsigned int parameterSize( unsigned int index ) const { return parameters[index]->size(); }
+
+	/**
+	 * @brief Gets an element of a float input.
+	 * @param index The input to read from.
+	 * @param x The column of the element.  Values outside the input wrap around.
+	 * @param y The row of the element.  Values outside the input wrap around.
+	 * @return A pointer to the four components of the element.
+	 *
+	 * The wrapping matches the default repeating textures of the GLSL engine.
+	 */
+	const float* inputElement( unsigned int index, int x, int y ) const
+	{
+		int inputWidth = inputInfo[index].width;
+		int inputHeight = inputInfo[index].height;
+
+		x %= inputWidth;
+		y %= inputHeight;
+		if( x < 0 ) x += inputWidth;
+		if( y < 0 ) y += inputHeight;
+
+		return (const float*) inputs[index] + (size_t(y) * inputWidth + x) * 4;
+	}
+
+	/**
+	 * @brief Gets the element of a float input under an output element.
+	 * @param index The input to read from.
+	 * @param x The column of the output element.
+	 * @param y The row of the output element.
+	 * @return A pointer to the four components of the input element.
+	 *
+	 * Unlike inputElement() the input does not need to be the size of the
+	 * output: the element is picked like a nearest filtered texture() lookup
+	 * in the GLSL engine, so a smaller input is scaled up to the output.
+	 */
+	const float* sampleInput( unsigned int index, unsigned int x, unsigned int y ) const
+	{
+		return inputElement( index, int(size_t(x) * inputInfo[index].width / width),
+			int(size_t(y) * inputInfo[index].height / height) );
+	}
+
+	/**
+	 * @brief Gets an element of a float output.
+	 * @param index The output to write to.
+	 * @param x The column of the element.
+	 * @param y The row of the element.
+	 * @return A pointer to the four components of the element.
+	 */
+	float* outputElement( unsigned int index, unsigned int x, unsigned int y ) const
+	{
+		return (float*) outputs[index] + (size_t(y) * width + x) * 4;
+	}
+};
+
+/**
+ * @brief A program written in C++ for engines that run on the host.
+ *
+ * Engines split the output into Tiles and call the Kernel once for every
+ * Tile, possibly from many threads at once, so a Kernel must only write
+ * inside the Tile it was handed.  Storages hold four components per element,
+ * just like the textures the GLSL engine uses, so arrays can be moved between
+ * engines unchanged.
+ */
+typedef std::function<void( const KernelArguments&, const Tile& )> Kernel;
+
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef LIBCOMPUTE_KERNELREGISTRY_HPP
+#define LIBCOMPUTE_KERNELREGISTRY_HPP
+
+#include <mutex>
+
+namespace libcompute
+{
+
+/**
+ * @brief Builds a Kernel from source code.
+ * @return The Kernel, or an empty Kernel if the source could not be compiled.
+ */
+typedef std::function<Kernel( const std::string& source )> KernelCompiler;
+
+/** The names of the Parameters a Kernel reads, in the order KernelArguments::parameters holds them. */
+typedef std::vector<std::string> KernelParameters;
+
+/**
+ * @brief Keeps Kernels under names that Programs can refer to.
+ *
+ * Plugins and hosts register their Kernels here, and a Program configuration
+ * can then name one inside an engine entry:
+ * @code
+ * <engine>
+ * 	<name>CPUComputeEngine</name>
+ * 	<kernel>life</kernel>
+ * </engine>
+ * @endcode
+ *
+ * Compilers can also be registered, to build Kernels from source held in
+ * memory.  Such source starts with a line naming its compiler:
+ * @code
+ * #pragma compiler escape
+ * @endcode
+ *
+ * Kernels, and the Kernels a compiler builds, are registered with the names
+ * of the Parameters they read, which the engine resolves into
+ * KernelArguments::parameters before handing the Tiles out.
+ */
+class KernelRegistry
+{
+public:
+
+	/** Gets the registry shared by the whole process. */
+	static KernelRegistry& instance();
+
+	/**
+	 * @brief Registers a Kernel that works on whole Tiles.
+	 * @param name The name to register under.  An existing Kernel with the same name is replaced.
+	 * @param kernel The Kernel.
+	 * @param parameters The Parameters \a kernel reads through KernelArguments::parameter().
+	 */
+	void registerKernel( const std::string& name, Kernel kernel, const KernelParameters& parameters = KernelParameters() );
+
+	/**
+	 * @brief Registers a Kernel built from a per-pixel functor type.
+	 * @param name The name to register under.  An existing Kernel with the same name is replaced.
+	 * @param parameters The Parameters \a Pixel reads through KernelArguments::parameter().
+	 *
+	 * \a Pixel is constructed once per Tile from the KernelArguments, which is
+	 * where it should read any Parameters it needs.  Its operator()( x, y ) is
+	 * then called for every element of the Tile and returns the vec4 written
+	 * to the first float output.  Since the loop is instantiated for \a Pixel,
+	 * the compiler is free to inline and specialise the whole thing.
+	 */
+	template<typename Pixel> void registerPixelKernel( const std::string& name, const KernelParameters& parameters = KernelParameters() )
+	{
+		registerKernel( name, []( const KernelArguments& arguments, const Tile& tile )
+		{
+			Pixel pixel( arguments );
+			for( unsigned int y = tile.y; y < tile.y + tile.height; y++ )
+			{
+				float* element = arguments.outputElement( 0, tile.x, y );
+				for( unsigned int x = tile.x; x < tile.x + tile.width; x++, element += 4 )
+				{
+					vec4 value = pixel( x, y );
+					element[0] = value.x;
+					element[1] = value.y;
+					element[2] = value.z;
+					element[3] = value.w;
+				}
+			}
+		}, parameters );
+	}
+
+	/**
+	 * @brief Checks to see if a Kernel has been registered.
+	 * @param name The name to check.
+	 * @return True if a Kernel is registered as \a name.
+	 */
+	bool hasKernel( const std::string& name );
+
+	/**
+	 * @brief Gets a registered Kernel.
+	 * @param name The name the Kernel was registered under.
+	 * @return The Kernel, or an empty Kernel if none was registered as \a name.
+	 */
+	Kernel getKernel( const std::string& name );
+
+	/** Gets the Parameters a registered Kernel reads, or none if no Kernel was registered as \a name. */
+	KernelParameters getKernelParameters( const std::string& name );
+
+	/** Returns a vector containing the names of all registered Kernels. */
+	std::vector<std::string> getKernelNames();
+
+	/**
+	 * @brief Registers a KernelCompiler.
+	 * @param name The name source uses to pick the compiler.  An existing compiler with the same name is replaced.
+	 * @param compiler The compiler.
+	 * @param parameters The Parameters every Kernel \a compiler builds reads.
+	 */
+	void registerCompiler( const std::string& name, KernelCompiler compiler, const KernelParameters& parameters = KernelParameters() );
+
+	/**
+	 * @brief Compiles source into a Kernel.
+	 * @param source Source whose first line is "#pragma compiler <name>".  The rest is handed to the compiler.
+	 * @param parameters If given, set to the Parameters the Kernel reads.
+	 * @return The Kernel, or an empty Kernel if no compiler is registered under the name or compiling failed.
+	 */
+	Kernel compileKernel( const std::string& source, KernelParameters* parameters = NULL );
+
+private:
+	std::map<std::string, Kernel> kernels_;
+	std::map<std::string, KernelParameters> kernelParameters_;
+	std::map<std::string, KernelCompiler> compilers_;
+	std::map<std::string, KernelParameters> compilerParameters_;
+	std::mutex mutex_;
+};
+
+};
+
+#endif
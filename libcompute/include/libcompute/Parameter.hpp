@@ -3,6 +3,9 @@
 
 #include <boost/bimap.hpp>
 
+#include <algorithm>
+#include <atomic>
+
 namespace libcompute
 {
 
@@ -229,8 +232,56 @@ public:
 	/** Get the size of the Parameter */
 	unsigned int size() { return size_; }
 
-	/** Get the name of the Parameter */
-	std::string name() { return name_; }
+	/** Get the name of the Parameter; elements from operator[]() only build theirs here. */
+	std::string name();
+
+	/**
+	 * @brief Sets one element of an array without making a Parameter for it.
+	 * @param index The element to set; indexes past the end are ignored.
+	 *
+	 * \a T has to be the type of the Parameter, as with the casts.
+	 */
+	template<typename T> void setElement( unsigned int index, const T& value )
+	{
+		if( index >= size_ )
+			return;
+
+		((T*) value_)[index] = value;
+		touch();
+	}
+
+	/**
+	 * @brief Copies \a count values into an array, starting at element \a offset.
+	 *
+	 * Values past the end of the array are dropped, and the array is marked
+	 * written once for all of them.
+	 */
+	template<typename T> void setElements( unsigned int offset, const T* values, unsigned int count )
+	{
+		if( offset >= size_ )
+			return;
+
+		count = std::min( count, size_ - offset );
+		std::copy( values, values + count, (T*) value_ + offset );
+		touch();
+	}
+
+	/**
+	 * @brief Gets a number that changes whenever the value may have been written.
+	 *
+	 * The setters and the casts to references and pointers all count as
+	 * writes, and writes to an element from operator[]() count for the whole
+	 * array, so an engine can skip uploading a Parameter whose generation it
+	 * has already seen.  Code that keeps a pointer and writes through it
+	 * later has to call touch() itself.
+	 */
+	unsigned long generation() const { return *generation_; }
+
+	/** Marks the value as written, see generation(). */
+	void touch() { *generation_ = ++nextGeneration_; }
+
+	/** Gets the value to read, without marking it written like the pointer casts do. */
+	const void* data() const { return value_; }
 private:
 
 	friend class Program;
@@ -243,6 +294,15 @@ private:
 	unsigned int size_;
 	bool isArrayChild_;
 	std::string name_;
+	/** The name of the array an element is in, which is not copied for every element. */
+	const std::string* arrayName_;
+	/** The index of an element in its array. */
+	unsigned int index_;
+
+	/** The generation of an array or single value; elements point at their array's. */
+	std::atomic<unsigned long> ownGeneration_;
+	std::atomic<unsigned long>* generation_;
+	static std::atomic<unsigned long> nextGeneration_;
 
 	static boost::bimap<std::string, ParameterType> parameterTypeTable_;
 	static boost::bimap<std::string, ParameterType> initParameterTypeTable();
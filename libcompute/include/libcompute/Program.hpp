@@ -3,6 +3,8 @@
 
 #include <boost/property_tree/ptree.hpp>
 
+#include <vector>
+
 namespace libcompute
 {
 
@@ -12,7 +14,7 @@ class Program
 public:
 
 	/** Create a blank Program */
-	Program(){}
+	Program(): precision_(Single), hasRunRegion_(false), hasActiveTiles_(false) {}
 
 	void setWorkingDirectory( const std::string& dir ) { workingDirectory_ = dir; }
 	std::string getWorkingDirectory() { return workingDirectory_; }
@@ -50,8 +52,36 @@ public:
 	{
 		File = 0, ///< The program is located in a file
 		Memory = 1, ///< The program is loaded into memory
+		Registry = 2, ///< The program is a Kernel registered by name with the KernelRegistry
+	};
+
+	/** Describes the floating point precision a program is compiled with */
+	enum Precision
+	{
+		Single = 0, ///< Plain single precision floats
+		DoubleSingle = 1, ///< Emulated double precision, each value held as a pair of floats ("df64")
 	};
 
+	/**
+	 * @brief Gets a Precision from its name in the XML configuration.
+	 * @param name Either "float" or "df64".
+	 * @return The named Precision, or Single if \a name is not recognised.
+	 */
+	static Precision precisionFromName( const std::string& name );
+
+	/** Gets the precision the program is compiled with. */
+	Precision getPrecision() const { return precision_; }
+
+	/**
+	 * @brief Sets the precision the program is compiled with.
+	 * @param precision The requested precision.
+	 *
+	 * The precision is read when an engine is bound, so the Program must be
+	 * rebound for a change to take effect.  Engines that cannot emulate a
+	 * higher precision ignore it; see the documentation for each engine.
+	 */
+	void setPrecision( Precision precision ) { precision_ = precision; }
+
 	/**
 	 * @brief Gets a reference to a Parameter.
 	 * @param name The name of the Parameter to reference.
@@ -60,6 +90,28 @@ public:
 	 */
 	Parameter& getParameter( const std::string& name );
 
+	/** A number standing for a Parameter of one Program, see getParameterHandle(). */
+	typedef unsigned int ParameterHandle;
+
+	/**
+	 * @brief Gets a handle to a Parameter, to reach it later without looking its name up.
+	 * @param name The name of the Parameter.
+	 * @return The same handle for every call with \a name.
+	 *
+	 * Parameters live as long as their Program, so a handle stays valid
+	 * across binding and unbinding engines.  Code that sets parameters every
+	 * frame gets its handles once, after load().
+	 */
+	ParameterHandle getParameterHandle( const std::string& name );
+
+	/**
+	 * @brief Gets a reference to the Parameter behind \a handle.
+	 *
+	 * A handle only means something to the Program that gave it out, so one
+	 * this Program never gave out is an error.
+	 */
+	Parameter& getParameter( ParameterHandle handle );
+
 	/** The std::map type used to store the parameters */
 	typedef std::map<std::string, Parameter> parameter_storage;
 
@@ -184,6 +236,17 @@ public:
 	 */
 	void setProgramLocationMemory( const std::string& engine, std::any program );
 
+	/**
+	 * @brief Sets the location of a program for an engine as a registered Kernel.
+	 * @param engine The engine to set for.
+	 * @param name The name the Kernel was registered under.
+	 *
+	 * If there is already a program set for \a engine, it will be replaced with
+	 * the one specified.  The name is not looked up until the engine is bound, so
+	 * the Kernel may be registered after the Program is loaded.
+	 */
+	void setProgramLocationKernel( const std::string& engine, const std::string& name );
+
 	/**
 	 * @brief Gets the file path of a program for a engine.
 	 * @brief engine The engine to get for.
@@ -202,6 +265,15 @@ public:
 	 */
 	std::any getProgramLocationMemory( const std::string& engine );
 
+	/**
+	 * @brief Gets the name of the registered Kernel used as the program for a engine.
+	 * @brief engine The engine to get for.
+	 * @return The name of the Kernel.
+	 * @throw ProgramLocationTypeMismatchException The program location is not a registered Kernel.
+	 * @throw EngineNotSupportedException The specified engine does not have a program.
+	 */
+	std::string getProgramLocationKernel( const std::string& engine );
+
 	/**
 	 * @brief Gets the program that is used by the bound engine.
 	 * @throw NoEngineBoundException There is no engine bound.
@@ -213,9 +285,70 @@ public:
 
 	/**
 	 * @brief Runs this program in the bound engine.
+	 * @return When the run is done, which an asynchronous engine may not be yet.
 	 * @throw NoEngineBoundException There is currently no engine bound to this Program.
 	 */
-	void run();
+	Engine::Completion::Ptr run();
+
+	/** A rectangle of a Program's output, in storage elements. */
+	struct Region
+	{
+		unsigned int x; ///< The left edge of the rectangle
+		unsigned int y; ///< The bottom edge of the rectangle
+		unsigned int width; ///< The width of the rectangle
+		unsigned int height; ///< The height of the rectangle
+	};
+
+	/**
+	 * @brief Limits the elements later runs compute to a rectangle of the output.
+	 * @param x The left edge of the rectangle.
+	 * @param y The bottom edge of the rectangle.
+	 * @param width The width of the rectangle.
+	 * @param height The height of the rectangle.
+	 *
+	 * Elements outside the rectangle keep whatever the output held before.
+	 * Every element inside it is computed exactly as a full run would, with
+	 * the same texture coordinates, so a picture can be patched a strip at a
+	 * time.  The rectangle is clipped to the output.
+	 */
+	void setRunRegion( unsigned int x, unsigned int y, unsigned int width, unsigned int height );
+
+	/** Makes later runs compute the whole output again. */
+	void clearRunRegion() { hasRunRegion_ = false; }
+
+	/** Checks to see if runs are limited to a rectangle of the output. */
+	bool hasRunRegion() const { return hasRunRegion_; }
+
+	/** Gets the rectangle runs are limited to, if hasRunRegion(). */
+	const Region& getRunRegion() const { return runRegion_; }
+
+	/** A grid of square tiles laid over a Program's output, some of them marked active. */
+	struct TileMask
+	{
+		unsigned int tileSize; ///< The side of each tile, in storage elements
+		unsigned int columns; ///< The number of tiles across the output
+		unsigned int rows; ///< The number of tiles up the output
+		std::vector<unsigned char> active; ///< Nonzero for the tiles to compute, row by row from the bottom
+	};
+
+	/**
+	 * @brief Limits the elements later runs compute to the active tiles of a mask.
+	 * @param mask The tiles to compute.
+	 *
+	 * Like a run region, elements outside the active tiles keep whatever the
+	 * output held before and elements inside them are computed exactly as a
+	 * full run would.  A run region, if there is one, clips the tiles further.
+	 */
+	void setActiveTiles( const TileMask& mask ) { activeTiles_ = mask; hasActiveTiles_ = true; }
+
+	/** Makes later runs compute every tile again. */
+	void clearActiveTiles() { hasActiveTiles_ = false; }
+
+	/** Checks to see if runs are limited to the active tiles of a mask. */
+	bool hasActiveTiles() const { return hasActiveTiles_; }
+
+	/** Gets the mask runs are limited to, if hasActiveTiles(). */
+	const TileMask& getActiveTiles() const { return activeTiles_; }
 
 	/**
 	 * @brief Allocates storage for the program through the currently bound engine.
@@ -260,6 +393,8 @@ private:
 	std::string workingDirectory_;
 
 	std::map<std::string, Parameter> parameters_;
+	/** The parameters handed out by getParameterHandle(), indexed by handle. */
+	std::vector<Parameter*> handles_;
 
 	std::map<std::string, std::pair<ProgramLocation, std::any> > supportedEngines_;
 	Engine* boundEngine_;
@@ -269,6 +404,11 @@ private:
 	Engine::DataStorage::Ptr** storage_[2];
 	unsigned int storageCount_[2];
 	Engine::DataStorage::Info storageDataTypes_[2];
+	Precision precision_;
+	bool hasRunRegion_;
+	Region runRegion_;
+	bool hasActiveTiles_;
+	TileMask activeTiles_;
 };
 
 };
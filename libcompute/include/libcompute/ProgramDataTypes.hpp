@@ -3,6 +3,9 @@
  * @brief Header file that defines the types that can be used by programs.
  */
 
+#ifndef LIBCOMPUTE_PROGRAMDATATYPES_HPP
+#define LIBCOMPUTE_PROGRAMDATATYPES_HPP
+
 #include <cmath>
 
 namespace libcompute
@@ -249,3 +252,5 @@ private:
 typedef matBase<3> mat3;
 typedef matBase<4> mat4;
 };
+
+#endif
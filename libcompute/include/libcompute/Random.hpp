@@ -0,0 +1,70 @@
+#ifndef LIBCOMPUTE_RANDOM_HPP
+#define LIBCOMPUTE_RANDOM_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace libcompute
+{
+
+/**
+ * @brief Four xoshiro128+ generators running side by side.
+ *
+ * Every lane is its own generator, seeded from a single 64 bit seed with
+ * splitmix64, and all four advance together through the GCC vector
+ * extensions, so one call makes four numbers in a handful of vector
+ * instructions on whatever unit the library was built for.
+ */
+class RandomStream
+{
+public:
+	/** The number of generators that run side by side. */
+	static const int Lanes = 4;
+
+	/** Four 32 bit numbers, one per lane. */
+	typedef uint32_t Vector __attribute__((vector_size( Lanes * sizeof(uint32_t) )));
+
+	/** Seeds every lane from \a seed; equal seeds make equal streams. */
+	RandomStream( uint64_t seed );
+
+	/** Gets the next number of every lane, uniform over all 32 bit values. */
+	Vector next()
+	{
+		Vector result = state_[0] + state_[3];
+		Vector shifted = state_[1] << 9;
+
+		state_[2] ^= state_[0];
+		state_[3] ^= state_[1];
+		state_[1] ^= state_[2];
+		state_[0] ^= state_[3];
+		state_[2] ^= shifted;
+		state_[3] = (state_[3] << 11) | (state_[3] >> 21);
+
+		return result;
+	}
+
+private:
+	Vector state_[4];
+};
+
+/**
+ * @brief Fills an array of four component float elements with sparse random values.
+ * @param data The array, elements * 4 floats long.
+ * @param elements The number of elements.
+ * @param density The chance of each element getting a value.
+ * @param min The smallest value.
+ * @param max The largest value, or the same as \a min for a single value.
+ * @param seed The seed; the same seed always gives the same array.
+ * @param channel The component the values go in.
+ *
+ * Every component of every element is cleared, then each element gets a
+ * value uniform over [min, max) in \a channel with a chance of \a density.
+ * The array is split into fixed blocks with seeds of their own and filled
+ * across the shared ThreadPool, so the result does not depend on how many
+ * threads there are.
+ */
+void fillRandomSparse( float* data, size_t elements, float density, float min, float max, uint64_t seed, unsigned int channel );
+
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef LIBCOMPUTE_THREADPOOL_HPP
+#define LIBCOMPUTE_THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace libcompute
+{
+
+/**
+ * @brief A work-stealing pool of threads for running host side computations.
+ *
+ * Every worker owns a queue that it pops work from; once its own queue runs
+ * dry it steals from the far end of the other workers' queues.  The
+ * thread that hands work to the pool joins in until that work is finished,
+ * so parallelFor() can safely be called from inside a task.
+ */
+class ThreadPool
+{
+public:
+	/** A unit of work that can be queued. */
+	typedef std::function<void()> Task;
+
+	/**
+	 * @brief Starts up the worker threads.
+	 * @param threads The total number of threads that should run work, counting
+	 *                the calling thread.  Zero uses one thread per hardware thread.
+	 */
+	ThreadPool( unsigned int threads = 0 );
+
+	/** Finishes any queued work and joins the worker threads. */
+	~ThreadPool();
+
+	/** Gets the number of threads that run work, counting the calling thread. */
+	unsigned int size() const { return threads_.size() + 1; }
+
+	/**
+	 * @brief Runs a function for every index in [0, count) across the pool.
+	 * @param count The number of indices to run.
+	 * @param func The function to run; it receives the index to work on.
+	 *
+	 * The call returns once every index has been run.
+	 */
+	void parallelFor( unsigned int count, const std::function<void(unsigned int)>& func );
+
+	/** Gets a pool shared by everything in the process, sized to the machine. */
+	static ThreadPool& shared();
+
+private:
+	ThreadPool( const ThreadPool& );
+	void operator=( const ThreadPool& );
+
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	void push( unsigned int queue, Task task );
+	bool take( unsigned int queue, Task& task );
+	void work( unsigned int queue );
+
+	std::vector<std::unique_ptr<Queue> > queues_;
+	std::vector<std::thread> threads_;
+
+	std::mutex sleepMutex_;
+	std::condition_variable wake_;
+	std::atomic<unsigned int> queued_;
+	bool stopping_;
+};
+
+};
+
+#endif
@@ -1,5 +1,44 @@
 #include "libcompute.hpp"
 
+#include <cstdio>
+#include <cstdlib>
+
 using namespace libcompute;
 
+Engine::Engine( const char* name )
+: Plugin(name, "compute"), asynchronous_(true)
+{
+	engines().insert( this );
+}
+
+Engine::~Engine()
+{
+	engines().erase( this );
+}
+
+std::set<Engine*>& Engine::engines()
+{
+	static std::set<Engine*> engines;
+	return engines;
+}
+
+void Engine::forgetTexture( unsigned int texture )
+{
+	for( Engine* engine: engines() )
+		engine->textureFreed( texture );
+}
+
 std::map<std::string, Engine::DataStorage::DataType> Engine::DataStorage::dataTypeNameTable_ = Engine::DataStorage::initDataTypeNameTable();
+
+void Engine::DataStorage::fillRandomSparse( float density, float min, float max, uint64_t seed, unsigned int channel )
+{
+	if( info_.type != Float )
+	{
+		printf("Only float storages can be filled with random values.\n");
+		exit(1);
+	}
+
+	std::vector<float> array( size_t(info_.width) * info_.height * 4 );
+	libcompute::fillRandomSparse( &array[0], size_t(info_.width) * info_.height, density, min, max, seed, channel );
+	fromArray( &array[0] );
+}
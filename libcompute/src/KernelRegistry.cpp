@@ -0,0 +1,90 @@
+#include "libcompute.hpp"
+#include <sstream>
+
+using namespace libcompute;
+
+KernelRegistry& KernelRegistry::instance()
+{
+	static KernelRegistry registry;
+	return registry;
+}
+
+void KernelRegistry::registerKernel( const std::string& name, Kernel kernel, const KernelParameters& parameters )
+{
+	std::lock_guard<std::mutex> lock( mutex_ );
+	kernels_[name] = kernel;
+	kernelParameters_[name] = parameters;
+}
+
+bool KernelRegistry::hasKernel( const std::string& name )
+{
+	std::lock_guard<std::mutex> lock( mutex_ );
+	return kernels_.find(name) != kernels_.end();
+}
+
+Kernel KernelRegistry::getKernel( const std::string& name )
+{
+	std::lock_guard<std::mutex> lock( mutex_ );
+	std::map<std::string, Kernel>::iterator kernel = kernels_.find(name);
+	if( kernel == kernels_.end() )
+		return Kernel();
+
+	return kernel->second;
+}
+
+KernelParameters KernelRegistry::getKernelParameters( const std::string& name )
+{
+	std::lock_guard<std::mutex> lock( mutex_ );
+	std::map<std::string, KernelParameters>::iterator parameters = kernelParameters_.find(name);
+	if( parameters == kernelParameters_.end() )
+		return KernelParameters();
+
+	return parameters->second;
+}
+
+std::vector<std::string> KernelRegistry::getKernelNames()
+{
+	std::lock_guard<std::mutex> lock( mutex_ );
+	std::vector<std::string> names;
+	for( auto& kernel: kernels_ )
+		names.push_back( kernel.first );
+
+	return names;
+}
+
+void KernelRegistry::registerCompiler( const std::string& name, KernelCompiler compiler, const KernelParameters& parameters )
+{
+	std::lock_guard<std::mutex> lock( mutex_ );
+	compilers_[name] = compiler;
+	compilerParameters_[name] = parameters;
+}
+
+Kernel KernelRegistry::compileKernel( const std::string& source, KernelParameters* parameters )
+{
+	std::istringstream lines( source );
+	std::string pragma, directive, name;
+	lines >> pragma >> directive >> name;
+
+	if( pragma != "#pragma" || directive != "compiler" )
+	{
+		printf("Kernel source must start with #pragma compiler.\n");
+		return Kernel();
+	}
+
+	KernelCompiler compiler;
+	{
+		std::lock_guard<std::mutex> lock( mutex_ );
+		std::map<std::string, KernelCompiler>::iterator found = compilers_.find(name);
+		if( found == compilers_.end() )
+		{
+			printf("No kernel compiler is registered as %s.\n", name.c_str());
+			return Kernel();
+		}
+		compiler = found->second;
+		if( parameters )
+			*parameters = compilerParameters_[name];
+	}
+
+	size_t body = source.find( '\n' );
+	return compiler( body == std::string::npos ? std::string() : source.substr( body + 1 ) );
+}
@@ -4,6 +4,7 @@ using namespace libcompute;
 
 std::map<Parameter::ParameterType, unsigned int> Parameter::sizeTable_ = Parameter::initSizeTable();
 boost::bimap<std::string, Parameter::ParameterType> Parameter::parameterTypeTable_ = Parameter::initParameterTypeTable();
+std::atomic<unsigned long> Parameter::nextGeneration_( 0 );
 
 boost::bimap<std::string, Parameter::ParameterType> Parameter::initParameterTypeTable()
 {
@@ -50,6 +51,10 @@ Parameter::Parameter()
 {
 	size_ = 0;
 	this->isArrayChild_ = false;
+	this->arrayName_ = NULL;
+	this->index_ = 0;
+	this->generation_ = &ownGeneration_;
+	touch();
 }
 
 Parameter::Parameter( const std::string& name, ParameterType type, unsigned int size )
@@ -59,6 +64,10 @@ Parameter::Parameter( const std::string& name, ParameterType type, unsigned int
 	this->name_ = name;
 	this->value_ = allocateStorage( type_, size_ );
 	this->isArrayChild_ = false;
+	this->arrayName_ = NULL;
+	this->index_ = 0;
+	this->generation_ = &ownGeneration_;
+	touch();
 }
 
 Parameter::Parameter( const std::string& name, ParameterType type )
@@ -68,6 +77,10 @@ Parameter::Parameter( const std::string& name, ParameterType type )
 	value_ = allocateStorage( type_, size_ );
 	this->isArrayChild_ = false;
 	this->name_ = name;
+	this->arrayName_ = NULL;
+	this->index_ = 0;
+	this->generation_ = &ownGeneration_;
+	touch();
 }
 
 Parameter::~Parameter()
@@ -83,13 +96,20 @@ Parameter::Parameter( const Parameter& other )
 	this->size_ = other.size_;
 	this->name_ = other.name_;
 	this->isArrayChild_ = other.isArrayChild_;
+	this->arrayName_ = other.arrayName_;
+	this->index_ = other.index_;
 	if( isArrayChild_ )
+	{
 		this->value_ = other.value_;
+		this->generation_ = other.generation_;
+	}
 	else
 	{
 		this->value_ = allocateStorage( type_, size_ );
 		memcpy( value_, other.value_, sizeTable_[type_] * size_ );
+		this->generation_ = &ownGeneration_;
 	}
+	touch();
 }
 
 void Parameter::operator=( const Parameter& other )
@@ -99,13 +119,20 @@ void Parameter::operator=( const Parameter& other )
 	this->size_ = other.size_;
 	this->name_ = other.name_;
 	this->isArrayChild_ = other.isArrayChild_;
+	this->arrayName_ = other.arrayName_;
+	this->index_ = other.index_;
 	if( isArrayChild_ )
+	{
 		this->value_ = other.value_;
+		this->generation_ = other.generation_;
+	}
 	else
 	{
 		this->value_ = allocateStorage( type_, size_ );
 		memcpy( value_, other.value_, sizeTable_[type_] * size_ );
+		this->generation_ = &ownGeneration_;
 	}
+	touch();
 }
 
 Parameter Parameter::operator[]( unsigned int index )
@@ -115,10 +142,22 @@ Parameter Parameter::operator[]( unsigned int index )
 	childParameter.type_ = type_;
 	childParameter.value_ = (void*)((char*)value_ + index * sizeTable_[type_]);
 	childParameter.isArrayChild_ = true;
-	childParameter.name_ = name_ + "[" + std::to_string( index ) + "]";
+	childParameter.generation_ = generation_;
+	// the name is only put together if it is asked for, so setting elements
+	// every frame builds no strings
+	childParameter.arrayName_ = isArrayChild_? arrayName_: &name_;
+	childParameter.index_ = isArrayChild_? index_ + index: index;
 	return childParameter;
 }
 
+std::string Parameter::name()
+{
+	if( isArrayChild_ )
+		return *arrayName_ + "[" + std::to_string( index_ ) + "]";
+
+	return name_;
+}
+
 Parameter::operator int()
 {
 	if( type_ == Int )
@@ -140,6 +179,7 @@ Parameter::operator float()
 #define PARAMETER_VALUE_CAST( T, N ) \
 	Parameter::operator T&()\
 	{\
+		touch();\
 		return ((T*) value_)[0];\
 	}
 
@@ -152,6 +192,7 @@ PARAMETER_VALUE_CAST( mat4, Mat4 )
 #define PARAMETER_POINTER_CAST( T, N ) \
 	Parameter::operator T*()\
 	{\
+		touch();\
 		return (T*) value_;\
 	}
 
@@ -166,6 +207,7 @@ PARAMETER_POINTER_CAST( mat4, Mat4 )
 #define PARAMETER_VALUE_SET( T, N ) \
 	void Parameter::operator=( const T& value )\
 	{\
+		touch();\
 		((T*) value_)[0] = value;\
 	}
 
@@ -3,6 +3,8 @@
 #include <boost/property_tree/xml_parser.hpp> 	
 #include <boost/foreach.hpp>
 
+#include <algorithm>
+
 using namespace libcompute;
 
 /*Program::Program(const std::string& str)
@@ -52,9 +54,14 @@ void Program::load( const std::string& path )
 		{
 			boost::property_tree::ptree engine = v.second;
 
-			supportedEngines_[engine.get<std::string>("name")] = std::pair<ProgramLocation, std::any>( File, engine.get<std::string>("file") );
+			if( engine.count("kernel") > 0 )
+				supportedEngines_[engine.get<std::string>("name")] = std::pair<ProgramLocation, std::any>( Registry, engine.get<std::string>("kernel") );
+			else
+				supportedEngines_[engine.get<std::string>("name")] = std::pair<ProgramLocation, std::any>( File, engine.get<std::string>("file") );
 		}	
 
+		precision_ = precisionFromName( config.get<std::string>( "program.precision", "float" ) );
+
 		storageDataTypes_[Input].type = Engine::DataStorage::typeFromName(config.get<std::string>( "program.input.type" ));
 		storageDataTypes_[Output].type = Engine::DataStorage::typeFromName(config.get<std::string>( "program.output.type" ));
 		storageDataTypes_[Input].size = config.get<unsigned int>("program.input.size", 0);
@@ -85,11 +92,50 @@ void Program::load( const std::string& path )
 	}
 }
 
+Program::Precision Program::precisionFromName( const std::string& name )
+{
+	if( name == "df64" )
+		return DoubleSingle;
+
+	if( name != "float" )
+		printf("Unknown precision %s, using float.\n", name.c_str());
+
+	return Single;
+}
+
 Parameter& Program::getParameter( const std::string& name )
 {
 	return parameters_[name];
 }
 
+Program::ParameterHandle Program::getParameterHandle( const std::string& name )
+{
+	parameter_storage::iterator parameter = parameters_.find( name );
+	if( parameter == parameters_.end() )
+	{
+		printf("Unknown parameter %s.\n", name.c_str());
+		exit(1);
+	}
+
+	std::vector<Parameter*>::iterator handle = std::find( handles_.begin(), handles_.end(), &parameter->second );
+	if( handle != handles_.end() )
+		return handle - handles_.begin();
+
+	handles_.push_back( &parameter->second );
+	return handles_.size() - 1;
+}
+
+Parameter& Program::getParameter( ParameterHandle handle )
+{
+	if( handle >= handles_.size() )
+	{
+		printf("Parameter handle %u was not given out by this program.\n", handle);
+		exit(1);
+	}
+
+	return *handles_[handle];
+}
+
 void Program::addParameter( const std::string& name, Parameter::ParameterType type ) 
 {
 	parameters_[name] = Parameter(name, type, 1);
@@ -115,9 +161,18 @@ void* Program::getActiveProgram()
 	return this->activeProgram_;
 }
 
-void Program::run()
+Engine::Completion::Ptr Program::run()
+{
+	return boundEngine_->runProgram(this);
+}
+
+void Program::setRunRegion( unsigned int x, unsigned int y, unsigned int width, unsigned int height )
 {
-	boundEngine_->runProgram(this);
+	runRegion_.x = x;
+	runRegion_.y = y;
+	runRegion_.width = width;
+	runRegion_.height = height;
+	hasRunRegion_ = true;
 }
 
 void Program::allocateStorage( unsigned int width, unsigned int height, StorageLocation location, unsigned int index )
@@ -146,6 +201,12 @@ void Program::setProgramLocationMemory( const std::string& engine, std::any loca
 	supportedEngines_[engine].second = location;
 }
 
+void Program::setProgramLocationKernel( const std::string& engine, const std::string& name )
+{
+	supportedEngines_[engine].first = Registry;
+	supportedEngines_[engine].second = name;
+}
+
 std::string Program::getProgramLocationFile( const std::string& engine )
 {
 	return workingDirectory_ + std::any_cast<std::string>( supportedEngines_[engine].second );
@@ -155,6 +216,11 @@ std::any Program::getProgramLocationMemory( const std::string& engine )
 	return supportedEngines_[engine].second;
 }
 
+std::string Program::getProgramLocationKernel( const std::string& engine )
+{
+	return std::any_cast<std::string>( supportedEngines_[engine].second );
+}
+
 Engine::DataStorage::Ptr Program::getStorage( StorageLocation location, unsigned int index )
 {
 	if( location == Input )
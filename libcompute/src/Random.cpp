@@ -0,0 +1,62 @@
+#include "libcompute.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace libcompute;
+
+namespace
+{
+
+/** Elements per block of fillRandomSparse(); each block has its own seed. */
+const size_t RandomBlock = 1 << 16;
+
+uint64_t splitMix( uint64_t& state )
+{
+	uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+};
+
+RandomStream::RandomStream( uint64_t seed )
+{
+	for( int word = 0; word < 4; word++ )
+		for( int lane = 0; lane < Lanes; lane += 2 )
+		{
+			uint64_t bits = splitMix( seed );
+			state_[word][lane] = uint32_t(bits);
+			state_[word][lane + 1] = uint32_t(bits >> 32);
+		}
+}
+
+void libcompute::fillRandomSparse( float* data, size_t elements, float density, float min, float max, uint64_t seed, unsigned int channel )
+{
+	// an element gets a value when its lane's number is under the threshold
+	double chance = std::min( std::max( double(density), 0.0 ), 1.0 );
+	uint32_t threshold = (chance >= 1)? 0xffffffff: uint32_t( chance * 4294967296.0 );
+	bool everything = chance >= 1;
+	float range = max - min;
+
+	unsigned int blocks = (elements + RandomBlock - 1)/RandomBlock;
+	ThreadPool::shared().parallelFor( blocks, [&]( unsigned int block )
+	{
+		uint64_t blockSeed = seed ^ (uint64_t(block) * 0xd1b54a32d192ed03ULL);
+		RandomStream stream( splitMix( blockSeed ) );
+
+		size_t start = size_t(block) * RandomBlock;
+		size_t end = std::min( start + RandomBlock, elements );
+		memset( data + start * 4, 0, (end - start) * 4 * sizeof(float) );
+
+		for( size_t i = start; i < end; i += RandomStream::Lanes )
+		{
+			RandomStream::Vector picked = stream.next();
+			RandomStream::Vector values = stream.next();
+			for( int lane = 0; lane < RandomStream::Lanes && i + lane < end; lane++ )
+				if( everything || picked[lane] < threshold )
+					data[(i + lane) * 4 + channel] = min + range * float(values[lane] >> 8) * (1.0f/16777216);
+		}
+	});
+}
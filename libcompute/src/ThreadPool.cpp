@@ -0,0 +1,135 @@
+#include "libcompute.hpp"
+
+using namespace libcompute;
+
+ThreadPool::ThreadPool( unsigned int threads )
+: queued_(0)
+, stopping_(false)
+{
+	if( threads == 0 )
+		threads = std::thread::hardware_concurrency();
+
+	if( threads == 0 )
+		threads = 1;
+
+	// one queue per worker plus one that threads outside the pool work from
+	for( unsigned int i = 0; i < threads; i++ )
+		queues_.push_back( std::unique_ptr<Queue>( new Queue ) );
+
+	for( unsigned int i = 0; i < threads - 1; i++ )
+		threads_.push_back( std::thread( &ThreadPool::work, this, i ) );
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock( sleepMutex_ );
+		stopping_ = true;
+	}
+	wake_.notify_all();
+
+	for( auto& thread: threads_ )
+		thread.join();
+}
+
+ThreadPool& ThreadPool::shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::push( unsigned int queue, Task task )
+{
+	std::lock_guard<std::mutex> lock( queues_[queue]->mutex );
+	queues_[queue]->tasks.push_back( std::move(task) );
+	queued_++;
+}
+
+bool ThreadPool::take( unsigned int queue, Task& task )
+{
+	if( queued_ == 0 )
+		return false;
+
+	unsigned int count = queues_.size();
+
+	// newest work from our own queue first, since it is most likely still in cache
+	{
+		std::lock_guard<std::mutex> lock( queues_[queue]->mutex );
+		if( !queues_[queue]->tasks.empty() )
+		{
+			task = std::move( queues_[queue]->tasks.back() );
+			queues_[queue]->tasks.pop_back();
+			queued_--;
+			return true;
+		}
+	}
+
+	// then steal the oldest work from everyone else
+	for( unsigned int i = 1; i < count; i++ )
+	{
+		Queue& victim = *queues_[(queue + i) % count];
+		std::lock_guard<std::mutex> lock( victim.mutex );
+		if( !victim.tasks.empty() )
+		{
+			task = std::move( victim.tasks.front() );
+			victim.tasks.pop_front();
+			queued_--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::work( unsigned int queue )
+{
+	Task task;
+	while( true )
+	{
+		if( take( queue, task ) )
+		{
+			task();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock( sleepMutex_ );
+		wake_.wait( lock, [this]() { return stopping_ || queued_ > 0; } );
+
+		if( stopping_ && queued_ == 0 )
+			return;
+	}
+}
+
+void ThreadPool::parallelFor( unsigned int count, const std::function<void(unsigned int)>& func )
+{
+	if( count == 0 )
+		return;
+
+	if( count == 1 || queues_.size() == 1 )
+	{
+		for( unsigned int i = 0; i < count; i++ )
+			func(i);
+		return;
+	}
+
+	std::atomic<unsigned int> remaining( count );
+
+	for( unsigned int i = 0; i < count; i++ )
+		push( i % queues_.size(), [&func, &remaining, i]() { func(i); remaining--; } );
+
+	{
+		std::lock_guard<std::mutex> lock( sleepMutex_ );
+	}
+	wake_.notify_all();
+
+	// help out until everything we queued is done
+	unsigned int external = queues_.size() - 1;
+	Task task;
+	while( remaining > 0 )
+	{
+		if( take( external, task ) )
+			task();
+		else
+			std::this_thread::yield();
+	}
+}
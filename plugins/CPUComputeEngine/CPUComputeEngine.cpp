@@ -0,0 +1,464 @@
+#include <any>
+#include <libcompute.hpp>
+using namespace libcompute;
+
+#include <stdlib.h>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include "Kernels.hpp"
+
+class CPUComputeEngine: public Engine
+{
+public:
+
+	CPUComputeEngine() : Engine( "CPUComputeEngine" ), pool_( ThreadPool::shared() ), done_( new Engine::Completion() ) {}
+	~CPUComputeEngine() {};
+
+	/** Side length of the square blocks each output is split into for the thread pool. */
+	static const unsigned int TileSize = 64;
+
+	class DataStorage: public Engine::DataStorage
+	{
+	public:
+		DataStorage() : data_(NULL) {}
+
+		~DataStorage()
+		{
+			free( data_ );
+		}
+
+		std::string getType() { return "CPUComputeEngine"; }
+
+		void fromArray( void* array )
+		{
+			memcpy( data(), array, byteSize() );
+		}
+
+		void toArray( void* array )
+		{
+			memcpy( array, data(), byteSize() );
+		}
+
+		/** Fills the host memory of the storage in place. */
+		void fillRandomSparse( float density, float min, float max, uint64_t seed, unsigned int channel )
+		{
+			const Info& info = getInfo();
+			if( info.type != Float )
+			{
+				printf("Only float storages can be filled with random values.\n");
+				exit(1);
+			}
+
+			libcompute::fillRandomSparse( (float*) data(), size_t(info.width) * info.height, density, min, max, seed, channel );
+		}
+
+		/** Gets the host memory holding this storage, allocating it on first use. */
+		void* data()
+		{
+			if( data_ == NULL )
+				data_ = calloc( 1, byteSize() );
+			return data_;
+		}
+
+		/** The size in bytes of a storage that holds four components per element. */
+		size_t byteSize()
+		{
+			const Info& info = getInfo();
+			return size_t(info.width) * info.height * 4 * CPUComputeEngine::typeSize( info.type );
+		}
+
+	private:
+		void* data_;
+	};
+
+	void* bindProgram( Program* const program );
+	void unbindProgram( Program* const program );
+
+	Engine::Completion::Ptr runProgram( Program* const program );
+
+	vec4 reduce( const Engine::DataStorage::Ptr& storage, Engine::ReductionType type );
+
+	bool requestStatistics( const Engine::DataStorage::Ptr& storage, float histogramMin, float histogramMax );
+	Engine::Statistics collectStatistics();
+
+	Engine::DataStorage::Ptr allocateStorage( const Engine::DataStorage::Info& type, int width, int height );
+	Engine::DataStorage::Ptr emptyStorage();
+
+private:
+
+	/** What bindProgram() hands a Program: its Kernel, and the handles of the Parameters it reads once they are resolved. */
+	struct BoundKernel
+	{
+		Kernel kernel;
+		KernelParameters names;
+		std::vector<Program::ParameterHandle> handles;
+	};
+
+	static unsigned int typeSize( Engine::DataStorage::DataType type );
+	static void* hostData( const Engine::DataStorage::Ptr& storage );
+
+	template<typename T> vec4 reduceTiles( const T* data, const Engine::DataStorage::Info& info, Engine::ReductionType type );
+	template<typename T> void gatherStatistics( const T* data, const Engine::DataStorage::Info& info, Engine::Statistics& result );
+
+	ThreadPool& pool_;
+
+	/** Runs are done before runProgram() returns, so they all hand out this. */
+	Engine::Completion::Ptr done_;
+
+	/** The result of the last requestStatistics(), computed straight away and held until collected. */
+	Engine::Statistics statistics_;
+};
+
+unsigned int CPUComputeEngine::typeSize( Engine::DataStorage::DataType type )
+{
+	switch( type )
+	{
+		case Engine::DataStorage::Int: return sizeof(int);
+		case Engine::DataStorage::Float: return sizeof(float);
+		case Engine::DataStorage::Byte: return sizeof(unsigned char);
+		default: return 0;
+	}
+}
+
+void* CPUComputeEngine::hostData( const Engine::DataStorage::Ptr& storage )
+{
+	if( storage->getType() != "CPUComputeEngine" )
+	{
+		printf("Storage of type %s cannot be used by the CPUComputeEngine.\n", storage->getType().c_str());
+		exit(1);
+	}
+
+	return static_cast<CPUComputeEngine::DataStorage*>( storage.get() )->data();
+}
+
+void* CPUComputeEngine::bindProgram( Program* const program )
+{
+	std::string engineName = this->pluginName();
+
+	if( !program->engineSupported(engineName) || program->getProgramLocationType(engineName) == Program::File )
+	{
+		printf("Program has no kernel for the %s.\n", engineName.c_str());
+		exit(1);
+	}
+
+	if( program->getProgramLocationType(engineName) == Program::Registry )
+	{
+		std::string name = program->getProgramLocationKernel(engineName);
+		BoundKernel* bound = new BoundKernel;
+		bound->kernel = KernelRegistry::instance().getKernel(name);
+		if( !bound->kernel )
+		{
+			printf("Kernel %s has not been registered.\n", name.c_str());
+			exit(1);
+		}
+		bound->names = KernelRegistry::instance().getKernelParameters(name);
+		return bound;
+	}
+
+	std::any location = program->getProgramLocationMemory(engineName);
+	if( location.type() == typeid(std::string) )
+	{
+		BoundKernel* bound = new BoundKernel;
+		bound->kernel = KernelRegistry::instance().compileKernel( std::any_cast<std::string>(location), &bound->names );
+		if( !bound->kernel )
+		{
+			printf("Kernel could not be compiled.\n");
+			exit(1);
+		}
+		return bound;
+	}
+
+	if( location.type() != typeid(Kernel) )
+	{
+		printf("Program location for the %s must be a Kernel or kernel source.\n", engineName.c_str());
+		exit(1);
+	}
+
+	BoundKernel* bound = new BoundKernel;
+	bound->kernel = std::any_cast<Kernel>(location);
+	return bound;
+}
+
+void CPUComputeEngine::unbindProgram( Program* const program )
+{
+	delete (BoundKernel*) program->getActiveProgram();
+}
+
+Engine::Completion::Ptr CPUComputeEngine::runProgram( Program* const program )
+{
+	BoundKernel& bound = *(BoundKernel*) program->getActiveProgram();
+	Kernel& kernel = bound.kernel;
+
+	// the handles are looked up by name only on the first run, and never on the pool's threads
+	if( bound.handles.size() != bound.names.size() )
+		for( const std::string& name: bound.names )
+			bound.handles.push_back( program->getParameterHandle( name ) );
+
+	KernelArguments arguments;
+	arguments.program = program;
+	for( Program::ParameterHandle handle: bound.handles )
+		arguments.parameters.push_back( &program->getParameter( handle ) );
+
+	DataStorage::Info info = program->getStorage(Program::Output, 0)->getInfo();
+	arguments.width = info.width;
+	arguments.height = info.height;
+
+	if( program->getStorageInfo(Program::Input).type != DataStorage::Void )
+	{
+		for( unsigned int i = 0; i < program->getStorageCount(Program::Input); i++ )
+		{
+			Engine::DataStorage::Ptr input = program->getStorage(Program::Input, i);
+			arguments.inputs.push_back( hostData(input) );
+			arguments.inputInfo.push_back( input->getInfo() );
+		}
+	}
+
+	for( unsigned int i = 0; i < program->getStorageCount(Program::Output); i++ )
+		arguments.outputs.push_back( hostData( program->getStorage(Program::Output, i) ) );
+
+	// only the tiles of the run region, clipped to the output
+	unsigned int left = 0, bottom = 0, right = info.width, top = info.height;
+	if( program->hasRunRegion() )
+	{
+		const Program::Region& region = program->getRunRegion();
+		left = std::min( region.x, info.width );
+		bottom = std::min( region.y, info.height );
+		right = std::min( region.x + region.width, info.width );
+		top = std::min( region.y + region.height, info.height );
+		if( right <= left || top <= bottom )
+			return done_;
+	}
+
+	// only the active tiles of a mask, clipped to the region
+	if( program->hasActiveTiles() )
+	{
+		const Program::TileMask& mask = program->getActiveTiles();
+		std::vector<Tile> tiles;
+		for( unsigned int row = 0; row < mask.rows; row++ )
+			for( unsigned int column = 0; column < mask.columns; column++ )
+			{
+				if( !mask.active[row * mask.columns + column] )
+					continue;
+
+				unsigned int x = std::max( column * mask.tileSize, left );
+				unsigned int y = std::max( row * mask.tileSize, bottom );
+				unsigned int xEnd = std::min( (column + 1) * mask.tileSize, right );
+				unsigned int yEnd = std::min( (row + 1) * mask.tileSize, top );
+				if( x < xEnd && y < yEnd )
+					tiles.push_back( Tile{ x, y, xEnd - x, yEnd - y } );
+			}
+
+		pool_.parallelFor( tiles.size(), [&]( unsigned int index )
+		{
+			kernel( arguments, tiles[index] );
+		});
+		return done_;
+	}
+
+	unsigned int tilesX = (right - left + TileSize - 1)/TileSize;
+	unsigned int tilesY = (top - bottom + TileSize - 1)/TileSize;
+
+	pool_.parallelFor( tilesX * tilesY, [&]( unsigned int index )
+	{
+		Tile tile;
+		tile.x = left + (index % tilesX) * TileSize;
+		tile.y = bottom + (index / tilesX) * TileSize;
+		tile.width = std::min( TileSize, right - tile.x );
+		tile.height = std::min( TileSize, top - tile.y );
+		kernel( arguments, tile );
+	});
+
+	return done_;
+}
+
+template<typename T> vec4 CPUComputeEngine::reduceTiles( const T* data, const Engine::DataStorage::Info& info, Engine::ReductionType type )
+{
+	unsigned int rows = (info.height + TileSize - 1)/TileSize;
+	std::vector<vec4> partial( rows );
+
+	pool_.parallelFor( rows, [&]( unsigned int band )
+	{
+		float result[4];
+		for( int c = 0; c < 4; c++ )
+		{
+			if( type == Engine::Minimum ) result[c] = std::numeric_limits<float>::max();
+			else if( type == Engine::Maximum ) result[c] = -std::numeric_limits<float>::max();
+			else result[c] = 0;
+		}
+
+		unsigned int end = std::min( (band + 1) * TileSize, info.height );
+		for( unsigned int y = band * TileSize; y < end; y++ )
+		{
+			const T* row = data + size_t(y) * info.width * 4;
+			for( unsigned int x = 0; x < info.width * 4; x += 4 )
+				for( int c = 0; c < 4; c++ )
+				{
+					float value = row[x + c];
+					if( type == Engine::Minimum ) result[c] = std::min( result[c], value );
+					else if( type == Engine::Maximum ) result[c] = std::max( result[c], value );
+					else result[c] += value;
+				}
+		}
+
+		partial[band] = vec4( result[0], result[1], result[2], result[3] );
+	});
+
+	vec4 total = partial[0];
+	for( unsigned int i = 1; i < rows; i++ )
+	{
+		if( type == Engine::Minimum )
+			total = vec4( std::min(total.x, partial[i].x), std::min(total.y, partial[i].y),
+			              std::min(total.z, partial[i].z), std::min(total.w, partial[i].w) );
+		else if( type == Engine::Maximum )
+			total = vec4( std::max(total.x, partial[i].x), std::max(total.y, partial[i].y),
+			              std::max(total.z, partial[i].z), std::max(total.w, partial[i].w) );
+		else
+			total = total + partial[i];
+	}
+
+	return total;
+}
+
+vec4 CPUComputeEngine::reduce( const Engine::DataStorage::Ptr& storage, Engine::ReductionType type )
+{
+	Engine::DataStorage::Info info = storage->getInfo();
+	void* data = hostData( storage );
+
+	if( info.type == DataStorage::Float )
+		return reduceTiles( (const float*) data, info, type );
+	if( info.type == DataStorage::Int )
+		return reduceTiles( (const int*) data, info, type );
+	if( info.type == DataStorage::Byte )
+		return reduceTiles( (const unsigned char*) data, info, type );
+
+	return vec4();
+}
+
+template<typename T> void CPUComputeEngine::gatherStatistics( const T* data, const Engine::DataStorage::Info& info, Engine::Statistics& result )
+{
+	unsigned int rows = (info.height + TileSize - 1)/TileSize;
+	std::vector<Engine::Statistics> partial( rows );
+	float binScale = Engine::Statistics::Bins/(result.histogramMax - result.histogramMin);
+
+	// one pass over each band gathers everything, so the data is only read once
+	pool_.parallelFor( rows, [&]( unsigned int band )
+	{
+		Engine::Statistics& part = partial[band];
+		float low[4], high[4];
+		for( int c = 0; c < 4; c++ )
+		{
+			low[c] = std::numeric_limits<float>::max();
+			high[c] = -std::numeric_limits<float>::max();
+		}
+
+		unsigned int end = std::min( (band + 1) * TileSize, info.height );
+		for( unsigned int y = band * TileSize; y < end; y++ )
+		{
+			const T* row = data + size_t(y) * info.width * 4;
+			for( unsigned int x = 0; x < info.width * 4; x += 4 )
+			{
+				for( int c = 0; c < 4; c++ )
+				{
+					float value = row[x + c];
+					low[c] = std::min( low[c], value );
+					high[c] = std::max( high[c], value );
+				}
+
+				float bin = std::floor( (float(row[x]) - result.histogramMin) * binScale );
+				if( bin >= 0 && bin < Engine::Statistics::Bins )
+					part.histogram[int(bin)]++;
+			}
+		}
+
+		part.minimum = vec4( low[0], low[1], low[2], low[3] );
+		part.maximum = vec4( high[0], high[1], high[2], high[3] );
+	});
+
+	result.minimum = partial[0].minimum;
+	result.maximum = partial[0].maximum;
+	for( unsigned int i = 0; i < rows; i++ )
+	{
+		const vec4& low = partial[i].minimum;
+		const vec4& high = partial[i].maximum;
+		result.minimum = vec4( std::min(result.minimum.x, low.x), std::min(result.minimum.y, low.y),
+		                       std::min(result.minimum.z, low.z), std::min(result.minimum.w, low.w) );
+		result.maximum = vec4( std::max(result.maximum.x, high.x), std::max(result.maximum.y, high.y),
+		                       std::max(result.maximum.z, high.z), std::max(result.maximum.w, high.w) );
+		for( int bin = 0; bin < Engine::Statistics::Bins; bin++ )
+			result.histogram[bin] += partial[i].histogram[bin];
+	}
+
+	result.count = info.width * info.height;
+}
+
+bool CPUComputeEngine::requestStatistics( const Engine::DataStorage::Ptr& storage, float histogramMin, float histogramMax )
+{
+	if( statistics_.ready )
+		return false;
+
+	Engine::DataStorage::Info info = storage->getInfo();
+	void* data = hostData( storage );
+
+	Engine::Statistics result;
+	result.histogramMin = histogramMin;
+	result.histogramMax = histogramMax;
+
+	if( info.type == DataStorage::Float )
+		gatherStatistics( (const float*) data, info, result );
+	else if( info.type == DataStorage::Int )
+		gatherStatistics( (const int*) data, info, result );
+	else if( info.type == DataStorage::Byte )
+		gatherStatistics( (const unsigned char*) data, info, result );
+	else
+		return false;
+
+	result.ready = true;
+	statistics_ = result;
+	return true;
+}
+
+Engine::Statistics CPUComputeEngine::collectStatistics()
+{
+	Engine::Statistics result = statistics_;
+	statistics_.ready = false;
+	return result;
+}
+
+Engine::DataStorage::Ptr CPUComputeEngine::allocateStorage( const Engine::DataStorage::Info& type, int width, int height )
+{
+	DataStorage::Info info = type;
+	info.width = width;
+	info.height = height;
+	info.byteSize = width * height * 4 * typeSize( type.type );
+
+	CPUComputeEngine::DataStorage* storage = new CPUComputeEngine::DataStorage();
+	storage->setDataStorage(0);
+	storage->setInfo( info );
+	storage->data();
+
+	return Engine::DataStorage::Ptr( storage );
+}
+
+Engine::DataStorage::Ptr CPUComputeEngine::emptyStorage()
+{
+	return Engine::DataStorage::Ptr( new CPUComputeEngine::DataStorage() );
+}
+
+extern "C"
+{
+	Plugin* plugin_init()
+	{
+		kernels::registerTransformKernels();
+		kernels::registerEscapeKernels();
+		kernels::registerNewtonKernels();
+		kernels::registerLifeKernels();
+		kernels::registerConvolveKernels();
+		kernels::registerPerturbKernels();
+		kernels::registerShiftKernels();
+
+		return new CPUComputeEngine;
+	}
+}
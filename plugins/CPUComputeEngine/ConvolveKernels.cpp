@@ -0,0 +1,49 @@
+#include <libcompute.hpp>
+using namespace libcompute;
+
+#include "Kernels.hpp"
+
+namespace
+{
+
+/** Applies a normalised 3x3 convolution, like convolve.frag. */
+void convolveKernel( const KernelArguments& arguments, const Tile& tile )
+{
+	float kernel[9];
+	float kernelSum = 0;
+
+	const float* values = &arguments.parameter<float>(0);
+	for( int i = 0; i < 9; i++ )
+	{
+		kernel[i] = values[i];
+		kernelSum += kernel[i];
+	}
+
+	float scale = (kernelSum != 0)? 1/kernelSum: 1;
+
+	for( unsigned int y = tile.y; y < tile.y + tile.height; y++ )
+	{
+		float* element = arguments.outputElement( 0, tile.x, y );
+		for( unsigned int x = tile.x; x < tile.x + tile.width; x++, element += 4 )
+		{
+			float sum[4] = { 0, 0, 0, 0 };
+
+			for( int i = 0; i < 9; i++ )
+			{
+				const float* source = arguments.inputElement( 0, x + i % 3 - 1, y + i / 3 - 1 );
+				for( int c = 0; c < 4; c++ )
+					sum[c] += source[c] * kernel[i];
+			}
+
+			for( int c = 0; c < 4; c++ )
+				element[c] = sum[c] * scale;
+		}
+	}
+}
+
+};
+
+void kernels::registerConvolveKernels()
+{
+	KernelRegistry::instance().registerKernel( "convolve", &convolveKernel, { "convolveKernel" } );
+}
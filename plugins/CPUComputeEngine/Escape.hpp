@@ -0,0 +1,367 @@
+/**
+ * @file Escape.hpp
+ * @brief The vectorised escape time loop shared by the per-ISA escape kernels.
+ *
+ * This header is compiled once per instruction set with different compiler
+ * flags, so it must not pull in libcompute or the standard library: any inline
+ * function they define would be built with wider instructions in one object
+ * and could be picked by the linker for all of them.  Everything here is plain
+ * data, and the loop itself lives in an anonymous namespace so every object
+ * keeps its own copy.
+ */
+#ifndef CPUCOMPUTEENGINE_ESCAPE_HPP
+#define CPUCOMPUTEENGINE_ESCAPE_HPP
+
+#include <stddef.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace kernels
+{
+
+/** The formulas an escape loop can iterate. */
+enum EscapeFormula
+{
+	EscapeMandelbrot, ///< The mandelbrot entry of escapes.xml
+	EscapeHenon, ///< The henon entry of escapes.xml
+	EscapeBytecode ///< Any formula, compiled by the EscapeCompiler
+};
+
+/** The operations of compiled escape formulas. */
+enum EscapeOpcode
+{
+	OpAdd,
+	OpSubtract,
+	OpMultiply,
+	OpDivide,
+	OpNegate,
+	OpAbs,
+	OpSqrt,
+	OpSin,
+	OpCos,
+	OpExp,
+	OpLog,
+	OpPow
+};
+
+/** Sets register \a destination to \a left \a opcode \a right, or to \a opcode( \a left ) for single operand operations. */
+struct EscapeInstruction
+{
+	unsigned char opcode;
+	unsigned char destination;
+	unsigned char left;
+	unsigned char right;
+};
+
+/**
+ * @brief An escape formula compiled to register bytecode.
+ *
+ * Registers 0 to 3 hold [x], [y], [cx] and [cy].  The next constantCount
+ * registers are loaded once per Tile, either with a literal or with an element
+ * of the p parameter array, and every instruction writes a new register after
+ * those.  Both results are computed from the previous [x] and [y], just like
+ * the two assignments of escape.frag.
+ */
+struct EscapeProgram
+{
+	static const unsigned int MaxRegisters = 128;
+	static const unsigned int MaxInstructions = 124;
+
+	unsigned int registerCount; ///< The number of registers used
+	unsigned int constantCount; ///< The number of registers loaded before the loop
+	float constants[MaxRegisters]; ///< The literal held by each constant register
+	int parameters[MaxRegisters]; ///< The index into p held by each constant register, or -1 for literals
+
+	unsigned int instructionCount; ///< The number of instructions
+	EscapeInstruction instructions[MaxInstructions]; ///< The instructions, run in order
+
+	unsigned char resultX; ///< The register holding the new [x]
+	unsigned char resultY; ///< The register holding the new [y]
+};
+
+/** Everything an escape loop needs, gathered from the Program once per Tile. */
+struct EscapeArguments
+{
+	EscapeFormula formula; ///< The formula to iterate
+	int maxIterations; ///< Points that have not escaped after this many iterations are marked -1
+	float radiusSquared; ///< The square of escapeRadius
+	float p[32]; ///< The values of the p parameter array
+	const EscapeProgram* program; ///< The bytecode run when formula is EscapeBytecode
+
+	const float* input; ///< The starting points, four floats per element
+	unsigned int inputWidth; ///< The width of the input
+	unsigned int inputHeight; ///< The height of the input
+
+	float* output; ///< The iteration counts, four floats per element
+	unsigned int width; ///< The width of the output
+
+	unsigned int x; ///< The left edge of the Tile
+	unsigned int y; ///< The bottom edge of the Tile
+	unsigned int tileWidth; ///< The width of the Tile
+	unsigned int tileHeight; ///< The height of the Tile
+};
+
+typedef void (*EscapeTileFunction)( const EscapeArguments& arguments );
+
+/** Runs four lanes at a time with whatever vector unit the plugin was built for. */
+void escapeTileGeneric( const EscapeArguments& arguments );
+
+/** Runs eight lanes at a time.  Only call this when the CPU has AVX2 and FMA. */
+void escapeTileAVX2( const EscapeArguments& arguments );
+
+/** Runs sixteen lanes at a time.  Only call this when the CPU has AVX-512F. */
+void escapeTileAVX512( const EscapeArguments& arguments );
+
+};
+
+namespace
+{
+
+/** Vectors of \a Lanes floats and ints, using the GCC vector extensions. */
+template<int Lanes> struct Vectors
+{
+	typedef float Float __attribute__((vector_size( Lanes * sizeof(float) )));
+	typedef int Int __attribute__((vector_size( Lanes * sizeof(int) )));
+};
+
+/**
+ * @brief Checks to see if any lane of a mask is set.
+ *
+ * Uses a single test instruction for the native vector width of the object
+ * being compiled, and falls back to or-ing the lanes together otherwise.
+ */
+template<int Lanes> bool anyLane( typename Vectors<Lanes>::Int mask )
+{
+#if defined(__AVX512F__)
+	if constexpr( Lanes == 16 )
+		return _mm512_test_epi32_mask( (__m512i) mask, (__m512i) mask ) != 0;
+#endif
+#if defined(__AVX__)
+	if constexpr( Lanes == 8 )
+		return !_mm256_testz_si256( (__m256i) mask, (__m256i) mask );
+#endif
+#if defined(__SSE2__)
+	if constexpr( Lanes == 4 )
+		return _mm_movemask_epi8( (__m128i) mask ) != 0;
+#endif
+
+	int any = 0;
+	for( int lane = 0; lane < Lanes; lane++ )
+		any |= mask[lane];
+	return any != 0;
+}
+
+/**
+ * @brief The mandelbrot entry of escapes.xml.
+ *
+ * Formulas iterate Count vectors of \a Lanes points in every step.
+ */
+template<int Lanes> struct Mandelbrot
+{
+	typedef typename Vectors<Lanes>::Float FloatV;
+	static const int Count = 1;
+
+	Mandelbrot( const kernels::EscapeArguments& arguments ) {}
+
+	void step( const FloatV* x, const FloatV* y, const FloatV* cx, const FloatV* cy, const float* p, FloatV* nx, FloatV* ny )
+	{
+		nx[0] = x[0] * x[0] - y[0] * y[0] + cx[0];
+		ny[0] = 2.0f * x[0] * y[0] + cy[0];
+	}
+};
+
+/** The henon entry of escapes.xml. */
+template<int Lanes> struct Henon
+{
+	typedef typename Vectors<Lanes>::Float FloatV;
+	static const int Count = 1;
+
+	Henon( const kernels::EscapeArguments& arguments ) {}
+
+	void step( const FloatV* x, const FloatV* y, const FloatV* cx, const FloatV* cy, const float* p, FloatV* nx, FloatV* ny )
+	{
+		nx[0] = 1.0f - p[0] * x[0] * x[0] + y[0];
+		ny[0] = p[1] * x[0];
+	}
+};
+
+/**
+ * @brief Interprets an EscapeProgram.
+ *
+ * Every instruction works on Count whole vectors at once, so the cost of
+ * decoding it is shared by Count * \a Lanes points.  More vectors share it
+ * further, but points that escape early then wait on more neighbours.
+ */
+template<int Lanes> class Bytecode
+{
+public:
+	typedef typename Vectors<Lanes>::Float FloatV;
+	static const int Count = 4;
+
+	Bytecode( const kernels::EscapeArguments& arguments )
+	: program_(*arguments.program)
+	{
+		for( unsigned int i = 0; i < program_.constantCount; i++ )
+		{
+			int parameter = program_.parameters[4 + i];
+			float value = parameter < 0 ? program_.constants[4 + i] : arguments.p[parameter];
+			for( int v = 0; v < Count; v++ )
+				registers_[4 + i][v] = FloatV{} + value;
+		}
+	}
+
+	void step( const FloatV* x, const FloatV* y, const FloatV* cx, const FloatV* cy, const float* p, FloatV* nx, FloatV* ny )
+	{
+		for( int v = 0; v < Count; v++ )
+		{
+			registers_[0][v] = x[v];
+			registers_[1][v] = y[v];
+			registers_[2][v] = cx[v];
+			registers_[3][v] = cy[v];
+		}
+
+		const kernels::EscapeInstruction* instruction = program_.instructions;
+		const kernels::EscapeInstruction* end = instruction + program_.instructionCount;
+		for( ; instruction != end; instruction++ )
+		{
+			FloatV* result = registers_[instruction->destination];
+			const FloatV* left = registers_[instruction->left];
+			const FloatV* right = registers_[instruction->right];
+
+			switch( instruction->opcode )
+			{
+				case kernels::OpAdd: for( int v = 0; v < Count; v++ ) result[v] = left[v] + right[v]; break;
+				case kernels::OpSubtract: for( int v = 0; v < Count; v++ ) result[v] = left[v] - right[v]; break;
+				case kernels::OpMultiply: for( int v = 0; v < Count; v++ ) result[v] = left[v] * right[v]; break;
+				case kernels::OpDivide: for( int v = 0; v < Count; v++ ) result[v] = left[v] / right[v]; break;
+				case kernels::OpNegate: for( int v = 0; v < Count; v++ ) result[v] = -left[v]; break;
+				case kernels::OpAbs: lanewise( result, left, right, []( float a, float b ) { return __builtin_fabsf(a); } ); break;
+				case kernels::OpSqrt: lanewise( result, left, right, []( float a, float b ) { return __builtin_sqrtf(a); } ); break;
+				case kernels::OpSin: lanewise( result, left, right, []( float a, float b ) { return __builtin_sinf(a); } ); break;
+				case kernels::OpCos: lanewise( result, left, right, []( float a, float b ) { return __builtin_cosf(a); } ); break;
+				case kernels::OpExp: lanewise( result, left, right, []( float a, float b ) { return __builtin_expf(a); } ); break;
+				case kernels::OpLog: lanewise( result, left, right, []( float a, float b ) { return __builtin_logf(a); } ); break;
+				case kernels::OpPow: lanewise( result, left, right, []( float a, float b ) { return __builtin_powf(a, b); } ); break;
+			}
+		}
+
+		for( int v = 0; v < Count; v++ )
+		{
+			nx[v] = registers_[program_.resultX][v];
+			ny[v] = registers_[program_.resultY][v];
+		}
+	}
+
+private:
+	/** Applies a function with no vector form to every lane. */
+	template<typename Function> static void lanewise( FloatV* result, const FloatV* left, const FloatV* right, Function function )
+	{
+		for( int v = 0; v < Count; v++ )
+			for( int lane = 0; lane < Lanes; lane++ )
+				result[v][lane] = function( left[v][lane], right[v][lane] );
+	}
+
+	const kernels::EscapeProgram& program_;
+	FloatV registers_[kernels::EscapeProgram::MaxRegisters][Count];
+};
+
+/**
+ * @brief Iterates Formula::Count vectors of \a Lanes points until every one of them has escaped.
+ *
+ * Each lane keeps its own escape mask.  A lane that escapes records the
+ * iteration it escaped on and is masked out, and the loop stops early as soon
+ * as no lane is left running, so a group of points costs as much as its
+ * slowest one.
+ */
+template<int Lanes, class Formula> void escapeRow( const kernels::EscapeArguments& arguments, Formula& formula, const float* inputRow, float* outputRow )
+{
+	typedef typename Vectors<Lanes>::Float FloatV;
+	typedef typename Vectors<Lanes>::Int IntV;
+	const int Count = Formula::Count;
+	const unsigned int Width = Lanes * Count;
+
+	for( unsigned int x = 0; x < arguments.tileWidth; x += Width )
+	{
+		unsigned int points = arguments.tileWidth - x < Width ? arguments.tileWidth - x : Width;
+
+		FloatV cx[Count] = {}, cy[Count] = {};
+		IntV active[Count] = {};
+		for( unsigned int point = 0; point < points; point++ )
+		{
+			const float* start = inputRow + ((arguments.x + x + point) % arguments.inputWidth) * 4;
+			cx[point / Lanes][point % Lanes] = start[0];
+			cy[point / Lanes][point % Lanes] = start[1];
+			active[point / Lanes][point % Lanes] = -1;
+		}
+
+		// Masks are -1 in running lanes, so subtracting them counts the
+		// iterations each lane survived.
+		IntV survived[Count] = {};
+
+		FloatV lastX[Count], lastY[Count], valueX[Count], valueY[Count];
+		for( int v = 0; v < Count; v++ )
+		{
+			lastX[v] = cx[v];
+			lastY[v] = cy[v];
+		}
+
+		for( int i = 1; i < arguments.maxIterations; i++ )
+		{
+			formula.step( lastX, lastY, cx, cy, arguments.p, valueX, valueY );
+
+			IntV running = {};
+			for( int v = 0; v < Count; v++ )
+			{
+				IntV escaped = valueX[v] * valueX[v] + valueY[v] * valueY[v] > arguments.radiusSquared;
+				active[v] &= ~escaped;
+				survived[v] -= active[v];
+				running |= active[v];
+
+				lastX[v] = valueX[v];
+				lastY[v] = valueY[v];
+			}
+
+			if( !anyLane<Lanes>( running ) )
+				break;
+		}
+
+		float* element = outputRow + x * 4;
+		for( unsigned int point = 0; point < points; point++, element += 4 )
+		{
+			// A lane that escaped on iteration i survived i - 1 of them.
+			int count = active[point / Lanes][point % Lanes] ? -1 : survived[point / Lanes][point % Lanes] + 1;
+			element[0] = count;
+			element[1] = 0;
+			element[2] = 0;
+			element[3] = 0;
+		}
+	}
+}
+
+/** Runs the escape loop for \a Formula over a whole Tile. */
+template<int Lanes, class Formula> void escapeTile( const kernels::EscapeArguments& arguments )
+{
+	Formula formula( arguments );
+	for( unsigned int y = arguments.y; y < arguments.y + arguments.tileHeight; y++ )
+	{
+		const float* inputRow = arguments.input + size_t(y % arguments.inputHeight) * arguments.inputWidth * 4;
+		float* outputRow = arguments.output + (size_t(y) * arguments.width + arguments.x) * 4;
+		escapeRow<Lanes, Formula>( arguments, formula, inputRow, outputRow );
+	}
+}
+
+/** Runs the escape loop for the formula in \a arguments over a whole Tile, \a Lanes points at a time. */
+template<int Lanes> void escapeTile( const kernels::EscapeArguments& arguments )
+{
+	switch( arguments.formula )
+	{
+		case kernels::EscapeMandelbrot: escapeTile<Lanes, Mandelbrot<Lanes> >( arguments ); break;
+		case kernels::EscapeHenon: escapeTile<Lanes, Henon<Lanes> >( arguments ); break;
+		case kernels::EscapeBytecode: escapeTile<Lanes, Bytecode<Lanes> >( arguments ); break;
+	}
+}
+
+};
+
+#endif
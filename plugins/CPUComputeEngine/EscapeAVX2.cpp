@@ -0,0 +1,6 @@
+#include "Escape.hpp"
+
+void kernels::escapeTileAVX2( const EscapeArguments& arguments )
+{
+	escapeTile<8>( arguments );
+}
@@ -0,0 +1,6 @@
+#include "Escape.hpp"
+
+void kernels::escapeTileAVX512( const EscapeArguments& arguments )
+{
+	escapeTile<16>( arguments );
+}
@@ -0,0 +1,156 @@
+/**
+ * @file EscapeBenchmark.cpp
+ * @brief Measures the escape loops of the CPUComputeEngine in pixels per second per core.
+ *
+ * Build with "make benchmark" and run ./escape-benchmark [width height [threads]].
+ * Every loop the CPU supports is run over the default plane of each formula,
+ * both natively and as bytecode from the EscapeCompiler, first on one thread
+ * and then on all of them, and its iteration counts are compared against the
+ * generic loop.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "Escape.hpp"
+#include "EscapeCompiler.hpp"
+
+using namespace kernels;
+
+struct Formula
+{
+	const char* name;
+	EscapeFormula formula;
+	float radius;
+	float p[2];
+	const char* source; ///< The formula to compile when formula is EscapeBytecode
+};
+
+struct Loop
+{
+	const char* name;
+	EscapeTileFunction function;
+	bool supported;
+};
+
+/** Runs \a loop over the whole of \a arguments, split into bands of rows across \a threads threads. */
+static double run( const Loop& loop, EscapeArguments arguments, unsigned int height, unsigned int threads )
+{
+	std::vector<std::thread> workers;
+	auto start = std::chrono::steady_clock::now();
+
+	unsigned int band = (height + threads - 1)/threads;
+	for( unsigned int i = 0; i < threads; i++ )
+	{
+		EscapeArguments part = arguments;
+		part.y = i * band;
+		part.tileHeight = part.y < height ? std::min( band, height - part.y ) : 0;
+		workers.push_back( std::thread( loop.function, part ) );
+	}
+
+	for( std::thread& worker: workers )
+		worker.join();
+
+	return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+}
+
+int main( int argc, char** argv )
+{
+	unsigned int width = argc > 2 ? atoi(argv[1]) : 1920;
+	unsigned int height = argc > 2 ? atoi(argv[2]) : 1080;
+	unsigned int threads = argc > 3 ? atoi(argv[3]) : std::thread::hardware_concurrency();
+	if( threads == 0 ) threads = 1;
+
+	__builtin_cpu_init();
+	Loop loops[] =
+	{
+		{ "generic", escapeTileGeneric, true },
+		{ "AVX2", escapeTileAVX2, __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") },
+		{ "AVX-512", escapeTileAVX512, __builtin_cpu_supports("avx512f") != 0 },
+	};
+
+	Formula formulas[] =
+	{
+		{ "mandelbrot", EscapeMandelbrot, 2, { 0, 0 }, NULL },
+		{ "henon", EscapeHenon, 10, { .2f, 1.01f }, NULL },
+		{ "mandelbrot", EscapeBytecode, 2, { 0, 0 }, "x = [x] * [x] - [y] * [y] + [cx]; y = 2 * [x] * [y] + [cy];" },
+		{ "henon", EscapeBytecode, 10, { .2f, 1.01f }, "x = 1 - p[0] * [x] * [x] + [y]; y = p[1] * [x];" },
+	};
+
+	// The plane escape.lua starts on, with an aspect ratio to match the output.
+	std::vector<float> plane( size_t(width) * height * 4 );
+	float yMin = -1.5f, yMax = 1.5f;
+	float xLength = (yMax - yMin) * width/height;
+	for( unsigned int y = 0; y < height; y++ )
+		for( unsigned int x = 0; x < width; x++ )
+		{
+			float* element = &plane[(size_t(y) * width + x) * 4];
+			element[0] = -xLength/2 + xLength * (x + .5f)/width;
+			element[1] = yMin + (yMax - yMin) * (y + .5f)/height;
+		}
+
+	std::vector<float> reference( plane.size() ), output( plane.size() );
+
+	printf("%u x %u, %u threads\n", width, height, threads);
+	for( const Formula& formula: formulas )
+	{
+		EscapeArguments arguments = {};
+		arguments.formula = formula.formula;
+		arguments.maxIterations = 500;
+		arguments.radiusSquared = formula.radius * formula.radius;
+		arguments.p[0] = formula.p[0];
+		arguments.p[1] = formula.p[1];
+
+		EscapeProgram program;
+		if( formula.source != NULL )
+		{
+			EscapeCompiler compiler;
+			if( !compiler.compile( formula.source, program ) )
+			{
+				printf("%s could not be compiled: %s\n", formula.name, compiler.getError().c_str());
+				return 1;
+			}
+			arguments.program = &program;
+		}
+		const char* kind = formula.source != NULL ? "bytecode" : "native";
+		arguments.input = plane.data();
+		arguments.inputWidth = width;
+		arguments.inputHeight = height;
+		arguments.width = width;
+		arguments.tileWidth = width;
+
+		for( const Loop& loop: loops )
+		{
+			if( !loop.supported )
+			{
+				printf("%-10s %-8s %-8s not supported by this CPU\n", formula.name, kind, loop.name);
+				continue;
+			}
+
+			arguments.output = loop.function == escapeTileGeneric ? reference.data() : output.data();
+
+			// Warm up once, then keep the best of a few runs.
+			double single = run( loop, arguments, height, 1 );
+			double multi = run( loop, arguments, height, threads );
+			for( int i = 0; i < 3; i++ )
+			{
+				single = std::min( single, run( loop, arguments, height, 1 ) );
+				multi = std::min( multi, run( loop, arguments, height, threads ) );
+			}
+
+			size_t mismatches = 0;
+			if( loop.function != escapeTileGeneric )
+				for( size_t i = 0; i < plane.size(); i += 4 )
+					mismatches += output[i] != reference[i];
+
+			double pixels = double(width) * height;
+			printf("%-10s %-8s %-8s %8.2f Mpixels/s/core on 1 thread, %8.2f Mpixels/s/core on %u, %zu pixels differ from generic\n",
+				formula.name, kind, loop.name, pixels/single/1e6, pixels/multi/threads/1e6, threads, mismatches);
+		}
+	}
+
+	return 0;
+}
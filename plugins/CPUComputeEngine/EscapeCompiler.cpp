@@ -0,0 +1,382 @@
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "EscapeCompiler.hpp"
+
+using namespace kernels;
+
+bool EscapeCompiler::compile( const std::string& source, EscapeProgram& program )
+{
+	source_ = source;
+	position_ = 0;
+	error_.clear();
+	program_ = &program;
+	literals_.clear();
+	parameters_.clear();
+	constants_.clear();
+	instructionCount_ = 0;
+
+	program.registerCount = 4;
+	program.constantCount = 0;
+	for( unsigned int i = 0; i < EscapeProgram::MaxRegisters; i++ )
+	{
+		program.constants[i] = 0;
+		program.parameters[i] = -1;
+	}
+
+	unsigned char results[2];
+	bool assigned[2] = { false, false };
+
+	for( int i = 0; i < 2; i++ )
+	{
+		skipSpace();
+		size_t start = position_;
+		std::string name = identifier();
+		if( name != "x" && name != "y" )
+		{
+			position_ = start;
+			return fail( "expected an assignment to x or y" );
+		}
+
+		int index = name == "x" ? 0 : 1;
+		if( assigned[index] )
+			return fail( name + " is assigned twice" );
+
+		if( !parseAssignment( results[index] ) )
+			return false;
+		assigned[index] = true;
+	}
+
+	skipSpace();
+	if( position_ != source_.size() )
+		return fail( "unexpected text after the assignments" );
+
+	program.instructionCount = instructionCount_;
+	program.resultX = results[0];
+	program.resultY = results[1];
+	renumber();
+	return true;
+}
+
+void EscapeCompiler::renumber()
+{
+	// Registers were handed out in the order they were parsed.  Move the
+	// constants straight after the inputs so the escape loops can load them
+	// in one block, and the instruction results after those.
+	unsigned char registers[EscapeProgram::MaxRegisters];
+	for( unsigned char i = 0; i < 4; i++ )
+		registers[i] = i;
+
+	unsigned char next = 4;
+	for( unsigned char reg: constants_ )
+		registers[reg] = next++;
+	for( unsigned int i = 0; i < program_->instructionCount; i++ )
+		registers[program_->instructions[i].destination] = next++;
+
+	float constants[EscapeProgram::MaxRegisters];
+	int parameters[EscapeProgram::MaxRegisters];
+	for( unsigned int i = 0; i < EscapeProgram::MaxRegisters; i++ )
+	{
+		constants[i] = 0;
+		parameters[i] = -1;
+	}
+
+	for( unsigned char reg: constants_ )
+	{
+		constants[registers[reg]] = program_->constants[reg];
+		parameters[registers[reg]] = program_->parameters[reg];
+	}
+
+	for( unsigned int i = 0; i < EscapeProgram::MaxRegisters; i++ )
+	{
+		program_->constants[i] = constants[i];
+		program_->parameters[i] = parameters[i];
+	}
+
+	for( unsigned int i = 0; i < program_->instructionCount; i++ )
+	{
+		EscapeInstruction& instruction = program_->instructions[i];
+		instruction.destination = registers[instruction.destination];
+		instruction.left = registers[instruction.left];
+		instruction.right = registers[instruction.right];
+	}
+
+	program_->resultX = registers[program_->resultX];
+	program_->resultY = registers[program_->resultY];
+}
+
+bool EscapeCompiler::parseAssignment( unsigned char& result )
+{
+	if( !expect('=') )
+		return false;
+
+	Operand value;
+	if( !parseExpression( value ) || !toRegister( value ) )
+		return false;
+
+	result = value.reg;
+	accept(';');
+	return true;
+}
+
+bool EscapeCompiler::parseExpression( Operand& result )
+{
+	if( !parseTerm( result ) )
+		return false;
+
+	while( true )
+	{
+		EscapeOpcode opcode;
+		if( accept('+') ) opcode = OpAdd;
+		else if( accept('-') ) opcode = OpSubtract;
+		else return true;
+
+		Operand right;
+		if( !parseTerm( right ) || !emit( opcode, result, right, result ) )
+			return false;
+	}
+}
+
+bool EscapeCompiler::parseTerm( Operand& result )
+{
+	if( !parseUnary( result ) )
+		return false;
+
+	while( true )
+	{
+		EscapeOpcode opcode;
+		if( accept('*') ) opcode = OpMultiply;
+		else if( accept('/') ) opcode = OpDivide;
+		else return true;
+
+		Operand right;
+		if( !parseUnary( right ) || !emit( opcode, result, right, result ) )
+			return false;
+	}
+}
+
+bool EscapeCompiler::parseUnary( Operand& result )
+{
+	if( accept('-') )
+	{
+		Operand operand;
+		return parseUnary( operand ) && emit( OpNegate, operand, operand, result );
+	}
+
+	accept('+');
+	return parsePrimary( result );
+}
+
+bool EscapeCompiler::parsePrimary( Operand& result )
+{
+	skipSpace();
+	if( position_ >= source_.size() )
+		return fail( "unexpected end of formula" );
+
+	if( accept('(') )
+		return parseExpression( result ) && expect(')');
+
+	char c = source_[position_];
+	if( isdigit(c) || c == '.' )
+	{
+		const char* start = source_.c_str() + position_;
+		char* end;
+		result.literal = true;
+		result.value = strtof( start, &end );
+		position_ += end - start;
+		return true;
+	}
+
+	if( accept('[') )
+	{
+		static const char* inputs[] = { "x", "y", "cx", "cy" };
+		std::string name = identifier();
+		if( !expect(']') )
+			return false;
+
+		for( unsigned char i = 0; i < 4; i++ )
+			if( name == inputs[i] )
+			{
+				result.literal = false;
+				result.reg = i;
+				return true;
+			}
+
+		return fail( "unknown variable [" + name + "]" );
+	}
+
+	std::string name = identifier();
+	if( name.empty() )
+		return fail( std::string("unexpected '") + c + "'" );
+
+	if( name == "p" )
+	{
+		skipSpace();
+		if( !expect('[') )
+			return false;
+
+		skipSpace();
+		char* end;
+		const char* start = source_.c_str() + position_;
+		long index = strtol( start, &end, 10 );
+		if( end == start || index < 0 || index >= 32 )
+			return fail( "p must be indexed by a number from 0 to 31" );
+		position_ += end - start;
+
+		if( !expect(']') )
+			return false;
+
+		result.literal = false;
+		return constantRegister( 0, index, result.reg );
+	}
+
+	static const struct { const char* name; EscapeOpcode opcode; int arguments; } functions[] =
+	{
+		{ "abs", OpAbs, 1 }, { "sqrt", OpSqrt, 1 }, { "sin", OpSin, 1 }, { "cos", OpCos, 1 },
+		{ "exp", OpExp, 1 }, { "log", OpLog, 1 }, { "pow", OpPow, 2 }
+	};
+
+	for( auto& function: functions )
+	{
+		if( name != function.name )
+			continue;
+
+		Operand left, right;
+		if( !expect('(') || !parseExpression( left ) )
+			return false;
+
+		right = left;
+		if( function.arguments == 2 && ( !expect(',') || !parseExpression( right ) ) )
+			return false;
+
+		return expect(')') && emit( function.opcode, left, right, result );
+	}
+
+	return fail( "unknown function " + name );
+}
+
+bool EscapeCompiler::emit( EscapeOpcode opcode, Operand left, Operand right, Operand& result )
+{
+	if( left.literal && right.literal )
+	{
+		float a = left.value, b = right.value;
+		float value = 0;
+		switch( opcode )
+		{
+			case OpAdd: value = a + b; break;
+			case OpSubtract: value = a - b; break;
+			case OpMultiply: value = a * b; break;
+			case OpDivide: value = a / b; break;
+			case OpNegate: value = -a; break;
+			case OpAbs: value = std::fabs(a); break;
+			case OpSqrt: value = std::sqrt(a); break;
+			case OpSin: value = std::sin(a); break;
+			case OpCos: value = std::cos(a); break;
+			case OpExp: value = std::exp(a); break;
+			case OpLog: value = std::log(a); break;
+			case OpPow: value = std::pow(a, b); break;
+		}
+
+		result.literal = true;
+		result.value = value;
+		return true;
+	}
+
+	if( !toRegister( left ) || !toRegister( right ) )
+		return false;
+
+	if( instructionCount_ >= EscapeProgram::MaxInstructions || program_->registerCount >= EscapeProgram::MaxRegisters )
+		return fail( "formula is too long" );
+
+	EscapeInstruction& instruction = program_->instructions[instructionCount_++];
+	instruction.opcode = opcode;
+	instruction.destination = program_->registerCount++;
+	instruction.left = left.reg;
+	instruction.right = right.reg;
+
+	result.literal = false;
+	result.reg = instruction.destination;
+	return true;
+}
+
+bool EscapeCompiler::toRegister( Operand& operand )
+{
+	if( !operand.literal )
+		return true;
+
+	operand.literal = false;
+	return constantRegister( operand.value, -1, operand.reg );
+}
+
+bool EscapeCompiler::constantRegister( float value, int parameter, unsigned char& reg )
+{
+	if( parameter < 0 && literals_.count(value) > 0 )
+	{
+		reg = literals_[value];
+		return true;
+	}
+	if( parameter >= 0 && parameters_.count(parameter) > 0 )
+	{
+		reg = parameters_[parameter];
+		return true;
+	}
+
+	if( program_->registerCount >= EscapeProgram::MaxRegisters )
+		return fail( "formula is too long" );
+
+	reg = program_->registerCount++;
+	program_->constantCount++;
+	program_->constants[reg] = value;
+	program_->parameters[reg] = parameter;
+	constants_.push_back( reg );
+
+	if( parameter < 0 )
+		literals_[value] = reg;
+	else
+		parameters_[parameter] = reg;
+
+	return true;
+}
+
+void EscapeCompiler::skipSpace()
+{
+	while( position_ < source_.size() && isspace( source_[position_] ) )
+		position_++;
+}
+
+bool EscapeCompiler::accept( char c )
+{
+	skipSpace();
+	if( position_ < source_.size() && source_[position_] == c )
+	{
+		position_++;
+		return true;
+	}
+	return false;
+}
+
+bool EscapeCompiler::expect( char c )
+{
+	if( accept(c) )
+		return true;
+	return fail( std::string("expected '") + c + "'" );
+}
+
+std::string EscapeCompiler::identifier()
+{
+	skipSpace();
+	size_t start = position_;
+	while( position_ < source_.size() && ( isalnum( source_[position_] ) || source_[position_] == '_' ) )
+		position_++;
+	return source_.substr( start, position_ - start );
+}
+
+bool EscapeCompiler::fail( const std::string& error )
+{
+	char location[32];
+	snprintf( location, sizeof(location), " at character %u", (unsigned int) position_ );
+	error_ = error + location;
+	return false;
+}
@@ -0,0 +1,86 @@
+/**
+ * @file EscapeCompiler.hpp
+ * @brief Compiles the formulas of escapes.xml to bytecode for the escape loops.
+ */
+#ifndef CPUCOMPUTEENGINE_ESCAPECOMPILER_HPP
+#define CPUCOMPUTEENGINE_ESCAPECOMPILER_HPP
+
+#include <string>
+#include <map>
+#include <vector>
+
+#include "Escape.hpp"
+
+namespace kernels
+{
+
+/**
+ * @brief Compiles escape formulas to EscapeProgram bytecode.
+ *
+ * The source holds one assignment for each of x and y, with the same
+ * expressions escape.frag has substituted into it:
+ * @code
+ * x = [x] * [x] - [y] * [y] + [cx];
+ * y = 2 * [x] * [y] + [cy];
+ * @endcode
+ * Expressions can use [x], [y], [cx] and [cy], elements of the p parameter
+ * array as p[i], numbers, + - * / and parentheses, and the functions abs,
+ * sqrt, sin, cos, exp, log and pow.  Operations on numbers alone are folded
+ * while compiling.
+ */
+class EscapeCompiler
+{
+public:
+
+	/**
+	 * @brief Compiles a pair of escape formulas.
+	 * @param source The assignments to compile.
+	 * @param program The program to write the bytecode to.
+	 * @return True if the source compiled, otherwise false and getError() says why.
+	 */
+	bool compile( const std::string& source, EscapeProgram& program );
+
+	/** Gets the reason the last compile failed. */
+	const std::string& getError() const { return error_; }
+
+private:
+
+	/** A value while compiling: either a literal yet to be placed in a register, or a register. */
+	struct Operand
+	{
+		bool literal;
+		float value;
+		unsigned char reg;
+	};
+
+	bool parseAssignment( unsigned char& result );
+	bool parseExpression( Operand& result );
+	bool parseTerm( Operand& result );
+	bool parseUnary( Operand& result );
+	bool parsePrimary( Operand& result );
+
+	bool emit( EscapeOpcode opcode, Operand left, Operand right, Operand& result );
+	bool toRegister( Operand& operand );
+	bool constantRegister( float value, int parameter, unsigned char& reg );
+	void renumber();
+
+	void skipSpace();
+	bool accept( char c );
+	bool expect( char c );
+	std::string identifier();
+	bool fail( const std::string& error );
+
+	std::string source_;
+	size_t position_;
+	std::string error_;
+
+	EscapeProgram* program_;
+	std::map<float, unsigned char> literals_;
+	std::map<int, unsigned char> parameters_;
+	std::vector<unsigned char> constants_;
+	unsigned int instructionCount_;
+};
+
+};
+
+#endif
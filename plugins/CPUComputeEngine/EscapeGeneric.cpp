@@ -0,0 +1,6 @@
+#include "Escape.hpp"
+
+void kernels::escapeTileGeneric( const EscapeArguments& arguments )
+{
+	escapeTile<4>( arguments );
+}
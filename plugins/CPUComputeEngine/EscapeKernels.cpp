@@ -0,0 +1,136 @@
+#include <libcompute.hpp>
+using namespace libcompute;
+
+#include "Kernels.hpp"
+#include "Escape.hpp"
+#include "EscapeCompiler.hpp"
+
+#include <memory>
+
+using namespace kernels;
+
+namespace
+{
+
+/** Picks the widest escape loop the CPU running the plugin can execute. */
+EscapeTileFunction selectEscapeTile()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports("avx512f") )
+	{
+		printf("CPUComputeEngine: escape kernels using AVX-512.\n");
+		return escapeTileAVX512;
+	}
+	if( __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") )
+	{
+		printf("CPUComputeEngine: escape kernels using AVX2.\n");
+		return escapeTileAVX2;
+	}
+#endif
+	return escapeTileGeneric;
+}
+
+/** The Parameters of the escape kernels, in the order they are registered with. */
+enum EscapeParameter { MaxIterations, EscapeRadius, P };
+
+const KernelParameters EscapeParameters = { "maxIterations", "escapeRadius", "p" };
+
+/**
+ * @brief Creates a Kernel that runs the vectorised escape loop for \a formula.
+ * @param bytecode The compiled formula, when \a formula is EscapeBytecode.
+ *
+ * The output matches escape.frag: the iteration a point escaped on, or -1 if
+ * it never did.
+ */
+Kernel escapeKernel( EscapeFormula formula, EscapeTileFunction escapeTile, std::shared_ptr<EscapeProgram> bytecode = std::shared_ptr<EscapeProgram>() )
+{
+	return [formula, escapeTile, bytecode]( const KernelArguments& arguments, const Tile& tile )
+	{
+		EscapeArguments escape;
+		escape.formula = formula;
+		escape.program = bytecode.get();
+		escape.maxIterations = arguments.parameter<int>(MaxIterations);
+		float radius = arguments.parameter<float>(EscapeRadius);
+		escape.radiusSquared = radius * radius;
+
+		const float* values = &arguments.parameter<float>(P);
+		unsigned int size = arguments.parameterSize(P);
+		for( unsigned int i = 0; i < 32; i++ )
+			escape.p[i] = i < size ? values[i] : 0;
+
+		escape.input = (const float*) arguments.inputs[0];
+		escape.inputWidth = arguments.inputInfo[0].width;
+		escape.inputHeight = arguments.inputInfo[0].height;
+		escape.output = (float*) arguments.outputs[0];
+		escape.width = arguments.width;
+
+		escape.x = tile.x;
+		escape.y = tile.y;
+		escape.tileWidth = tile.width;
+		escape.tileHeight = tile.height;
+
+		escapeTile( escape );
+	};
+}
+
+/** Colours iteration counts, like escape.color.frag. */
+class EscapeColorPixel
+{
+public:
+	EscapeColorPixel( const KernelArguments& arguments )
+	: arguments_(arguments)
+	{
+		logMaxIterations_ = std::log( float(arguments.parameter<int>(0)) );
+		hueOffset_ = arguments.parameter<float>(1);
+		highlightNonConverge_ = arguments.parameter<int>(2) == 1;
+	}
+
+	vec4 operator()( unsigned int x, unsigned int y )
+	{
+		float iterCount = arguments_.sampleInput( 0, x, y )[0];
+
+		if( iterCount == -1 )
+		{
+			if( highlightNonConverge_ )
+				return vec4( 1, 0, 0, 1 );
+			iterCount = 0;
+		}
+
+		if( iterCount <= 0 )
+			return vec4( 0, 0, 0, 1 );
+
+		float logRat = std::log(iterCount)/logMaxIterations_;
+		vec3 rgb = kernels::hsvToRGB( vec3( kernels::fract(logRat + hueOffset_), logRat, logRat ) );
+		return vec4( rgb.x, rgb.y, rgb.z, 1 );
+	}
+
+private:
+	const KernelArguments& arguments_;
+	float logMaxIterations_;
+	float hueOffset_;
+	bool highlightNonConverge_;
+};
+
+};
+
+void kernels::registerEscapeKernels()
+{
+	KernelRegistry& registry = KernelRegistry::instance();
+	EscapeTileFunction escapeTile = selectEscapeTile();
+	registry.registerKernel( "escape.mandelbrot", escapeKernel( EscapeMandelbrot, escapeTile ), EscapeParameters );
+	registry.registerKernel( "escape.henon", escapeKernel( EscapeHenon, escapeTile ), EscapeParameters );
+
+	registry.registerCompiler( "escape", [escapeTile]( const std::string& source )
+	{
+		std::shared_ptr<EscapeProgram> bytecode( new EscapeProgram );
+		EscapeCompiler compiler;
+		if( !compiler.compile( source, *bytecode ) )
+		{
+			printf("Escape formula could not be compiled: %s\n", compiler.getError().c_str());
+			return Kernel();
+		}
+		return escapeKernel( EscapeBytecode, escapeTile, bytecode );
+	}, EscapeParameters );
+	registry.registerPixelKernel<EscapeColorPixel>( "escape.color", { "maxIterations", "hueOffset", "highlightNonConverge" } );
+}
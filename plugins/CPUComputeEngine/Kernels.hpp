@@ -0,0 +1,67 @@
+/**
+ * @file Kernels.hpp
+ * @brief Helpers shared by the Kernels that ship with the CPUComputeEngine.
+ */
+#ifndef CPUCOMPUTEENGINE_KERNELS_HPP
+#define CPUCOMPUTEENGINE_KERNELS_HPP
+
+#include <cmath>
+
+namespace kernels
+{
+
+/**
+ * @brief Gets the texture coordinate of the centre of an output element.
+ * @return The same value gl_TexCoord[0].xy holds for the element in the GLSL engine.
+ */
+inline vec2 texCoord( const KernelArguments& arguments, unsigned int x, unsigned int y )
+{
+	return vec2( (x + 0.5f)/arguments.width, (y + 0.5f)/arguments.height );
+}
+
+/**
+ * @brief Converts a HSV triplet to a RGB triplet.
+ *
+ * Matches hsvToRGB() from the GLSL engine's color include, so colour
+ * passes look the same on either engine.
+ */
+inline vec3 hsvToRGB( vec3 hsv )
+{
+	if( hsv.x == 1 ) hsv.x = 0;
+
+	int i = int(std::floor(hsv.x * 6));
+	float f = hsv.x * 6 - i;
+	float p = hsv.z * (1 - hsv.y);
+	float q = hsv.z * (1 - f * hsv.y);
+	float t = hsv.z * (1 - (1 - f) * hsv.y);
+	float v = hsv.z;
+
+	switch(i)
+	{
+		case 0: return vec3(v,t,p);
+		case 1: return vec3(q,v,p);
+		case 2: return vec3(p,v,t);
+		case 3: return vec3(p,q,v);
+		case 4: return vec3(t,p,v);
+		case 5: return vec3(v,p,q);
+	}
+	return vec3(0,0,0);
+}
+
+/** Gets the fractional part of a value, like fract() in GLSL. */
+inline float fract( float value )
+{
+	return value - std::floor(value);
+}
+
+void registerTransformKernels();
+void registerEscapeKernels();
+void registerNewtonKernels();
+void registerLifeKernels();
+void registerConvolveKernels();
+void registerPerturbKernels();
+void registerShiftKernels();
+
+};
+
+#endif
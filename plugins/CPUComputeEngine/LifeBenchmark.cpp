@@ -0,0 +1,216 @@
+/**
+ * @file LifeBenchmark.cpp
+ * @brief Measures the packed life steps of the CPUComputeEngine in cell updates per second.
+ *
+ * Build with "make life-benchmark" and run ./life-benchmark [width height [threads]].
+ * A few rules from programs/lifelike/rules.xml are run on a random board,
+ * first with a float board stepped like life.frag and then with every packed
+ * step the CPU supports, on one thread and then on all of them.  Every packed
+ * board is compared against the float one after the same generations, cell
+ * state by cell state for the rules with death states.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "PackedLife.hpp"
+
+using namespace kernels;
+
+struct Rule
+{
+	const char* name;
+	unsigned int birth;
+	unsigned int live;
+	unsigned int deathStates;
+	float density;
+};
+
+struct Step
+{
+	const char* name;
+	PackedLifeFunction function;
+	bool supported;
+};
+
+/** Gets the mask LifeLike:computeRule() would compute for a string of neighbour counts. */
+static unsigned int ruleMask( const char* counts )
+{
+	unsigned int mask = 0;
+	for( ; *counts; counts++ )
+		mask |= 1 << (*counts - '0');
+	return mask;
+}
+
+/** Gets the state a packed board holds for a cell of a float board. */
+static unsigned int cellState( const float* cell )
+{
+	return (cell[0] > 0)? 1: (cell[1] > 0)? unsigned(cell[1]) + 1: 0;
+}
+
+/** Steps a float board one generation, the way life.frag does. */
+static void floatStep( const std::vector<float>& board, std::vector<float>& next, unsigned int width, unsigned int height, const Rule& rule )
+{
+	for( unsigned int y = 0; y < height; y++ )
+		for( unsigned int x = 0; x < width; x++ )
+		{
+			int neighbours = 0;
+			for( int dy = -1; dy <= 1; dy++ )
+				for( int dx = -1; dx <= 1; dx++ )
+				{
+					if( dx == 0 && dy == 0 ) continue;
+					unsigned int nx = (x + width + dx) % width, ny = (y + height + dy) % height;
+					neighbours += board[(size_t(ny) * width + nx) * 4] > 0;
+				}
+
+			float age = board[(size_t(y) * width + x) * 4];
+			float death = board[(size_t(y) * width + x) * 4 + 1];
+			float* result = &next[(size_t(y) * width + x) * 4];
+			result[1] = 0;
+			if( death > 0 )
+			{
+				result[0] = age;
+				result[1] = death - 1;
+			}
+			else if( age > 0 )
+			{
+				bool survives = (rule.live >> neighbours) & 1;
+				result[0] = survives? age + 1: -age;
+				result[1] = survives? 0: rule.deathStates;
+			}
+			else
+				result[0] = ((rule.birth >> neighbours) & 1)? 1: 0;
+		}
+}
+
+/** Runs \a generations steps of \a step, split into bands of rows across \a threads threads. */
+static double run( PackedLifeFunction step, PackedLifeArguments arguments, std::vector<uint64_t>& board,
+                   std::vector<uint64_t>& next, int generations, unsigned int threads )
+{
+	auto start = std::chrono::steady_clock::now();
+	for( int generation = 0; generation < generations; generation++ )
+	{
+		arguments.input = board.data();
+		arguments.output = next.data();
+
+		std::vector<std::thread> workers;
+		unsigned int band = (arguments.height + threads - 1)/threads;
+		for( unsigned int i = 0; i < threads; i++ )
+		{
+			PackedLifeArguments part = arguments;
+			part.y = i * band;
+			part.rows = part.y < arguments.height ? std::min( band, arguments.height - part.y ) : 0;
+			workers.push_back( std::thread( step, part ) );
+		}
+
+		for( std::thread& worker: workers )
+			worker.join();
+
+		board.swap( next );
+	}
+
+	return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+}
+
+int main( int argc, char** argv )
+{
+	unsigned int width = argc > 2 ? atoi(argv[1]) : 2560;
+	unsigned int height = argc > 2 ? atoi(argv[2]) : 1440;
+	unsigned int threads = argc > 3 ? atoi(argv[3]) : std::thread::hardware_concurrency();
+	if( threads == 0 ) threads = 1;
+
+	const int generations = 20;
+
+	__builtin_cpu_init();
+	Step steps[] =
+	{
+		{ "generic", packedLifeGeneric, true },
+		{ "AVX2", packedLifeAVX2, __builtin_cpu_supports("avx2") != 0 },
+		{ "AVX-512", packedLifeAVX512, __builtin_cpu_supports("avx512f") != 0 },
+	};
+
+	Rule rules[] =
+	{
+		{ "life", ruleMask("3"), ruleMask("23"), 0, .5f },
+		{ "coral", ruleMask("3"), ruleMask("45678"), 0, .2f },
+		{ "maze", ruleMask("3"), ruleMask("12345"), 0, .01f },
+		{ "walls", ruleMask("45678"), ruleMask("2345"), 0, .4f },
+		{ "starwars", ruleMask("2"), ruleMask("345"), 5, .1f },
+		{ "brain", ruleMask("2"), ruleMask(""), 1, .3f },
+	};
+
+	unsigned int stride = (width + PackedLifeElementCells - 1)/PackedLifeElementCells * 2;
+	double cells = double(width) * height * generations;
+
+	printf("%u x %u, %d generations, %u threads\n", width, height, generations, threads);
+	for( const Rule& rule: rules )
+	{
+		std::mt19937 random( 1 );
+		std::bernoulli_distribution alive( rule.density );
+
+		unsigned int planes = packedLifePlanes( rule.deathStates );
+		std::vector<float> board( size_t(width) * height * 4 ), next( board.size() );
+		std::vector<uint64_t> start( size_t(stride) * height * planes, 0 );
+		for( unsigned int y = 0; y < height; y++ )
+			for( unsigned int x = 0; x < width; x++ )
+				if( alive( random ) )
+				{
+					board[(size_t(y) * width + x) * 4] = 1;
+					start[size_t(y) * stride + x / 64] |= uint64_t(1) << (x % 64);
+				}
+
+		auto floatStart = std::chrono::steady_clock::now();
+		for( int generation = 0; generation < generations; generation++ )
+		{
+			floatStep( board, next, width, height, rule );
+			board.swap( next );
+		}
+		double floatTime = std::chrono::duration<double>( std::chrono::steady_clock::now() - floatStart ).count();
+		printf("%-8s float     1 thread %8.1f Mcells/s\n", rule.name, cells/floatTime/1e6);
+
+		PackedLifeArguments arguments = {};
+		arguments.birthRules = rule.birth;
+		arguments.liveRules = rule.live;
+		arguments.deathStates = rule.deathStates;
+		arguments.planes = planes;
+		arguments.stride = stride;
+		arguments.width = width;
+		arguments.height = height;
+		arguments.firstWord = 0;
+		arguments.lastWord = stride;
+
+		for( const Step& step: steps )
+		{
+			if( !step.supported )
+			{
+				printf("%-8s %-8s not supported by this CPU\n", rule.name, step.name);
+				continue;
+			}
+
+			std::vector<uint64_t> packed = start, packedNext( start.size() );
+			double single = run( step.function, arguments, packed, packedNext, generations, 1 );
+
+			unsigned int wrong = 0;
+			for( unsigned int y = 0; y < height; y++ )
+				for( unsigned int x = 0; x < width; x++ )
+				{
+					unsigned int state = 0;
+					for( unsigned int plane = 0; plane < planes; plane++ )
+						state |= ((packed[(size_t(plane) * height + y) * stride + x / 64] >> (x % 64)) & 1) << plane;
+					wrong += state != cellState( &board[(size_t(y) * width + x) * 4] );
+				}
+
+			packed = start;
+			double multi = run( step.function, arguments, packed, packedNext, generations, threads );
+
+			printf("%-8s %-8s  1 thread %8.1f Mcells/s (%.0fx float), %u threads %8.1f Mcells/s, %u cells differ\n",
+				rule.name, step.name, cells/single/1e6, floatTime/single, threads, cells/multi/1e6, wrong);
+		}
+	}
+
+	return 0;
+}
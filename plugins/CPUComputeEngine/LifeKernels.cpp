@@ -0,0 +1,301 @@
+#include <libcompute.hpp>
+using namespace libcompute;
+
+#include "Kernels.hpp"
+#include "PackedLife.hpp"
+
+using namespace kernels;
+
+namespace
+{
+
+const float PI = 3.14159265358979323846264f;
+
+/** The Parameters of life and life.packed, in the order they are registered with. */
+enum LifeParameter { LiveRules, BirthRules, DeathStates, PackedWidth };
+
+/** Advances a Life-like board one generation, like life.frag. */
+void lifeKernel( const KernelArguments& arguments, const Tile& tile )
+{
+	int liveRules = arguments.parameter<int>(LiveRules);
+	int birthRules = arguments.parameter<int>(BirthRules);
+	int deathStates = arguments.parameter<int>(DeathStates);
+
+	const float* board = (const float*) arguments.inputs[0];
+	int width = arguments.inputInfo[0].width;
+	int height = arguments.inputInfo[0].height;
+
+	for( unsigned int y = tile.y; y < tile.y + tile.height; y++ )
+	{
+		// the board wraps around at the edges, just like the repeating texture does
+		const float* rows[3] = {
+			board + size_t( y == 0? height - 1: y - 1 ) * width * 4,
+			board + size_t( y ) * width * 4,
+			board + size_t( int(y) == height - 1? 0: y + 1 ) * width * 4 };
+
+		float* element = arguments.outputElement( 0, tile.x, y );
+		for( unsigned int x = tile.x; x < tile.x + tile.width; x++, element += 4 )
+		{
+			unsigned int left = (x == 0? width - 1: x - 1) * 4;
+			unsigned int center = x * 4;
+			unsigned int right = (int(x) == width - 1? 0: x + 1) * 4;
+
+			int neighborCount = 0;
+			for( int r = 0; r < 3; r++ )
+				neighborCount += (rows[r][left] > 0) + (rows[r][center] > 0) + (rows[r][right] > 0);
+
+			int age = int(rows[1][center]);
+			float death = rows[1][center + 1];
+
+			if( age > 0 ) neighborCount--;
+
+			if( death > 0 )
+				death--;
+			else if( age > 0 )
+			{
+				if( ((1 << neighborCount) & liveRules) > 0 )
+					age++;
+				else
+				{
+					age = -age;
+					death = deathStates;
+				}
+			}
+			else
+				age = ( ((1 << neighborCount) & birthRules) > 0 )? 1: 0;
+
+			element[0] = age;
+			element[1] = death;
+			element[2] = 0;
+			element[3] = 0;
+		}
+	}
+}
+
+/**
+ * @brief Marks the blocks of a board where anything changed in a generation, like life.changes.frag.
+ *
+ * Each output element covers a tileSize square block of the boards in the
+ * two inputs, and is set to one if a cell there was born, died or counted
+ * down a death state between the first board and the second.
+ */
+void lifeChangesKernel( const KernelArguments& arguments, const Tile& tile )
+{
+	unsigned int tileSize = arguments.parameter<int>(0);
+	unsigned int width = arguments.inputInfo[0].width;
+	unsigned int height = arguments.inputInfo[0].height;
+
+	for( unsigned int row = tile.y; row < tile.y + tile.height; row++ )
+		for( unsigned int column = tile.x; column < tile.x + tile.width; column++ )
+		{
+			bool changed = false;
+			unsigned int xEnd = std::min( (column + 1) * tileSize, width );
+			unsigned int yEnd = std::min( (row + 1) * tileSize, height );
+			for( unsigned int y = row * tileSize; y < yEnd && !changed; y++ )
+			{
+				const float* before = arguments.inputElement( 0, column * tileSize, y );
+				const float* after = arguments.inputElement( 1, column * tileSize, y );
+				for( unsigned int x = column * tileSize; x < xEnd; x++, before += 4, after += 4 )
+					if( (before[0] > 0) != (after[0] > 0) || before[1] != after[1] )
+					{
+						changed = true;
+						break;
+					}
+			}
+
+			float* element = arguments.outputElement( 0, column, row );
+			element[0] = changed;
+			element[1] = 0;
+			element[2] = 0;
+			element[3] = 0;
+		}
+}
+
+/** Ages the live cells of a block whose neighbourhood did not change, like life.age.frag. */
+void lifeAgeKernel( const KernelArguments& arguments, const Tile& tile )
+{
+	for( unsigned int y = tile.y; y < tile.y + tile.height; y++ )
+	{
+		const float* cell = arguments.inputElement( 0, tile.x, y );
+		float* element = arguments.outputElement( 0, tile.x, y );
+		for( unsigned int x = tile.x; x < tile.x + tile.width; x++, cell += 4, element += 4 )
+		{
+			element[0] = (cell[0] > 0)? cell[0] + 1: 0;
+			element[1] = cell[1];
+			element[2] = 0;
+			element[3] = 0;
+		}
+	}
+}
+
+/** Colours cells by their age, like life.color.frag. */
+class LifeColorPixel
+{
+public:
+	LifeColorPixel( const KernelArguments& arguments )
+	: arguments_(arguments)
+	{
+		deathStates_ = arguments.parameter<int>(0);
+		hueSpacing_ = arguments.parameter<int>(1);
+	}
+
+	vec4 operator()( unsigned int x, unsigned int y )
+	{
+		const float* pixelData = arguments_.inputElement( 0, x, y );
+		float age = pixelData[0];
+		float death = pixelData[1];
+
+		vec3 hsv;
+		hsv.x = std::sin( age/hueSpacing_ * PI ) * .5f + .5f;
+		hsv.y = (age > 0)? 1 - 1/(1 + .025f * age): 0;
+		hsv.z = (age > 0)? hsv.y: 0;
+
+		if( death > 0 )
+		{
+			hsv.y *= death/deathStates_;
+			hsv.z *= death/deathStates_;
+		}
+
+		vec3 rgb = kernels::hsvToRGB(hsv);
+		return vec4( rgb.x, rgb.y, rgb.z, 1 );
+	}
+
+private:
+	const KernelArguments& arguments_;
+	float deathStates_;
+	float hueSpacing_;
+};
+
+/** Picks the widest packed step the CPU running the plugin can execute. */
+PackedLifeFunction selectPackedLife()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports("avx512f") )
+		return packedLifeAVX512;
+	if( __builtin_cpu_supports("avx2") )
+		return packedLifeAVX2;
+#endif
+	return packedLifeGeneric;
+}
+
+/**
+ * @brief Advances a packed board one generation.
+ *
+ * The storages hold the planes of a board with deathStates death states,
+ * each height rows tall.  The board is width cells wide and wraps around
+ * there, like life.frag does at the edges of its texture.
+ */
+Kernel packedLifeKernel( PackedLifeFunction step )
+{
+	return [step]( const KernelArguments& arguments, const Tile& tile )
+	{
+		PackedLifeArguments packed;
+		packed.birthRules = arguments.parameter<int>(BirthRules);
+		packed.liveRules = arguments.parameter<int>(LiveRules);
+		packed.deathStates = arguments.parameter<int>(DeathStates);
+		packed.planes = packedLifePlanes( packed.deathStates );
+		packed.input = (const uint64_t*) arguments.inputs[0];
+		packed.output = (uint64_t*) arguments.outputs[0];
+		packed.stride = arguments.width * 2;
+		packed.width = arguments.parameter<int>(PackedWidth);
+		packed.height = arguments.height / packed.planes;
+		packed.firstWord = tile.x * 2;
+		packed.lastWord = (tile.x + tile.width) * 2;
+
+		// every row steps all of its planes, so the tiles over the higher planes have nothing to do
+		packed.y = tile.y;
+		packed.rows = (tile.y < packed.height)? std::min( tile.height, packed.height - tile.y ): 0;
+		if( packed.rows > 0 && packed.planes <= PackedLifeMaxPlanes )
+			step( packed );
+	};
+}
+
+/**
+ * @brief Packs a float board into a packed board.
+ *
+ * The output is as many times as tall as the input as the board has planes.
+ * Live cells, the ones with a positive age, are 1, and dying cells are their
+ * death state plus one.
+ */
+void lifePackKernel( const KernelArguments& arguments, const Tile& tile )
+{
+	const float* board = (const float*) arguments.inputs[0];
+	unsigned int width = arguments.inputInfo[0].width;
+	unsigned int height = arguments.inputInfo[0].height;
+	uint64_t* packed = (uint64_t*) arguments.outputs[0];
+
+	for( unsigned int y = tile.y; y < tile.y + tile.height; y++ )
+	{
+		unsigned int plane = y / height;
+		const float* row = board + size_t(y % height) * width * 4;
+		for( unsigned int word = tile.x * 2; word < (tile.x + tile.width) * 2; word++ )
+		{
+			uint64_t bits = 0;
+			for( unsigned int bit = 0; bit < 64 && word * 64 + bit < width; bit++ )
+			{
+				const float* cell = row + (word * 64 + bit) * 4;
+				unsigned int state = (cell[0] > 0)? 1: (cell[1] > 0)? unsigned(cell[1]) + 1: 0;
+				bits |= uint64_t( (state >> plane) & 1 ) << bit;
+			}
+			packed[size_t(y) * arguments.width * 2 + word] = bits;
+		}
+	}
+}
+
+/**
+ * @brief Unpacks a packed board into the float board life.color reads.
+ *
+ * The second input is the last float board, usually the output itself.
+ * Together with the new states it gives every cell the age and death state
+ * life.frag would have: live cells get one more than their age there, cells
+ * that start dying keep their age negated and dying cells keep their age.
+ */
+void lifeUnpackKernel( const KernelArguments& arguments, const Tile& tile )
+{
+	const uint64_t* packed = (const uint64_t*) arguments.inputs[0];
+	unsigned int stride = arguments.inputInfo[0].width * 2;
+	unsigned int planes = arguments.inputInfo[0].height / arguments.height;
+	size_t planeSize = size_t(arguments.height) * stride;
+
+	for( unsigned int y = tile.y; y < tile.y + tile.height; y++ )
+	{
+		const uint64_t* row = packed + size_t(y) * stride;
+		float* element = arguments.outputElement( 0, tile.x, y );
+		for( unsigned int x = tile.x; x < tile.x + tile.width; x++, element += 4 )
+		{
+			unsigned int state = 0;
+			for( unsigned int plane = 0; plane < planes; plane++ )
+				state |= ((row[plane * planeSize + x / 64] >> (x % 64)) & 1) << plane;
+
+			const float* last = arguments.inputElement( 1, x, y );
+			float age = last[0], death = last[1];
+
+			if( state == 1 )
+				age = std::max( age, 0.0f ) + 1;
+			else if( state > 1 || death == 1 || age > 0 )
+				age = -std::abs( age );
+			else
+				age = 0;
+
+			element[0] = age;
+			element[1] = (state > 1)? state - 1: 0;
+			element[2] = 0;
+			element[3] = 0;
+		}
+	}
+}
+
+};
+
+void kernels::registerLifeKernels()
+{
+	KernelRegistry& registry = KernelRegistry::instance();
+	registry.registerKernel( "life", &lifeKernel, { "liveRules", "birthRules", "deathStates" } );
+	registry.registerPixelKernel<LifeColorPixel>( "life.color", { "deathStates", "hueSpacing" } );
+	registry.registerKernel( "life.changes", &lifeChangesKernel, { "tileSize" } );
+	registry.registerKernel( "life.age", &lifeAgeKernel );
+	registry.registerKernel( "life.packed", packedLifeKernel( selectPackedLife() ), { "liveRules", "birthRules", "deathStates", "width" } );
+	registry.registerKernel( "life.pack", &lifePackKernel );
+	registry.registerKernel( "life.unpack", &lifeUnpackKernel );
+}
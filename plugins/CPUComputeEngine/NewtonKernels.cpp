@@ -0,0 +1,129 @@
+#include <libcompute.hpp>
+using namespace libcompute;
+
+#include "Kernels.hpp"
+
+namespace
+{
+
+const float PI = 3.14159265358979323846264f;
+
+/** Complex division, like cDiv() from the GLSL engine's complex include. */
+inline vec2 cDiv( const vec2& a, const vec2& b )
+{
+	float denominator = b.x * b.x + b.y * b.y;
+	return vec2( (a.x * b.x + a.y * b.y)/denominator, (a.y * b.x - a.x * b.y)/denominator );
+}
+
+/** Runs Newton's method from every point of the plane, like newton.frag. */
+class NewtonPixel
+{
+public:
+	NewtonPixel( const KernelArguments& arguments )
+	: arguments_(arguments)
+	{
+		maxIterations_ = arguments.parameter<int>(0);
+		requiredPrecision_ = arguments.parameter<float>(1);
+		coeff_ = arguments.parameter<vec2>(2);
+
+		functionSize_ = std::min( arguments.parameter<int>(4), 8 );
+		const vec4* roots = &arguments.parameter<vec4>(3);
+		for( int i = 0; i < functionSize_; i++ )
+			function_[i] = roots[i];
+	}
+
+	vec4 operator()( unsigned int x, unsigned int y )
+	{
+		const float* start = arguments_.inputElement( 0, x, y );
+		vec2 lastValue( start[0], start[1] );
+		vec2 currentValue;
+		float curveLength = 0;
+		float convergeAngle = 0;
+
+		int iterationCount;
+		for( iterationCount = 1; iterationCount < maxIterations_; iterationCount++ )
+		{
+			currentValue = vec2();
+			for( int i = 0; i < functionSize_; i++ )
+				currentValue += cDiv( vec2( function_[i].z, function_[i].w ), lastValue - vec2( function_[i].x, function_[i].y ) );
+
+			currentValue = lastValue - cDiv( coeff_, currentValue );
+
+			vec2 step = currentValue - lastValue;
+			float delta = std::sqrt( step.x * step.x + step.y * step.y );
+			curveLength += delta;
+			if( delta <= requiredPrecision_ )
+			{
+				convergeAngle = std::atan2( -step.y, -step.x );
+				break;
+			}
+			lastValue = currentValue;
+		}
+
+		float fractionalIter = std::min( iterationCount, maxIterations_ );
+
+		return vec4( std::atan2( currentValue.y, currentValue.x ), curveLength, fractionalIter, (convergeAngle + PI)/(2 * PI) );
+	}
+
+private:
+	const KernelArguments& arguments_;
+	int maxIterations_;
+	float requiredPrecision_;
+	vec2 coeff_;
+	vec4 function_[8];
+	int functionSize_;
+};
+
+/** Colours the results of NewtonPixel, like newton.color.frag. */
+class NewtonColorPixel
+{
+public:
+	NewtonColorPixel( const KernelArguments& arguments )
+	: arguments_(arguments)
+	{
+		logMaxIterations_ = std::log( float(arguments.parameter<int>(0)) );
+		hueOffset_ = arguments.parameter<float>(1);
+		blend_ = arguments.parameter<float>(2);
+		const vec3& gamma = arguments.parameter<vec3>(3);
+		inverseGamma_ = vec3( 1/gamma.x, 1/gamma.y, 1/gamma.z );
+	}
+
+	vec4 operator()( unsigned int x, unsigned int y )
+	{
+		const float* pixelData = arguments_.sampleInput( 0, x, y );
+		float rootArg = pixelData[0];
+		float curveLength = pixelData[1];
+		float iterCount = pixelData[2];
+
+		float logRat = 1 - 1/(.2f * curveLength + 1) + iterCount;
+		logRat = std::log(logRat)/logMaxIterations_;
+
+		vec3 hsv;
+		hsv.x = kernels::fract( .1f * curveLength/(.1f * curveLength + 1) );
+		hsv.y = logRat;
+		hsv.z = 1 - logRat;
+		vec3 rgb = kernels::hsvToRGB(hsv);
+
+		hsv.x = kernels::fract( (rootArg + PI)/(2 * PI) + hueOffset_ );
+		rgb = rgb * blend_ + kernels::hsvToRGB(hsv) * (1 - blend_);
+
+		return vec4( std::pow( rgb.x, inverseGamma_.x ), std::pow( rgb.y, inverseGamma_.y ),
+		             std::pow( rgb.z, inverseGamma_.z ), 1 );
+	}
+
+private:
+	const KernelArguments& arguments_;
+	float logMaxIterations_;
+	float hueOffset_;
+	float blend_;
+	vec3 inverseGamma_;
+};
+
+};
+
+void kernels::registerNewtonKernels()
+{
+	KernelRegistry& registry = KernelRegistry::instance();
+	registry.registerPixelKernel<NewtonPixel>( "newton", { "maxIterations", "requiredPrecision", "coeff", "function", "functionSize" } );
+	registry.registerPixelKernel<NewtonColorPixel>( "newton.color", { "maxIterations", "hueOffset", "blend", "gamma" } );
+}
@@ -0,0 +1,334 @@
+/**
+ * @file PackedLife.hpp
+ * @brief The bit-sliced Life-like step shared by the per-ISA packed life kernels.
+ *
+ * Like Escape.hpp this header is compiled once per instruction set with
+ * different compiler flags, so it only holds plain data and a loop that
+ * lives in an anonymous namespace.
+ *
+ * A packed board holds one bit per cell, 64 cells to a word: cell x of a row
+ * is bit x % 64 of word x / 64.  Storage elements are four ints, so every
+ * row is padded to a whole number of 128 cell elements, and the bits past
+ * the width of the board are always zero.
+ *
+ * Rules with death states keep a small number per cell instead: 0 for dead,
+ * 1 for alive and n + 1 for a dying cell with n death states left to go,
+ * split into bit planes.  Plane p of row y is row p * height + y of the
+ * storage, so a board without death states is just plane 0.
+ */
+#ifndef CPUCOMPUTEENGINE_PACKEDLIFE_HPP
+#define CPUCOMPUTEENGINE_PACKEDLIFE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace kernels
+{
+
+/** The number of cells packed into each storage element. */
+const unsigned int PackedLifeElementCells = 128;
+
+/** The most bit planes a packed board can have, enough for 254 death states. */
+const unsigned int PackedLifeMaxPlanes = 8;
+
+/** Gets the number of bit planes a board with \a deathStates death states needs. */
+inline unsigned int packedLifePlanes( unsigned int deathStates )
+{
+	unsigned int planes = 1;
+	while( (1u << planes) < deathStates + 2 )
+		planes++;
+	return planes;
+}
+
+/** Everything the packed step needs, gathered from the Program once per Tile. */
+struct PackedLifeArguments
+{
+	unsigned int birthRules; ///< Bit n is set if a dead cell with n live neighbours is born
+	unsigned int liveRules; ///< Bit n is set if a live cell with n live neighbours survives
+	unsigned int deathStates; ///< The number of generations a cell takes to die, 0 for none
+	unsigned int planes; ///< The number of bit planes, packedLifePlanes( deathStates )
+
+	const uint64_t* input; ///< The board, stride words per row
+	uint64_t* output; ///< The next generation, laid out like the input
+	unsigned int stride; ///< The number of words in each row of the storages
+	unsigned int width; ///< The width of the board in cells; it wraps around there
+	unsigned int height; ///< The height of the board in cells, which is also the distance between planes
+
+	unsigned int firstWord; ///< The first word of each row to step
+	unsigned int lastWord; ///< One past the last word of each row to step
+	unsigned int y; ///< The first row to step
+	unsigned int rows; ///< The number of rows to step
+};
+
+typedef void (*PackedLifeFunction)( const PackedLifeArguments& arguments );
+
+/** Steps two words at a time with whatever vector unit the plugin was built for. */
+void packedLifeGeneric( const PackedLifeArguments& arguments );
+
+/** Steps four words at a time.  Only call this when the CPU has AVX2. */
+void packedLifeAVX2( const PackedLifeArguments& arguments );
+
+/** Steps eight words at a time.  Only call this when the CPU has AVX-512F. */
+void packedLifeAVX512( const PackedLifeArguments& arguments );
+
+};
+
+namespace
+{
+
+/** Vectors of \a Lanes words, using the GCC vector extensions. */
+template<int Lanes> struct WordVector
+{
+	typedef uint64_t Type __attribute__((vector_size( Lanes * sizeof(uint64_t) )));
+};
+
+/** Adds three one bit numbers in every bit position at once. */
+template<typename T> inline void fullAdd( T a, T b, T c, T& sum, T& carry )
+{
+	T ab = a ^ b;
+	sum = ab ^ c;
+	carry = (a & b) | (ab & c);
+}
+
+/** The rules turned into masks that are all ones for the neighbour counts they hold. */
+template<typename T> struct PackedRules
+{
+	T birth[9];
+	T live[9];
+	bool used[9];
+
+	PackedRules( const kernels::PackedLifeArguments& arguments )
+	{
+		for( int count = 0; count <= 8; count++ )
+		{
+			bool born = (arguments.birthRules >> count) & 1;
+			bool lives = (arguments.liveRules >> count) & 1;
+			birth[count] = T{} + (born? ~uint64_t(0): 0);
+			live[count] = T{} + (lives? ~uint64_t(0): 0);
+			used[count] = born || lives;
+		}
+	}
+};
+
+/**
+ * @brief Steps every cell of a word, or of a vector of words, at once.
+ *
+ * Each neighbour argument holds that neighbour of every cell in the same bit
+ * as the cell.  The neighbours are counted with a tree of adders into four
+ * bit planes, and each count the rules use is matched against them.
+ */
+template<typename T> inline T stepCells( T northWest, T north, T northEast, T west, T cell, T east,
+                                         T southWest, T south, T southEast, const PackedRules<T>& rules )
+{
+	T top1, top2, bottom1, bottom2;
+	fullAdd( northWest, north, northEast, top1, top2 );
+	fullAdd( southWest, south, southEast, bottom1, bottom2 );
+	T middle1 = west ^ east;
+	T middle2 = west & east;
+
+	T count1, twos, fours, eights;
+	fullAdd( top1, middle1, bottom1, count1, twos );
+	fullAdd( top2, middle2, bottom2, fours, eights );
+	T count2 = fours ^ twos;
+	T carry = fours & twos;
+	T count4 = eights ^ carry;
+	T count8 = eights & carry;
+
+	T result = T{};
+	for( int count = 0; count <= 8; count++ )
+	{
+		if( !rules.used[count] )
+			continue;
+
+		T match = ((count & 1)? count1: ~count1) & ((count & 2)? count2: ~count2)
+		        & ((count & 4)? count4: ~count4) & ((count & 8)? count8: ~count8);
+		result |= match & ((rules.birth[count] & ~cell) | (rules.live[count] & cell));
+	}
+
+	return result;
+}
+
+/**
+ * @brief Steps one row of live cells, \a Lanes words at a time where the words do not wrap around.
+ *
+ * Writes the cells that are alive next generation to the words of \a output
+ * between arguments.firstWord and arguments.lastWord, or would be if no cell
+ * were dying.
+ */
+template<int Lanes> void packedLifeRow( const kernels::PackedLifeArguments& arguments, const uint64_t* above, const uint64_t* row,
+                                        const uint64_t* below, uint64_t* output, const PackedRules<uint64_t>& wordRules,
+                                        const PackedRules<typename WordVector<Lanes>::Type>& vectorRules )
+{
+	typedef typename WordVector<Lanes>::Type Vector;
+
+	unsigned int words = (arguments.width + 63)/64;
+	unsigned int lastBits = arguments.width - (words - 1) * 64;
+	uint64_t lastMask = (lastBits == 64)? ~uint64_t(0): (uint64_t(1) << lastBits) - 1;
+
+	// the first and last words of a row take a cell from the other end
+	auto west = [&]( const uint64_t* row, unsigned int i ) -> uint64_t
+	{
+		uint64_t previous = (i > 0)? row[i - 1] >> 63: (row[words - 1] >> (lastBits - 1)) & 1;
+		return (row[i] << 1) | previous;
+	};
+	auto east = [&]( const uint64_t* row, unsigned int i ) -> uint64_t
+	{
+		if( i + 1 < words )
+			return (row[i] >> 1) | (row[i + 1] << 63);
+		return (row[i] >> 1) | ((row[0] & 1) << (lastBits - 1));
+	};
+	auto load = []( const uint64_t* words ) -> Vector
+	{
+		Vector vector;
+		__builtin_memcpy( &vector, words, sizeof(Vector) );
+		return vector;
+	};
+
+	unsigned int i = arguments.firstWord;
+	while( i < arguments.lastWord )
+	{
+		if( i >= words )
+		{
+			output[i++] = 0;
+		}
+		else if( i > 0 && i + Lanes < words && i + Lanes <= arguments.lastWord )
+		{
+			Vector a = load( above + i ), r = load( row + i ), b = load( below + i );
+			Vector aWest = (a << 1) | (load( above + i - 1 ) >> 63);
+			Vector rWest = (r << 1) | (load( row + i - 1 ) >> 63);
+			Vector bWest = (b << 1) | (load( below + i - 1 ) >> 63);
+			Vector aEast = (a >> 1) | (load( above + i + 1 ) << 63);
+			Vector rEast = (r >> 1) | (load( row + i + 1 ) << 63);
+			Vector bEast = (b >> 1) | (load( below + i + 1 ) << 63);
+
+			Vector result = stepCells( aWest, a, aEast, rWest, r, rEast, bWest, b, bEast, vectorRules );
+			__builtin_memcpy( output + i, &result, sizeof(Vector) );
+			i += Lanes;
+		}
+		else
+		{
+			uint64_t result = stepCells( west( above, i ), above[i], east( above, i ),
+			                             west( row, i ), row[i], east( row, i ),
+			                             west( below, i ), below[i], east( below, i ), wordRules );
+			output[i] = (i + 1 == words)? result & lastMask: result;
+			i++;
+		}
+	}
+}
+
+/** Steps the rows of a board without death states. */
+template<int Lanes> void packedLifeRows( const kernels::PackedLifeArguments& arguments )
+{
+	PackedRules<uint64_t> wordRules( arguments );
+	PackedRules<typename WordVector<Lanes>::Type> vectorRules( arguments );
+
+	for( unsigned int y = arguments.y; y < arguments.y + arguments.rows; y++ )
+	{
+		const uint64_t* above = arguments.input + size_t( y == 0? arguments.height - 1: y - 1 ) * arguments.stride;
+		const uint64_t* row = arguments.input + size_t(y) * arguments.stride;
+		const uint64_t* below = arguments.input + size_t( y + 1 == arguments.height? 0: y + 1 ) * arguments.stride;
+		uint64_t* output = arguments.output + size_t(y) * arguments.stride;
+
+		packedLifeRow<Lanes>( arguments, above, row, below, output, wordRules, vectorRules );
+	}
+}
+
+/**
+ * @brief Steps the rows of a board with death states.
+ *
+ * The live cells of the rows around each row are picked out of the planes
+ * and stepped like a board without death states.  Dying cells cannot be
+ * born, live cells that do not survive start dying at deathStates + 1, and
+ * dying cells count down, to 0 instead of 1 at the end, all a plane at a time.
+ */
+template<int Lanes> void packedGenerationsRows( const kernels::PackedLifeArguments& arguments )
+{
+	PackedRules<uint64_t> wordRules( arguments );
+	PackedRules<typename WordVector<Lanes>::Type> vectorRules( arguments );
+
+	unsigned int planes = arguments.planes;
+	size_t planeSize = size_t(arguments.height) * arguments.stride;
+	uint64_t dyingStart = arguments.deathStates + 1;
+
+	// the live cells of the row above, the row and the row below, rolled down as y goes up
+	std::vector<uint64_t> alive( size_t(arguments.stride) * 3 ), next( arguments.stride );
+	auto pickAlive = [&]( unsigned int y, uint64_t* output )
+	{
+		const uint64_t* row = arguments.input + size_t(y) * arguments.stride;
+		for( unsigned int i = 0; i < arguments.stride; i++ )
+		{
+			uint64_t higher = 0;
+			for( unsigned int plane = 1; plane < planes; plane++ )
+				higher |= row[plane * planeSize + i];
+			output[i] = row[i] & ~higher;
+		}
+	};
+
+	uint64_t* above = &alive[0];
+	uint64_t* row = &alive[arguments.stride];
+	uint64_t* below = &alive[size_t(arguments.stride) * 2];
+	pickAlive( arguments.y == 0? arguments.height - 1: arguments.y - 1, above );
+	pickAlive( arguments.y, row );
+
+	for( unsigned int y = arguments.y; y < arguments.y + arguments.rows; y++ )
+	{
+		pickAlive( y + 1 == arguments.height? 0: y + 1, below );
+		packedLifeRow<Lanes>( arguments, above, row, below, &next[0], wordRules, vectorRules );
+
+		const uint64_t* input = arguments.input + size_t(y) * arguments.stride;
+		uint64_t* output = arguments.output + size_t(y) * arguments.stride;
+		for( unsigned int i = arguments.firstWord; i < arguments.lastWord; i++ )
+		{
+			uint64_t state[kernels::PackedLifeMaxPlanes];
+			uint64_t highest = 0;
+			for( unsigned int plane = 0; plane < planes; plane++ )
+			{
+				state[plane] = input[plane * planeSize + i];
+				if( plane > 1 )
+					highest |= state[plane];
+			}
+
+			// 2 and up are dying, and 2 is the last death state
+			uint64_t dying = state[1] | highest;
+			uint64_t lastDeathState = ~state[0] & state[1] & ~highest;
+			uint64_t living = next[i] & ~dying;
+			uint64_t died = row[i] & ~living;
+			uint64_t countDown = dying & ~lastDeathState;
+
+			// subtract one from every dying cell, borrowing up through the planes
+			uint64_t borrow = ~uint64_t(0);
+			for( unsigned int plane = 0; plane < planes; plane++ )
+			{
+				uint64_t bits = countDown & (state[plane] ^ borrow);
+				borrow &= ~state[plane];
+
+				if( plane == 0 )
+					bits |= living;
+				if( (dyingStart >> plane) & 1 )
+					bits |= died;
+				output[plane * planeSize + i] = bits;
+			}
+		}
+
+		// roll the rows down for the next row up
+		uint64_t* oldAbove = above;
+		above = row;
+		row = below;
+		below = oldAbove;
+	}
+}
+
+/** Steps the rows of \a arguments, with or without death states. */
+template<int Lanes> void packedLifeStep( const kernels::PackedLifeArguments& arguments )
+{
+	if( arguments.deathStates > 0 )
+		packedGenerationsRows<Lanes>( arguments );
+	else
+		packedLifeRows<Lanes>( arguments );
+}
+
+};
+
+#endif
@@ -0,0 +1,6 @@
+#include "PackedLife.hpp"
+
+void kernels::packedLifeAVX2( const PackedLifeArguments& arguments )
+{
+	packedLifeStep<4>( arguments );
+}
@@ -0,0 +1,6 @@
+#include "PackedLife.hpp"
+
+void kernels::packedLifeAVX512( const PackedLifeArguments& arguments )
+{
+	packedLifeStep<8>( arguments );
+}
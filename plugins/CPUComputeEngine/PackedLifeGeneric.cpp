@@ -0,0 +1,6 @@
+#include "PackedLife.hpp"
+
+void kernels::packedLifeGeneric( const PackedLifeArguments& arguments )
+{
+	packedLifeStep<2>( arguments );
+}
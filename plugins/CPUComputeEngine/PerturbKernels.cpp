@@ -0,0 +1,106 @@
+#include <libcompute.hpp>
+using namespace libcompute;
+
+#include "Kernels.hpp"
+
+#include <cmath>
+
+namespace
+{
+
+/**
+ * @brief Iterates offsets from a reference orbit, like perturb.frag.
+ *
+ * The offsets are doubles rather than floats, and the reference orbit is
+ * put back together from both floats of each element, so the CPU can zoom
+ * down to about 1e-300 where the GLSL engine stops near 1e-38.
+ */
+class PerturbPixel
+{
+public:
+	PerturbPixel( const KernelArguments& arguments )
+	: arguments_(arguments)
+	{
+		maxIterations_ = arguments.parameter<int>(0);
+		float radius = arguments.parameter<float>(1);
+		radiusSquared_ = double(radius) * radius;
+		referenceLength_ = arguments.parameter<int>(2);
+		halfScale_ = std::ldexp( double(arguments.parameter<float>(3)), arguments.parameter<int>(4) );
+		offsetX_ = arguments.parameter<float>(5);
+		offsetY_ = arguments.parameter<float>(6);
+
+		reference_ = (const float*) arguments.inputs[1];
+		int referenceCapacity = int(arguments.inputInfo[1].width * arguments.inputInfo[1].height);
+		if( referenceLength_ > referenceCapacity )
+			referenceLength_ = referenceCapacity;
+	}
+
+	vec4 operator()( unsigned int x, unsigned int y )
+	{
+		const float* unit = arguments_.inputElement( 0, x, y );
+		double dcx = (unit[0] + offsetX_) * halfScale_, dcy = (unit[1] + offsetY_) * halfScale_;
+		double dx = 0, dy = 0;
+		int m = 0;
+		float rebases = 0, glitches = 0;
+
+		if( referenceLength_ < 2 )
+			return vec4( -1, 0, 0, 0 );
+
+		for( int n = 1; n <= maxIterations_; n++ )
+		{
+			double zx, zy;
+			reference( m, zx, zy );
+
+			// delta = 2 Z delta + delta^2 + dc
+			double nx = 2 * (zx * dx - zy * dy) + (dx * dx - dy * dy) + dcx;
+			double ny = 2 * (zx * dy + zy * dx) + 2 * dx * dy + dcy;
+			dx = nx;
+			dy = ny;
+			m++;
+
+			reference( m, zx, zy );
+			double vx = zx + dx, vy = zy + dy;
+			double valueSquared = vx * vx + vy * vy;
+
+			if( n > 1 && valueSquared > radiusSquared_ )
+				return vec4( n - 1, rebases, glitches, 0 );
+
+			bool glitch = valueSquared < 1e-6 * (zx * zx + zy * zy);
+			if( glitch || valueSquared < dx * dx + dy * dy || m == referenceLength_ - 1 )
+			{
+				if( glitch ) glitches++;
+				rebases++;
+				dx = vx;
+				dy = vy;
+				m = 0;
+			}
+		}
+
+		return vec4( -1, rebases, glitches, 0 );
+	}
+
+private:
+	/** Gets element \a n of the reference orbit as doubles. */
+	void reference( int n, double& x, double& y ) const
+	{
+		const float* element = reference_ + size_t(n) * 4;
+		x = double(element[0]) + element[2];
+		y = double(element[1]) + element[3];
+	}
+
+	const KernelArguments& arguments_;
+	int maxIterations_;
+	double radiusSquared_;
+	int referenceLength_;
+	double halfScale_;
+	double offsetX_, offsetY_;
+	const float* reference_;
+};
+
+};
+
+void kernels::registerPerturbKernels()
+{
+	KernelRegistry::instance().registerPixelKernel<PerturbPixel>( "escape.perturb",
+		{ "maxIterations", "escapeRadius", "referenceLength", "halfScaleMantissa", "halfScaleExponent", "referenceOffsetX", "referenceOffsetY" } );
+}
@@ -0,0 +1,37 @@
+#include <libcompute.hpp>
+using namespace libcompute;
+
+#include "Kernels.hpp"
+
+namespace
+{
+
+/** Moves the input by a whole number of elements, like shift.frag. */
+class ShiftPixel
+{
+public:
+	ShiftPixel( const KernelArguments& arguments )
+	: arguments_(arguments)
+	{
+		shiftX_ = arguments.parameter<int>(0);
+		shiftY_ = arguments.parameter<int>(1);
+	}
+
+	vec4 operator()( unsigned int x, unsigned int y )
+	{
+		const float* element = arguments_.inputElement( 0, int(x) + shiftX_, int(y) + shiftY_ );
+		return vec4( element[0], element[1], element[2], element[3] );
+	}
+
+private:
+	const KernelArguments& arguments_;
+	int shiftX_;
+	int shiftY_;
+};
+
+};
+
+void kernels::registerShiftKernels()
+{
+	KernelRegistry::instance().registerPixelKernel<ShiftPixel>( "shift", { "shiftX", "shiftY" } );
+}
@@ -0,0 +1,38 @@
+#include <libcompute.hpp>
+using namespace libcompute;
+
+#include "Kernels.hpp"
+
+namespace
+{
+
+/** Maps every element onto the complex plane, like transform.frag with the identity transform. */
+class TransformPixel
+{
+public:
+	TransformPixel( const KernelArguments& arguments )
+	: arguments_(arguments)
+	{
+		xMin_ = arguments.parameter<float>(0);
+		yMin_ = arguments.parameter<float>(1);
+		xRange_ = arguments.parameter<float>(2) - xMin_;
+		yRange_ = arguments.parameter<float>(3) - yMin_;
+	}
+
+	vec4 operator()( unsigned int x, unsigned int y )
+	{
+		vec2 coord = kernels::texCoord( arguments_, x, y );
+		return vec4( coord.x * xRange_ + xMin_, coord.y * yRange_ + yMin_, 0, 0 );
+	}
+
+private:
+	const KernelArguments& arguments_;
+	float xMin_, yMin_, xRange_, yRange_;
+};
+
+};
+
+void kernels::registerTransformKernels()
+{
+	KernelRegistry::instance().registerPixelKernel<TransformPixel>( "transform", { "X_MIN", "Y_MIN", "X_MAX", "Y_MAX" } );
+}
@@ -6,7 +6,12 @@ using namespace libcompute;
 #include <GL/glew.h>
 #include <stdlib.h>
 #include <fstream>
+#include <filesystem>
+#include <iterator>
 #include <cstring>
+#include <algorithm>
+#include <limits>
+#include <vector>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/foreach.hpp>
@@ -23,6 +28,36 @@ void checkGLErrors(const char *label) {
     }
 }
 
+/** A fence queued after a run, which tells when the GPU has got through it. */
+class Fence: public Engine::Completion
+{
+public:
+	Fence() : sync_( glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 ) ) {}
+	~Fence() { glDeleteSync( sync_ ); }
+
+	bool isComplete()
+	{
+		GLenum status = glClientWaitSync( sync_, 0, 0 );
+		return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+	}
+
+	void wait()
+	{
+		// the first wait flushes the queue, or the fence might never be reached
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		for( ;; )
+		{
+			GLenum status = glClientWaitSync( sync_, flags, 1000000000 );
+			if( status != GL_TIMEOUT_EXPIRED )
+				return;
+			flags = 0;
+		}
+	}
+
+private:
+	GLsync sync_;
+};
+
 class GLSLComputeEngine: public Engine
 {
 public:
@@ -33,10 +68,15 @@ public:
 	class DataStorage: public Engine::DataStorage
 	{
 	public:
+		DataStorage() : readBuffer_(0) {}
+
 		~DataStorage()
 		{
 			GLuint texture = getDataStorage();
+			GLSLComputeEngine::forgetFramebuffers( texture );
 			glDeleteTextures(1, &texture);
+			if( readBuffer_ )
+				glDeleteBuffers(1, &readBuffer_);
 		}
 		
 		std::string getType() { return "GLSLComputeEngine"; }
@@ -49,11 +89,12 @@ public:
 
 			GLSLComputeEngine::dataTypeToGLFormat( info, format );
 
+			forgetRead();
+
+			// the array is copied before glTexSubImage2D returns, so there is nothing to wait for
 			glBindTexture(GL_TEXTURE_2D, texture);
 			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, info.width, info.height, GL_RGBA, format[1], array);
 			glBindTexture(GL_TEXTURE_2D, 0);
-
-			glFinish();
 		}
 
 		void toArray( void* array )
@@ -64,134 +105,432 @@ public:
 			GLuint format[2];
 			GLSLComputeEngine::dataTypeToGLFormat( info, format );
 
-			//glClampColorARB( GL_CLAMP_VERTEX_COLOR_ARB, GL_FIXED_ONLY_ARB );
-			glClampColorARB( GL_CLAMP_FRAGMENT_COLOR_ARB,  GL_FALSE );
-			glClampColorARB( GL_CLAMP_READ_COLOR_ARB, GL_FALSE );
-			//LglClampColorARB( GL_RGBA_FLOAT_MODE_ARB, GL_TRUE );
-
+			glClampColor( GL_CLAMP_READ_COLOR, GL_FALSE );
+
+			if( read_ )
+			{
+				// the copy requestRead() queued is usually done by now, so this rarely waits
+				read_->wait();
+				read_.reset();
+
+				glBindBuffer( GL_PIXEL_PACK_BUFFER, readBuffer_ );
+				const void* data = glMapBuffer( GL_PIXEL_PACK_BUFFER, GL_READ_ONLY );
+				if( data )
+				{
+					memcpy( array, data, readSize() );
+					glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+				}
+				glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+				return;
+			}
+
+			waitForWrite();
 			glBindTexture(GL_TEXTURE_2D, texture);
 			glGetTexImage(GL_TEXTURE_2D, 0, format[0],  format[1], array);
 			glBindTexture(GL_TEXTURE_2D, 0);
-			glFinish();
 		}
+
+		void requestRead()
+		{
+			DataStorage::Info info = getInfo();
+
+			GLuint format[2];
+			GLSLComputeEngine::dataTypeToGLFormat( info, format );
+
+			if( !readBuffer_ )
+			{
+				glGenBuffers(1, &readBuffer_);
+				glBindBuffer( GL_PIXEL_PACK_BUFFER, readBuffer_ );
+				glBufferData( GL_PIXEL_PACK_BUFFER, readSize(), NULL, GL_STREAM_READ );
+			}
+			else
+				glBindBuffer( GL_PIXEL_PACK_BUFFER, readBuffer_ );
+
+			glClampColor( GL_CLAMP_READ_COLOR, GL_FALSE );
+
+			// with a pack buffer bound the read is only queued behind the run writing the storage
+			glBindTexture(GL_TEXTURE_2D, getDataStorage());
+			glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, format[1], 0);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+			read_.reset( new Fence() );
+			glFlush();
+		}
+
+		/** Drops the copy requestRead() queued, for when the storage is written again. */
+		void forgetRead() { read_.reset(); }
+
+	private:
+		/** Gets the bytes the storage takes up in the pack buffer. */
+		size_t readSize() const
+		{
+			const DataStorage::Info& info = getInfo();
+			return size_t(info.width) * info.height * 4 * (info.type == DataStorage::Byte ? 1 : 4);
+		}
+
+		GLuint readBuffer_;
+		Engine::Completion::Ptr read_;
 	};
 
 	void* bindProgram( Program* const program );
 	void unbindProgram( Program* const program );
 
-	void runProgram( Program* const program );
+	Engine::Completion::Ptr runProgram( Program* const program );
 
 	vec4 reduce( const Engine::DataStorage::Ptr& storage, Engine::ReductionType type );
 
+	bool requestStatistics( const Engine::DataStorage::Ptr& storage, float histogramMin, float histogramMax );
+	Engine::Statistics collectStatistics();
+
 	Engine::DataStorage::Ptr allocateStorage( const Engine::DataStorage::Info& type, int width, int height );
 	Engine::DataStorage::Ptr emptyStorage();
 
+protected:
+	void textureFreed( unsigned int texture ) { forgetFramebuffers( texture ); }
+
+public:
+
+	Engine::ProgramCacheCounts getProgramCacheCounts() const
+	{
+		Engine::ProgramCacheCounts counts;
+		counts.hits = binaryCacheHits_;
+		counts.misses = binaryCacheMisses_;
+		return counts;
+	}
+
 private:
 	friend class DataStorage;
 
 	void init();
 
 	std::map<std::string, GLuint> loadProgram( Program* const program, std::string filepath );
-	std::map<GLuint, std::map<std::string, GLuint> > uniformCache;
 
-	bool isCached( GLuint shaderProgram );
+	/** A plain uniform of a program, and the generation of its Parameter last uploaded. */
+	struct Uniform
+	{
+		Parameter* parameter;
+		GLint location;
+		unsigned long generation;
+	};
+
+	/** An array of a program kept in its uniform block, at its std140 offset. */
+	struct BlockMember
+	{
+		Parameter* parameter;
+		unsigned int offset;
+		unsigned long generation;
+	};
+
+	/**
+	 * @brief What runProgram() needs to upload the parameters of a program.
+	 *
+	 * It is looked up once, when the program first runs, and only the
+	 * parameters whose generation moved on since are uploaded again.
+	 */
+	struct ProgramUniforms
+	{
+		std::vector<Uniform> uniforms;
+		std::vector<BlockMember> members;
+		/** A copy of the uniform block, which the dirty members are packed into. */
+		std::vector<char> blockData;
+		GLuint blockBuffer;
+		GLint dx, dy;
+		float lastDX, lastDY;
+	};
+
+	std::map<GLuint, ProgramUniforms> uniformCache;
+
 	void cacheProgram( GLuint shaderProgram, Program* const program );
+
+	/** The name of the uniform block the arrays of a program are kept in. */
+	static constexpr const char* BlockName = "ComputeParameters";
+	/** The binding point the uniform block of the running program is bound to. */
+	static const GLuint BlockBinding = 0;
+	/** GL_MAX_UNIFORM_BLOCK_SIZE, which arrays that no longer fit stay plain uniforms past. */
+	GLint maxBlockSize_;
+
+	/**
+	 * @brief Tells whether \a parameter goes in the uniform block, after the members before it.
+	 * @param blockSize The size of the block so far, which grows by the parameter if it goes in.
+	 *
+	 * Arrays go in, so changing a few of their elements is a single
+	 * glBufferSubData, while single values stay plain uniforms.
+	 */
+	bool inUniformBlock( Parameter& parameter, unsigned int& blockSize ) const;
+
+	/** The directory, under the plugin's, linked programs are kept in between runs. */
+	static constexpr const char* BinaryCacheDirectory = "cache";
+
+	/** Whether the driver can hand back linked programs for the binary cache. */
+	bool binaryCache_;
+	/** The vendor, renderer and version of the driver, which the cached binaries are only good for. */
+	std::string driver_;
+	unsigned int binaryCacheHits_;
+	unsigned int binaryCacheMisses_;
+
+	/** Gets the file the binary of a program built from \a source is cached in, or an empty string with no binary cache. */
+	std::string binaryCachePath( const std::string& source ) const;
+	/** Loads a cached program binary, returning 0 if there is none or the driver refuses it. */
+	GLuint loadProgramBinary( const std::string& path );
+	void saveProgramBinary( GLuint shaderProgram, const std::string& path );
 	
 	static void dataTypeToGLFormat( const Engine::DataStorage::Info& type, GLuint* result );
 	void flipTexture( GLuint* texture );
 
-	static GLuint fbo_;
+	/**
+	 * @brief Gets the framebuffer with \a textures attached as its colour attachments, in order.
+	 *
+	 * Each set of outputs gets its framebuffer made, and checked, the first
+	 * time a program runs into it, and keeps it until one of its textures is
+	 * deleted, so runs only bind one.  A program whose storages were set,
+	 * allocated or swapped simply has a different set of textures.
+	 */
+	GLuint getFramebuffer( const std::vector<GLuint>& textures );
+	/** Deletes the framebuffers \a texture is attached to, before the texture goes and its name can be reused. */
+	static void forgetFramebuffers( GLuint texture );
+
+	static std::map<std::vector<GLuint>, GLuint> framebuffers_;
+	static GLuint reductionFbo_;
 	static GLuint depth_;
-	GLint lastFbo_;
+
+	/**
+	 * @brief The pass-through vertex shader every program is linked with.
+	 *
+	 * Its vertices are given in the [0, 1] square the viewport covers, and
+	 * are passed on as the texture coordinate too, so a fragment's texture
+	 * coordinate is where it lies in its output.
+	 */
+	static const char* VertexSource;
+	GLuint vertexShader_;
+
+	/** A triangle covering the [0, 1] square, which passes draw with the scissor cutting out any region. */
+	GLuint triangleArray_;
+	GLuint triangleBuffer_;
+	/** The two triangles of each tile of a tile mask are streamed through this. */
+	GLuint quadArray_;
+	GLuint quadBuffer_;
+
+	/**
+	 * @brief Rewrites a fragment shader written against the compatibility profile for the core profile.
+	 *
+	 * Programs keep reading gl_TexCoord[0] and writing gl_FragColor or
+	 * gl_FragData, which become the output of the vertex shader and an
+	 * array of \a outputs outputs, and texture2D() becomes texture().
+	 */
+	static std::string coreFragmentSource( const std::string& source, unsigned int outputs );
+	GLuint compileShader( GLenum type, const std::string& source );
+
+	/** The state passes change, saved by saveOpenGLStateAndSetup() and put back by restoreOpenGLState(). */
+	struct SavedState
+	{
+		GLint framebuffer;
+		GLint readFramebuffer;
+		GLint viewport[4];
+		GLint scissorBox[4];
+		GLint program;
+		GLint vertexArray;
+		GLint arrayBuffer;
+		GLint activeTexture;
+		GLint texture;
+		GLboolean depthTest;
+		GLboolean blend;
+		GLboolean scissorTest;
+		GLboolean depthMask;
+	};
+	SavedState saved_;
+
+	/** Draws the full-screen triangle, or streamed quads over each region, with the state set up. */
+	void drawRegions( const std::vector<Program::Region>& regions, unsigned int width, unsigned int height );
 	
 	std::map<Engine::ReductionType, GLuint> reductionPrograms_;
 	GLuint reduceTextures_[2];
 	Engine::DataStorage::Info lastReductionTexture_;
 	
 	GLuint loadReduction( const std::string& filename );
+
+	/** Side length of the blocks of input the statistics pass folds into one element. */
+	static const int StatisticsBlock = 16;
+	/** The minimum, the maximum and four histogram bins per render target. */
+	static const int StatisticsTargets = 2 + Engine::Statistics::Bins/4;
+
+	GLuint statisticsProgram_;
+	GLuint statisticsFbo_;
+	GLuint statisticsTextures_[StatisticsTargets];
+	GLuint statisticsBuffer_;
+	int statisticsWidth_;
+	int statisticsHeight_;
+	GLsync statisticsFence_;
+	Engine::Statistics statisticsPending_;
+
+	GLuint loadStatistics();
+
+	/** What runs that queue nothing, or have already waited for the GPU, hand out. */
+	Engine::Completion::Ptr done_;
 	
 	void saveOpenGLStateAndSetup();
 	
 	void restoreOpenGLState();
 };
 
-GLuint GLSLComputeEngine::fbo_ = 0;
+std::map<std::vector<GLuint>, GLuint> GLSLComputeEngine::framebuffers_;
+GLuint GLSLComputeEngine::reductionFbo_ = 0;
 GLuint GLSLComputeEngine::depth_ = 0;
 
+const char* GLSLComputeEngine::VertexSource =
+	"#version 330\n"
+	"layout(location = 0) in vec2 position;\n"
+	"out vec4 computeTexCoord;\n"
+	"void main()\n"
+	"{\n"
+	"	computeTexCoord = vec4( position, 0.0, 1.0 );\n"
+	"	gl_Position = vec4( position * 2.0 - 1.0, 0.0, 1.0 );\n"
+	"}\n";
+
+// only the state a pass changes is saved, rather than whole attribute groups
+// and matrix stacks; texture units past the first are left unbound
 void GLSLComputeEngine::saveOpenGLStateAndSetup()
 {
-	glGetIntegerv( GL_FRAMEBUFFER_BINDING_EXT, &lastFbo_ );
-	glPushAttrib(GL_VIEWPORT_BIT | GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT | GL_TEXTURE_BIT | GL_ENABLE_BIT | GL_PIXEL_MODE_BIT );
+	glGetIntegerv( GL_DRAW_FRAMEBUFFER_BINDING, &saved_.framebuffer );
+	glGetIntegerv( GL_READ_FRAMEBUFFER_BINDING, &saved_.readFramebuffer );
+	glGetIntegerv( GL_VIEWPORT, saved_.viewport );
+	glGetIntegerv( GL_SCISSOR_BOX, saved_.scissorBox );
+	glGetIntegerv( GL_CURRENT_PROGRAM, &saved_.program );
+	glGetIntegerv( GL_VERTEX_ARRAY_BINDING, &saved_.vertexArray );
+	glGetIntegerv( GL_ARRAY_BUFFER_BINDING, &saved_.arrayBuffer );
+	glGetIntegerv( GL_ACTIVE_TEXTURE, &saved_.activeTexture );
+	glActiveTexture( GL_TEXTURE0 );
+	glGetIntegerv( GL_TEXTURE_BINDING_2D, &saved_.texture );
+	saved_.depthTest = glIsEnabled( GL_DEPTH_TEST );
+	saved_.blend = glIsEnabled( GL_BLEND );
+	saved_.scissorTest = glIsEnabled( GL_SCISSOR_TEST );
+	glGetBooleanv( GL_DEPTH_WRITEMASK, &saved_.depthMask );
+
 	glDisable( GL_DEPTH_TEST );
 	glDisable( GL_BLEND );
+	glDisable( GL_SCISSOR_TEST );
 	glDepthMask( GL_FALSE );
+}
 
-	glMatrixMode( GL_MODELVIEW );
-	glPushMatrix();
-	glLoadIdentity();
-	glMatrixMode( GL_PROJECTION );
-	glPushMatrix();
+void GLSLComputeEngine::restoreOpenGLState()
+{
+	if( saved_.depthTest ) glEnable( GL_DEPTH_TEST );
+	if( saved_.blend ) glEnable( GL_BLEND );
+	if( saved_.scissorTest ) glEnable( GL_SCISSOR_TEST ); else glDisable( GL_SCISSOR_TEST );
+	glDepthMask( saved_.depthMask );
+
+	glActiveTexture( GL_TEXTURE0 );
+	glBindTexture( GL_TEXTURE_2D, saved_.texture );
+	glActiveTexture( saved_.activeTexture );
+	glBindBuffer( GL_ARRAY_BUFFER, saved_.arrayBuffer );
+	glBindVertexArray( saved_.vertexArray );
+	glUseProgram( saved_.program );
+	glScissor( saved_.scissorBox[0], saved_.scissorBox[1], saved_.scissorBox[2], saved_.scissorBox[3] );
+	glViewport( saved_.viewport[0], saved_.viewport[1], saved_.viewport[2], saved_.viewport[3] );
+	glBindFramebuffer( GL_DRAW_FRAMEBUFFER, saved_.framebuffer );
+	glBindFramebuffer( GL_READ_FRAMEBUFFER, saved_.readFramebuffer );
+}
 
-	glLoadIdentity();
-	glOrtho(0, 1, 0, 1, -1.0f, 1.0f);
+void GLSLComputeEngine::drawRegions( const std::vector<Program::Region>& regions, unsigned int width, unsigned int height )
+{
+	if( regions.size() == 1 )
+	{
+		const Program::Region& region = regions[0];
+		if( region.x != 0 || region.y != 0 || region.width != width || region.height != height )
+		{
+			glEnable( GL_SCISSOR_TEST );
+			glScissor( region.x, region.y, region.width, region.height );
+		}
+
+		glBindVertexArray( triangleArray_ );
+		glDrawArrays( GL_TRIANGLES, 0, 3 );
+		return;
+	}
+
+	std::vector<float> vertices;
+	vertices.reserve( regions.size() * 12 );
+	for( const Program::Region& region: regions )
+	{
+		float sMin = float(region.x)/width, sMax = float(region.x + region.width)/width;
+		float tMin = float(region.y)/height, tMax = float(region.y + region.height)/height;
+		float quad[12] = { sMin, tMin, sMax, tMin, sMax, tMax, sMin, tMin, sMax, tMax, sMin, tMax };
+		vertices.insert( vertices.end(), quad, quad + 12 );
+	}
+
+	glBindVertexArray( quadArray_ );
+	glBindBuffer( GL_ARRAY_BUFFER, quadBuffer_ );
+	glBufferData( GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STREAM_DRAW );
+	glDrawArrays( GL_TRIANGLES, 0, regions.size() * 6 );
 }
 
-void GLSLComputeEngine::restoreOpenGLState()
+std::string GLSLComputeEngine::coreFragmentSource( const std::string& source, unsigned int outputs )
 {
-	glPopAttrib();
-	glPopMatrix();
-	glMatrixMode( GL_MODELVIEW );
-	glPopMatrix();
-	
-	glBindFramebufferEXT( GL_FRAMEBUFFER_EXT, lastFbo_ );
+	std::string core = source;
+
+	// a #version of the program's own would come after the declarations
+	for( size_t version = core.find("#version"); version != std::string::npos; version = core.find("#version") )
+		core.erase( version, core.find( "\n", version ) - version );
+
+	boost::replace_all( core, "gl_TexCoord[0]", "computeTexCoord" );
+	boost::replace_all( core, "gl_FragColor", "computeFragData[0]" );
+	boost::replace_all( core, "gl_FragData", "computeFragData" );
+	boost::replace_all( core, "texture2D", "texture" );
+
+	return "#version 330\n"
+		"in vec4 computeTexCoord;\n"
+		"layout(location = 0) out vec4 computeFragData[" + boost::lexical_cast<std::string>( std::max( outputs, 1u ) ) + "];\n"
+		+ core;
 }
 
-	void printInfoLog(GLhandleARB obj)
+	void printInfoLog(GLuint obj)
 	{
 	    int infologLength = 0;
 	    int charsWritten  = 0;
 	    char *infoLog;
 	
-	    glGetObjectParameterivARB(obj, GL_OBJECT_INFO_LOG_LENGTH_ARB,
-						 &infologLength);
+	    if (glIsShader(obj))
+		glGetShaderiv(obj, GL_INFO_LOG_LENGTH, &infologLength);
+	    else
+		glGetProgramiv(obj, GL_INFO_LOG_LENGTH, &infologLength);
 	
 	    if (infologLength > 0)
 	    {
 		infoLog = (char *)malloc(infologLength);
-		glGetInfoLogARB(obj, infologLength, &charsWritten, infoLog);
-			printf("%s\n",infoLog);
+		if (glIsShader(obj))
+			glGetShaderInfoLog(obj, infologLength, &charsWritten, infoLog);
+		else
+			glGetProgramInfoLog(obj, infologLength, &charsWritten, infoLog);
+		printf("%s\n",infoLog);
 		free(infoLog);
 	    }
 	}
 
-GLuint GLSLComputeEngine::loadReduction( const std::string& name )
+GLuint GLSLComputeEngine::compileShader( GLenum type, const std::string& source )
 {
-	std::string baseSource = readFile("reductions\\reduction.frag");
-	std::string reductionSource = readFile( "reductions\\" + name + ".frag" );
-	const char* reductionSrc = reductionSource.c_str();
-	const char* baseSrc = baseSource.c_str();
-	
-	GLuint program = glCreateProgramObjectARB();
-	GLuint baseShader = glCreateShaderObjectARB(GL_FRAGMENT_SHADER_ARB);
-	GLuint reductionShader = glCreateShaderObjectARB(GL_FRAGMENT_SHADER_ARB);
-
+	const char* src = source.c_str();
+	GLuint shader = glCreateShader( type );
+	glShaderSource( shader, 1, &src, NULL );
+	glCompileShader( shader );
+	return shader;
+}
 
-	glShaderSourceARB(baseShader, 1, &baseSrc, NULL);
-    glCompileShaderARB(baseShader);
-    
-    glShaderSourceARB(reductionShader, 1, &reductionSrc, NULL);
-    glCompileShaderARB(reductionShader);
+GLuint GLSLComputeEngine::loadReduction( const std::string& name )
+{
+	// only the base declares the output; the reduce() of each reduction just needs a version
+	GLuint baseShader = compileShader( GL_FRAGMENT_SHADER, coreFragmentSource( readFile("reductions/reduction.frag"), 1 ) );
+	GLuint reductionShader = compileShader( GL_FRAGMENT_SHADER, "#version 330\n" + readFile( "reductions/" + name + ".frag" ) );
     
 	printInfoLog(baseShader);
 	printInfoLog(reductionShader);
 
-    glAttachObjectARB(program, reductionShader);
-    glAttachObjectARB(program, baseShader);
+	GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader_);
+    glAttachShader(program, reductionShader);
+    glAttachShader(program, baseShader);
 
-	glLinkProgramARB(program);
+	glLinkProgram(program);
     GLint progLinkSuccess;
-    glGetObjectParameterivARB(program, GL_OBJECT_LINK_STATUS_ARB,
-               &progLinkSuccess);
+    glGetProgramiv(program, GL_LINK_STATUS, &progLinkSuccess);
 	if (!progLinkSuccess)
 	{
 	    printf("Reduction %s could not be compiled.\n", name.c_str());
@@ -225,20 +564,19 @@ vec4 GLSLComputeEngine::reduce( const Engine::DataStorage::Ptr& storage, Engine:
 		glTexImage2D(GL_TEXTURE_2D, 0, format[0], width, height, 0, GL_RGBA, format[1], 0);
 	}
 	
-	glBindFramebufferEXT(GL_FRAMEBUFFER, fbo_);
-	glFramebufferTexture2DEXT(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_2D, reduceTextures_[0], 0);
-	glFramebufferTexture2DEXT(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1_EXT, GL_TEXTURE_2D, reduceTextures_[1], 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, reductionFbo_);
 	glBindTexture( GL_TEXTURE_2D, input );
 
 	GLuint program = reductionPrograms_[type];
 	
-	GLuint xOffLocation = glGetUniformLocationARB( program, "xOff" ); 
-	GLuint yOffLocation = glGetUniformLocationARB( program, "yOff" ); 
-	GLuint widthLocation = glGetUniformLocationARB( program, "width" ); 
-	GLuint heightLocation = glGetUniformLocationARB( program, "height" ); 
+	GLuint xOffLocation = glGetUniformLocation( program, "xOff" ); 
+	GLuint yOffLocation = glGetUniformLocation( program, "yOff" ); 
+	GLuint widthLocation = glGetUniformLocation( program, "width" ); 
+	GLuint heightLocation = glGetUniformLocation( program, "height" ); 
 	
-	glUniform1i( glGetUniformLocationARB( program, "intex" ), 0 );
-	glUseProgramObjectARB( program );
+	glUseProgram( program );
+	glUniform1i( glGetUniformLocation( program, "intex" ), 0 );
+	glBindVertexArray( triangleArray_ );
 	
 	float dx = 1.0/width;
 	float dy = 1.0/height;
@@ -251,8 +589,9 @@ vec4 GLSLComputeEngine::reduce( const Engine::DataStorage::Ptr& storage, Engine:
 		width -= ( width % 2 == 0 )? width/2: (width - 1)/2;
 		height -= ( height % 2 == 0 )? height/2: (height - 1)/2;
 		
-		glDrawBuffer( GL_COLOR_ATTACHMENT0_EXT + (inTex^1) );
+		glDrawBuffer( GL_COLOR_ATTACHMENT0 + (inTex^1) );
 		
+		glDisable( GL_SCISSOR_TEST );
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		
 		float w = float(width)/info.width;
@@ -263,23 +602,10 @@ vec4 GLSLComputeEngine::reduce( const Engine::DataStorage::Ptr& storage, Engine:
 		glUniform1f( widthLocation, w);
 		glUniform1f( heightLocation, h );
 		
-		glBegin( GL_QUADS );
-			// vertex: top left
-			glTexCoord2f( 0, h );
-			glVertex3f( 0, h, 1 );
-	
-			// vertex: top right
-			glTexCoord2f( w, h );
-			glVertex3f( w, h, 1 );
-	
-			// vertex: bottom right
-			glTexCoord2f( w, 0 );
-			glVertex3f( w, 0, 1 );
-	
-			// vertex: bottom left
-			glTexCoord2f( 0, 0 );
-			glVertex3f( 0, 0, 1 );
-		glEnd();
+		// the whole texture is cleared, and only the part still being reduced drawn
+		glEnable( GL_SCISSOR_TEST );
+		glScissor( 0, 0, width, height );
+		glDrawArrays( GL_TRIANGLES, 0, 3 );
 		
 		if( width == 1 && height == 1 ) break;
 		inTex = inTex^1;
@@ -289,16 +615,10 @@ vec4 GLSLComputeEngine::reduce( const Engine::DataStorage::Ptr& storage, Engine:
 	
 	float result[4];
 	
-	glReadBuffer( GL_COLOR_ATTACHMENT0_EXT + (inTex^1) );
+	glReadBuffer( GL_COLOR_ATTACHMENT0 + (inTex^1) );
+	glClampColor( GL_CLAMP_READ_COLOR, GL_FALSE );
 	
 	glReadPixels(0,0,1,1, GL_RGBA, GL_FLOAT, result);
-	
-	glBindTexture( GL_TEXTURE_2D, 0 );
-	glFramebufferTexture2DEXT(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_2D, 0, 0);
-	glFramebufferTexture2DEXT(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1_EXT, GL_TEXTURE_2D, 0, 0);
-	glBindFramebufferEXT(GL_FRAMEBUFFER, 0 );
-	
-	glUseProgramObjectARB(0);
 
 	restoreOpenGLState();
 	
@@ -307,6 +627,158 @@ vec4 GLSLComputeEngine::reduce( const Engine::DataStorage::Ptr& storage, Engine:
 	return vec4( result[0], result[1], result[2], result[3] );
 }
 
+GLuint GLSLComputeEngine::loadStatistics()
+{
+	GLuint shader = compileShader( GL_FRAGMENT_SHADER, coreFragmentSource( readFile("reductions/statistics.frag"), StatisticsTargets ) );
+	printInfoLog(shader);
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertexShader_);
+	glAttachShader(program, shader);
+	glLinkProgram(program);
+	GLint progLinkSuccess;
+	glGetProgramiv(program, GL_LINK_STATUS, &progLinkSuccess);
+	if (!progLinkSuccess)
+	{
+		printf("The statistics reduction could not be compiled.\n");
+		printInfoLog(program);
+		exit(1);
+	}
+
+	return program;
+}
+
+bool GLSLComputeEngine::requestStatistics( const Engine::DataStorage::Ptr& storage, float histogramMin, float histogramMax )
+{
+	if( statisticsFence_ )
+		return false;
+
+	Engine::DataStorage::Info info = storage->getInfo();
+	int width = (info.width + StatisticsBlock - 1)/StatisticsBlock;
+	int height = (info.height + StatisticsBlock - 1)/StatisticsBlock;
+	size_t targetSize = size_t(width) * height * 4 * sizeof(float);
+
+	saveOpenGLStateAndSetup();
+	glBindFramebuffer( GL_FRAMEBUFFER, statisticsFbo_ );
+
+	if( width != statisticsWidth_ || height != statisticsHeight_ )
+	{
+		for( int i = 0; i < StatisticsTargets; i++ )
+		{
+			glBindTexture( GL_TEXTURE_2D, statisticsTextures_[i] );
+			glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, 0 );
+			glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, statisticsTextures_[i], 0 );
+		}
+
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, statisticsBuffer_ );
+		glBufferData( GL_PIXEL_PACK_BUFFER, targetSize * StatisticsTargets, NULL, GL_STREAM_READ );
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+		statisticsWidth_ = width;
+		statisticsHeight_ = height;
+	}
+
+	glViewport( 0, 0, width, height );
+
+	GLenum targets[StatisticsTargets];
+	for( int i = 0; i < StatisticsTargets; i++ )
+		targets[i] = GL_COLOR_ATTACHMENT0 + i;
+	glDrawBuffers( StatisticsTargets, targets );
+
+	glUseProgram( statisticsProgram_ );
+	glUniform1i( glGetUniformLocation( statisticsProgram_, "intex" ), 0 );
+	glUniform1i( glGetUniformLocation( statisticsProgram_, "blockSize" ), StatisticsBlock );
+	glUniform1f( glGetUniformLocation( statisticsProgram_, "histogramMin" ), histogramMin );
+	glUniform1f( glGetUniformLocation( statisticsProgram_, "binScale" ), Engine::Statistics::Bins/(histogramMax - histogramMin) );
+
+	glBindTexture( GL_TEXTURE_2D, storage->getDataStorage() );
+
+	glClampColor( GL_CLAMP_READ_COLOR, GL_FALSE );
+
+	glBindVertexArray( triangleArray_ );
+	glDrawArrays( GL_TRIANGLES, 0, 3 );
+
+	// the reads only queue copies into the pack buffer, and the fence says
+	// when they are done, so nothing here waits for the GPU
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, statisticsBuffer_ );
+	for( int i = 0; i < StatisticsTargets; i++ )
+	{
+		glReadBuffer( GL_COLOR_ATTACHMENT0 + i );
+		glReadPixels( 0, 0, width, height, GL_RGBA, GL_FLOAT, (GLvoid*)(i * targetSize) );
+	}
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+	statisticsFence_ = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	glFlush();
+
+	restoreOpenGLState();
+
+	statisticsPending_ = Engine::Statistics();
+	statisticsPending_.histogramMin = histogramMin;
+	statisticsPending_.histogramMax = histogramMax;
+	statisticsPending_.count = info.width * info.height;
+
+	return true;
+}
+
+Engine::Statistics GLSLComputeEngine::collectStatistics()
+{
+	Engine::Statistics result;
+
+	if( !statisticsFence_ )
+		return result;
+
+	GLenum status = glClientWaitSync( statisticsFence_, 0, 0 );
+	if( status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED )
+		return result;
+
+	glDeleteSync( statisticsFence_ );
+	statisticsFence_ = 0;
+
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, statisticsBuffer_ );
+	const float* data = (const float*) glMapBuffer( GL_PIXEL_PACK_BUFFER, GL_READ_ONLY );
+	if( data )
+	{
+		// each target holds one vec4 per block, so only a few thousand are left to fold here
+		size_t elements = size_t(statisticsWidth_) * statisticsHeight_;
+		const float* low = data;
+		const float* high = data + elements * 4;
+		const float* bins = data + elements * 8;
+
+		result = statisticsPending_;
+		float minimum[4], maximum[4];
+		for( int c = 0; c < 4; c++ )
+		{
+			minimum[c] = std::numeric_limits<float>::max();
+			maximum[c] = -std::numeric_limits<float>::max();
+		}
+
+		for( size_t e = 0; e < elements * 4; e += 4 )
+			for( int c = 0; c < 4; c++ )
+			{
+				minimum[c] = std::min( minimum[c], low[e + c] );
+				maximum[c] = std::max( maximum[c], high[e + c] );
+			}
+
+		for( int target = 0; target < Engine::Statistics::Bins/4; target++ )
+		{
+			const float* targetBins = bins + target * elements * 4;
+			for( size_t e = 0; e < elements * 4; e += 4 )
+				for( int c = 0; c < 4; c++ )
+					result.histogram[target * 4 + c] += (unsigned int)( targetBins[e + c] );
+		}
+
+		result.minimum = vec4( minimum[0], minimum[1], minimum[2], minimum[3] );
+		result.maximum = vec4( maximum[0], maximum[1], maximum[2], maximum[3] );
+		result.ready = true;
+
+		glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+	}
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+	return result;
+}
+
 void GLSLComputeEngine::flipTexture( GLuint* texture )
 {
 	
@@ -314,9 +786,32 @@ void GLSLComputeEngine::flipTexture( GLuint* texture )
 
 void GLSLComputeEngine::init()
 {
-	glGenFramebuffersEXT(1, &fbo_);
 	glUniform::Initalize();
 	checkGLErrors("init");
+
+	vertexShader_ = compileShader( GL_VERTEX_SHADER, VertexSource );
+	printInfoLog(vertexShader_);
+
+	// core contexts draw nothing without a vertex array, so even the
+	// full-screen triangle gets one
+	const float triangle[6] = { 0, 0, 2, 0, 0, 2 };
+	glGenVertexArrays(1, &triangleArray_);
+	glGenBuffers(1, &triangleBuffer_);
+	glBindVertexArray(triangleArray_);
+	glBindBuffer(GL_ARRAY_BUFFER, triangleBuffer_);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+	glGenVertexArrays(1, &quadArray_);
+	glGenBuffers(1, &quadBuffer_);
+	glBindVertexArray(quadArray_);
+	glBindBuffer(GL_ARRAY_BUFFER, quadBuffer_);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
 	reductionPrograms_[Engine::Minimum] = loadReduction("minimum");
 	reductionPrograms_[Engine::Maximum] = loadReduction("maximum");
 	reductionPrograms_[Engine::Sum] = loadReduction("sum");
@@ -328,6 +823,49 @@ void GLSLComputeEngine::init()
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// the reduction textures are resized in place, so they stay attached
+	glGenFramebuffers(1, &reductionFbo_);
+	glBindFramebuffer(GL_FRAMEBUFFER, reductionFbo_);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, reduceTextures_[0], 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, reduceTextures_[1], 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	statisticsProgram_ = loadStatistics();
+	glGenFramebuffers(1, &statisticsFbo_);
+	glGenTextures(StatisticsTargets, statisticsTextures_);
+	for( int i = 0; i < StatisticsTargets; i++ )
+	{
+		glBindTexture(GL_TEXTURE_2D, statisticsTextures_[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glGenBuffers(1, &statisticsBuffer_);
+	statisticsWidth_ = 0;
+	statisticsHeight_ = 0;
+	statisticsFence_ = 0;
+	done_ = Engine::Completion::Ptr( new Engine::Completion() );
+
+	GLint binaryFormats = 0;
+	if( GLEW_ARB_get_program_binary )
+		glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats );
+	binaryCache_ = binaryFormats > 0;
+	driver_ = std::string( (const char*) glGetString(GL_VENDOR) ) + "\n" + (const char*) glGetString(GL_RENDERER)
+		+ "\n" + (const char*) glGetString(GL_VERSION);
+	binaryCacheHits_ = 0;
+	binaryCacheMisses_ = 0;
+
+	glGetIntegerv( GL_MAX_UNIFORM_BLOCK_SIZE, &maxBlockSize_ );
+}
+
+bool GLSLComputeEngine::inUniformBlock( Parameter& parameter, unsigned int& blockSize ) const
+{
+	if( parameter.size() < 2 || blockSize + glUniform::std140Size( parameter ) > (unsigned int) maxBlockSize_ )
+		return false;
+
+	blockSize += glUniform::std140Size( parameter );
+	return true;
 }
 
 void* GLSLComputeEngine::bindProgram( Program* const program )
@@ -335,17 +873,25 @@ void* GLSLComputeEngine::bindProgram( Program* const program )
 	std::string engineName = this->pluginName();
 
 	std::string uniformDeclarations = "uniform float DX;\nuniform float DY;\n";
+	std::string blockDeclarations;
+	unsigned int blockSize = 0;
 
 	BOOST_FOREACH( Program::parameter_storage::value_type& param, *program )
 	{
-		uniformDeclarations += "uniform " + Parameter::nameFromType(param.second.type()) + " " + param.first;
+		std::string declaration = Parameter::nameFromType(param.second.type()) + " " + param.first;
 
 		if( param.second.size() > 1 )
-			uniformDeclarations += "[" + boost::lexical_cast<std::string>(param.second.size()) + "]";
+			declaration += "[" + boost::lexical_cast<std::string>(param.second.size()) + "]";
 
-		uniformDeclarations += ";\n";
+		if( inUniformBlock( param.second, blockSize ) )
+			blockDeclarations += "\t" + declaration + ";\n";
+		else
+			uniformDeclarations += "uniform " + declaration + ";\n";
 	}
 
+	if( !blockDeclarations.empty() )
+		uniformDeclarations += std::string("layout(std140) uniform ") + BlockName + "\n{\n" + blockDeclarations + "};\n";
+
 	if( program->getStorageInfo(Program::Input).type != DataStorage::Void )
 	{
 		uniformDeclarations += "uniform sampler2D intex";
@@ -374,123 +920,370 @@ void* GLSLComputeEngine::bindProgram( Program* const program )
 		programSource.insert( includePos, includeSrc );		
 	}
 
-	programSource = "#version 130\n" + uniformDeclarations + programSource + "\n";
+	// df64 programs get the emulated double arithmetic and a define to pick their df64 path with
+	std::string precisionSource;
+	if( program->getPrecision() == Program::DoubleSingle )
+		precisionSource = "#define DF64\n" + readFile( "includes/df64.frag" );
+
+	programSource = coreFragmentSource( precisionSource + uniformDeclarations + programSource + "\n",
+		program->getStorageCount(Program::Output) );
 	const char* src = programSource.c_str();
-	printf("%s\n", src);
 	
 	GLuint* programData = new GLuint[2];
 
-	programData[0] = glCreateProgramObjectARB();
-	programData[1] = glCreateShaderObjectARB(GL_FRAGMENT_SHADER_ARB);
+	// programs loaded from the binary cache have no shader object, which
+	// unbindProgram() deletes as 0 and so ignores
+	std::string binaryPath = binaryCachePath( VertexSource + programSource );
+	programData[0] = loadProgramBinary( binaryPath );
+	programData[1] = 0;
+	if( programData[0] != 0 )
+	{
+		binaryCacheHits_++;
+		cacheProgram( programData[0], program );
+		return programData;
+	}
+	binaryCacheMisses_++;
 
-	glShaderSourceARB(programData[1], 1, &src, NULL);
-        glCompileShaderARB(programData[1]);
+	programData[0] = glCreateProgram();
+	programData[1] = compileShader( GL_FRAGMENT_SHADER, programSource );
 	//printInfoLog(programData[1]);
-        glAttachObjectARB(programData[0], programData[1]);
+        glAttachShader(programData[0], vertexShader_);
+        glAttachShader(programData[0], programData[1]);
 
-	glLinkProgramARB(programData[0]);
+	if( !binaryPath.empty() )
+		glProgramParameteri(programData[0], GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+	glLinkProgram(programData[0]);
         GLint progLinkSuccess;
-        glGetObjectParameterivARB(programData[0], GL_OBJECT_LINK_STATUS_ARB,
-               &progLinkSuccess);
+        glGetProgramiv(programData[0], GL_LINK_STATUS, &progLinkSuccess);
 	if (!progLinkSuccess)
 	{
 	    printf("Program %s could not be compiled.\n", program->getProgramLocationFile(engineName).c_str());
+		printf("%s\n", src);
 		printInfoLog(programData[1]);
 		checkGLErrors("link");
 	    exit(1);
 	}
 
+	saveProgramBinary( programData[0], binaryPath );
 	cacheProgram( programData[0], program );
 
 	return programData;
 }
 
-bool GLSLComputeEngine::isCached( GLuint shaderProgram )
+std::string GLSLComputeEngine::binaryCachePath( const std::string& source ) const
+{
+	if( !binaryCache_ )
+		return std::string();
+
+	// 64 bit FNV-1a of the driver and the source, which together decide what the binary holds
+	uint64_t hash = 14695981039346656037ULL;
+	const std::string* keys[2] = { &driver_, &source };
+	for( int k = 0; k < 2; k++ )
+		for( size_t i = 0; i < keys[k]->size(); i++ )
+		{
+			hash ^= (unsigned char) (*keys[k])[i];
+			hash *= 1099511628211ULL;
+		}
+
+	char name[32];
+	snprintf( name, sizeof(name), "%016llx.bin", (unsigned long long) hash );
+	return "plugins/" + pluginName() + "/" + BinaryCacheDirectory + "/" + name;
+}
+
+GLuint GLSLComputeEngine::loadProgramBinary( const std::string& path )
+{
+	if( path.empty() )
+		return 0;
+
+	std::ifstream file( path.c_str(), std::ios::binary );
+	if( !file.is_open() )
+		return 0;
+
+	GLenum format;
+	std::vector<char> binary;
+	file.read( (char*) &format, sizeof(format) );
+	binary.assign( std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() );
+	if( binary.empty() )
+		return 0;
+
+	// a driver update can refuse an old binary even with the same version
+	// string, in which case the program is built from source and saved again
+	GLuint shaderProgram = glCreateProgram();
+	glProgramBinary( shaderProgram, format, &binary[0], binary.size() );
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv( shaderProgram, GL_LINK_STATUS, &linked );
+	if( !linked )
+	{
+		glDeleteProgram( shaderProgram );
+		return 0;
+	}
+
+	return shaderProgram;
+}
+
+void GLSLComputeEngine::saveProgramBinary( GLuint shaderProgram, const std::string& path )
 {
-	return uniformCache.find(shaderProgram) != uniformCache.end();
+	if( path.empty() )
+		return;
+
+	GLint length = 0;
+	glGetProgramiv( shaderProgram, GL_PROGRAM_BINARY_LENGTH, &length );
+	if( length <= 0 )
+		return;
+
+	GLenum format;
+	std::vector<char> binary( length );
+	glGetProgramBinary( shaderProgram, length, &length, &format, &binary[0] );
+
+	std::error_code error;
+	std::filesystem::create_directories( std::filesystem::path(path).parent_path(), error );
+
+	// written under another name first so a program that dies halfway
+	// never leaves a truncated binary behind
+	std::string temporaryPath = path + ".tmp";
+	std::ofstream file( temporaryPath.c_str(), std::ios::binary );
+	if( !file.is_open() )
+	{
+		printf("Cannot write the program binary %s.\n", path.c_str());
+		return;
+	}
+
+	file.write( (const char*) &format, sizeof(format) );
+	file.write( &binary[0], length );
+	file.close();
+	std::filesystem::rename( temporaryPath, path, error );
 }
 
 void GLSLComputeEngine::cacheProgram( GLuint shaderProgram, Program* const program )
 {
-	glUseProgramObjectARB(shaderProgram);
+	ProgramUniforms& cache = uniformCache[shaderProgram];
+	unsigned int blockSize = 0;
 
 	BOOST_FOREACH( Program::parameter_storage::value_type& param, *program )
-		uniformCache[shaderProgram][param.first] = glGetUniformLocationARB( shaderProgram, param.first.c_str() );
+	{
+		unsigned int offset = blockSize;
+		if( inUniformBlock( param.second, blockSize ) )
+			cache.members.push_back( BlockMember{ &param.second, offset, 0 } );
+		else
+			cache.uniforms.push_back( Uniform{ &param.second, glGetUniformLocation( shaderProgram, param.first.c_str() ), 0 } );
+	}
+
+	// a block whose arrays the shader never reads is optimised away
+	cache.blockBuffer = 0;
+	GLuint blockIndex = cache.members.empty()? GL_INVALID_INDEX: glGetUniformBlockIndex( shaderProgram, BlockName );
+	if( blockIndex != GL_INVALID_INDEX )
+	{
+		glUniformBlockBinding( shaderProgram, blockIndex, BlockBinding );
+		cache.blockData.assign( blockSize, 0 );
+
+		glGenBuffers( 1, &cache.blockBuffer );
+		glBindBuffer( GL_UNIFORM_BUFFER, cache.blockBuffer );
+		glBufferData( GL_UNIFORM_BUFFER, blockSize, NULL, GL_DYNAMIC_DRAW );
+		glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+	}
 
+	// the samplers never change, so they are set once here, with the
+	// program put in use for it since bindProgram() calls this too
 	if( program->getStorageInfo(Program::Input).type != DataStorage::Void )
-		uniformCache[shaderProgram]["intex"] = glGetUniformLocationARB( shaderProgram, "input" );
+	{
+		unsigned int count = program->getStorageCount(Program::Input);
+		std::vector<GLint> texArray( count );
+		for( unsigned int i = 0; i < count; i++ )
+			texArray[i] = i;
 
-	uniformCache[shaderProgram]["DX"] = glGetUniformLocationARB( shaderProgram, "DX" );
-	uniformCache[shaderProgram]["DY"] = glGetUniformLocationARB( shaderProgram, "DY" );
-	
-	glUseProgramObjectARB(0);
+		GLint currentProgram;
+		glGetIntegerv( GL_CURRENT_PROGRAM, &currentProgram );
+		glUseProgram( shaderProgram );
+		glUniform1iv( glGetUniformLocation( shaderProgram, "intex" ), count, &texArray[0] );
+		glUseProgram( currentProgram );
+	}
+
+	cache.dx = glGetUniformLocation( shaderProgram, "DX" );
+	cache.dy = glGetUniformLocation( shaderProgram, "DY" );
+	cache.lastDX = cache.lastDY = 0;
 }
 
 void GLSLComputeEngine::unbindProgram( Program* const program )
 {
 	GLuint* programPtr = (GLuint*) program->getActiveProgram();
+
+	std::map<GLuint, ProgramUniforms>::iterator cache = uniformCache.find( programPtr[0] );
+	if( cache != uniformCache.end() )
+	{
+		glDeleteBuffers( 1, &cache->second.blockBuffer );
+		uniformCache.erase( cache );
+	}
+
 	glDeleteShader( programPtr[1] );
 	glDeleteProgram( programPtr[0] );
 	delete programPtr;
 }
 
-void GLSLComputeEngine::runProgram( Program* const program )
+Engine::Completion::Ptr GLSLComputeEngine::runProgram( Program* const program )
 {
 std::string engineName = this->pluginName();
 
 	DataStorage::Info info = program->getStorage(Program::Output, 0)->getInfo();
 
+	// a run region draws the quad over just that part of the output, with the
+	// texture coordinates a full run would have there
+	unsigned int left = 0, bottom = 0, right = info.width, top = info.height;
+	if( program->hasRunRegion() )
+	{
+		const Program::Region& region = program->getRunRegion();
+		left = std::min( region.x, info.width );
+		bottom = std::min( region.y, info.height );
+		right = std::min( region.x + region.width, info.width );
+		top = std::min( region.y + region.height, info.height );
+		if( right <= left || top <= bottom )
+			return done_;
+	}
+
+	// a tile mask draws a quad over each active tile instead, all in one batch
+	std::vector<Program::Region> quads;
+	if( program->hasActiveTiles() )
+	{
+		const Program::TileMask& mask = program->getActiveTiles();
+		for( unsigned int row = 0; row < mask.rows; row++ )
+			for( unsigned int column = 0; column < mask.columns; column++ )
+			{
+				if( !mask.active[row * mask.columns + column] )
+					continue;
+
+				unsigned int x = std::max( column * mask.tileSize, left );
+				unsigned int y = std::max( row * mask.tileSize, bottom );
+				unsigned int xEnd = std::min( (column + 1) * mask.tileSize, right );
+				unsigned int yEnd = std::min( (row + 1) * mask.tileSize, top );
+				if( x < xEnd && y < yEnd )
+					quads.push_back( Program::Region{ x, y, xEnd - x, yEnd - y } );
+			}
+
+		if( quads.empty() )
+			return done_;
+	}
+	else
+		quads.push_back( Program::Region{ left, bottom, right - left, top - bottom } );
+
 	saveOpenGLStateAndSetup();
 	glViewport( 0, 0, info.width, info.height );
 
 	GLuint shaderProgram = ((GLuint*)program->getActiveProgram())[0];
 
-	glUseProgramObjectARB( shaderProgram );
+	glUseProgram( shaderProgram );
 
-	if( !isCached(shaderProgram) )
+	std::map<GLuint, ProgramUniforms>::iterator cached = uniformCache.find( shaderProgram );
+	if( cached == uniformCache.end() )
+	{
 		cacheProgram( shaderProgram, program );
+		cached = uniformCache.find( shaderProgram );
+	}
+	ProgramUniforms& cache = cached->second;
 
-	BOOST_FOREACH( Program::parameter_storage::value_type& param, *program )
-		glUniform::push[param.second.type()]( uniformCache[shaderProgram][param.first], param.second );
+	// uniforms keep their values in the program object, so only what was
+	// written since the last run goes up
+	for( Uniform& uniform: cache.uniforms )
+	{
+		unsigned long generation = uniform.parameter->generation();
+		if( generation == uniform.generation )
+			continue;
+
+		glUniform::push[uniform.parameter->type()]( uniform.location, uniform.parameter->size(), uniform.parameter->data() );
+		uniform.generation = generation;
+	}
+
+	if( cache.blockBuffer )
+	{
+		unsigned int dirtyBegin = cache.blockData.size(), dirtyEnd = 0;
+		for( BlockMember& member: cache.members )
+		{
+			unsigned long generation = member.parameter->generation();
+			if( generation == member.generation )
+				continue;
+
+			unsigned int size = glUniform::packStd140( *member.parameter, &cache.blockData[member.offset] );
+			dirtyBegin = std::min( dirtyBegin, member.offset );
+			dirtyEnd = std::max( dirtyEnd, member.offset + size );
+			member.generation = generation;
+		}
+
+		glBindBuffer( GL_UNIFORM_BUFFER, cache.blockBuffer );
+		if( dirtyBegin < dirtyEnd )
+			glBufferSubData( GL_UNIFORM_BUFFER, dirtyBegin, dirtyEnd - dirtyBegin, &cache.blockData[dirtyBegin] );
+		glBindBufferBase( GL_UNIFORM_BUFFER, BlockBinding, cache.blockBuffer );
+	}
 
 	if( program->getStorageInfo(Program::Input).type != DataStorage::Void )
 	{
 		unsigned int count = program->getStorageCount(Program::Input);
-		int texArray[count];
-		
-		for( int i = 0; i < count; i++ )
+		for( unsigned int i = 0; i < count; i++ )
 		{
-			texArray[i] = i;
-			glActiveTextureARB( GL_TEXTURE0_ARB + i );
+			glActiveTexture( GL_TEXTURE0 + i );
 			glBindTexture(GL_TEXTURE_2D, 
 				std::any_cast<GLuint>(program->getStorage(Program::Input, i)->getDataStorage()));
 		}
-		glUniform1iv( uniformCache[shaderProgram]["intex"], count, texArray );
 	}
 
-	glUniform1f( uniformCache[shaderProgram]["DX"], 1.0f/info.width );
-	glUniform1f( uniformCache[shaderProgram]["DY"], 1.0f/info.height );
-
-	glClampColorARB( GL_CLAMP_VERTEX_COLOR_ARB, GL_FALSE );
-	glClampColorARB( GL_CLAMP_FRAGMENT_COLOR_ARB,  GL_FALSE);
-	glClampColorARB( GL_CLAMP_READ_COLOR_ARB, GL_FALSE );
+	float dx = 1.0f/info.width, dy = 1.0f/info.height;
+	if( dx != cache.lastDX || dy != cache.lastDY )
+	{
+		glUniform1f( cache.dx, dx );
+		glUniform1f( cache.dy, dy );
+		cache.lastDX = dx;
+		cache.lastDY = dy;
+	}
 
-	glBindFramebufferEXT(GL_DRAW_FRAMEBUFFER, fbo_);
-	
 	unsigned int count = program->getStorageCount( Program::Output );
-	//printf("attaching %d textures\n", count);
-	GLenum renderTargets[count];
-	
-	for( int i = 0; i < count; i++ )
+	std::vector<GLuint> outputs( count );
+	for( unsigned int i = 0; i < count; i++ )
+		outputs[i] = program->getStorage(Program::Output, i)->getDataStorage();
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, getFramebuffer( outputs ));
+
+	for( unsigned int i = 0; i < count; i++ )
+		static_cast<DataStorage*>( program->getStorage(Program::Output, i).get() )->forgetRead();
+
+	// the viewport covers the whole output, so vertices and texture coordinates match
+	drawRegions( quads, info.width, info.height );
+
+	restoreOpenGLState();
+
+	if( !isAsynchronous() )
 	{
-		glFramebufferTexture2DEXT(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0_EXT + i, GL_TEXTURE_2D, 
-			std::any_cast<GLuint>(program->getStorage(Program::Output, i)->getDataStorage()), 0);
-		renderTargets[i] = GL_COLOR_ATTACHMENT0_EXT + i;
+		glFinish();
+		return done_;
 	}
-	
-	glDrawBuffers(count, renderTargets);
-		
-	GLenum status = glCheckFramebufferStatusEXT(GL_DRAW_FRAMEBUFFER);
+
+	// the run is only queued; host reads of its outputs wait for the fence
+	Engine::Completion::Ptr completion( new Fence() );
+	for( unsigned int i = 0; i < count; i++ )
+		program->getStorage(Program::Output, i)->setPendingWrite( completion );
+
+	return completion;
+}
+
+GLuint GLSLComputeEngine::getFramebuffer( const std::vector<GLuint>& textures )
+{
+	std::map<std::vector<GLuint>, GLuint>::iterator found = framebuffers_.find( textures );
+	if( found != framebuffers_.end() )
+		return found->second;
+
+	GLuint framebuffer;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+
+	GLenum renderTargets[textures.size()];
+	for( size_t i = 0; i < textures.size(); i++ )
+	{
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, textures[i], 0);
+		renderTargets[i] = GL_COLOR_ATTACHMENT0 + i;
+	}
+
+	// the draw buffers belong to the framebuffer, so they are set once too
+	glDrawBuffers(textures.size(), renderTargets);
+
+	GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
 	#define FRAMEBUFFER_CASE(c) case c: printf("Framebuffer error: %s\n", #c); break;
 	switch( status )
 	{
@@ -498,35 +1291,35 @@ std::string engineName = this->pluginName();
 		FRAMEBUFFER_CASE(GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT)
 		FRAMEBUFFER_CASE(GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER)
 		FRAMEBUFFER_CASE(GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER)
+		case GL_FRAMEBUFFER_COMPLETE: break;
+		default: printf("Framebuffer error: 0x%x\n", status); break;
 	}
 
+	// a run into an incomplete framebuffer draws nothing, so there is no point going on
+	if( status != GL_FRAMEBUFFER_COMPLETE )
+	{
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &framebuffer);
+		exit(1);
+	}
 
-	glBegin( GL_QUADS );
-		// vertex: top left
-		glTexCoord2f( 0, 1 );
-		glVertex3f( 0, 1, 1 );
-	
-		// vertex: top right
-		glTexCoord2f( 1, 1 );
-		glVertex3f( 1, 1, 1 );
-	
-		// vertex: bottom right
-		glTexCoord2f( 1, 0 );
-		glVertex3f( 1, 0, 1 );
-	
-		// vertex: bottom left
-		glTexCoord2f( 0, 0 );
-		glVertex3f( 0, 0, 1 );
-	glEnd();
-	for( int i = 0; i < count; i++ )
-		glFramebufferTexture2DEXT(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0_EXT + i, GL_TEXTURE_2D, 0, 0);
-	glBindFramebufferEXT(GL_DRAW_FRAMEBUFFER, 0);
-
-	glUseProgramObjectARB(0);
-	
-	restoreOpenGLState();
+	framebuffers_[textures] = framebuffer;
+	return framebuffer;
+}
 
-	glFinish();
+void GLSLComputeEngine::forgetFramebuffers( GLuint texture )
+{
+	std::map<std::vector<GLuint>, GLuint>::iterator i = framebuffers_.begin();
+	while( i != framebuffers_.end() )
+	{
+		if( std::find( i->first.begin(), i->first.end(), texture ) != i->first.end() )
+		{
+			glDeleteFramebuffers(1, &i->second);
+			framebuffers_.erase( i++ );
+		}
+		else
+			++i;
+	}
 }
 
 Engine::DataStorage::Ptr GLSLComputeEngine::allocateStorage( const Engine::DataStorage::Info& type, int width, int height )
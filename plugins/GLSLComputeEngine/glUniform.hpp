@@ -1,49 +1,87 @@
 namespace glUniform
 {
-	typedef void (*TypeFunction)( GLuint, Parameter& );
+	typedef void (*TypeFunction)( GLint, GLsizei, const void* );
 
-	void Float( GLuint location, Parameter& parameter )
+	void Float( GLint location, GLsizei count, const void* value )
 	{
-		glUniform1fvARB( location, parameter.size(), (float*) parameter );
+		glUniform1fv( location, count, (const GLfloat*) value );
 	}
 
-	void Int( GLuint location, Parameter& parameter )
+	void Int( GLint location, GLsizei count, const void* value )
 	{
-		glUniform1ivARB( location, parameter.size(), (int*) parameter );
+		glUniform1iv( location, count, (const GLint*) value );
 	}
 
-	void Vec2( GLuint location, Parameter& parameter )
+	void Vec2( GLint location, GLsizei count, const void* value )
 	{
-		glUniform2fvARB( location, parameter.size(), (GLfloat*)((vec2*) parameter) );
+		glUniform2fv( location, count, (const GLfloat*) value );
 	}
 
-	void Vec3( GLuint location, Parameter& parameter )
+	void Vec3( GLint location, GLsizei count, const void* value )
 	{
-		glUniform3fvARB( location, parameter.size(), (GLfloat*)((vec3*) parameter) );
+		glUniform3fv( location, count, (const GLfloat*) value );
 	}
 
-	void Vec4( GLuint location, Parameter& parameter )
+	void Vec4( GLint location, GLsizei count, const void* value )
 	{
 		// glUniform4fv expects the third parameter to be a float array
 		// with the second parameter being the size of the array divided by 4.
-		// since the vec4 array is essentially an array of floats when laid out 
+		// since the vec4 array is essentially an array of floats when laid out
 		// in memory we can just pass the vec4 array pointer in.
 		//
 		// this is somewhat of an ugly hack, but I like it. :)
-		glUniform4fvARB( location, parameter.size(), (GLfloat*)((vec4*) parameter) );
+		glUniform4fv( location, count, (const GLfloat*) value );
 	}
-	
-	void Mat3( GLuint location, Parameter& parameter )
+
+	void Mat3( GLint location, GLsizei count, const void* value )
 	{
-		glUniformMatrix3fvARB( location, parameter.size(), 0, (GLfloat*)((mat3*) parameter) );
+		glUniformMatrix3fv( location, count, 0, (const GLfloat*) value );
 	}
 
-	void Mat4( GLuint location, Parameter& parameter )
+	void Mat4( GLint location, GLsizei count, const void* value )
 	{
-		glUniformMatrix4fvARB( location, parameter.size(), 0, (GLfloat*)((mat4*) parameter) );
+		glUniformMatrix4fv( location, count, 0, (const GLfloat*) value );
 	}
 
-	std::map<Parameter::ParameterType, TypeFunction> push;
+	/** The upload function of each Parameter::ParameterType, indexed by it. */
+	TypeFunction push[Parameter::Mat4 + 1];
+
+	/**
+	 * @brief How an array element of each type is laid out in a std140 uniform block.
+	 *
+	 * Every column of an element starts 16 bytes after the last, so
+	 * scalars, vectors and mat3 columns are padded and only vec4 and mat4
+	 * arrays are laid out like a Parameter holds them.
+	 */
+	struct Std140Layout
+	{
+		unsigned int columns;
+		unsigned int columnSize;
+	};
+
+	Std140Layout std140[Parameter::Mat4 + 1];
+
+	/** Gets the bytes a uniform block member holding \a parameter takes up. */
+	unsigned int std140Size( Parameter& parameter )
+	{
+		return parameter.size() * std140[parameter.type()].columns * 16;
+	}
+
+	/** Copies \a parameter into \a block with its std140 padding, returning the bytes written. */
+	unsigned int packStd140( Parameter& parameter, char* block )
+	{
+		const Std140Layout& layout = std140[parameter.type()];
+		const char* value = (const char*) parameter.data();
+		unsigned int columns = parameter.size() * layout.columns;
+
+		if( layout.columnSize == 16 )
+			memcpy( block, value, columns * 16 );
+		else
+			for( unsigned int i = 0; i < columns; i++ )
+				memcpy( block + i * 16, value + i * layout.columnSize, layout.columnSize );
+
+		return columns * 16;
+	}
 
 	void Initalize()
 	{
@@ -54,5 +92,13 @@ namespace glUniform
 		push[Parameter::Vec4] = &Vec4;
 		push[Parameter::Mat3] = &Mat3;
 		push[Parameter::Mat4] = &Mat4;
+
+		std140[Parameter::Float] = Std140Layout{ 1, sizeof(float) };
+		std140[Parameter::Int] = Std140Layout{ 1, sizeof(int) };
+		std140[Parameter::Vec2] = Std140Layout{ 1, sizeof(vec2) };
+		std140[Parameter::Vec3] = Std140Layout{ 1, sizeof(vec3) };
+		std140[Parameter::Vec4] = Std140Layout{ 1, sizeof(vec4) };
+		std140[Parameter::Mat3] = Std140Layout{ 3, sizeof(mat3)/3 };
+		std140[Parameter::Mat4] = Std140Layout{ 4, sizeof(mat4)/4 };
 	}
 };
@@ -0,0 +1,136 @@
+/**
+ * @file df64.frag
+ * @brief Emulated double precision ("double-single") arithmetic in GLSL.
+ *
+ * A df64 value is a vec2 holding the float nearest the value in x and the
+ * float nearest what is left over in y, which gives about 48 bits of
+ * mantissa but no more exponent range than a float.  The engine injects
+ * this file into programs whose precision is df64 and defines DF64, so
+ * programs can keep a float path next to the df64 one.
+ *
+ * The arithmetic relies on every float operation being rounded exactly
+ * once, so drivers must not reassociate or contract it.
+ */
+#pragma optionNV(fastmath off)
+#pragma optionNV(fastprecision off)
+
+/**
+ * @brief Converts a float to df64.
+ * @param a The float.
+ * @return \f$a\f$ with no remainder.
+ */
+vec2 df64( float a )
+{
+	return vec2( a, 0.0 );
+}
+
+/**
+ * @brief Adds two floats without losing the rounding error.
+ * @return The rounded sum in x and its error in y.
+ */
+vec2 df64TwoSum( float a, float b )
+{
+	float s = a + b;
+	float v = s - a;
+	float e = (a - (s - v)) + (b - v);
+	return vec2( s, e );
+}
+
+/**
+ * @brief Adds two floats whose sum is known to be no bigger than \a a.
+ * @return The rounded sum in x and its error in y.
+ */
+vec2 df64QuickTwoSum( float a, float b )
+{
+	float s = a + b;
+	float e = b - (s - a);
+	return vec2( s, e );
+}
+
+/**
+ * @brief Splits a float into two halves of 12 bits each.
+ * @return The high half in x and the low half in y.
+ */
+vec2 df64Split( float a )
+{
+	float t = a * 4097.0;
+	float hi = t - (t - a);
+	return vec2( hi, a - hi );
+}
+
+/**
+ * @brief Multiplies two floats without losing the rounding error.
+ * @return The rounded product in x and its error in y.
+ */
+vec2 df64TwoProduct( float a, float b )
+{
+	float p = a * b;
+	vec2 as = df64Split(a);
+	vec2 bs = df64Split(b);
+	float e = ((as.x * bs.x - p) + as.x * bs.y + as.y * bs.x) + as.y * bs.y;
+	return vec2( p, e );
+}
+
+/**
+ * @brief Adds two df64 values.
+ * @return \f$a + b\f$
+ */
+vec2 df64Add( vec2 a, vec2 b )
+{
+	vec2 s = df64TwoSum( a.x, b.x );
+	vec2 t = df64TwoSum( a.y, b.y );
+	s.y += t.x;
+	s = df64QuickTwoSum( s.x, s.y );
+	s.y += t.y;
+	return df64QuickTwoSum( s.x, s.y );
+}
+
+/**
+ * @brief Negates a df64 value.
+ * @return \f$-a\f$
+ */
+vec2 df64Neg( vec2 a )
+{
+	return -a;
+}
+
+/**
+ * @brief Subtracts two df64 values.
+ * @return \f$a - b\f$
+ */
+vec2 df64Sub( vec2 a, vec2 b )
+{
+	return df64Add( a, -b );
+}
+
+/**
+ * @brief Multiplies two df64 values.
+ * @return \f$a * b\f$
+ */
+vec2 df64Mul( vec2 a, vec2 b )
+{
+	vec2 p = df64TwoProduct( a.x, b.x );
+	p.y += a.x * b.y + a.y * b.x;
+	return df64QuickTwoSum( p.x, p.y );
+}
+
+/**
+ * @brief Divides two df64 values.
+ * @return \f$\frac{a}{b}\f$
+ */
+vec2 df64Div( vec2 a, vec2 b )
+{
+	float q = a.x / b.x;
+	vec2 r = df64Sub( a, df64Mul( df64(q), b ) );
+	float q2 = r.x / b.x;
+	return df64QuickTwoSum( q, q2 );
+}
+
+/**
+ * @brief Gets a df64 value as the nearest float.
+ * @return \f$a\f$ rounded to a float.
+ */
+float df64ToFloat( vec2 a )
+{
+	return a.x + a.y;
+}
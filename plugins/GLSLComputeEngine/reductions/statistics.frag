@@ -0,0 +1,46 @@
+#version 130
+
+// Gathers the minimum, maximum and a 16 bin histogram of the first component
+// of one blockSize x blockSize block of the input per output element.  The
+// engine reads the small result back later and finishes it on the host.
+
+uniform sampler2D intex;
+uniform int blockSize;
+uniform float histogramMin;
+uniform float binScale;
+
+void main()
+{
+	ivec2 size = textureSize( intex, 0 );
+	ivec2 start = ivec2( gl_FragCoord.xy ) * blockSize;
+	ivec2 end = min( start + blockSize, size );
+
+	vec4 low = vec4( 3.4e38 );
+	vec4 high = vec4( -3.4e38 );
+	vec4 bins[4];
+	for( int k = 0; k < 4; k++ )
+		bins[k] = vec4( 0.0 );
+
+	for( int y = start.y; y < end.y; y++ )
+		for( int x = start.x; x < end.x; x++ )
+		{
+			vec4 value = texelFetch( intex, ivec2( x, y ), 0 );
+			low = min( low, value );
+			high = max( high, value );
+
+			float bin = floor( (value.x - histogramMin) * binScale );
+			if( bin >= 0.0 && bin < 16.0 )
+			{
+				ivec4 index = ivec4( int(bin) );
+				for( int k = 0; k < 4; k++ )
+					bins[k] += vec4( equal( ivec4( 4 * k ) + ivec4( 0, 1, 2, 3 ), index ) );
+			}
+		}
+
+	gl_FragData[0] = low;
+	gl_FragData[1] = high;
+	gl_FragData[2] = bins[0];
+	gl_FragData[3] = bins[1];
+	gl_FragData[4] = bins[2];
+	gl_FragData[5] = bins[3];
+}
@@ -1,5 +1,31 @@
 void main()
 {
+#ifdef DF64
+	// each part is a df64 pair: the transform writes the remainders in zw
+	vec4 start = texture( intex, gl_TexCoord[0].st );
+	vec2 startX = start.xz;
+	vec2 startY = start.yw;
+	
+	vec2 valueX;
+	vec2 valueY;
+	vec2 lastX = startX;
+	vec2 lastY = startY;
+	float radiusSquared = escapeRadius * escapeRadius;
+	
+	for( int i = 1; i < maxIterations; i++ )
+	{
+		valueX = $df64x$;
+		valueY = $df64y$;
+		
+		if( valueX.x * valueX.x + valueY.x * valueY.x > radiusSquared )
+		{
+			gl_FragColor = vec4( i, 0.0, 0.0, 0.0 );
+			return;
+		}
+		lastX = valueX;
+		lastY = valueY;
+	}
+#else
 	vec2 startValue = texture( intex, gl_TexCoord[0].st ).xy;
 	
 	vec2 value;
@@ -19,6 +45,7 @@ void main()
 		}
 		lastValue = value;
 	}
+#endif
 	
 	gl_FragColor = vec4( -1, 0.0, 0.0, 0.0 );
 }
@@ -1,4 +1,6 @@
 assert(loadfile("scripts/drawStatus.lua"))()
+assert(loadfile("scripts/computeEngine.lua"))()
+assert(loadfile("scripts/progressivePlane.lua"))()
 
 Escape = {}
 
@@ -38,31 +40,151 @@ function Escape:loadAllEscapes()
 	end
 end
 
+-- Rewrites an escape formula as calls to the df64.frag functions, or returns
+-- nil and the reason when it uses something df64.frag has no function for.
+function Escape.formulaToDF64( formula )
+	local variables = { x = "lastX", y = "lastY", cx = "startX", cy = "startY" }
+	local position = 1
+	
+	local function accept( c )
+		position = string.find( formula, "%S", position ) or #formula + 1
+		if string.sub( formula, position, position ) == c then
+			position = position + 1
+			return true
+		end
+		return false
+	end
+	
+	local function match( pattern )
+		position = string.find( formula, "%S", position ) or #formula + 1
+		local token = string.match( formula, "^" .. pattern, position )
+		if token then position = position + #token end
+		return token
+	end
+	
+	local expression
+	
+	local function primary()
+		if accept("(") then
+			local value = expression()
+			if not accept(")") then error("expected ')'", 0) end
+			return value
+		end
+		
+		local number = match("%d*%.?%d+") or match("%d+%.")
+		if number then
+			if not string.find( number, "%." ) then number = number .. ".0" end
+			return string.format( "df64(%s)", number )
+		end
+		
+		local variable = match("%[%a+%]")
+		if variable then
+			local name = variables[string.sub( variable, 2, -2 )]
+			if not name then error("unknown variable " .. variable, 0) end
+			return name
+		end
+		
+		local parameter = match("p%[%d+%]")
+		if parameter then return string.format( "df64(%s)", parameter ) end
+		
+		error(string.format( "cannot use '%s' in df64", string.sub( formula, position ) ), 0)
+	end
+	
+	local function unary()
+		if accept("-") then return string.format( "df64Neg(%s)", unary() ) end
+		accept("+")
+		return primary()
+	end
+	
+	local function term()
+		local value = unary()
+		while true do
+			if accept("*") then value = string.format( "df64Mul(%s, %s)", value, unary() )
+			elseif accept("/") then value = string.format( "df64Div(%s, %s)", value, unary() )
+			else return value end
+		end
+	end
+	
+	expression = function()
+		local value = term()
+		while true do
+			if accept("+") then value = string.format( "df64Add(%s, %s)", value, term() )
+			elseif accept("-") then value = string.format( "df64Sub(%s, %s)", value, term() )
+			else return value end
+		end
+	end
+	
+	local ok, result = pcall( function()
+		local value = expression()
+		if position <= #formula then error(string.format( "unexpected '%s'", string.sub( formula, position ) ), 0) end
+		return value
+	end )
+	
+	if ok then return result end
+	return nil, result
+end
+
 function Escape:useEscape( name, unbind )
 	local escape = self.escapes[name]
-	local source = io.open(self:getWorkingDirectory() .. "escape.frag"):read("*a")
 	local exp = {"x", "y"}
 
 	if unbind ~= false then self.calc:unbindEngine() end
 	
+	local formulas = {}
 	for k,v in pairs(exp) do
 		local sourceString = escape[v]
-		for index,v in pairs(escape.parameters) do
-			sourceString = string.gsub( sourceString, "%[" .. v.name .. "%]", 
+		for index,p in pairs(escape.parameters) do
+			sourceString = string.gsub( sourceString, "%[" .. p.name .. "%]", 
 					string.format("p[%d]", index))
 		end
+		formulas[v] = sourceString
+	end
+	
+	if self.engineName == "CPUComputeEngine" then
+		-- built in escapes have native kernels, anything else is compiled to bytecode
+		if KernelRegistry.instance():hasKernel("escape." .. name) then
+			self.calc:setProgramLocationKernel(self.engineName, "escape." .. name)
+		else
+			self.calc:setProgramLocationMemoryString(self.engineName, string.format(
+				"#pragma compiler escape\nx = %s;\ny = %s;\n", formulas.x, formulas.y))
+		end
+	else
+		local source = io.open(self:getWorkingDirectory() .. "escape.frag"):read("*a")
+		for k,v in pairs(exp) do
+			local sourceString = formulas[v]
+			for k,w in pairs(exp) do
+				sourceString = string.gsub( sourceString, string.format("%%[%s%%]", w), 
+					string.format("lastValue.%s", w))
+			end
+			print(v .. ": " .. sourceString)
+			source = string.gsub( source, string.format("%%$%s%%$", v), sourceString)
+		end
+		
+		source = string.gsub( source, "%[cx%]", "startValue.x")
+		source = string.gsub( source, "%[cy%]", "startValue.y")
+		
+		-- the df64 path is only compiled when the program asks for it, but it
+		-- still needs something in its place
+		local df64 = { x = "df64(0.0)", y = "df64(0.0)" }
+		if self.calc:getPrecision() == Program.DoubleSingle then
+			for k,v in pairs(exp) do
+				local df64String, reason = Escape.formulaToDF64( formulas[v] )
+				if not df64String then
+					print(string.format( "%s has no df64 form (%s), using float.", name, reason ))
+					self.calc:setPrecision( Program.Single )
+					self.transform:setPrecision( Program.Single )
+					break
+				end
+				df64[v] = df64String
+			end
+		end
 		
 		for k,v in pairs(exp) do
-			sourceString = string.gsub( sourceString, string.format("%%[%s%%]", v), 
-				string.format("lastValue.%s", v))
+			source = string.gsub( source, string.format("%%$df64%s%%$", v), df64[v] )
 		end
-		print(v .. ": " .. sourceString)
-		source = string.gsub( source, string.format("%%$%s%%$", v), sourceString)
+		self.calc:setProgramLocationMemoryString(self.engineName, source)
 	end
 	
-	source = string.gsub( source, "%[cx%]", "startValue.x")
-	source = string.gsub( source, "%[cy%]", "startValue.y")
-	
 	self.parameters = {}
 	for name,v in pairs(escape.parameters) do
 		self.parameters[v.index] = {}
@@ -70,9 +192,7 @@ function Escape:useEscape( name, unbind )
 	end				
 
 	self.activeEscape = escape
-	self.maxIterations = escape.maxIterations
-	self.minIterations = 0
-	self.calc:setProgramLocationMemoryString("GLSLComputeEngine", source)
+	self.iterationBudget = escape.maxIterations
 	self.calc:bindEngine(self.engine)
 end
 
@@ -81,27 +201,137 @@ function Escape:processTransitions( dt )
 		for k,v in pairs(self.activeEscape.parameters) do
 			local param = self.parameters[k]
 			param.startVal = param.endVal
+			if param.val ~= param.startVal then self:restartRefinement() end
 			param.val = param.startVal
 			param.endVal = math.random() * (v.max - v.min) + v.min
 		end
 		self.time = self.transTime
 	else
 		for k,v in pairs(self.parameters) do
-			v.val = self.smoothstep( 1 - self.time/self.transTime, v.startVal, v.endVal )
+			local val = self.smoothstep( 1 - self.time/self.transTime, v.startVal, v.endVal )
+			if val ~= v.val then self:restartRefinement() end
+			v.val = val
 		end
 		self.time = self.time - dt
 	end
 end
 
 function Escape:updateTransform( func, unbind )
+	self.transformFunction = func
 	if unbind ~= false then self.transform:unbindEngine() end
-	local source = io.open("programs/transform.frag"):read("*a")
-	source = string.gsub(source, "%$TRANSFORM%$", func)
-	self.transform:setProgramLocationMemoryString("GLSLComputeEngine", source)
+	if self.engineName == "CPUComputeEngine" then
+		-- the native transform kernel only maps the plane, so func is ignored
+		self.transform:setProgramLocationKernel(self.engineName, "transform")
+	else
+		local source = io.open("programs/transform.frag"):read("*a")
+		source = string.gsub(source, "%$TRANSFORM%$", func)
+		self.transform:setProgramLocationMemoryString(self.engineName, source)
+	end
 	self.transform:bindEngine(self.engine)
 end
 
-function Escape:updatePlane( xCenter, yMin, yMax )
+function Escape:setPrecision( precision )
+	self.transform:setPrecision( precision )
+	self.calc:setPrecision( precision )
+	
+	-- useEscape drops back to float for formulas with no df64 form, so it
+	-- goes before the transform; the running transitions are kept
+	local parameters = self.parameters
+	self:useEscape( self.activeEscape.name )
+	self.parameters = parameters
+	self:updateTransform( self.transformFunction )
+	self:restartRefinement()
+end
+
+-- Times the escape at the current view and finds the smallest view height at
+-- which neighbouring pixels still get their own point of the plane, for
+-- float and then df64.  Reducing the output waits for each frame to finish.
+function Escape:benchmarkPrecision()
+	local screenInfo = GraphicsSystem.instance():getScreenInfo()
+	local frames = 20
+	local xCenter, yMin, yMax = self.xCenter, self.yMin, self.yMax
+	local precision = self.calc:getPrecision()
+	local transformed = Array1Dfloat( screenInfo.w * screenInfo.h * 4 )
+	local row = math.floor(screenInfo.h/2) * screenInfo.w * 4
+	
+	-- away from the axes, where a float has no more bits than anywhere else
+	local benchmarkX, benchmarkY = -0.743643887037151, 0.131825904205330
+	
+	for k,benchmark in ipairs({ { "float", Program.Single }, { "df64", Program.DoubleSingle } }) do
+		self:setPrecision( benchmark[2] )
+		self:updatePlane( xCenter, yMin, yMax )
+		self.plane:useLevel( self.plane:getLevelCount() )
+		
+		local start = ticks()
+		for i = 1,frames do
+			self:runEscape()
+			self.engine:reduce( self.calc:getStorage( Program.output, 0 ), Engine.Maximum )
+		end
+		local frameTime = (ticks() - start)/frames
+		
+		local usableHeight = nil
+		for depth = 1,30 do
+			local height = math.pow( 10, -depth )
+			self:updatePlane( benchmarkX, benchmarkY - height/2, benchmarkY + height/2 )
+			self.transform:run()
+			self.transform:getStorageVal( Program.output, 0 ):copyToArray( transformed:array() )
+			
+			local distinct = 0
+			local last = nil
+			for x = 0,screenInfo.w - 1 do
+				local value = transformed:get( row + x * 4 ) + transformed:get( row + x * 4 + 2 )
+				if value ~= last then distinct = distinct + 1 end
+				last = value
+			end
+			
+			if distinct < 0.9 * screenInfo.w then break end
+			usableHeight = height
+		end
+		
+		print(string.format( "%s: %.2f ms per frame, usable down to a view %s high", benchmark[1], frameTime,
+			usableHeight and string.format( "%g", usableHeight ) or "no" ))
+	end
+	
+	self:setPrecision( precision )
+	self:updatePlane( xCenter, yMin, yMax )
+end
+
+-- Times the whole escape chain, transform to calc to colour, with the
+-- engine waiting for every pass before the next is queued and then with
+-- the passes only queued, waiting once a frame for the colour pass as
+-- drawing it would.
+function Escape:benchmarkAsynchronous()
+	local frames = 50
+	local asynchronous = self.engine:isAsynchronous()
+	
+	for k,benchmark in ipairs({ { "synchronous", false }, { "asynchronous", true } }) do
+		self.engine:setAsynchronous( benchmark[2] )
+		self.plane:useLevel( self.plane:getLevelCount() )
+		
+		local start = ticks()
+		for i = 1,frames do
+			self:runEscape()
+			self.color:run():wait()
+		end
+		local frameTime = (ticks() - start)/frames
+		
+		print(string.format( "%s: %.2f ms per frame, %.1f frames per second", benchmark[1], frameTime, 1000/frameTime ))
+	end
+	
+	self.engine:setAsynchronous( asynchronous )
+	self:restartRefinement()
+end
+
+-- the remainders are only read by the df64 transform
+function Escape:setTransformBound( name, value )
+	local hi, lo = splitDoubleSingle(value)
+	self.transform:setFloat( self.transformHandles[name], hi )
+	self.transform:setFloat( self.transformHandles[name .. "_LO"], lo )
+end
+
+-- scrollX and scrollY, if given, are the whole pixels the view moved by,
+-- so the plane can keep what it has already rendered.
+function Escape:updatePlane( xCenter, yMin, yMax, scrollX, scrollY )
 	self.yMin = yMin
 	self.yMax = yMax
 	self.yLength = yMax - yMin
@@ -111,17 +341,79 @@ function Escape:updatePlane( xCenter, yMin, yMax )
 	self.xMin = xCenter - self.xLength/2
 	self.xMax = xCenter + self.xLength/2
 	
-	local parameters = {}
-	parameters["X_MIN"] = self.xMin
-	parameters["X_MAX"] = self.xMax
-	parameters["Y_MIN"] = self.yMin
-	parameters["Y_MAX"] = self.yMax
+	self:setTransformBound( "X_MIN", self.xMin )
+	self:setTransformBound( "X_MAX", self.xMax )
+	self:setTransformBound( "Y_MIN", self.yMin )
+	self:setTransformBound( "Y_MAX", self.yMax )
 	
-	for param,value in pairs(parameters) do
-		self.transform:getParameter( param ):setFloat(value)
+	if scrollX then
+		self.plane:scroll( scrollX, scrollY )
+		self.deepPlane:restart()
+	else
+		self:restartRefinement()
+	end
+end
+
+-- Throws away the passes rendered so far, for when the picture has changed.
+function Escape:restartRefinement()
+	if self.plane then self.plane:restart() end
+	if self.deepPlane then self.deepPlane:restart() end
+end
+
+function Escape:setDeepZoom( enabled )
+	if enabled and self.activeEscape.name ~= "mandelbrot" then
+		print("Deep zoom only works with mandelbrot.")
+		return
+	end
+	
+	self.deep = enabled
+	if enabled then
+		-- carry on from the current view, then only the offsets from its centre go to the transform
+		local yCenter = (self.yMax + self.yMin)/2
+		self.deepZoom:setCenter( string.format("%.17g", self.xCenter), string.format("%.17g", yCenter) )
+		self.deepZoom:setScale( self.yLength )
+		self:updatePlane( 0, -1, 1 )
+	else
+		local scale = self.deepZoom:getScale()
+		local yCenter = tonumber(self.deepZoom:getCenterY())
+		self:updatePlane( tonumber(self.deepZoom:getCenterX()), yCenter - scale/2, yCenter + scale/2 )
 	end
 end
 
+function Escape:getDeepIterations()
+	-- deeper views need longer orbits before points escape, rounded so the
+	-- reference orbit is not iterated again on every frame of a zoom
+	local depth = math.max( 0, math.log10( 4/self.deepZoom:getScale() ) )
+	return self.activeEscape.maxIterations + 250 * math.ceil( depth )
+end
+
+function Escape:runDeepZoom( maxIterations )
+	local rows = DeepZoom.getReferenceRows( maxIterations )
+	if rows ~= self.referenceRows then
+		self.perturb:allocateStorage( DeepZoom.ReferenceWidth, rows, Program.input, 1 )
+		self.referenceRows = rows
+		self.referenceWritten = false
+	end
+	
+	if self.deepZoom:updateReference( maxIterations, self.activeEscape.radius ) or not self.referenceWritten then
+		self.deepZoom:writeReference( self.perturb:getStorage( Program.input, 1 ) )
+		self.referenceWritten = true
+	end
+	
+	local handles = self.perturbHandles
+	self.perturb:setInt( handles.maxIterations, maxIterations )
+	self.perturb:setFloat( handles.escapeRadius, self.activeEscape.radius )
+	self.perturb:setInt( handles.referenceLength, self.deepZoom:getReferenceLength() )
+	self.perturb:setInt( handles.referenceWidth, DeepZoom.ReferenceWidth )
+	self.perturb:setFloat( handles.halfScaleMantissa, self.deepZoom:getHalfScaleMantissa() )
+	self.perturb:setInt( handles.halfScaleExponent, self.deepZoom:getHalfScaleExponent() )
+	self.perturb:setFloat( handles.referenceOffsetX, self.deepZoom:getReferenceOffsetX() )
+	self.perturb:setFloat( handles.referenceOffsetY, self.deepZoom:getReferenceOffsetY() )
+	
+	self.transform:run()
+	self.perturb:run()
+end
+
 function Escape:init( usingTextureSource, width, height )
 
 	local graphicsSystem = GraphicsSystem.instance()
@@ -130,10 +422,12 @@ function Escape:init( usingTextureSource, width, height )
 	self:loadAllEscapes()
 
 	self.interactive = true
-	self.engine = PluginManager.instance():loadPlugin("GLSLComputeEngine"):toEngine()
+	self.engine, self.engineName = loadComputeEngine()
 	
 	self.transform = Program()
 	self.transform:load("programs/transform.program")
+	self.transformHandles = getParameterHandles( self.transform, { "X_MIN", "X_MAX", "Y_MIN", "Y_MAX",
+		"X_MIN_LO", "X_MAX_LO", "Y_MIN_LO", "Y_MAX_LO" } )
 	
 	print("bind transform")
 	self:updateTransform( "z", false )
@@ -142,14 +436,25 @@ function Escape:init( usingTextureSource, width, height )
 	self.calc = Program()
 	self.calc:setWorkingDirectory(self:getWorkingDirectory())
 	self.calc:load("escape.program")
+	self.calcHandles = getParameterHandles( self.calc, { "p", "maxIterations", "escapeRadius" } )
 	
 	print("bind escape")
 	self:useEscape( "mandelbrot", false )
 	print("done")
 	
+	self.perturb = Program()
+	self.perturb:setWorkingDirectory(self:getWorkingDirectory())
+	self.perturb:load("perturb.program")
+	self.perturbHandles = getParameterHandles( self.perturb, { "maxIterations", "escapeRadius", "referenceLength",
+		"referenceWidth", "halfScaleMantissa", "halfScaleExponent", "referenceOffsetX", "referenceOffsetY" } )
+	self.perturb:bindEngine(self.engine)
+	self.deepZoom = DeepZoom()
+	self.deep = false
+	
 	self.color = Program()
 	self.color:setWorkingDirectory( self:getWorkingDirectory() )
 	self.color:load("escape.color.program")
+	self.colorHandles = getParameterHandles( self.color, { "highlightNonConverge", "maxIterations", "hueOffset" } )
 	
 	print("bind color")
 	self.color:bindEngine( self.engine )
@@ -159,13 +464,12 @@ function Escape:init( usingTextureSource, width, height )
 	
 	io.write(Program.output)
 
-	self.transform:allocateStorage( screenInfo.w, screenInfo.h, Program.output, 0 )
-	self.calc:allocateStorage( screenInfo.w, screenInfo.h, Program.output, 0 )
+	-- the transform and escape run coarse to fine, the colour always at full size
+	self.plane = ProgressivePlane.new( screenInfo.w, screenInfo.h, { self.transform, self.calc }, self.color )
+	self.deepPlane = ProgressivePlane.new( screenInfo.w, screenInfo.h, { self.transform, self.perturb }, self.color )
+	self.plane:enableScrolling( self.engine )
+	self.deepPlane:enableScrolling( self.engine )
 	self.color:allocateStorage( screenInfo.w, screenInfo.h, Program.output, 0 )
-	self.outputTexture = self.color:getStorage( Program.output, 0 ):toTexture()
-	
-	self.calc:setStorage( Program.input, 0, self.transform:getStorage( Program.output, 0 ) )
-	self.color:setStorage( Program.input, 0, self.calc:getStorage( Program.output, 0 ) )
 	
 	self.highlight = 0
 	
@@ -187,6 +491,11 @@ function Escape:init( usingTextureSource, width, height )
 	
 	self.iterSmooth = .01
 	
+	-- the share of escaping points that may escape in the last bin before
+	-- the budget is raised, and how far above the escape's own it may go
+	self.lateEscapes = .002
+	self.maxBudgetFactor = 16
+	
 	self.smoothstep = function( weight, edge0, edge1 )
 						weight = weight * weight * (3 - 2 * weight)
 						return edge0 * (1 - weight) + edge1 * weight
@@ -201,12 +510,39 @@ function Escape:input()
 	if inputSystem:getKeyState( InputSystem.K_SPACE ) == InputSystem.released then
 		self.paused = not self.paused
 	end
+	
+	if inputSystem:getKeyState( InputSystem.K_d ) == InputSystem.released then
+		self:setDeepZoom( not self.deep )
+	end
+	
+	if inputSystem:getKeyState( InputSystem.K_p ) == InputSystem.released then
+		if self.calc:getPrecision() == Program.Single then
+			self:setPrecision( Program.DoubleSingle )
+		else
+			self:setPrecision( Program.Single )
+		end
+	end
+	
+	if inputSystem:getKeyState( InputSystem.K_b ) == InputSystem.released and not self.deep then
+		self:benchmarkPrecision()
+	end
+	
+	if inputSystem:getKeyState( InputSystem.K_a ) == InputSystem.released and not self.deep then
+		self:benchmarkAsynchronous()
+	end
 
 	if inputSystem:getMouseButtonState(2) == InputSystem.down then
 		local mouseMove = inputSystem:getMouseMotion()
-		local dx = -self.xLength/screenInfo.w * mouseMove.x
-		local dy = -self.yLength/screenInfo.h * mouseMove.y
-		self:updatePlane( self.xCenter + dx, self.yMin + dy, self.yMax + dy )
+		if self.deep then
+			local scale = self.deepZoom:getScale()
+			self.deepZoom:pan( -scale * self.aspect/screenInfo.w * mouseMove.x, -scale/screenInfo.h * mouseMove.y )
+			self.deepPlane:scroll( -mouseMove.x, -mouseMove.y )
+			self.plane:restart()
+		else
+			local dx = -self.xLength/screenInfo.w * mouseMove.x
+			local dy = -self.yLength/screenInfo.h * mouseMove.y
+			self:updatePlane( self.xCenter + dx, self.yMin + dy, self.yMax + dy, -mouseMove.x, -mouseMove.y )
+		end
 	end
 	
 	local scroll = inputSystem:getMouseWheelScroll()
@@ -225,39 +561,80 @@ function Escape:input()
 		local yMax = yCenter + yLength/2
 		self.zoom = self.zoom + -factor * math.abs(self.zoom)/self.zoom
 		if math.abs(self.zoom) < 1 then self.zoom = 0 end
-		self:updatePlane( self.xCenter, yMin, yMax )
+		if self.deep then
+			self.deepZoom:zoom( factor )
+			self:restartRefinement()
+		else
+			self:updatePlane( self.xCenter, yMin, yMax )
+		end
 	end
 end
 
-function Escape:run( dt, scale )
+-- Raises the iteration budget while a noticeable share of the points that
+-- escape do so in the last sixteenth of it, which means some of the points
+-- shown as inside would escape too, and lowers it again once every point
+-- escapes well short of it.  The statistics come from an earlier frame, so
+-- nothing waits on the engine for them.
+function Escape:adaptIterations()
+	local stats = self.engine:collectStatistics()
+	if not stats.ready or stats.histogramMax ~= self.iterationBudget then return end
 	
-	if not self.paused then self:processTransitions(dt) end
+	local escaped = 0
+	for bin = 0,Statistics.Bins - 1 do
+		escaped = escaped + stats:getBin( bin )
+	end
 	
-	self.hueTime = self.hueTime + dt
-	if self.hueTime > self.hueCycleTime then self.hueTime = self.hueTime - self.hueCycleTime end
+	local budget = self.iterationBudget
+	local base = self.activeEscape.maxIterations
+	if escaped > 0 and stats:getBin( Statistics.Bins - 1 )/escaped > self.lateEscapes then
+		budget = math.min( budget * 2, base * self.maxBudgetFactor )
+	elseif stats.maximum.x < budget/4 then
+		budget = math.max( math.ceil( stats.maximum.x * 2 ), base )
+	end
 	
-	local p = self.calc:getParameter("p")
+	if budget ~= self.iterationBudget then
+		self.iterationBudget = budget
+		self.plane:restart()
+	end
+end
+
+function Escape:runEscape()
+	local handles = self.calcHandles
 	for index,v in pairs(self.parameters) do
-		p:at(index):setFloat(v.val)
+		self.calc:setFloatAt( handles.p, index, v.val )
 	end
 	
-	self.calc:getParameter("maxIterations"):setInt( self.activeEscape.maxIterations )
-	self.calc:getParameter("escapeRadius"):setFloat( self.activeEscape.radius )
+	self.calc:setInt( handles.maxIterations, self.iterationBudget )
+	self.calc:setFloat( handles.escapeRadius, self.activeEscape.radius )
 	self.transform:run()
 	self.calc:run()
+end
+
+function Escape:run( dt, scale )
 	
-	--local reduce = self.engine:reduce( self.calc:getStorage( Program.output, 0 ), Engine.Maximum )
-	--self.frameMinIter = self.activeEscape.maxIterations - reduce.y
-	--self.frameMaxIter = reduce.x
+	if not self.paused then self:processTransitions(dt) end
+	
+	self.hueTime = self.hueTime + dt
+	if self.hueTime > self.hueCycleTime then self.hueTime = self.hueTime - self.hueCycleTime end
 	
-	--self.maxIterations = self.maxIterations * (1 - self.iterSmooth) + self.frameMaxIter * self.iterSmooth
-	--self.minIterations = self.minIterations * (1 - self.iterSmooth) + self.frameMinIter * self.iterSmooth
+	local maxIterations = self.iterationBudget
+	if self.deep then
+		maxIterations = self:getDeepIterations()
+		self.deepPlane:run( dt, function() self:runDeepZoom( maxIterations ) end )
+	else
+		self:adaptIterations()
+		maxIterations = self.iterationBudget
+		if self.plane:run( dt, function() self:runEscape() end ) then
+			self.engine:requestStatistics( self.calc:getStorage( Program.output, 0 ), 0, maxIterations )
+		end
+	end
 	
-	self.color:getParameter("highlightNonConverge"):setInt( self.highlight )
-	self.color:getParameter("maxIterations"):setInt( self.activeEscape.maxIterations )
+	local handles = self.colorHandles
+	self.color:setInt( handles.highlightNonConverge, self.highlight )
+	self.color:setInt( handles.maxIterations, maxIterations )
 	--self.color:getParameter("actualMaxIterations"):setFloat( self.maxIterations )
 	--self.color:getParameter("actualMinIterations"):setFloat( self.minIterations )
-	self.color:getParameter("hueOffset"):setFloat( self.hueTime/self.hueCycleTime )
+	self.color:setFloat( handles.hueOffset, self.hueTime/self.hueCycleTime )
 	self.color:run()
 
 end
@@ -267,7 +644,8 @@ function Escape:draw()
 	local screenInfo = graphicsSystem:getScreenInfo()
 	
 	graphicsSystem:clearToColor( Color( 0.0, 0.0, 0.0, 0.0 ) )
-	graphicsSystem:useTexture(self.outputTexture)
+	-- storages kept in host memory are only copied into their texture here
+	graphicsSystem:useTexture(self.color:getStorage( Program.output, 0 ):toTexture())
 	graphicsSystem:drawRectangle(Point(0,0), Point(screenInfo.w, screenInfo.h))
 	graphicsSystem:useTexture(Texture())
 
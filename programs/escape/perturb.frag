@@ -0,0 +1,58 @@
+#pragma include <complex>
+
+/*
+ * Perturbation form of escape.frag for the mandelbrot formula.  intex[0]
+ * holds each pixel's offset from the centre of the view on the unit plane,
+ * and intex[1] the reference orbit written by DeepZoom, whose point is
+ * referenceOffset away from the centre on the same plane.  Only
+ * the offset from the reference orbit is iterated, so it keeps its precision
+ * however small the view is, until floats themselves run out near 1e-38.
+ *
+ * Whenever the full value comes closer to zero than the offset, or the
+ * reference orbit runs out, the offset is rebased onto the start of the
+ * reference orbit.  Pixels whose value drops far below the reference are
+ * glitches by Pauldelbrot's test and are rebased too.  The output matches
+ * escape.frag in x, with the number of rebases in y and glitches in z.
+ */
+
+vec2 reference( int n )
+{
+	return texelFetch( intex[1], ivec2( n % referenceWidth, n / referenceWidth ), 0 ).xy;
+}
+
+void main()
+{
+	vec2 unit = texture( intex[0], gl_TexCoord[0].st ).xy + vec2( referenceOffsetX, referenceOffsetY );
+	vec2 dc = unit * (halfScaleMantissa * exp2(float(halfScaleExponent)));
+	vec2 delta = vec2( 0.0, 0.0 );
+	int m = 0;
+	float rebases = 0.0;
+	float glitches = 0.0;
+	
+	for( int n = 1; n <= maxIterations; n++ )
+	{
+		delta = 2.0 * cMul( reference(m), delta ) + cMul( delta, delta ) + dc;
+		m++;
+		
+		vec2 referenceValue = reference(m);
+		vec2 value = referenceValue + delta;
+		float valueLength = length(value);
+		
+		if( n > 1 && valueLength > escapeRadius )
+		{
+			gl_FragColor = vec4( n - 1, rebases, glitches, 0.0 );
+			return;
+		}
+		
+		bool glitch = valueLength < 1e-3 * length(referenceValue);
+		if( glitch || valueLength < length(delta) || m == referenceLength - 1 )
+		{
+			if( glitch ) glitches++;
+			rebases++;
+			delta = value;
+			m = 0;
+		}
+	}
+	
+	gl_FragColor = vec4( -1.0, rebases, glitches, 0.0 );
+}
@@ -95,3 +95,14 @@ function AffineMatrix:toMat4()
 	
 	return retMat
 end
+
+function AffineMatrix.fromMat4( mat )
+	local retMat = AffineMatrix()
+	
+	for c=1,3 do
+		retMat.matrix[1][c] = mat:get(0, c - 1)
+		retMat.matrix[2][c] = mat:get(1, c - 1)
+	end
+	
+	return retMat
+end
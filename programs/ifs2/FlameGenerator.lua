@@ -35,6 +35,7 @@ end
 
 function FlameGenerator.random( numXforms )
 	local flame = Flame()
+	flame:randomizeTrans()
 	
 	if numXforms == nil then
 		local xformDist = {2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 5, 5, 6}
@@ -54,6 +55,7 @@ function FlameGenerator.random( numXforms )
 		--end
 		xform:setDensity( math.random() )
 		xform:setColor( math.random() )
+		xform:setColorSpeed( math.random() )
 			
 		for j=1, varCount do
 			local randVar
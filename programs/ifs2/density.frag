@@ -0,0 +1,78 @@
+// Density estimation, log-density tone mapping and downsampling of a flame
+// histogram in one pass.  intex is the tiled summed-area table prefix.program
+// builds from the histogram, so any box of it sums in a few lookups.  Each
+// output element covers a samples x samples block of the histogram; blocks
+// with few points are spread over a wider box, as flam3's density estimation
+// does, and the result is mapped by the log of its density relative to the
+// mean density of the whole image.
+
+ivec2 histogramSize;
+
+// Reads the table, counting elements before the corner of the tile as empty.
+vec4 tableAt( ivec2 position, ivec2 corner )
+{
+	if( position.x < corner.x || position.y < corner.y )
+		return vec4( 0.0 );
+	return texelFetch( intex, position, 0 );
+}
+
+// Sums the histogram over [low, high], which lie in one tile.
+vec4 tileSum( ivec2 low, ivec2 high )
+{
+	ivec2 corner = (low / tileSize) * tileSize;
+	return tableAt( high, corner ) - tableAt( ivec2( low.x - 1, high.y ), corner )
+		- tableAt( ivec2( high.x, low.y - 1 ), corner ) + tableAt( low - 1, corner );
+}
+
+// Sums the histogram over [low, high], at most tileSize across, split where
+// it crosses into another tile.
+vec4 boxSum( ivec2 low, ivec2 high )
+{
+	low = max( low, ivec2( 0 ) );
+	high = min( high, histogramSize - 1 );
+
+	ivec2 split = max( (high / tileSize) * tileSize, low );
+	vec4 sum = tileSum( split, high );
+	if( low.x < split.x )
+		sum += tileSum( ivec2( low.x, split.y ), ivec2( split.x - 1, high.y ) );
+	if( low.y < split.y )
+		sum += tileSum( ivec2( split.x, low.y ), ivec2( high.x, split.y - 1 ) );
+	if( low.x < split.x && low.y < split.y )
+		sum += tileSum( low, split - 1 );
+	return sum;
+}
+
+void main()
+{
+	histogramSize = textureSize( intex, 0 );
+
+	ivec2 low = ivec2( gl_FragCoord.xy ) * samples;
+	ivec2 high = low + samples - 1;
+	vec4 pixel = boxSum( low, high );
+
+	// the box has to fit in two tiles a side for boxSum(), so samples + 2 spread is at most tileSize
+	float radius = max( deMaxRadius / pow( pixel.a + 1.0, deCurve ), deMinRadius );
+	int spread = min( int( radius + 0.5 ), max( (tileSize - samples)/2, 0 ) );
+	if( spread > 0 )
+	{
+		ivec2 boxLow = max( low - spread, ivec2( 0 ) );
+		ivec2 boxHigh = min( high + spread, histogramSize - 1 );
+		ivec2 area = boxHigh - boxLow + 1;
+		pixel = boxSum( boxLow, boxHigh ) * float(samples * samples)/float(area.x * area.y);
+	}
+
+	float meanDensity = densitySum/float(histogramSize.x * histogramSize.y) * float(samples * samples);
+
+	vec3 color = vec3( 0.0 );
+	if( pixel.a > 0.0 && meanDensity > 0.0 )
+	{
+		float scale = brightness * log( 1.0 + pixel.a/meanDensity )/pixel.a;
+		float logDensity = pixel.a * scale;
+		float gammaDensity = pow( logDensity, 1.0/gamma );
+
+		color = vibrancy * pixel.rgb * scale * gammaDensity/logDensity
+			+ (1.0 - vibrancy) * pow( max( pixel.rgb * scale, vec3( 0.0 ) ), vec3( 1.0/gamma ) );
+	}
+
+	gl_FragColor = vec4( clamp( color, 0.0, 1.0 ), alpha );
+}
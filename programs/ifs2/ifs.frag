@@ -109,5 +109,6 @@ void main()
 
 	}
 	gl_FragData[0] = vec4( pos, 0.0 , col );
-	gl_FragData[1] = vec4( texture(input[1], vec2(.5, col)));
+	// the xform that placed the point scales it by its opacity, as flam3 does
+	gl_FragData[1] = vec4( texture(input[1], vec2(.5, col))) * mats[funcIdx][1].w;
 }
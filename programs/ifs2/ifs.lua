@@ -1,4 +1,5 @@
 assert(loadfile("scripts/drawStatus.lua"))()
+assert(loadfile("scripts/computeEngine.lua"))()
 assert(loadfile("programs/ifs2/VariationTable.lua"))()
 assert(loadfile("programs/ifs2/AffineMatrix.lua"))()
 assert(loadfile("programs/ifs2/Flame.lua"))()
@@ -12,7 +13,7 @@ function IFS:__init()
 end
 
 function ss()
-	GraphicsSystem.instance():saveTexture( self.downsample.out:toTexture(), "./" .. math.random(100000, 999999))
+	GraphicsSystem.instance():saveTexture( self.density.out:toTexture(), "./" .. math.random(100000, 999999))
 end
 
 function IFS:init(interactive)
@@ -46,12 +47,35 @@ function IFS:init(interactive)
 	-- maximum value for each affine coefficient
 	self.affineMax = 1
 	
-	-- gamma applied before tonemapping
-	self.preGamma = .8
+	-- brightness of the log-density tonemapping
+	self.brightness = 4
 	
 	-- gamma applied after tonemapping
-	self.postGamma = 2.2
+	self.gamma = 2.2
+	
+	-- how much of the gamma is applied to the density instead of each color
+	self.vibrancy = 1
+	
+	-- radius in histogram pixels a lone point is spread over; denser
+	-- pixels are spread less, by their density to the power of deCurve
+	self.deMaxRadius = 9 * self.oversample
+	self.deMinRadius = 0
+	self.deCurve = .4
+	
+	-- side of the tiles the summed-area table for density estimation
+	-- is split into; the spread is limited to half of it
+	self.tileSize = 64
 
+	-- flam3 file whose flames are animated through in turn instead of
+	-- random ones, relative to the program directory; nil for random flames
+	self.flameFile = nil
+	
+	-- flam3 file the flames on screen are saved to with w, and the size
+	-- written with them, which sets the scale other renderers use
+	self.saveFile = "saved.flam3"
+	self.saveWidth = 1024
+	self.saveHeight = 768
+	
 	-- chance that a function only has a linear variation
 	self.linearOnlyChance = .2
 
@@ -61,8 +85,6 @@ function IFS:init(interactive)
 	-- minimum weight for each variation (pre normalization)
 	self.varMin = 0
 	
-	self.exposure = 1.5
-	
 	-- maximum variations per flame
 	-- lowering this allows for more total xforms
 	-- making it too low can mess with flame interpolation
@@ -70,6 +92,7 @@ function IFS:init(interactive)
 	self.maximumVariations = 12
 	
 	self.clearColor = Color( 0.0, 0.0, 0.0, .5 )
+	self.histogramClear = Color( 0.0, 0.0, 0.0, 0.0 )
 	self.rot = Point( 0, 0, 0 )
 	self.trans = Point( 0,0, -1.85 )
 	self.scale = Point( 1, 1, 1 )
@@ -104,14 +127,30 @@ function IFS:init(interactive)
 	self.numVariations = #VariationTable.variations
 	self.numParameters = #VariationTable.parameters
 	self.numParamMats = math.ceil(self.numParameters/16)
-
-	self.maxPerSwitch = 16
-	self.numSwitch = math.ceil(self.numVariations/self.maxPerSwitch)
 	
-	local buildBlock = function(code, idx, start)
-		if start == nil then start = "" end
-		return start .. " if( idx < " .. idx .. ")\n{\nswitch(idx){\n" .. code .. "\n}\n} "
+	-- the CPU renderer reads the same parameters as ifs.frag, so it needs
+	-- the variations and their parameters in the same order
+	self.flameRenderer = FlameRenderer()
+	for k,varName in ipairs(VariationTable.variations) do
+		self.flameRenderer:addVariation(varName)
+	end
+	for k,param in ipairs(VariationTable.parameters) do
+		self.flameRenderer:addParameter(param.name)
 	end
+	self.flameRenderer:setFuseIterations(self.seedIterCount)
+	
+	-- so do the native flames, which hold the variations by their index
+	for k,varName in ipairs(VariationTable.variations) do
+		Flame.addVariation(varName)
+	end
+	for k,param in ipairs(VariationTable.parameters) do
+		Flame.addParameter(param.name)
+	end
+	
+	-- render with the chaos game on the CPU instead of splatting particles
+	self.cpuFlame = false
+
+	self.maxPerSwitch = 16
 	
 	local matPosFromIdx = function(idx)
 		local mat = math.floor(idx/16)
@@ -121,50 +160,26 @@ function IFS:init(interactive)
 		return string.format("varParam[funcIdx * %d + %d][%d][%d]", self.numParamMats, mat, row, idx)
 	end
 	
-	-- build the shader source
-	local compiledStruct = ""
-	local compiledVars = ""
+	-- the source of every variation, ready to be placed in a switch case
+	local affineCoeff = {aa="mat[0].x", ab="mat[0].y", ac="mat[0].z", ad="mat[1].x", ae="mat[1].y", af="mat[1].z"}
+	self.varSource = {}
 	for k,varName in pairs(VariationTable.variations) do
-		local sIdx = k - 1
-		local parameters = VariationTable.getVariationParameterNames(varName)
-		
-		if #parameters > 0 then
-			for k,paramName in pairs(parameters) do
-				local matPos = matPosFromIdx(VariationTable.getParameterIndex(paramName) - 1)
-				varSource[varName] = string.gsub(varSource[varName], paramName, matPos)
-			end
+		local code = varSource[varName]
+		for k,paramName in pairs(VariationTable.getVariationParameterNames(varName)) do
+			code = string.gsub(code, paramName, matPosFromIdx(VariationTable.getParameterIndex(paramName) - 1))
 		end
-		if sIdx ~= 0 and sIdx % self.maxPerSwitch == 0 then
-			local start = (sIdx == self.maxPerSwitch and "") or "else"
-			compiledStruct = compiledStruct .. "\n" .. buildBlock(compiledVars, sIdx, start)
-			compiledVars = ""
-		end
-
-		compiledVars = compiledVars .. string.format("// variation %d: %s\ncase %d:\n{%s\ncontinue;}", 
-			sIdx, varName, sIdx, varSource[varName])
-	end
-	
-	if compiledVars ~= "" then
-		compiledStruct = compiledStruct .. "\n" .. "else{\nswitch(idx){\n" .. compiledVars .. "\n}\n}"
+		self.varSource[k - 1] = string.format("// variation %d: %s\ncase %d:\n{%s\ncontinue;}", 
+			k - 1, varName, k - 1, (string.gsub(code, "(%w+)", affineCoeff)))
 	end
-	print(compiledStruct)
-	
-	-- replace affine coefficients
-	local affineCoeff = {aa="mat[0].x", ab="mat[0].y", ac="mat[0].z", ad="mat[1].x", ae="mat[1].y", af="mat[1].z"}
-	compiledVars = string.gsub(compiledStruct, "(%w+)", affineCoeff)
-	
-	-- place the variation source in the shader
-	source = string.gsub( source, "%$VARSOURCE%$", compiledVars)
+	self.ifsSource = source
 	
-	self.ifs = Program()
-	self.ifs:setWorkingDirectory(self:getWorkingDirectory())
-	self.ifs:load("ifs.program")
-	self.ifs:setProgramLocationMemoryString("GLSLComputeEngine", source)
-	self.ifs:addParameterArray("mats", Parameter.Mat4, self.maxFunctions)
-	self.ifs:addParameterArray("vars", Parameter.Vec2, self.maxFunctions * self.maximumVariations)
-	self.ifs:addParameterArray("varOffsets", Parameter.Int, self.maxFunctions)
-	self.ifs:addParameterArray("varParam", Parameter.Mat4, self.maxFunctions * self.numParamMats)
-	self.ifs:addParameterArray("colSpeeds", Parameter.Float, self.maxFunctions)
+	-- compiled ifs programs, each with only the variations of one set of
+	-- flames, keyed by the variation set; the least recently used ones are
+	-- dropped once there are more than maxPermutations
+	self.maxPermutations = 16
+	self.permutations = {}
+	self.permutationCount = 0
+	self.permutationUse = 0
 	
 	self.engine = PluginManager.instance():loadPlugin("GLSLComputeEngine"):toEngine()
 	
@@ -174,37 +189,35 @@ function IFS:init(interactive)
 	self.bufferHeight = screenInfo.h * self.oversample
 	self:setBufferTexture(graphicsSystem:createBufferTexture(self.bufferWidth, self.bufferHeight))
 	self.bufferStorage = self.engine:fromTexture( self:getBufferTexture() )
-	self.ifs:bindEngine(self.engine)
+	self.ifs = self:getPermutation({})
 	
 	self.paused = false
 	self.drawStatus = true
 	
-	self.tonemap = Program();
-	self.tonemap.out = self.engine:fromTexture( graphicsSystem:createBufferTexture(self.bufferWidth, self.bufferHeight) )
-	self.tonemap:setWorkingDirectory("./programs/")
-	self.tonemap:load("tonemap.program")
-	self.tonemap:bindEngine(self.engine)
-	self.tonemap:setStorage( Program.input, 0, self.bufferStorage )
-	self.tonemap:setStorage( Program.output, 0, self.tonemap.out )	
-	
-	self.convolve = Program()
-	self.convolve.out = self.engine:fromTexture( graphicsSystem:createBufferTexture(self.bufferWidth, self.bufferHeight) )
-	self.convolve:setWorkingDirectory("./programs/")
-	self.convolve:load("convolve.program");
-	self.convolve:bindEngine(self.engine);
-	self.convolve:setStorage( Program.input, 0, self.tonemap.out )
-	self.convolve:setStorage( Program.output, 0, self.convolve.out )
-	self.convolve.kernel = {1,2,1,2,4,2,1,2,1} -- gaussian kernel
-	
-	self.downsample = Program();
-	self.downsample.out = self.engine:fromTexture( graphicsSystem:createBufferTexture(0,0) )
-	self.downsample:setWorkingDirectory("./programs/")
-	self.downsample:load("downsample.program")
-	self.downsample:bindEngine(self.engine)
-	self.downsample:setStorage( Program.input, 0, self.convolve.out )
-	self.downsample:setStorage( Program.output, 0, self.downsample.out )	
-	self.downsample:getParameter("samples"):setInt(self.oversample)
-	self.downsample:getParameter("inOff"):setVec2( vec2( 1/self.bufferWidth, 1/self.bufferHeight ) )
+	-- tiled summed-area tables of the histogram, built a pass at a time
+	self.prefix = Program()
+	self.prefix:setWorkingDirectory("./programs/")
+	self.prefix:load("prefix.program")
+	self.prefix:bindEngine(self.engine)
+	self.prefixHandles = getParameterHandles( self.prefix, { "offsetX", "offsetY" } )
+	self.prefix:getParameter("tileSize"):setInt(self.tileSize)
+	self.prefixTables = {}
+	for i=1,2 do
+		self.prefix:allocateStorage( self.bufferWidth, self.bufferHeight, Program.output, 0 )
+		self.prefixTables[i] = self.prefix:getStorage( Program.output, 0 )
+	end
+	
+	-- density estimation, tonemapping and downsampling in one pass
+	self.density = Program()
+	self.density.out = self.engine:fromTexture( graphicsSystem:createBufferTexture(0,0) )
+	self.density:setWorkingDirectory(self:getWorkingDirectory())
+	self.density:load("density.program")
+	self.densityHandles = getParameterHandles( self.density, { "deMinRadius", "deMaxRadius", "deCurve", "densitySum",
+		"brightness", "gamma", "vibrancy", "alpha" } )
+	self.density:bindEngine(self.engine)
+	self.density:setStorage( Program.output, 0, self.density.out )
+	self.density:getParameter("samples"):setInt(self.oversample)
+	self.density:getParameter("tileSize"):setInt(self.tileSize)
 	
 	self.ifs:allocateStorage( self.size, self.size, Program.input, 0 )
 	self.ifs:allocateStorage( 1, 512, Program.input, 1 )
@@ -217,12 +230,20 @@ function IFS:init(interactive)
 	graphicsSystem:drawToTexture( self.blurBuffer  )
 	graphicsSystem:clearToColor( self.clearColor )
 	graphicsSystem:drawToTexture( self:getBufferTexture()  )
-	graphicsSystem:clearToColor( self.clearColor )
+	graphicsSystem:clearToColor( self.histogramClear )
 	graphicsSystem:drawToTexture( Texture() )
 	
-	self.sFlame = FlameGenerator.random()
-	self.eFlame = FlameGenerator.random()
+	self.loadedFlames = {}
+	self.flameIndex = 0
+	if self.flameFile ~= nil then
+		self.loadedFlames = Flame.loadFlam3( self:getWorkingDirectory() .. self.flameFile )
+	end
+	
+	self.sFlame = self:nextFlame()
+	self.eFlame = self:nextFlame()
 	self.iFlame = nil
+	-- interpolated flames are written into this one rather than made anew every frame
+	self.blendFlame = Flame()
 	
 	self.time = 0
 	
@@ -256,29 +277,13 @@ function IFS:run( dt )
 	if self.paused then dt = 0 end
 	self.time = self.time - dt
 	local rot = dt * 360/self.ROT_SPEED
-	for i=1,self.sFlame:getXformCount() do
-		local xform = self.sFlame:getXform(i)
-		if xform:getColorSpeed() > 0 then
-			xform:getPostMatrix():rotate(rot)
-			xform:getAffineMatrix():rotate(-rot)
-			rot = rot * -1
-		end
-	end 
-	
-	rot = math.abs(rot)
-	for i=1,self.eFlame:getXformCount() do
-		local xform = self.eFlame:getXform(i)
-		if xform:getColorSpeed() > 0 then
-			xform:getPostMatrix():rotate(rot)
-			xform:getAffineMatrix():rotate(-rot)
-			rot = rot * -1
-		end
-	end 
+	self.sFlame:spin(rot)
+	self.eFlame:spin(rot)
 	
 	if self.time <= -self.HOLD_TIME and self.lockSpin == false then
 		self.holding = false
 		self.sFlame = self.eFlame
-		self.eFlame = FlameGenerator.random()
+		self.eFlame = self:nextFlame()
 		self.time = self.TRANS_TIME
 		self.iFlame = self.sFlame
 	elseif self.holding then
@@ -289,21 +294,24 @@ function IFS:run( dt )
 	else
 		local weight = self.time/self.TRANS_TIME
 		weight = weight * weight * (3 - 2 * weight)
-		self.iFlame = self.sFlame:interpolate( self.eFlame, weight )
+		self.blendFlame:interpolate( self.sFlame, self.eFlame, weight )
+		self.iFlame = self.blendFlame
 	end
 		self.pushTime = ticks() - self.pushTime
 		self.ifsTime = ticks()
-	self.iFlame:pushToProgram( self.ifs, self.numVarMats, self.numParamMats )
+	self:usePermutation()
+	self.iFlame:pushToProgram( self.ifs )
 	self.ifsTime = ticks() - self.ifsTime
 	
 	self.randTime = math.random(100, 30592059)
-	self.ifs:getParameter("time"):setInt(self.randTime)
-	self.ifs:getParameter("iterCount"):setInt(self.seedIterCount)
-	self.ifs:getParameter("seed"):setInt(1)
-	self.ifs:getParameter("colWeight"):setFloat(self.colWeight)
+	local handles = self.ifs.handles
+	self.ifs:setInt(handles.time, self.randTime)
+	self.ifs:setInt(handles.iterCount, self.seedIterCount)
+	self.ifs:setInt(handles.seed, 1)
+	self.ifs:setFloat(handles.colWeight, self.colWeight)
 	
 	self.runTime = ticks()
-	self.ifs:run()
+	if not self.cpuFlame then self.ifs:run() end
 	self.runTime = ticks() - self.runTime
 end
 
@@ -311,7 +319,19 @@ function IFS:draw()
 local graphicsSystem = GraphicsSystem.instance()
 	local screenInfo = graphicsSystem:getScreenInfo()
 	
-	graphicsSystem:clearToColor(self.clearColor)
+	if self.cpuFlame then
+		-- the same number of points the particles draw, through the same view
+		local transVec = self.iFlame:getTrans()
+		self.flameRenderer:setCamera( vec3(transVec.x, transVec.y, transVec.z), vec3(self.rot.x, self.rot.y, -self.rot.z),
+			vec3(self.scale.x, self.scale.y, self.scale.z) )
+		self.drawCalcTime = 0
+		self.drawPointTime = ticks()
+		self.flameRenderer:render( self.ifs, self.bufferStorage, self.size * self.size * (self.drawIterCount + 1), self.randTime )
+		self.drawPointTime = ticks() - self.drawPointTime
+		return
+	end
+	
+	graphicsSystem:clearToColor(self.histogramClear)
 	
 	graphicsSystem:pushDrawingMode()
 	graphicsSystem:setDrawingMode( GraphicsSystem.ThreeD )
@@ -323,13 +343,14 @@ local graphicsSystem = GraphicsSystem.instance()
 	graphicsSystem:rotateView( self.rot.y, Point(0,1,0))
 	graphicsSystem:rotateView( -self.rot.z, Point(0,0,1))
 	
-	self.ifs:getParameter("seed"):setInt(0);
-	self.ifs:getParameter("iterCount"):setInt(1);
+	local handles = self.ifs.handles
+	self.ifs:setInt(handles.seed, 0);
+	self.ifs:setInt(handles.iterCount, 1);
 	graphicsSystem:setBlendingMode( GraphicsSystem.Additive )
 	self.drawCalcTime = 0
 	self.drawPointTime = 0
 	for i=0,self.drawIterCount do
-		self.ifs:getParameter("time"):setInt( self.randTime * (i + 1))
+		self.ifs:setInt( handles.time, self.randTime * (i + 1))
 
 		local drawTime = ticks()
 		graphicsSystem:drawPointArray( self.ifs:getStorageVal( Program.output, 0 ):toTexture(), 
@@ -346,39 +367,49 @@ local graphicsSystem = GraphicsSystem.instance()
 	graphicsSystem:popDrawingMode()
 end
 
+-- Builds the tiled summed-area table of the histogram with log2(tileSize)
+-- prefix passes along each axis, and returns the storage that holds it.
+function IFS:buildDensityTable()
+	local source = self.bufferStorage
+	local target = 1
+	for axis=1,2 do
+		local offset = 1
+		while offset < self.tileSize do
+			self.prefix:setInt( self.prefixHandles.offsetX, (axis == 1 and offset) or 0 )
+			self.prefix:setInt( self.prefixHandles.offsetY, (axis == 2 and offset) or 0 )
+			self.prefix:setStorage( Program.input, 0, source )
+			self.prefix:setStorage( Program.output, 0, self.prefixTables[target] )
+			self.prefix:run()
+			
+			source = self.prefixTables[target]
+			target = 3 - target
+			offset = offset * 2
+		end
+	end
+	return source
+end
+
 function IFS:getOutput()
 	self.postTime = ticks()
 	local graphicsSystem = GraphicsSystem.instance()
 	local screenInfo = graphicsSystem:getScreenInfo()
 	
-	self.tonemap:getParameter("preGamma"):setFloat(self.preGamma)
-	self.tonemap:getParameter("postGamma"):setFloat(self.postGamma)
-	self.tonemap:getParameter("exposure"):setFloat(self.exposure)
-	self.tonemap:getParameter("alpha"):setFloat(1.0)
-	self.tonemap:getParameter("useAlpha"):setInt(1)
-	self.tonemap:run()
-	
-	convolveKernel = self.convolve:getParameter("convolveKernel")
-	for i=1,9 do
-		convolveKernel:at(i-1):setFloat(self.convolve.kernel[i])
-	end
-
-	self.convolve:run()
-	
-	-- for oversampling less than 3, use the built in linear downsampling
-	-- provided by opengl
-	if self.oversample <= 2 then
-		graphicsSystem:drawToTexture( self.downsample.out:toTexture()  )
-		graphicsSystem:clearToColor(self.clearColor)
-		graphicsSystem:useTexture(self.convolve.out:toTexture() )
-		graphicsSystem:drawRectangle( Point(0,screenInfo.h), Point(screenInfo.w, 0) )
-		graphicsSystem:useTexture( Texture() )
-		graphicsSystem:drawToTexture( Texture() )
-	else
-		self.downsample:run()
-	end
-	
-	graphicsSystem:drawToTexture( self.downsample.out:toTexture()  )
+	-- the mean density of the whole image sets where the log curve bends
+	local sums = self.engine:reduce( self.bufferStorage, Engine.Sum )
+	
+	self.density:setStorage( Program.input, 0, self:buildDensityTable() )
+	local handles = self.densityHandles
+	self.density:setFloat(handles.deMinRadius, self.deMinRadius)
+	self.density:setFloat(handles.deMaxRadius, self.deMaxRadius)
+	self.density:setFloat(handles.deCurve, self.deCurve)
+	self.density:setFloat(handles.densitySum, sums.w)
+	self.density:setFloat(handles.brightness, self.brightness)
+	self.density:setFloat(handles.gamma, self.gamma)
+	self.density:setFloat(handles.vibrancy, self.vibrancy)
+	self.density:setFloat(handles.alpha, 1.0)
+	self.density:run()
+	
+	graphicsSystem:drawToTexture( self.density.out:toTexture()  )
 	graphicsSystem:useTexture(self.blurBuffer)
 	graphicsSystem:setDrawColor( Color( 1.0, 1.0, 1.0,1- math.pow(10, -self.blurFactor)) )
 	graphicsSystem:drawRectangle( Point(0,screenInfo.h), Point(screenInfo.w, 0) )
@@ -386,7 +417,7 @@ function IFS:getOutput()
 	graphicsSystem:drawToTexture( Texture() )
 	
 	graphicsSystem:drawToTexture(self.blurBuffer)
-	graphicsSystem:useTexture(self.downsample.out:toTexture())
+	graphicsSystem:useTexture(self.density.out:toTexture())
 	graphicsSystem:resetDrawColor()
 	graphicsSystem:drawRectangle( Point(0,screenInfo.h), Point(screenInfo.w, 0) )
 	graphicsSystem:useTexture( Texture() )
@@ -411,24 +442,28 @@ function IFS:getOutput()
 	table.insert(status, {"IPS", string.format("%.5f mil", fps * self.size * self.size * (self.drawIterCount + self.seedIterCount)/1000000.0)})
 	table.insert(status, {"Drawn", string.format("%.5f mil", self.size * self.size * (self.drawIterCount + 1)/1000000.0)})
 	table.insert(status, {"Rpt", (self.lockSpin and "true") or "false"} )
+	table.insert(status, {"Eng", (self.cpuFlame and string.format("CPU (%d walkers)", self.flameRenderer:getWalkerCount())) or "GPU"} )
+	table.insert(status, {"Perm", string.format("%d (%d compiled)", self:countPermutations(), self.permutationCount)} )
+	local cache = self.engine:getProgramCacheCounts()
+	table.insert(status, {"Shader cache", string.format("%d hits, %d misses", cache.hits, cache.misses)} )
 	table.insert(status, {"FPS", math.floor(fps)})
 	
 	--graphicsSystem:useTexture(Texture())
 	if self.drawStatus then
-		graphicsSystem:drawToTexture(self.downsample.out:toTexture())
+		graphicsSystem:drawToTexture(self.density.out:toTexture())
 		drawStatus( Color( 0.0, 0.0, 0.0, 1.0 ), Color( 1.0, 1.0, 1.0, 1.0 ), unpack(status))
 		graphicsSystem:drawToTexture(Texture())
 	end
 
-	return self.downsample.out:toTexture()
+	return self.density.out:toTexture()
 end
 
 function IFS:input()
 	local inputSystem = InputSystem.instance()
 	
 	if inputSystem:getKeyState(InputSystem.K_r) == InputSystem.released then
-			self.sFlame = FlameGenerator.random()
-	self.eFlame = FlameGenerator.random()
+			self.sFlame = self:nextFlame()
+	self.eFlame = self:nextFlame()
 	self.holding = true
 		self.time = 0
 	end
@@ -460,6 +495,130 @@ function IFS:input()
 	if inputSystem:getKeyState(InputSystem.K_l) == InputSystem.released then
 		self.lockSpin = not self.lockSpin
 	end
+	
+	if inputSystem:getKeyState(InputSystem.K_f) == InputSystem.released then
+		self.cpuFlame = not self.cpuFlame
+	end
+	
+	if inputSystem:getKeyState(InputSystem.K_w) == InputSystem.released then
+		Flame.saveFlam3( self:getWorkingDirectory() .. self.saveFile, { self.sFlame, self.eFlame }, self.saveWidth, self.saveHeight )
+	end
+end
+
+-- the ifs shader source running only the variations of set, which holds
+-- their indexes from zero in order, split into switches of maxPerSwitch
+function IFS:buildSource(set)
+	local buildBlock = function(code, idx, start)
+		if start == nil then start = "" end
+		return start .. " if( idx < " .. idx .. ")\n{\nswitch(idx){\n" .. code .. "\n}\n} "
+	end
+	
+	local compiledStruct = ""
+	local compiledVars = ""
+	for n,sIdx in ipairs(set) do
+		if n ~= 1 and (n - 1) % self.maxPerSwitch == 0 then
+			local start = (n - 1 == self.maxPerSwitch and "") or "else"
+			compiledStruct = compiledStruct .. "\n" .. buildBlock(compiledVars, sIdx, start)
+			compiledVars = ""
+		end
+		
+		compiledVars = compiledVars .. self.varSource[sIdx]
+	end
+	
+	if compiledVars ~= "" then
+		if compiledStruct ~= "" then compiledStruct = compiledStruct .. "\nelse" end
+		compiledStruct = compiledStruct .. "{\nswitch(idx){\n" .. compiledVars .. "\n}\n}"
+	end
+	
+	return (string.gsub( self.ifsSource, "%$VARSOURCE%$", function() return compiledStruct end ))
+end
+
+-- the ifs program for a variation set, compiled the first time it is asked for
+function IFS:getPermutation(set)
+	local key = table.concat(set, ",")
+	local permutation = self.permutations[key]
+	
+	if permutation == nil then
+		local program = Program()
+		program:setWorkingDirectory(self:getWorkingDirectory())
+		program:load("ifs.program")
+		program:setProgramLocationMemoryString("GLSLComputeEngine", self:buildSource(set))
+		program:addParameterArray("mats", Parameter.Mat4, self.maxFunctions)
+		program:addParameterArray("vars", Parameter.Vec2, self.maxFunctions * self.maximumVariations)
+		program:addParameterArray("varOffsets", Parameter.Int, self.maxFunctions)
+		program:addParameterArray("varParam", Parameter.Mat4, self.maxFunctions * self.numParamMats)
+		program:addParameterArray("colSpeeds", Parameter.Float, self.maxFunctions)
+		program:bindEngine(self.engine)
+		program.handles = getParameterHandles( program, { "time", "iterCount", "seed", "colWeight" } )
+		
+		permutation = { program = program }
+		self.permutations[key] = permutation
+		self.permutationCount = self.permutationCount + 1
+		self:evictPermutations()
+	end
+	
+	self.permutationUse = self.permutationUse + 1
+	permutation.lastUse = self.permutationUse
+	return permutation.program
+end
+
+-- drops the least recently used permutations past maxPermutations, apart from the one running
+function IFS:evictPermutations()
+	while self:countPermutations() > self.maxPermutations do
+		local oldestKey = nil
+		for key,permutation in pairs(self.permutations) do
+			if permutation.program ~= self.ifs and (oldestKey == nil or permutation.lastUse < self.permutations[oldestKey].lastUse) then
+				oldestKey = key
+			end
+		end
+		if oldestKey == nil then return end
+		
+		self.permutations[oldestKey].program:unbindEngine()
+		self.permutations[oldestKey] = nil
+	end
+end
+
+function IFS:countPermutations()
+	local count = 0
+	for key,permutation in pairs(self.permutations) do count = count + 1 end
+	return count
+end
+
+-- switches to the permutation with every variation of the flames being
+-- blended, so it only changes when a new flame comes in; the storages
+-- and the uploaded palette move over to it
+function IFS:usePermutation()
+	if self.permutationFlames ~= nil and self.permutationFlames[1] == self.sFlame and self.permutationFlames[2] == self.eFlame then
+		return
+	end
+	self.permutationFlames = { self.sFlame, self.eFlame }
+	
+	local set = {}
+	for k,idx in ipairs(self.sFlame:getVariationSet()) do set[idx] = true end
+	for k,idx in ipairs(self.eFlame:getVariationSet()) do set[idx] = true end
+	local sorted = {}
+	for idx in pairs(set) do table.insert(sorted, idx) end
+	table.sort(sorted)
+	
+	local program = self:getPermutation(sorted)
+	if program == self.ifs then return end
+	
+	for k,location in ipairs({ Program.input, Program.output }) do
+		for idx=0,1 do
+			program:setStorage( location, idx, self.ifs:getStorage( location, idx ) )
+		end
+	end
+	program.palletteIndex = self.ifs.palletteIndex
+	self.ifs = program
+	self:evictPermutations()
+end
+
+-- the next flame of flameFile, going round once they run out, or a random one
+function IFS:nextFlame()
+	if #self.loadedFlames == 0 then return FlameGenerator.random() end
+	
+	self.flameIndex = self.flameIndex % #self.loadedFlames + 1
+	return self.loadedFlames[self.flameIndex]:clone()
 end
 
 function getProgram()
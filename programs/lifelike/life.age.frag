@@ -0,0 +1,7 @@
+// Advances a cell whose neighbourhood did not change last generation: it
+// stays alive or dead, so all that moves is the age of the live ones.
+void main()
+{
+	vec4 cell = texture2D( intex, gl_TexCoord[0].xy );
+	gl_FragColor = vec4( (cell.x > 0.0)? cell.x + 1.0: 0.0, cell.y, 0, 0 );
+}
@@ -0,0 +1,25 @@
+// Marks each tileSize x tileSize block of the board where a cell was born,
+// died or counted down a death state between the board in intex[0] and the
+// next generation in intex[1].  Blocks where nothing changed need not be
+// stepped again until one of their neighbours changes.
+void main()
+{
+	ivec2 size = textureSize( intex[0], 0 );
+	ivec2 start = ivec2( gl_FragCoord.xy ) * tileSize;
+	ivec2 end = min( start + tileSize, size );
+
+	float changed = 0.0;
+	for( int y = start.y; y < end.y && changed == 0.0; y++ )
+		for( int x = start.x; x < end.x; x++ )
+		{
+			vec4 before = texelFetch( intex[0], ivec2( x, y ), 0 );
+			vec4 after = texelFetch( intex[1], ivec2( x, y ), 0 );
+			if( (before.x > 0.0) != (after.x > 0.0) || before.y != after.y )
+			{
+				changed = 1.0;
+				break;
+			}
+		}
+
+	gl_FragColor = vec4( changed, 0, 0, 0 );
+}
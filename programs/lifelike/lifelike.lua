@@ -1,3 +1,6 @@
+assert(loadfile("scripts/computeEngine.lua"))()
+assert(loadfile("scripts/drawStatus.lua"))()
+
 LifeLike = {}
 
 function LifeLike:setRule( name )
@@ -5,10 +8,91 @@ function LifeLike:setRule( name )
 	self.rules.live = self:computeRule(self.ruleTable[name].live)
 	self.rules.deathStates = self.ruleTable[name].deathStates
 	self.rules.goodRandom = self.ruleTable[name].goodRandom
+	
+	-- death states take more bit planes, which means a new packed board
+	local usePacked = self.packed ~= nil
+	if usePacked and self.packedBoardReady then
+		local planes = self:packedPlanes( self.rules.deathStates )
+		if planes ~= self.planes then
+			self:allocatePacked( planes )
+			self:packBoard()
+		elseif not self.usePacked then
+			self:packBoard()
+		end
+	end
+	self.usePacked = usePacked
+	if self.activeTiles then self.activeTiles:reset() end
+	
+	if self.useHashLife then
+		local refusal = self:hashLifeRefusal()
+		if refusal then
+			print(refusal .. "  Stepping the board instead.")
+			self:setHashLife( false )
+		else
+			self.hashLife:setRules( self.rules.birth, self.rules.live )
+		end
+	end
+end
+
+-- Gets why HashLife cannot run the current rule, or nil if it can.
+function LifeLike:hashLifeRefusal()
+	if self.rules.deathStates ~= 0 then
+		return "HashLife cannot run rules with death states."
+	end
+	-- with B0 empty space is born, so an unbounded universe has no empty nodes to build on
+	if self.rules.birth % 2 == 1 then
+		return "HashLife cannot run rules where cells are born without neighbours (B0)."
+	end
+	return nil
+end
+
+-- Switches between stepping the board in place and stepping an unbounded
+-- universe with HashLife, which is drawn into the board around the view.
+function LifeLike:setHashLife( enabled )
+	local refusal = enabled and self:hashLifeRefusal()
+	if refusal then
+		print(refusal)
+		return
+	end
+	
+	if enabled then
+		self.hashLife:setRules( self.rules.birth, self.rules.live )
+		self.hashLife:setBoard( self.compute:getStorage( Program.input, 0 ) )
+		self.viewLeft = -math.floor(self.w/2)
+		self.viewBottom = -math.floor(self.h/2)
+	elseif self.useHashLife then
+		if self.usePacked then self:packBoard() end
+		self.activeTiles:reset()
+	end
+	
+	self.useHashLife = enabled
+end
+
+-- Gets the number of bit planes the packed board needs for a number of death states.
+function LifeLike:packedPlanes( deathStates )
+	local planes = 1
+	while math.ldexp( 1, planes ) < deathStates + 2 do planes = planes + 1 end
+	return planes
+end
+
+-- Allocates the packed boards, one plane above the other, 128 cells to a storage element.
+function LifeLike:allocatePacked( planes )
+	self.planes = planes
+	self.packed:allocateStorage( math.ceil(self.w/128), self.h * planes, Program.input, 0 )
+	self.packed:allocateStorage( math.ceil(self.w/128), self.h * planes, Program.output, 0 )
+end
+
+-- Packs the float board, the input of compute, into the input of packed.
+function LifeLike:packBoard()
+	self.pack:setStorage( Program.input, 0, self.compute:getStorage( Program.input, 0 ) )
+	self.pack:setStorage( Program.output, 0, self.packed:getStorage( Program.input, 0 ) )
+	self.pack:run()
 end
 
 function LifeLike:init(interactive, width, height)
-	self.engine = PluginManager.instance():loadPlugin("GLSLComputeEngine"):toEngine()
+	self.engine, self.engineName = loadComputeEngine()
+	-- the buffer texture and convolution always live on the GPU
+	self.glEngine = PluginManager.instance():loadPlugin("GLSLComputeEngine"):toEngine()
 	print("in init")
 	self.compute = Program()
 	self.compute:setWorkingDirectory(self:getWorkingDirectory())
@@ -21,14 +105,47 @@ function LifeLike:init(interactive, width, height)
 	self.color:bindEngine(self.engine)
 	self.hueSpacing = 255
 	
+	-- the float step only runs the tiles whose neighbourhood changed last
+	-- generation; life.age moves the rest along and life.changes finds
+	-- which tiles to run next
+	self.changes = Program()
+	self.changes:setWorkingDirectory(self:getWorkingDirectory())
+	self.changes:load("life.changes.program")
+	self.changes:bindEngine(self.engine)
+	
+	self.age = Program()
+	self.age:setWorkingDirectory(self:getWorkingDirectory())
+	self.age:load("life.age.program")
+	self.age:bindEngine(self.engine)
+	self.trackTiles = true
+	
+	-- on the CPU the board is stepped as bit planes, one for rules without
+	-- death states, and unpacked into the float board only for colouring
+	if self.engineName == "CPUComputeEngine" then
+		self.packed = Program()
+		self.packed:setWorkingDirectory(self:getWorkingDirectory())
+		self.packed:load("life.packed.program")
+		self.packed:bindEngine(self.engine)
+		
+		self.pack = Program()
+		self.pack:setWorkingDirectory(self:getWorkingDirectory())
+		self.pack:load("life.pack.program")
+		self.pack:bindEngine(self.engine)
+		
+		self.unpack = Program()
+		self.unpack:setWorkingDirectory(self:getWorkingDirectory())
+		self.unpack:load("life.unpack.program")
+		self.unpack:bindEngine(self.engine)
+	end
+	
 	self:setBufferTexture(GraphicsSystem.instance():createBufferTexture(2560,1440))
-	self.bufferStorage = self.engine:fromTexture( self:getBufferTexture() )
+	self.bufferStorage = self.glEngine:fromTexture( self:getBufferTexture() )
 	
 	self.convolve = Program()
-	self.convolve_out = self.engine:fromTexture( GraphicsSystem.instance():createBufferTexture(2560,1440) )
+	self.convolve_out = self.glEngine:fromTexture( GraphicsSystem.instance():createBufferTexture(2560,1440) )
 	self.convolve:setWorkingDirectory("./programs/")
 	self.convolve:load("convolve.program");
-	self.convolve:bindEngine(self.engine);
+	self.convolve:bindEngine(self.glEngine);
 	self.convolve:setStorage( Program.input, 0, self.bufferStorage )
 	self.convolve:setStorage( Program.output, 0, self.convolve_out )
 	self.kernel = {1, 1, 1, 1, 1, 1, 1, 1, 1}
@@ -46,6 +163,13 @@ function LifeLike:init(interactive, width, height)
 	self.fadeTime = 0
 	
 	self.paused = false
+	
+	-- HashLife advances 2^hashStep generations every run
+	self.hashLife = HashLife()
+	self.useHashLife = false
+	self.hashStep = 0
+	self.viewLeft = 0
+	self.viewBottom = 0
 
 	local screenInfo = GraphicsSystem.instance():getScreenInfo()
 
@@ -56,11 +180,20 @@ function LifeLike:init(interactive, width, height)
 	self.compute:allocateStorage( self.w, self.h, Program.output, 0 )
 	self.color:allocateStorage( self.w, self.h, Program.output, 0 )
 	
-	local boardSize = self.w * self.h * 4
-	self.localBoard = Array1Dfloat( boardSize )
-	local setTime = ticks()
-	self.localBoard:setAll(0)
-	print(string.format("Took %d ms to clear board to zero.", ticks() - setTime))
+	self.activeTiles = ActiveTiles( self.w, self.h, 64 )
+	-- the tile marks are read back a generation late, so generations take turns writing two
+	self.changeMarks = {}
+	for i = 1, 2 do
+		self.changes:allocateStorage( self.activeTiles:getColumns(), self.activeTiles:getRows(), Program.output, 0 )
+		self.changeMarks[i] = self.changes:getStorage( Program.output, 0 )
+	end
+	self.changes:getParameter("tileSize"):setInt( self.activeTiles:getTileSize() )
+	
+	if self.packed then
+		self:allocatePacked( 1 )
+		self.packed:getParameter("width"):setInt( self.w )
+		self.packedBoardReady = true
+	end
 	
 	local rulesPath = self:getWorkingDirectory() .. "rules.xml"
 	ConfigSystem.instance():loadConfig(rulesPath)
@@ -81,21 +214,20 @@ end
 
 function LifeLike:randomize( genChance, valMin, valMax )
 
+	-- the good_random chances were tuned for w*h*genChance cells picked at
+	-- random, which leaves about 1 - e^-genChance of the board alive
 	local genTime = ticks()
-	self.localBoard:setAll(0)
-	local randCount = math.floor(self.w * self.h * genChance)
-	local x,y, offset
-	for i=1,randCount do
-		x = math.random(0, self.w-1)
-		y = math.random(0, self.h-1)
-		self.localBoard:set( (y * self.w + x) * 4, math.random() * (valMax - valMin) + valMin )
-	end
+	local board = self.compute:getStorage( Program.input, 0 )
+	board:fillRandomSparse( 1 - math.exp(-genChance), valMin, valMax, math.random(0, 2147483647), 0 )
 	genTime = ticks() - genTime
+	
 	local copyTime = ticks()
-	self.compute:getStorageVal( Program.input, 0 ):copyFromArray( self.localBoard:array() )
+	if self.usePacked then self:packBoard() end
+	if self.useHashLife then self.hashLife:setBoard( self.compute:getStorage( Program.input, 0 ) ) end
+	self.activeTiles:reset()
 	copyTime = ticks() - copyTime
 	
-	print(string.format("Took %d ms to generate, %d ms to copy to storage.", genTime, copyTime))
+	print(string.format("Took %d ms to generate, %d ms to pass the board on.", genTime, copyTime))
 end
 
 function LifeLike:draw()
@@ -106,6 +238,25 @@ function LifeLike:draw()
 	graphicsSystem:useTexture( self.color:getStorage(Program.output, 0):toTexture() )
 	graphicsSystem:drawRectangle( Point(0,0), Point(screenInfo.w, screenInfo.h) )
 	graphicsSystem:useTexture( Texture() )
+	
+	if self.drawStatus then
+		local status = {}
+		if self.useHashLife then
+			table.insert(status, {"Generation", string.format("%.0f", self.hashLife:getGeneration())})
+			table.insert(status, {"Step", string.format("2^%d", self.hashStep)})
+			table.insert(status, {"Population", string.format("%.0f", self.hashLife:getPopulation())})
+			table.insert(status, {"Nodes", self.hashLife:getNodeCount()})
+		elseif self.usePacked then
+			table.insert(status, {"Step", string.format("packed, %d planes", self.planes)})
+		elseif self.trackTiles then
+			local active, total = self.activeTiles:getActiveCount(), self.activeTiles:getTileCount()
+			table.insert(status, {"Active tiles", string.format("%d/%d (%.1f%%)", active, total, active/total * 100)})
+		else
+			table.insert(status, {"Active tiles", "all"})
+		end
+		table.insert(status, {"FPS", math.floor(graphicsSystem:getFPS())})
+		drawStatus( Color( 1.0, 1.0, 1.0, 1.0 ), Color( 0.0, 0.0, 0.0, 1.0 ), unpack(status) )
+	end
 end
 
 function LifeLike:getOutput()
@@ -124,6 +275,28 @@ function LifeLike:input()
 	
 	if inputSystem:getKeyState( InputSystem.K_SPACE ) == InputSystem.released then self.paused = not self.paused end
 	if inputSystem:getKeyState( InputSystem.K_r ) == InputSystem.released then self:randomize( self.rules.goodRandom, 1, 1 ) end
+	if inputSystem:getKeyState( InputSystem.K_h ) == InputSystem.released then self:setHashLife( not self.useHashLife ) end
+	if inputSystem:getKeyState( InputSystem.K_s ) == InputSystem.released then self.drawStatus = not self.drawStatus end
+	if inputSystem:getKeyState( InputSystem.K_t ) == InputSystem.released then
+		self.trackTiles = not self.trackTiles
+		self.activeTiles:reset()
+	end
+	
+	if self.useHashLife then
+		if inputSystem:getKeyState( InputSystem.K_EQUALS ) == InputSystem.released then
+			self.hashStep = math.min( self.hashStep + 1, HashLife.MaxExponent )
+		end
+		if inputSystem:getKeyState( InputSystem.K_MINUS ) == InputSystem.released then
+			self.hashStep = math.max( self.hashStep - 1, 0 )
+		end
+		
+		if inputSystem:getMouseButtonState(2) == InputSystem.down then
+			local screenInfo = GraphicsSystem.instance():getScreenInfo()
+			local mouseMove = inputSystem:getMouseMotion()
+			self.viewLeft = self.viewLeft - math.floor(mouseMove.x * self.w/screenInfo.w + 0.5)
+			self.viewBottom = self.viewBottom - math.floor(mouseMove.y * self.h/screenInfo.h + 0.5)
+		end
+	end
 end
 
 function LifeLike:computeRule( rule )
@@ -144,13 +317,63 @@ function LifeLike:run(dt)
 	
 	self.fade = self.fadeTime
 	
+	self.color:getParameter("deathStates"):setInt(self.rules.deathStates)
+	self.color:getParameter("hueSpacing"):setInt(self.hueSpacing)
+	
+	-- either way the input of compute ends up holding the latest float board
+	local board = self.compute:getStorage( Program.input, 0 )
+	if self.useHashLife then
+		self.hashLife:step( self.hashStep )
+		self.hashLife:rasterise( board, self.viewLeft, self.viewBottom )
+		
+		self.color:setStorage( Program.input, 0, board )
+		self.color:run()
+		return
+	end
+	
+	if self.usePacked then
+		self.packed:getParameter("liveRules"):setInt(self.rules.live)
+		self.packed:getParameter("birthRules"):setInt(self.rules.birth)
+		self.packed:getParameter("deathStates"):setInt(self.rules.deathStates)
+		self.packed:run()
+		self.packed:swapInputOutput(0)
+		
+		self.unpack:setStorage( Program.input, 0, self.packed:getStorage( Program.input, 0 ) )
+		self.unpack:setStorage( Program.input, 1, board )
+		self.unpack:setStorage( Program.output, 0, board )
+		self.unpack:run()
+		
+		self.color:setStorage( Program.input, 0, board )
+		self.color:run()
+		return
+	end
+	
 	self.compute:getParameter("liveRules"):setInt(self.rules.live)
 	self.compute:getParameter("birthRules"):setInt(self.rules.birth)
 	self.compute:getParameter("deathStates"):setInt(self.rules.deathStates)
-	self.color:getParameter("deathStates"):setInt(self.rules.deathStates)
-	self.color:getParameter("hueSpacing"):setInt(self.hueSpacing)
 	
-	self.compute:run()
+	if self.trackTiles then
+		self.activeTiles:setActive( self.compute )
+		self.compute:run()
+		
+		local output = self.compute:getStorage( Program.output, 0 )
+		self.age:setStorage( Program.input, 0, board )
+		self.age:setStorage( Program.output, 0, output )
+		self.activeTiles:setIdle( self.age )
+		self.age:run()
+		
+		self.changes:setStorage( Program.input, 0, board )
+		self.changes:setStorage( Program.input, 1, output )
+		self.changeMarks[1], self.changeMarks[2] = self.changeMarks[2], self.changeMarks[1]
+		self.changes:setStorage( Program.output, 0, self.changeMarks[1] )
+		self.activeTiles:setActiveGrid( self.changes )
+		self.changes:run()
+		self.activeTiles:update( self.changeMarks[1] )
+	else
+		self.compute:clearActiveTiles()
+		self.compute:run()
+	end
+	
 	self.color:setStorage( Program.input, 0, self.compute:getStorage( Program.output, 0 ) )
 	self.color:run()
 	
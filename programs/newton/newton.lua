@@ -1,3 +1,6 @@
+assert(loadfile("scripts/computeEngine.lua"))()
+assert(loadfile("scripts/progressivePlane.lua"))()
+
 NewtonFunction = {}
 Newton = {}
 
@@ -29,9 +32,14 @@ end
 
 function Newton:updateTransform( func, unbind )
 	if unbind ~= false then self.transform:unbindEngine() end
-	local source = io.open("programs/transform.frag"):read("*a")
-	source = string.gsub(source, "%$TRANSFORM%$", func)
-	self.transform:setProgramLocationMemoryString("GLSLComputeEngine", source)
+	if self.engineName == "CPUComputeEngine" then
+		-- the native transform kernel only maps the plane, so func is ignored
+		self.transform:setProgramLocationKernel(self.engineName, "transform")
+	else
+		local source = io.open("programs/transform.frag"):read("*a")
+		source = string.gsub(source, "%$TRANSFORM%$", func)
+		self.transform:setProgramLocationMemoryString(self.engineName, source)
+	end
 	self.transform:bindEngine(self.engine)
 end
 
@@ -53,7 +61,7 @@ function Newton:init( interactive )
 
 	self.zoom = 0
 
-	self.engine = PluginManager.instance():loadPlugin("GLSLComputeEngine"):toEngine()
+	self.engine, self.engineName = loadComputeEngine()
 	
 	self.transform = Program()
 	self.transform:load("programs/transform.program")
@@ -74,13 +82,11 @@ function Newton:init( interactive )
 	
 	local screenInfo = GraphicsSystem.instance():getScreenInfo()
 	
-	self.transform:allocateStorage( screenInfo.w, screenInfo.h, Program.output, 0 )
-	self.calc:allocateStorage( screenInfo.w, screenInfo.h, Program.output, 0 )
+	-- the transform and calc run coarse to fine, the colour always at full size
+	self.plane = ProgressivePlane.new( screenInfo.w, screenInfo.h, { self.transform, self.calc }, self.color )
+	self.plane:enableScrolling( self.engine )
 	self.color:allocateStorage( screenInfo.w, screenInfo.h, Program.output, 0 )
 
-	self.calc:setStorage( Program.input, 0, self.transform:getStorage(Program.output, 0))
-	self.color:setStorage( Program.input, 0, self.calc:getStorage(Program.output, 0) )
-
 	print("\tdone.")
 
 	self.yMin = -1
@@ -112,7 +118,9 @@ function Newton:init( interactive )
 
 end
 
-function Newton:updatePlane( xCenter, yMin, yMax )
+-- scrollX and scrollY, if given, are the whole pixels the view moved by,
+-- so the plane can keep what it has already rendered.
+function Newton:updatePlane( xCenter, yMin, yMax, scrollX, scrollY )
 	self.yMin = yMin
 	self.yMax = yMax
 	self.yLength = yMax - yMin
@@ -131,6 +139,12 @@ function Newton:updatePlane( xCenter, yMin, yMax )
 	for param,value in pairs(parameters) do
 		self.transform:getParameter( param ):setFloat(value)
 	end
+	
+	if scrollX then
+		self.plane:scroll( scrollX, scrollY )
+	else
+		self.plane:restart()
+	end
 end
 
 function Newton:input()
@@ -146,13 +160,14 @@ function Newton:input()
 		self.sFunc = NewtonFunction.random( self.xMin, self.xMax, self.yMin, self.yMax, self.pMin, self.pMax )
 		self.eFunc = NewtonFunction.random( self.xMin, self.xMax, self.yMin, self.yMax, self.pMin, self.pMax )
 		self.time = self.transTime
+		self.plane:restart()
 	end
 		
 	if inputSystem:getMouseButtonState(1) == InputSystem.down then
 		local mouseMove = inputSystem:getMouseMotion()
 		local dx = -self.xLength/screenInfo.w * mouseMove.x
 		local dy = -self.yLength/screenInfo.h * mouseMove.y
-		self:updatePlane( self.xCenter + dx, self.yMin + dy, self.yMax + dy )
+		self:updatePlane( self.xCenter + dx, self.yMin + dy, self.yMax + dy, -mouseMove.x, -mouseMove.y )
 	end
 
 	if not self.ignoreZoom then
@@ -219,6 +234,9 @@ function Newton:run(dt)
 	self.delta = (self.paused and 0) or dt
 	self:processTransitions(self.delta)
 	
+	-- the function only stands still while paused or holding
+	if self.delta ~= 0 and not self.holding then self.plane:restart() end
+	
 	self.calc:getParameter("requiredPrecision"):setFloat(self.precision)
 	self.calc:getParameter("maxIterations"):setInt(self.maxIterations)
 	self.calc:getParameter("t"):setFloat(0)
@@ -229,8 +247,10 @@ function Newton:run(dt)
 	self.color:getParameter("blend"):setFloat(self.blend)
 	self.color:getParameter("gamma"):setVec3(self.gamma)
 	
-	self.transform:run()
-	self.calc:run()
+	self.plane:run( dt, function()
+		self.transform:run()
+		self.calc:run()
+	end )
 	self.color:run()
 end
 
@@ -1,3 +1,5 @@
+assert(loadfile("scripts/computeEngine.lua"))()
+
 Pickover = {}
 
 function draw_status( ... )
@@ -145,6 +147,8 @@ function Pickover:init( interactive )
 	self.pickover = Program()
 	self.pickover:setWorkingDirectory(self:getWorkingDirectory());
 	self.pickover:load("pickover.program");
+	self.pickoverHandles = getParameterHandles( self.pickover, { "param", "escapeRadius", "alpha", "lenPow",
+		"anglePow", "iterCount", "hueOffset", "time" } )
 	--self.pickover:bindEngine(self.engine)
 	print("done bind")
 	
@@ -191,6 +195,7 @@ function Pickover:init( interactive )
 	self.convolve_out = self.engine:fromTexture( graphicsSystem:createBufferTexture(0,0) )
 	self.convolve:setWorkingDirectory("./programs/")
 	self.convolve:load("convolve.program");
+	self.convolveHandles = getParameterHandles( self.convolve, { "convolveKernel" } )
 	self.convolve:bindEngine(self.engine);
 	self.convolve:setStorage( Program.input, 0, self.bufferStorage )
 	self.convolve:setStorage( Program.output, 0, self.convolve_out )
@@ -200,6 +205,7 @@ function Pickover:init( interactive )
 	self.tonemap_out = self.engine:fromTexture( graphicsSystem:createBufferTexture(0,0) )
 	self.tonemap:setWorkingDirectory("./programs/")
 	self.tonemap:load("tonemap.program")
+	self.tonemapHandles = getParameterHandles( self.tonemap, { "preGamma", "postGamma", "exposure", "alpha", "useAlpha" } )
 	self.tonemap:bindEngine(self.engine)
 	self.tonemap:setStorage( Program.input, 0, self.bufferStorage )
 	self.tonemap:setStorage( Program.output, 0, self.tonemap_out )	
@@ -310,19 +316,20 @@ function Pickover:run(dt)
 	
 	if not self.paused then self:processTransitions(dt) end
 	
-	local p = self.pickover:getParameter("param")
+	local handles = self.pickoverHandles
+	local attractorParameters = self.attractors[self.activeAttractor].parameters
 	for k,v in pairs(self.parameters) do
-		p:at(self.attractors[self.activeAttractor].parameters[k].index):setFloat(v.val)
+		self.pickover:setFloatAt(handles.param, attractorParameters[k].index, v.val)
 	end
 	
-	self.pickover:getParameter("escapeRadius"):setFloat(self.escapeRadius);
-	self.pickover:getParameter("alpha"):setFloat(self.alpha);
-	self.pickover:getParameter("lenPow"):setFloat(self.lenPow);
-	self.pickover:getParameter("anglePow"):setFloat(self.anglePow);
-	self.pickover:getParameter("iterCount"):setInt(self.iterCount);
-	self.pickover:getParameter("hueOffset"):setFloat((self.hueTime % self.hueCycleTime)/self.hueCycleTime)
+	self.pickover:setFloat(handles.escapeRadius, self.escapeRadius);
+	self.pickover:setFloat(handles.alpha, self.alpha);
+	self.pickover:setFloat(handles.lenPow, self.lenPow);
+	self.pickover:setFloat(handles.anglePow, self.anglePow);
+	self.pickover:setInt(handles.iterCount, self.iterCount);
+	self.pickover:setFloat(handles.hueOffset, (self.hueTime % self.hueCycleTime)/self.hueCycleTime)
 	self.hueTime = self.hueTime + dt
-	self.pickover:getParameter("time"):setInt(self.hueTime)
+	self.pickover:setInt(handles.time, self.hueTime)
 
 	self.pickover:run()
 	
@@ -348,16 +355,15 @@ function Pickover:getOutput()
 
 	table.insert(status, {"time", self.time})
 	table.insert(status, {"iters per sec", string.format("%.5f mil", self.size * self.size * self.iterCount/1000000) } )
+	local cache = self.engine:getProgramCacheCounts()
+	table.insert(status, {"Shader cache", string.format("%d hits, %d misses", cache.hits, cache.misses)} )
 	table.insert(status, {"FPS", math.floor(graphicsSystem:getFPS())} )
 	
 	if self.doConvolve then
 	
 		-- perform convolution on the framebuffer
 		self.convolve:setStorage( Program.input, 0, self.bufferStorage )
-		convolveKernel = self.convolve:getParameter("convolveKernel")
-		for i=1,9 do
-			convolveKernel:at(i-1):setFloat(self.convolve_kernel[i])
-		end
+		self.convolve:setFloatArray(self.convolveHandles.convolveKernel, self.convolve_kernel, 0)
 
 		self.convolve:run()
 
@@ -388,11 +394,12 @@ function Pickover:getOutput()
 		--self.tonemap:getParameter("alpha"):setFloat(1.0)
 		--self.tonemap:getParameter("useAlpha"):setInt(0)
 		--self.tonemap:run()
-		self.tonemap:getParameter("preGamma"):setFloat(self.preGamma)
-	self.tonemap:getParameter("postGamma"):setFloat(self.postGamma)
-	self.tonemap:getParameter("exposure"):setFloat(self.exposure)
-	self.tonemap:getParameter("alpha"):setFloat(1.0)
-	self.tonemap:getParameter("useAlpha"):setInt(1)
+		local handles = self.tonemapHandles
+		self.tonemap:setFloat(handles.preGamma, self.preGamma)
+	self.tonemap:setFloat(handles.postGamma, self.postGamma)
+	self.tonemap:setFloat(handles.exposure, self.exposure)
+	self.tonemap:setFloat(handles.alpha, 1.0)
+	self.tonemap:setInt(handles.useAlpha, 1)
 	self.tonemap:run()
 		-- overwrite the framebuffer with the tonemapped result
 		graphicsSystem:drawToTexture( self:getBufferTexture()  )
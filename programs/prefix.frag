@@ -0,0 +1,19 @@
+// One pass of a tiled summed-area table.  Each element adds the element
+// (offsetX, offsetY) before it, unless that element lies in another tile, so
+// running the offsets 1, 2, 4 ... below tileSize along x and then along y
+// leaves every element holding the sum of its tile from the tile's corner up
+// to itself.  Keeping the sums inside a tile keeps them small enough for
+// floats to tell sparse regions apart.
+
+void main()
+{
+	ivec2 position = ivec2( gl_FragCoord.xy );
+	ivec2 from = position - ivec2( offsetX, offsetY );
+	ivec2 corner = (position / tileSize) * tileSize;
+
+	vec4 sum = texelFetch( intex, position, 0 );
+	if( from.x >= corner.x && from.y >= corner.y )
+		sum += texelFetch( intex, from, 0 );
+
+	gl_FragColor = sum;
+}
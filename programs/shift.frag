@@ -0,0 +1,6 @@
+// Moves the whole input by a whole number of elements, so the parts of a
+// picture that are still on screen after a pan need not be computed again.
+void main()
+{
+	gl_FragColor = texelFetch( intex, ivec2( gl_FragCoord.xy ) + ivec2( shiftX, shiftY ), 0 );
+}
@@ -2,6 +2,20 @@
 
 void main()
 {
+#ifdef DF64
+	// the bounds are split into a float and the float remainder, and the
+	// output keeps the remainder of z in zw; the transform function is not
+	// applied, as it is written for floats
+	vec2 xMin = vec2( X_MIN, X_MIN_LO );
+	vec2 yMin = vec2( Y_MIN, Y_MIN_LO );
+	vec2 xRange = df64Sub( vec2( X_MAX, X_MAX_LO ), xMin );
+	vec2 yRange = df64Sub( vec2( Y_MAX, Y_MAX_LO ), yMin );
+	
+	vec2 x = df64Add( df64Mul( df64(gl_TexCoord[0].x), xRange ), xMin );
+	vec2 y = df64Add( df64Mul( df64(gl_TexCoord[0].y), yRange ), yMin );
+	
+	gl_FragColor = vec4( x.x, y.x, x.y, y.y );
+#else
 	float yRange = Y_MAX - Y_MIN;
 	float xRange = X_MAX - X_MIN;
 
@@ -9,4 +23,5 @@ void main()
 	z = z * blend + (1 - blend) * $TRANSFORM$;
 	
 	gl_FragColor = vec4( z, 0, 0 );
+#endif
 }
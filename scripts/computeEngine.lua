@@ -0,0 +1,17 @@
+-- Loads the engine named by infractus.compute.engine in infractus.xml, falling
+-- back to the GLSLComputeEngine.  Returns the engine and its name.
+function loadComputeEngine()
+	local name = ConfigSystem.instance():getConfigPtree("infractus.xml"):get("infractus.compute.engine")
+	if name == "" then name = "GLSLComputeEngine" end
+	return PluginManager.instance():loadPlugin(name):toEngine(), name
+end
+
+-- Gets the handles of the named parameters of a program, keyed by name, for
+-- setting them every frame without looking their names up.
+function getParameterHandles( program, names )
+	local handles = {}
+	for k,name in ipairs(names) do
+		handles[name] = program:getParameterHandle(name)
+	end
+	return handles
+end
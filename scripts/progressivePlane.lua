@@ -0,0 +1,189 @@
+-- Renders a chain of plane programs (a transform followed by the programs it
+-- feeds) coarse to fine.  After restart() the next pass runs at a fraction
+-- of the screen's resolution and every later frame refines it one level,
+-- until the chain has run at full resolution and stops running at all.  The
+-- colour program is pointed at the last level rendered, and scales it up to
+-- the screen itself.
+--
+-- The level a restart begins at follows the frame time: while restarts keep
+-- coming (panning, zooming, animating) frames slower than the budget move it
+-- coarser and frames well inside it move it finer.
+--
+-- With enableScrolling() a pan of the finished picture does not restart it:
+-- the picture is moved by whole elements and only the strips that came into
+-- view are computed, through run regions on the chain.
+
+ProgressivePlane = {}
+ProgressivePlane.__index = ProgressivePlane
+
+-- the fractions of the screen's resolution rendered at each level, coarsest first
+ProgressivePlane.scales = { 8, 4, 2, 1 }
+
+function ProgressivePlane.new( width, height, chain, color, budget )
+	local plane = setmetatable( {}, ProgressivePlane )
+	plane.chain = chain
+	plane.width = width
+	plane.height = height
+	plane.color = color
+	plane.budget = budget or 1000/30
+	plane.startLevel = 1
+	plane.level = 0
+	plane.lastPassStarted = false
+	plane.scrollX = 0
+	plane.scrollY = 0
+
+	-- each level gets its own outputs, so changing level never reallocates
+	plane.storage = {}
+	for level,scale in ipairs(ProgressivePlane.scales) do
+		plane.storage[level] = {}
+		for k,program in ipairs(chain) do
+			program:allocateStorage( math.ceil(width/scale), math.ceil(height/scale), Program.output, 0 )
+			plane.storage[level][k] = program:getStorage( Program.output, 0 )
+		end
+	end
+
+	return plane
+end
+
+-- Starts refining again from a coarse pass, for when the view has changed.
+function ProgressivePlane:restart()
+	self.level = 0
+	self.scrollX = 0
+	self.scrollY = 0
+end
+
+-- Lets scroll() reuse the finished picture.  The last program of the chain
+-- needs a spare full size output to be moved into.
+function ProgressivePlane:enableScrolling( engine )
+	self.shift = Program()
+	self.shift:load("programs/shift.program")
+	self.shift:bindEngine( engine )
+	self.shiftHandles = getParameterHandles( self.shift, { "shiftX", "shiftY" } )
+	self.shift:allocateStorage( self.width, self.height, Program.output, 0 )
+	self.spare = self.shift:getStorage( Program.output, 0 )
+	self.scrollX = 0
+	self.scrollY = 0
+end
+
+-- Moves the view by whole elements, so the element at (x, y) shows what was
+-- at (x + dx, y + dy).  Anything but a finished picture starts over instead.
+function ProgressivePlane:scroll( dx, dy )
+	if dx == 0 and dy == 0 then
+		return
+	end
+	
+	if not self.shift or not self:isRefined() then
+		self:restart()
+		return
+	end
+	
+	self.scrollX = self.scrollX + dx
+	self.scrollY = self.scrollY + dy
+	if math.abs(self.scrollX) >= self.width or math.abs(self.scrollY) >= self.height then
+		self:restart()
+	end
+end
+
+-- Moves the finished picture by the scroll so far and computes what came into view.
+function ProgressivePlane:runScroll( pass )
+	local dx, dy = self.scrollX, self.scrollY
+	self.scrollX = 0
+	self.scrollY = 0
+	
+	local storage = self.storage[#ProgressivePlane.scales]
+	local last = #self.chain
+	local keepX, keepY = math.max( 0, -dx ), math.max( 0, -dy )
+	local keepWidth, keepHeight = self.width - math.abs(dx), self.height - math.abs(dy)
+	
+	self.shift:setInt( self.shiftHandles.shiftX, dx )
+	self.shift:setInt( self.shiftHandles.shiftY, dy )
+	self.shift:setStorage( Program.input, 0, storage[last] )
+	self.shift:setStorage( Program.output, 0, self.spare )
+	self.shift:setRunRegion( keepX, keepY, keepWidth, keepHeight )
+	self.shift:run()
+	storage[last], self.spare = self.spare, storage[last]
+	self:useLevel( #ProgressivePlane.scales )
+	
+	-- whole columns on the side that came into view, then the rows between them
+	local strips = {}
+	if dx > 0 then table.insert( strips, { self.width - dx, 0, dx, self.height } ) end
+	if dx < 0 then table.insert( strips, { 0, 0, -dx, self.height } ) end
+	if dy > 0 then table.insert( strips, { keepX, self.height - dy, keepWidth, dy } ) end
+	if dy < 0 then table.insert( strips, { keepX, 0, keepWidth, -dy } ) end
+	
+	for k,strip in ipairs(strips) do
+		for j,program in ipairs(self.chain) do
+			program:setRunRegion( strip[1], strip[2], strip[3], strip[4] )
+		end
+		pass()
+	end
+	
+	for j,program in ipairs(self.chain) do
+		program:clearRunRegion()
+	end
+end
+
+-- Gets the level last rendered, from 1 for the coarsest to getLevelCount(),
+-- or 0 if nothing has been rendered since the last restart.
+function ProgressivePlane:getLevel()
+	return self.level
+end
+
+function ProgressivePlane:getLevelCount()
+	return #ProgressivePlane.scales
+end
+
+-- Gets the fraction of the screen's resolution last rendered, such as 8 for 1/8.
+function ProgressivePlane:getScale()
+	return ProgressivePlane.scales[math.max( self.level, 1 )]
+end
+
+function ProgressivePlane:isRefined()
+	return self.level == #ProgressivePlane.scales
+end
+
+-- Points the chain and the colour program at the storages of a level.
+function ProgressivePlane:useLevel( level )
+	local storage = self.storage[level]
+	for k,program in ipairs(self.chain) do
+		program:setStorage( Program.output, 0, storage[k] )
+		if k > 1 then program:setStorage( Program.input, 0, storage[k - 1] ) end
+	end
+	self.color:setStorage( Program.input, 0, storage[#self.chain] )
+end
+
+-- Runs the next pass, if there is one.  pass() sets the parameters and runs
+-- the chain.  dt is the length of the last frame, in milliseconds.
+function ProgressivePlane:run( dt, pass )
+	if self:isRefined() and (self.scrollX ~= 0 or self.scrollY ~= 0) then
+		self:runScroll( pass )
+		self.lastPassStarted = false
+		return true
+	end
+	
+	local starting = self.level == 0
+
+	if starting then
+		-- only a frame that also started over says how long a start takes
+		if self.lastPassStarted and dt then
+			if dt > self.budget and self.startLevel > 1 then
+				self.startLevel = self.startLevel - 1
+			elseif dt < self.budget/2 and self.startLevel < #ProgressivePlane.scales then
+				self.startLevel = self.startLevel + 1
+			end
+		end
+		self.level = self.startLevel
+	elseif self.level < #ProgressivePlane.scales then
+		self.level = self.level + 1
+	else
+		-- point the colour program back, in case something else used it
+		self:useLevel( self.level )
+		self.lastPassStarted = false
+		return false
+	end
+
+	self.lastPassStarted = starting
+	self:useLevel( self.level )
+	pass()
+	return true
+end
@@ -0,0 +1,91 @@
+#include "ActiveTiles.hpp"
+
+#include <algorithm>
+
+using namespace libcompute;
+
+ActiveTiles::ActiveTiles( unsigned int width, unsigned int height, unsigned int tileSize )
+{
+	mask_.tileSize = tileSize;
+	mask_.columns = (width + tileSize - 1)/tileSize;
+	mask_.rows = (height + tileSize - 1)/tileSize;
+	reset();
+}
+
+void ActiveTiles::reset()
+{
+	mask_.active.assign( size_t(mask_.columns) * mask_.rows, 1 );
+	activeCount_ = int(mask_.active.size());
+	pending_.reset();
+}
+
+void ActiveTiles::update( const Engine::DataStorage::Ptr& changes )
+{
+	Engine::DataStorage::Info info = changes->getInfo();
+	if( info.width != mask_.columns || info.height != mask_.rows )
+	{
+		printf("Tile changes must be %u x %u, not %u x %u.\n", mask_.columns, mask_.rows, info.width, info.height);
+		exit(1);
+	}
+
+	if( mask_.tileSize < 2 )
+	{
+		printf("Tiles must be at least 2 cells wide to use marks a generation late, not %u.\n", mask_.tileSize);
+		exit(1);
+	}
+
+	changes->requestRead();
+
+	Engine::DataStorage::Ptr previous = pending_;
+	std::vector<unsigned char> stepped = mask_.active;
+	pending_ = changes;
+	pendingStepped_.swap( stepped );
+
+	// right after a reset there are no earlier marks, and every tile stays active
+	if( !previous )
+		return;
+
+	std::vector<float> marks( mask_.active.size() * 4 );
+	previous->toArray( &marks[0] );
+
+	// tiles that were not stepped hold stale marks, but they did not change
+	std::vector<unsigned char> active( mask_.active.size(), 0 );
+	for( unsigned int row = 0; row < mask_.rows; row++ )
+		for( unsigned int column = 0; column < mask_.columns; column++ )
+		{
+			size_t index = size_t(row) * mask_.columns + column;
+			if( !stepped[index] || marks[index * 4] == 0 )
+				continue;
+
+			for( int dy = -1; dy <= 1; dy++ )
+				for( int dx = -1; dx <= 1; dx++ )
+				{
+					unsigned int x = (column + mask_.columns + dx) % mask_.columns;
+					unsigned int y = (row + mask_.rows + dy) % mask_.rows;
+					active[size_t(y) * mask_.columns + x] = 1;
+				}
+		}
+
+	mask_.active.swap( active );
+	activeCount_ = int(std::count( mask_.active.begin(), mask_.active.end(), 1 ));
+}
+
+void ActiveTiles::setActive( Program& program ) const
+{
+	program.setActiveTiles( mask_ );
+}
+
+void ActiveTiles::setIdle( Program& program ) const
+{
+	Program::TileMask idle = mask_;
+	for( unsigned char& tile: idle.active )
+		tile = !tile;
+	program.setActiveTiles( idle );
+}
+
+void ActiveTiles::setActiveGrid( Program& program ) const
+{
+	Program::TileMask grid = mask_;
+	grid.tileSize = 1;
+	program.setActiveTiles( grid );
+}
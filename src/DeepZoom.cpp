@@ -0,0 +1,200 @@
+#include "DeepZoom.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace libcompute;
+
+namespace
+{
+	/** How far the centre of the view can get from the reference orbit, on the unit plane, before it is iterated again. */
+	const double RebaseDistance = 2;
+
+	/** Bits the reference orbit keeps beyond the depth of the view, for the pixels and the rounding of its iterations. */
+	const int GuardBits = 64;
+
+	typedef boost::multiprecision::number<boost::multiprecision::cpp_bin_float<128, boost::multiprecision::digit_base_2> > Real128;
+	typedef boost::multiprecision::number<boost::multiprecision::cpp_bin_float<256, boost::multiprecision::digit_base_2> > Real256;
+	typedef boost::multiprecision::number<boost::multiprecision::cpp_bin_float<512, boost::multiprecision::digit_base_2> > Real512;
+
+	template<typename T> T toWorking( const DeepZoom::Real& value ) { return T( value ); }
+	template<> double toWorking<double>( const DeepZoom::Real& value ) { return value.convert_to<double>(); }
+
+	template<typename T> double toDouble( const T& value ) { return value.template convert_to<double>(); }
+	template<> double toDouble<double>( const double& value ) { return value; }
+
+	/**
+	 * @brief Iterates the orbit of (\a cx, \a cy) in \a T, storing each element as DeepZoom::writeReference() expects.
+	 * @return The index of the last element.
+	 *
+	 * Z(0) = 0 and Z(n+1) = Z(n)^2 + C.  Each part is stored as the nearest
+	 * float and the float nearest to what is left over.
+	 */
+	template<typename T> int iterateReference( const DeepZoom::Real& cx, const DeepZoom::Real& cy, int maxIterations,
+		double radiusSquared, float* reference )
+	{
+		T centerX = toWorking<T>( cx ), centerY = toWorking<T>( cy );
+		T x = 0, y = 0;
+		int n = 0;
+		while( true )
+		{
+			double xd = toDouble( x ), yd = toDouble( y );
+			float* element = &reference[size_t(n) * 4];
+			element[0] = float(xd);
+			element[1] = float(yd);
+			element[2] = float(xd - element[0]);
+			element[3] = float(yd - element[1]);
+
+			if( n == maxIterations || xd * xd + yd * yd > radiusSquared )
+				return n;
+
+			T xx = x * x, yy = y * y;
+			y = 2 * x * y + centerY;
+			x = xx - yy + centerX;
+			n++;
+		}
+	}
+}
+
+DeepZoom::DeepZoom()
+: centerX_(-0.5)
+, centerY_(0)
+, scale_(3)
+, referenceX_(0)
+, referenceY_(0)
+, referenceDirty_(true)
+, referenceBits_(0)
+, referenceIterations_(0)
+, referenceRadius_(0)
+, referenceLength_(0)
+{
+}
+
+void DeepZoom::setCenter( const std::string& x, const std::string& y )
+{
+	centerX_ = Real(x);
+	centerY_ = Real(y);
+	referenceDirty_ = true;
+}
+
+std::string DeepZoom::getCenterX() const
+{
+	return centerX_.str( std::numeric_limits<Real>::digits10 );
+}
+
+std::string DeepZoom::getCenterY() const
+{
+	return centerY_.str( std::numeric_limits<Real>::digits10 );
+}
+
+void DeepZoom::pan( double dx, double dy )
+{
+	if( dx == 0 && dy == 0 )
+		return;
+
+	// the reference orbit stays where it is until updateReference() finds the view too far from it
+	centerX_ += dx;
+	centerY_ += dy;
+}
+
+void DeepZoom::zoom( double factor )
+{
+	scale_ *= factor;
+}
+
+float DeepZoom::getHalfScaleMantissa() const
+{
+	int exponent;
+	return std::frexp( scale_/2, &exponent );
+}
+
+int DeepZoom::getHalfScaleExponent() const
+{
+	int exponent;
+	std::frexp( scale_/2, &exponent );
+	return exponent;
+}
+
+int DeepZoom::getReferenceRows( int maxIterations )
+{
+	return (maxIterations + 1 + ReferenceWidth - 1)/ReferenceWidth;
+}
+
+float DeepZoom::getReferenceOffsetX() const
+{
+	return Real( (centerX_ - referenceX_)/(scale_/2) ).convert_to<float>();
+}
+
+float DeepZoom::getReferenceOffsetY() const
+{
+	return Real( (centerY_ - referenceY_)/(scale_/2) ).convert_to<float>();
+}
+
+bool DeepZoom::updateReference( int maxIterations, float escapeRadius )
+{
+	int bits = std::max( 0, int(std::ceil( -std::log2( scale_ ) )) ) + GuardBits;
+	bool far = std::max( std::fabs( getReferenceOffsetX() ), std::fabs( getReferenceOffsetY() ) ) > RebaseDistance;
+
+	if( !referenceDirty_ && !far && bits <= referenceBits_ &&
+		maxIterations == referenceIterations_ && escapeRadius == referenceRadius_ )
+		return false;
+
+	reference_.assign( size_t(getReferenceRows( maxIterations )) * ReferenceWidth * 4, 0.0f );
+
+	// the centre needs every bit to be placed, but the orbit only as many as the depth
+	double radiusSquared = double(escapeRadius) * escapeRadius;
+	int n;
+	if( bits <= std::numeric_limits<double>::digits )
+	{
+		n = iterateReference<double>( centerX_, centerY_, maxIterations, radiusSquared, &reference_[0] );
+		referenceBits_ = std::numeric_limits<double>::digits;
+	}
+	else if( bits <= 128 )
+	{
+		n = iterateReference<Real128>( centerX_, centerY_, maxIterations, radiusSquared, &reference_[0] );
+		referenceBits_ = 128;
+	}
+	else if( bits <= 256 )
+	{
+		n = iterateReference<Real256>( centerX_, centerY_, maxIterations, radiusSquared, &reference_[0] );
+		referenceBits_ = 256;
+	}
+	else if( bits <= 512 )
+	{
+		n = iterateReference<Real512>( centerX_, centerY_, maxIterations, radiusSquared, &reference_[0] );
+		referenceBits_ = 512;
+	}
+	else
+	{
+		n = iterateReference<Real>( centerX_, centerY_, maxIterations, radiusSquared, &reference_[0] );
+		referenceBits_ = std::numeric_limits<Real>::digits;
+	}
+
+	referenceX_ = centerX_;
+	referenceY_ = centerY_;
+	referenceLength_ = n + 1;
+	referenceIterations_ = maxIterations;
+	referenceRadius_ = escapeRadius;
+	referenceDirty_ = false;
+
+	return true;
+}
+
+void DeepZoom::writeReference( const Engine::DataStorage::Ptr& storage )
+{
+	Engine::DataStorage::Info info = storage->getInfo();
+	size_t needed = size_t(info.width) * info.height * 4;
+
+	if( info.width != ReferenceWidth || reference_.size() > needed )
+	{
+		printf("Reference storage is %ux%u but the reference orbit needs %dx%d.\n",
+			info.width, info.height, ReferenceWidth, int(reference_.size()/4/ReferenceWidth));
+		exit(1);
+	}
+
+	if( reference_.size() < needed )
+		reference_.resize( needed, 0.0f );
+
+	storage->fromArray( &reference_[0] );
+}
@@ -0,0 +1,695 @@
+#include "Flame.hpp"
+
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+using namespace libcompute;
+
+std::vector<std::string> Flame::variations_;
+std::vector<std::string> Flame::parameters_;
+std::map<std::string, int> Flame::variationIndexes_;
+std::map<std::string, int> Flame::parameterIndexes_;
+unsigned long Flame::nextPaletteId_ = 1;
+
+namespace
+{
+
+const float Identity[6] = { 1, 0, 0, 0, 1, 0 };
+
+/** Four floats, using the GCC vector extensions. */
+typedef float Vector __attribute__((vector_size( 4 * sizeof(float) )));
+
+/** Sets \a out to \a start * \a weight + \a end * (1 - \a weight), four floats at a time. */
+void lerp( float* out, const float* start, const float* end, float weight, size_t count )
+{
+	const Vector startWeight = { weight, weight, weight, weight };
+	const Vector endWeight = 1.0f - startWeight;
+
+	size_t i = 0;
+	for( ; i + 4 <= count; i += 4 )
+	{
+		Vector s, e;
+		memcpy( &s, start + i, sizeof(Vector) );
+		memcpy( &e, end + i, sizeof(Vector) );
+		Vector o = s * startWeight + e * endWeight;
+		memcpy( out + i, &o, sizeof(Vector) );
+	}
+
+	for( ; i < count; i++ )
+		out[i] = start[i] * weight + end[i] * (1 - weight);
+}
+
+mat4 toMat4( const float* affine )
+{
+	mat4 mat;
+	for( int c = 0; c < 3; c++ )
+	{
+		mat(0, c) = affine[c];
+		mat(1, c) = affine[c + 3];
+	}
+	return mat;
+}
+
+void fromMat4( mat4 mat, float* affine )
+{
+	for( int c = 0; c < 3; c++ )
+	{
+		affine[c] = mat(0, c);
+		affine[c + 3] = mat(1, c);
+	}
+}
+
+}
+
+Xform::Xform()
+: color_(.5)
+, colorSpeed_(.5)
+, density_(0)
+, opacity_(1)
+, variations_( Flame::variations_.size(), 0.0f )
+, parameters_( Flame::parameters_.size(), 0.0f )
+{
+	std::copy( Identity, Identity + 6, affine_ );
+	std::copy( Identity, Identity + 6, post_ );
+}
+
+mat4 Xform::getAffine() const
+{
+	return toMat4( affine_ );
+}
+
+void Xform::setAffine( mat4 affine )
+{
+	fromMat4( affine, affine_ );
+}
+
+mat4 Xform::getPost() const
+{
+	return toMat4( post_ );
+}
+
+void Xform::setPost( mat4 post )
+{
+	fromMat4( post, post_ );
+}
+
+float Xform::getVariationWeight( const std::string& name ) const
+{
+	std::map<std::string, int>::const_iterator it = Flame::variationIndexes_.find( name );
+	return (it == Flame::variationIndexes_.end())? 0.0f: variations_[it->second];
+}
+
+void Xform::setVariationWeight( const std::string& name, float weight )
+{
+	std::map<std::string, int>::const_iterator it = Flame::variationIndexes_.find( name );
+	if( it == Flame::variationIndexes_.end() )
+	{
+		printf("Xform has no variation called %s; add it with Flame.addVariation first.\n", name.c_str());
+		exit(1);
+	}
+
+	variations_[it->second] = weight;
+}
+
+bool Xform::hasVariation( const std::string& name ) const
+{
+	return getVariationWeight( name ) != 0.0f;
+}
+
+float Xform::getParameter( const std::string& name ) const
+{
+	std::map<std::string, int>::const_iterator it = Flame::parameterIndexes_.find( name );
+	return (it == Flame::parameterIndexes_.end())? 0.0f: parameters_[it->second];
+}
+
+void Xform::setParameter( const std::string& name, float value )
+{
+	std::map<std::string, int>::const_iterator it = Flame::parameterIndexes_.find( name );
+	if( it == Flame::parameterIndexes_.end() )
+	{
+		printf("Xform has no parameter called %s; add it with Flame.addParameter first.\n", name.c_str());
+		exit(1);
+	}
+
+	parameters_[it->second] = value;
+}
+
+void Xform::normalizeVariations()
+{
+	float sum = 0;
+	for( size_t i = 0; i < variations_.size(); i++ )
+		sum += variations_[i];
+
+	for( size_t i = 0; i < variations_.size(); i++ )
+		variations_[i] /= sum;
+}
+
+Flame::Flame()
+: count_(0)
+, values_( (VariationField + variations_.size() + parameters_.size()) * MaxXforms )
+, palette_( PaletteSize * 4, 0.0f )
+, trans_(0, 0, 0)
+, paletteId_(nextPaletteId_++)
+{
+	for( int i = 0; i < PaletteSize; i++ )
+		palette_[i * 4 + 3] = 1;
+
+	for( int i = 0; i < MaxXforms; i++ )
+		clearXform( i );
+}
+
+void Flame::addVariation( const std::string& name )
+{
+	variationIndexes_[name] = int(variations_.size());
+	variations_.push_back( name );
+}
+
+void Flame::addParameter( const std::string& name )
+{
+	parameterIndexes_[name] = int(parameters_.size());
+	parameters_.push_back( name );
+}
+
+void Flame::addXform( const Xform& xform )
+{
+	if( count_ == MaxXforms )
+	{
+		printf("A flame holds at most %d xforms.\n", MaxXforms);
+		exit(1);
+	}
+
+	count_++;
+	setXform( count_ - 1, xform );
+}
+
+Xform Flame::getXform( int index ) const
+{
+	Xform xform;
+	for( int k = 0; k < 6; k++ )
+	{
+		xform.affine_[k] = row( AffineField + k )[index];
+		xform.post_[k] = row( PostField + k )[index];
+	}
+
+	xform.color_ = row( ColorField )[index];
+	xform.colorSpeed_ = row( ColorSpeedField )[index];
+	xform.density_ = row( DensityField )[index];
+	xform.opacity_ = row( OpacityField )[index];
+
+	for( size_t v = 0; v < xform.variations_.size(); v++ )
+		xform.variations_[v] = row( VariationField + int(v) )[index];
+	for( size_t p = 0; p < xform.parameters_.size(); p++ )
+		xform.parameters_[p] = row( parameterField() + int(p) )[index];
+
+	return xform;
+}
+
+void Flame::setXform( int index, const Xform& xform )
+{
+	if( index < 0 || index >= count_ )
+	{
+		printf("The flame has no xform %d.\n", index + 1);
+		exit(1);
+	}
+
+	for( int k = 0; k < 6; k++ )
+	{
+		row( AffineField + k )[index] = xform.affine_[k];
+		row( PostField + k )[index] = xform.post_[k];
+	}
+
+	row( ColorField )[index] = xform.color_;
+	row( ColorSpeedField )[index] = xform.colorSpeed_;
+	row( DensityField )[index] = xform.density_;
+	row( OpacityField )[index] = xform.opacity_;
+
+	// xforms made before every variation was added leave the rest at zero
+	int variations = int(variations_.size());
+	int parameters = int(parameters_.size());
+	for( int v = 0; v < variations; v++ )
+		row( VariationField + v )[index] = (v < int(xform.variations_.size()))? xform.variations_[v]: 0.0f;
+	for( int p = 0; p < parameters; p++ )
+		row( parameterField() + p )[index] = (p < int(xform.parameters_.size()))? xform.parameters_[p]: 0.0f;
+}
+
+void Flame::removeXform( int index )
+{
+	if( index < 0 || index >= count_ )
+		return;
+
+	int fields = int(values_.size()/MaxXforms);
+	for( int field = 0; field < fields; field++ )
+	{
+		float* values = row( field );
+		std::copy( values + index + 1, values + count_, values + index );
+	}
+
+	count_--;
+	clearXform( count_ );
+}
+
+void Flame::clearXform( int index )
+{
+	int fields = int(values_.size()/MaxXforms);
+	for( int field = 0; field < fields; field++ )
+		row( field )[index] = 0;
+
+	for( int k = 0; k < 6; k++ )
+	{
+		row( AffineField + k )[index] = Identity[k];
+		row( PostField + k )[index] = Identity[k];
+	}
+
+	row( ColorField )[index] = .5;
+	row( ColorSpeedField )[index] = .5;
+	row( OpacityField )[index] = 1;
+}
+
+vec4 Flame::getPaletteEntry( int index ) const
+{
+	const float* entry = &palette_[size_t(index) * 4];
+	return vec4( entry[0], entry[1], entry[2], entry[3] );
+}
+
+void Flame::setPaletteEntry( int index, vec4 colour )
+{
+	if( index < 0 || index >= PaletteSize )
+		return;
+
+	float* entry = &palette_[size_t(index) * 4];
+	entry[0] = colour.x;
+	entry[1] = colour.y;
+	entry[2] = colour.z;
+	entry[3] = colour.w;
+	paletteId_ = nextPaletteId_++;
+}
+
+float Flame::getDensitySum() const
+{
+	float sum = 0;
+	const float* density = row( DensityField );
+	for( int i = 0; i < count_; i++ )
+		sum += density[i];
+	return sum;
+}
+
+std::vector<int> Flame::getVariationSet() const
+{
+	int linear = variationIndexes_.count("linear")? variationIndexes_.at("linear"): -1;
+
+	std::vector<int> set;
+	for( int v = 0; v < int(variations_.size()); v++ )
+	{
+		const float* weights = row( VariationField + v );
+		for( int i = 0; i < count_; i++ )
+			if( weights[i] != 0.0f && (linear < 0 || row( VariationField + linear )[i] != 1.0f) )
+			{
+				set.push_back( v );
+				break;
+			}
+	}
+
+	return set;
+}
+
+void Flame::normalizeDensities( float to )
+{
+	float scale = to/getDensitySum();
+	float* density = row( DensityField );
+	for( int i = 0; i < count_; i++ )
+		density[i] *= scale;
+}
+
+void Flame::spin( float degrees )
+{
+	float radians = degrees * float(M_PI)/180;
+	for( int i = 0; i < count_; i++ )
+	{
+		if( row( ColorSpeedField )[i] <= 0 )
+			continue;
+
+		// the post transform turns one way and the affine transform the other
+		for( int k = 0; k < 2; k++ )
+		{
+			int field = (k == 0)? PostField: AffineField;
+			float angle = (k == 0)? radians: -radians;
+			float s = std::sin( angle ), c = std::cos( angle );
+
+			for( int column = 0; column < 3; column++ )
+			{
+				float& top = row( field + column )[i];
+				float& bottom = row( field + column + 3 )[i];
+				float t = top;
+				top = t * c - bottom * s;
+				bottom = t * s + bottom * c;
+			}
+		}
+
+		radians = -radians;
+	}
+}
+
+void Flame::interpolate( const Flame& start, const Flame& end, float weight )
+{
+	if( start.values_.size() != end.values_.size() )
+	{
+		printf("Cannot interpolate flames made with different variation tables.\n");
+		exit(1);
+	}
+
+	count_ = std::max( start.count_, end.count_ );
+	values_.resize( start.values_.size() );
+	lerp( &values_[0], &start.values_[0], &end.values_[0], weight, values_.size() );
+	lerp( &palette_[0], &start.palette_[0], &end.palette_[0], weight, palette_.size() );
+	trans_ = start.trans_ * weight + end.trans_ * (1 - weight);
+	paletteId_ = nextPaletteId_++;
+}
+
+Flame::ProgramHandles::ProgramHandles( Program& program )
+: mats( program.getParameterHandle("mats") ),
+  colSpeeds( program.getParameterHandle("colSpeeds") ),
+  varOffsets( program.getParameterHandle("varOffsets") ),
+  vars( program.getParameterHandle("vars") ),
+  varParam( program.getParameterHandle("varParam") ),
+  matCount( program.getParameterHandle("matCount") ),
+  densitySum( program.getParameterHandle("densitySum") )
+{
+}
+
+void Flame::writeParameters( Program& program, const ProgramHandles& handles ) const
+{
+	Parameter& matsParameter = program.getParameter( handles.mats );
+	Parameter& varsParameter = program.getParameter( handles.vars );
+	Parameter& varParamParameter = program.getParameter( handles.varParam );
+
+	int count = writeParameters( matsParameter, program.getParameter( handles.colSpeeds ), program.getParameter( handles.varOffsets ),
+		varsParameter, varParamParameter, matsParameter.size(), varsParameter.size(), varParamParameter.size()/matsParameter.size() );
+
+	program.getParameter( handles.matCount ) = count;
+	program.getParameter( handles.densitySum ) = getDensitySum();
+}
+
+int Flame::writeParameters( mat4* mats, float* colSpeeds, int* varOffsets, vec2* vars, mat4* varParams,
+	unsigned int matCount, unsigned int varCount, unsigned int paramMats ) const
+{
+	int count = std::min( count_, int(matCount) );
+	int linear = variationIndexes_.count("linear")? variationIndexes_.at("linear"): -1;
+
+	unsigned int varOffset = 0;
+	for( int i = 0; i < count; i++ )
+	{
+		mat4& mat = mats[i];
+		for( int c = 0; c < 3; c++ )
+		{
+			mat(0, c) = row( AffineField + c )[i];
+			mat(1, c) = row( AffineField + c + 3 )[i];
+			mat(2, c) = row( PostField + c )[i];
+			mat(3, c) = row( PostField + c + 3 )[i];
+		}
+		mat(0, 3) = row( ColorField )[i];
+		mat(1, 3) = row( OpacityField )[i];
+		mat(2, 3) = 0;
+		mat(3, 3) = row( DensityField )[i];
+
+		colSpeeds[i] = row( ColorSpeedField )[i];
+
+		if( linear >= 0 && row( VariationField + linear )[i] == 1.0f )
+			varOffsets[i] = -1;
+		else
+		{
+			varOffsets[i] = int(varOffset);
+			for( int v = 0; v < int(variations_.size()) && varOffset + 1 < varCount; v++ )
+			{
+				float weight = row( VariationField + v )[i];
+				if( weight != 0.0f )
+					vars[varOffset++] = vec2( float(v), weight );
+			}
+
+			if( varOffset < varCount )
+				vars[varOffset++] = vec2( -1, -1 );
+		}
+
+		// the parameters are packed sixteen to a mat4, row by row
+		for( unsigned int m = 0; m < paramMats; m++ )
+		{
+			float* values = &varParams[i * paramMats + m](0, 0);
+			for( unsigned int k = 0; k < 16; k++ )
+			{
+				size_t p = m * 16 + k;
+				values[k] = (p < parameters_.size())? row( parameterField() + int(p) )[i]: 0.0f;
+			}
+		}
+	}
+
+	return count;
+}
+
+void Flame::writePalette( const Engine::DataStorage::Ptr& storage ) const
+{
+	Engine::DataStorage::Info info = storage->getInfo();
+	std::vector<float> values( size_t(info.width) * info.height * 4, 0.0f );
+	writePalette( &values[0], values.size() );
+	storage->fromArray( &values[0] );
+}
+
+void Flame::writePalette( float* values, size_t size ) const
+{
+	size = std::min( size, palette_.size() );
+	for( size_t i = 0; i < size; i++ )
+		values[i] = std::min( std::max( palette_[i], 0.0f ), 1.0f );
+}
+
+namespace
+{
+
+/** Half the field of view of FlameRenderer and the ThreeD drawing mode, in radians. */
+const float HalfFieldOfView = 22.5f * float(M_PI)/180;
+
+std::vector<float> readNumbers( const std::string& text )
+{
+	std::vector<float> numbers;
+	std::istringstream stream( text );
+	float number;
+	while( stream >> number )
+		numbers.push_back( number );
+	return numbers;
+}
+
+/** Reads flam3 coefficients, which list the columns of the matrix, into the rows of an affine mat4. */
+mat4 readCoefficients( const std::string& text )
+{
+	std::vector<float> coefficients = readNumbers( text );
+	coefficients.resize( 6, 0.0f );
+
+	mat4 mat;
+	for( int c = 0; c < 3; c++ )
+	{
+		mat(0, c) = coefficients[c * 2];
+		mat(1, c) = coefficients[c * 2 + 1];
+	}
+	return mat;
+}
+
+std::string writeCoefficients( mat4 mat )
+{
+	std::ostringstream stream;
+	for( int c = 0; c < 3; c++ )
+		stream << (c > 0? " ": "") << mat(0, c) << " " << mat(1, c);
+	return stream.str();
+}
+
+Flame readFlame( const boost::property_tree::ptree& node, const std::string& path )
+{
+	Flame flame;
+	std::vector<float> size = readNumbers( node.get<std::string>( "<xmlattr>.size", "640 480" ) );
+	std::vector<float> center = readNumbers( node.get<std::string>( "<xmlattr>.center", "0 0" ) );
+	float scale = node.get<float>( "<xmlattr>.scale", 1.0f );
+	size.resize( 2, 480.0f );
+	center.resize( 2, 0.0f );
+
+	// move back until the plane fills as much of the view as it fills the flam3 image
+	float depth = size[1] * .5f/scale/std::tan( HalfFieldOfView );
+	flame.setTrans( vec3( -center[0], -center[1], -depth ) );
+
+	std::vector<float> palette( 256 * 3, 0.0f );
+	const boost::property_tree::ptree none;
+	for( const boost::property_tree::ptree::value_type& child: node )
+	{
+		if( child.first == "finalxform" )
+			printf("%s: skipping a final xform, which the ifs program cannot run.\n", path.c_str());
+		else if( child.first == "color" )
+		{
+			int index = child.second.get<int>( "<xmlattr>.index", -1 );
+			std::vector<float> rgb = readNumbers( child.second.get<std::string>( "<xmlattr>.rgb", "" ) );
+			rgb.resize( 3, 0.0f );
+			if( index >= 0 && index < 256 )
+				for( int k = 0; k < 3; k++ )
+					palette[index * 3 + k] = rgb[k]/255;
+		}
+		else if( child.first == "palette" )
+		{
+			// six hexadecimal digits a colour, with any amount of white space between them
+			std::string digits;
+			for( char c: child.second.get_value<std::string>() )
+				if( isxdigit( (unsigned char) c ) )
+					digits += c;
+
+			int count = std::min( std::max( child.second.get<int>( "<xmlattr>.count", 256 ), 0 ), 256 );
+			size_t end = std::min( digits.size(), size_t(count) * 6 );
+			for( size_t i = 0; i + 2 <= end; i += 2 )
+				palette[i/2] = strtol( digits.substr( i, 2 ).c_str(), NULL, 16 )/255.0f;
+		}
+		else if( child.first == "xform" )
+		{
+			if( flame.getXformCount() == Flame::MaxXforms )
+			{
+				printf("%s: skipping xforms past the first %d.\n", path.c_str(), Flame::MaxXforms);
+				continue;
+			}
+
+			Xform xform;
+			for( const boost::property_tree::ptree::value_type& attribute: child.second.get_child( "<xmlattr>", none ) )
+			{
+				const std::string& name = attribute.first;
+				const std::string value = attribute.second.data();
+
+				if( name == "weight" )
+					xform.setDensity( strtof( value.c_str(), NULL ) );
+				else if( name == "color" )
+					xform.setColor( strtof( value.c_str(), NULL ) );
+				else if( name == "color_speed" )
+					xform.setColorSpeed( strtof( value.c_str(), NULL ) );
+				else if( name == "symmetry" )
+				{
+					// older files give the colour speed as a symmetry
+					if( !child.second.get_child( "<xmlattr>" ).count( "color_speed" ) )
+						xform.setColorSpeed( (1 - strtof( value.c_str(), NULL ))/2 );
+				}
+				else if( name == "opacity" )
+					xform.setOpacity( strtof( value.c_str(), NULL ) );
+				else if( name == "coefs" )
+					xform.setAffine( readCoefficients( value ) );
+				else if( name == "post" )
+					xform.setPost( readCoefficients( value ) );
+				else if( Flame::isVariation( name ) )
+					xform.setVariationWeight( name, strtof( value.c_str(), NULL ) );
+				else if( Flame::isParameter( name ) )
+					xform.setParameter( name, strtof( value.c_str(), NULL ) );
+				else
+					printf("%s: ignoring %s, which is not a variation infractus has.\n", path.c_str(), name.c_str());
+			}
+
+			flame.addXform( xform );
+		}
+	}
+
+	for( int i = 0; i < Flame::PaletteSize; i++ )
+	{
+		const float* colour = &palette[size_t(i) * 256/Flame::PaletteSize * 3];
+		flame.setPaletteEntry( i, vec4( colour[0], colour[1], colour[2], 1 ) );
+	}
+
+	return flame;
+}
+
+}
+
+std::vector<Flame> Flame::loadFlam3( const std::string& path )
+{
+	boost::property_tree::ptree tree;
+	try
+	{
+		read_xml( path, tree );
+	}
+	catch( const boost::property_tree::xml_parser_error& error )
+	{
+		printf("Cannot read the flames in %s: %s\n", path.c_str(), error.what());
+		exit(1);
+	}
+
+	// files hold either one flame or a list of them
+	const boost::property_tree::ptree& root = tree.count("flames")? tree.get_child("flames"): tree;
+
+	std::vector<Flame> flames;
+	for( const boost::property_tree::ptree::value_type& child: root )
+		if( child.first == "flame" )
+			flames.push_back( readFlame( child.second, path ) );
+
+	return flames;
+}
+
+void Flame::saveFlam3( const std::string& path, const std::vector<Flame>& flames, int width, int height )
+{
+	boost::property_tree::ptree tree;
+	boost::property_tree::ptree& root = tree.add_child( "flames", boost::property_tree::ptree() );
+
+	for( size_t f = 0; f < flames.size(); f++ )
+	{
+		const Flame& flame = flames[f];
+		boost::property_tree::ptree& node = root.add_child( "flame", boost::property_tree::ptree() );
+
+		vec3 trans = flame.getTrans();
+		float depth = std::max( -trans.z, 0.0001f );
+		std::ostringstream size, center;
+		size << width << " " << height;
+		center << -trans.x << " " << -trans.y;
+
+		node.put( "<xmlattr>.name", "infractus-" + std::to_string( f ) );
+		node.put( "<xmlattr>.size", size.str() );
+		node.put( "<xmlattr>.center", center.str() );
+		node.put( "<xmlattr>.scale", height * .5f/depth/std::tan( HalfFieldOfView ) );
+
+		for( int i = 0; i < flame.getXformCount(); i++ )
+		{
+			Xform xform = flame.getXform( i );
+			boost::property_tree::ptree& child = node.add( "xform", "" );
+			child.put( "<xmlattr>.weight", xform.getDensity() );
+			child.put( "<xmlattr>.color", xform.getColor() );
+			child.put( "<xmlattr>.color_speed", xform.getColorSpeed() );
+			child.put( "<xmlattr>.symmetry", 1 - 2 * xform.getColorSpeed() );
+			child.put( "<xmlattr>.opacity", xform.getOpacity() );
+			child.put( "<xmlattr>.coefs", writeCoefficients( xform.getAffine() ) );
+			child.put( "<xmlattr>.post", writeCoefficients( xform.getPost() ) );
+
+			// parameters are named after their variation, so only write the ones of variations in use
+			for( const std::string& variation: variations_ )
+			{
+				if( !xform.hasVariation( variation ) )
+					continue;
+
+				child.put( "<xmlattr>." + variation, xform.getVariationWeight( variation ) );
+				for( const std::string& parameter: parameters_ )
+					if( parameter.compare( 0, variation.size() + 1, variation + "_" ) == 0 )
+						child.put( "<xmlattr>." + parameter, xform.getParameter( parameter ) );
+			}
+		}
+
+		for( int i = 0; i < 256; i++ )
+		{
+			vec4 colour = flame.getPaletteEntry( i * PaletteSize/256 );
+			std::ostringstream rgb;
+			rgb << int( std::min( std::max( colour.x, 0.0f ), 1.0f ) * 255 + .5f ) << " "
+				<< int( std::min( std::max( colour.y, 0.0f ), 1.0f ) * 255 + .5f ) << " "
+				<< int( std::min( std::max( colour.z, 0.0f ), 1.0f ) * 255 + .5f );
+
+			boost::property_tree::ptree& child = node.add( "color", "" );
+			child.put( "<xmlattr>.index", i );
+			child.put( "<xmlattr>.rgb", rgb.str() );
+		}
+	}
+
+	try
+	{
+		write_xml( path, tree, std::locale(), boost::property_tree::xml_writer_make_settings<std::string>( '\t', 1 ) );
+	}
+	catch( const boost::property_tree::xml_parser_error& error )
+	{
+		printf("Cannot write the flames to %s: %s\n", path.c_str(), error.what());
+		exit(1);
+	}
+}
@@ -0,0 +1,1162 @@
+#include "FlameRenderer.hpp"
+#include "Flame.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace libcompute;
+
+/** A walker's random numbers, taken one lane of a RandomStream at a time. */
+struct FlameRenderer::Walker
+{
+	Walker( uint64_t seed )
+	: stream(seed)
+	, used(RandomStream::Lanes)
+	{
+	}
+
+	/** Gets a number uniform over [0, 1), like randFloat() in the GLSL engine. */
+	double random()
+	{
+		if( used == RandomStream::Lanes )
+		{
+			numbers = stream.next();
+			used = 0;
+		}
+		return (numbers[used++] >> 8) * (1.0/16777216);
+	}
+
+	RandomStream stream;
+	RandomStream::Vector numbers;
+	int used;
+};
+
+namespace
+{
+
+/** Points each walker draws before it starts again from a random point. */
+const size_t BatchSize = 10000;
+
+/** Bins of a histogram summed by one task of the reduction. */
+const size_t ReduceChunk = 1 << 16;
+
+const double PI = 3.14159265358979323846264;
+const double SQRT_2 = 1.4142135623730950488;
+const double EPS = 2e-24;
+const double LOG_10 = 2.302585092994045684017991454684360;
+
+/** Tells if a coordinate has run off, like BADVALUE() in ifs.frag. */
+inline bool badValue( double value )
+{
+	return value != value || value > 1e10 || value < -1e10;
+}
+
+/** GLSL's mod(), which unlike fmod() always takes the sign of \a y. */
+inline double mod( double x, double y )
+{
+	return x - y * std::floor(x/y);
+}
+
+inline double fract( double value )
+{
+	return value - std::floor(value);
+}
+
+};
+
+namespace variations
+{
+
+typedef FlameRenderer::Input Input;
+
+// the parameters of each variation are read in the order the table below lists them
+
+void linear( const Input& in, double& x, double& y )
+{
+	x += in.weight * in.x;
+	y += in.weight * in.y;
+}
+
+void sinusoidal( const Input& in, double& x, double& y )
+{
+	x += in.weight * sin(in.x);
+	y += in.weight * sin(in.y);
+}
+
+void spherical( const Input& in, double& x, double& y )
+{
+	double scale = in.weight/(in.rSq + EPS);
+	x += scale * in.x;
+	y += scale * in.y;
+}
+
+void swirl( const Input& in, double& x, double& y )
+{
+	double sinRsq = sin(in.rSq), cosRsq = cos(in.rSq);
+	x += in.weight * (sinRsq * in.x - cosRsq * in.y);
+	y += in.weight * (cosRsq * in.x + sinRsq * in.y);
+}
+
+void horseshoe( const Input& in, double& x, double& y )
+{
+	double scale = in.weight/(in.r + EPS);
+	x += scale * (in.x - in.y) * (in.x + in.y);
+	y += scale * 2 * in.x * in.y;
+}
+
+void polar( const Input& in, double& x, double& y )
+{
+	x += in.weight * in.a/PI;
+	y += in.weight * (in.r - 1);
+}
+
+void handkerchief( const Input& in, double& x, double& y )
+{
+	x += in.weight * in.r * sin(in.a + in.r);
+	y += in.weight * in.r * cos(in.a - in.r);
+}
+
+void heart( const Input& in, double& x, double& y )
+{
+	x += in.weight * in.r * sin(in.a * in.r);
+	y -= in.weight * in.r * cos(in.a * in.r);
+}
+
+void disc( const Input& in, double& x, double& y )
+{
+	x += in.weight * in.a * sin(PI * in.r);
+	y += in.weight * in.a * cos(PI * in.r);
+}
+
+void spiral( const Input& in, double& x, double& y )
+{
+	double scale = in.weight/(in.r + EPS);
+	x += scale * (cos(in.a) + sin(in.r));
+	y += scale * (sin(in.a) - cos(in.r));
+}
+
+void hyperbolic( const Input& in, double& x, double& y )
+{
+	x += in.weight * sin(in.a)/(in.r + EPS);
+	y += in.weight * (in.r + EPS) * cos(in.a);
+}
+
+void diamond( const Input& in, double& x, double& y )
+{
+	x += in.weight * sin(in.a) * cos(in.r);
+	y += in.weight * cos(in.a) * sin(in.r);
+}
+
+void ex( const Input& in, double& x, double& y )
+{
+	double m0 = sin(in.a + in.r), m1 = cos(in.a - in.r);
+	m0 = m0 * m0 * m0;
+	m1 = m1 * m1 * m1;
+	x += in.weight * (m0 + m1);
+	y += in.weight * (m0 - m1);
+}
+
+void julia( const Input& in, double& x, double& y )
+{
+	double ja = in.a/2;
+	if( in.walker->random() > .5 ) ja += PI;
+	x += in.weight * sqrt(in.r) * cos(ja);
+	y += in.weight * sqrt(in.r) * sin(ja);
+}
+
+void bent( const Input& in, double& x, double& y )
+{
+	x += in.weight * ((in.x >= 0)? in.x: 2 * in.x);
+	y += in.weight * ((in.y >= 0)? in.x: .5 * in.x);
+}
+
+void waves( const Input& in, double& x, double& y )
+{
+	const double* affine = in.affine;
+	x += in.weight * (in.x + affine[1] * sin(in.y/(affine[2] * affine[2] + EPS)));
+	y += in.weight * (in.y + affine[4] * sin(in.x/(affine[5] * affine[5] + EPS)));
+}
+
+void fisheye( const Input& in, double& x, double& y )
+{
+	double scale = in.weight * 2/(in.r + 1);
+	x += scale * in.y;
+	y += scale * in.x;
+}
+
+void popcorn( const Input& in, double& x, double& y )
+{
+	x += in.weight * (in.x + in.affine[2] * sin(tan(3 * in.y)));
+	y += in.weight * (in.y + in.affine[5] * sin(tan(3 * in.x)));
+}
+
+void exponential( const Input& in, double& x, double& y )
+{
+	double scale = in.weight * exp(in.x - 1);
+	x += scale * cos(PI * in.y);
+	y += scale * sin(PI * in.y);
+}
+
+void power( const Input& in, double& x, double& y )
+{
+	double scale = in.weight * pow(in.r, sin(in.a));
+	x += scale * cos(in.a);
+	y += scale * sin(in.a);
+}
+
+void cosine( const Input& in, double& x, double& y )
+{
+	x += in.weight * cos(PI * in.x) * cosh(in.y);
+	y -= in.weight * sin(PI * in.x) * sinh(in.y);
+}
+
+void rings( const Input& in, double& x, double& y )
+{
+	double cSq = in.affine[2] * in.affine[2] + EPS;
+	double scale = in.weight * (mod(in.r + cSq, 2 * cSq) - cSq + in.r * (1 - cSq));
+	x += scale * cos(in.a);
+	y += scale * sin(in.a);
+}
+
+void fan( const Input& in, double& x, double& y )
+{
+	// the GLSL multiplies by a bool here; flam3 turns by half the fan either way
+	double cSq = PI * (in.affine[2] * in.affine[2] + EPS);
+	double fa = in.a + ((mod(in.a + in.affine[5], cSq) > cSq/2)? -cSq/2: cSq/2);
+	x += in.weight * in.r * cos(fa);
+	y += in.weight * in.r * sin(fa);
+}
+
+void blob( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	// 1/2 is an integer division in the GLSL, so only the sine is left
+	double br = in.r * (p[0] + (p[1] - p[0]) * (sin(p[2] * in.a)/2));
+	x += in.weight * br * sin(in.a);
+	y += in.weight * br * cos(in.a);
+}
+
+void pdj( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	x += in.weight * (sin(p[0] * in.y) - cos(p[1] * in.x));
+	y += in.weight * (sin(p[2] * in.x) - cos(p[3] * in.y));
+}
+
+void fan2( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double f2x = (p[0] * p[0] + EPS) * PI;
+	double ft = in.a + p[1] - f2x * floor((in.t + p[1])/f2x);
+	double fa = (ft > f2x/2)? in.a - f2x/2: in.a + f2x/2;
+	x += in.weight * in.r * sin(fa);
+	y += in.weight * in.r * cos(fa);
+}
+
+void rings2( const Input& in, double& x, double& y )
+{
+	double r2v = in.parameters[0] * in.parameters[0] + EPS;
+	double rr = in.r - 2 * r2v * floor((in.r + r2v)/(2 * r2v)) + in.r * (1 - r2v);
+	x += in.weight * rr * sin(in.a);
+	y += in.weight * rr * cos(in.a);
+}
+
+void eyefish( const Input& in, double& x, double& y )
+{
+	double scale = in.weight * 2/(in.r + 1);
+	x += scale * in.x;
+	y += scale * in.y;
+}
+
+void bubble( const Input& in, double& x, double& y )
+{
+	double scale = in.weight/(in.rSq * .25 + 1);
+	x += scale * in.x;
+	y += scale * in.y;
+}
+
+void cylinder( const Input& in, double& x, double& y )
+{
+	x += in.weight * sin(in.x);
+	y += in.weight * in.y;
+}
+
+void perspective( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double scale = in.weight * p[1] * cos(p[0] * PI/2)/(p[1] * in.x * sin(p[0] * PI/2));
+	x += scale * in.x;
+	y += scale * in.y;
+}
+
+void julian( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double jt = (in.t + 2 * PI * fract(std::abs(p[0]) * in.walker->random()))/p[0];
+	double scale = in.weight * pow(in.r, p[1]/p[0]);
+	x += scale * cos(jt);
+	y += scale * sin(jt);
+}
+
+void juliascope( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double sign = (in.walker->random() > .5)? -1: 1;
+	double jt = (sign * in.t + 2 * PI * fract(std::abs(p[0]) * in.walker->random()))/p[0];
+	double scale = in.weight * pow(in.r, p[1]/p[0]);
+	x += scale * cos(jt);
+	y += scale * sin(jt);
+}
+
+void ngon( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double rFactor = pow(in.rSq, p[1]/2);
+	double b = 2 * PI/p[0];
+
+	double phi = mod(in.t, b);
+	if( phi > b/2 )
+		phi -= b;
+
+	double scale = in.weight * (p[3] * (1/(cos(phi) + EPS) - 1) + p[2])/(rFactor + EPS);
+	x += scale * in.x;
+	y += scale * in.y;
+}
+
+void curl( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double re = 1 + p[0] * in.x + p[1] * in.x * in.x - in.y * in.y;
+	double im = p[0] * in.y + 2 * p[1] * in.x * in.y;
+
+	double scale = in.weight/(re * re + im * im);
+	x += scale * (in.x * re - in.y * im);
+	y += scale * (in.y * re - in.x * im);
+}
+
+void rectangles( const Input& in, double& x, double& y )
+{
+	// the GLSL assigns rx twice and never ry; flam3 folds each axis on its own
+	const float* p = in.parameters;
+	double rx = (p[0] == 0)? in.x: (2 * floor(in.x/p[0]) + 1) * p[0] - in.x;
+	double ry = (p[1] == 0)? in.y: (2 * floor(in.y/p[1]) + 1) * p[1] - in.y;
+	x += in.weight * rx;
+	y += in.weight * ry;
+}
+
+void arch( const Input& in, double& x, double& y )
+{
+	double ang = in.walker->random() * in.weight * PI;
+	x += in.weight * sin(ang);
+	y += in.weight * tan(ang) * sin(ang);
+}
+
+void tangent( const Input& in, double& x, double& y )
+{
+	x += in.weight * sin(in.y)/cos(in.y);
+	y += in.weight * tan(in.y);
+}
+
+void blade( const Input& in, double& x, double& y )
+{
+	double br = in.walker->random() * in.weight * in.rSq;
+	double sinr = sin(br), cosr = cos(br);
+	x += in.weight * in.x * (cosr + sinr);
+	y += in.weight * in.x * (cosr - sinr);
+}
+
+void secant2( const Input& in, double& x, double& y )
+{
+	// the GLSL adds a bool to the secant; flam3 adds one or takes one away
+	double cr = cos(in.weight * in.rSq);
+	x += in.weight * in.x;
+	y += in.weight * (1/cr + ((cr < 0)? 1: -1));
+}
+
+void twintrian( const Input& in, double& x, double& y )
+{
+	double tr = in.walker->random() * in.weight * in.r;
+	double sinr = sin(tr), cosr = cos(tr);
+
+	double diff = log(sinr * sinr)/LOG_10 + cosr;
+	if( badValue(diff) ) diff = -30;
+
+	x += in.weight * in.x * diff;
+	y += in.weight * in.x * (diff - sinr * PI);
+}
+
+void cross( const Input& in, double& x, double& y )
+{
+	double s = in.x * in.x - in.y * in.y;
+	double scale = in.weight * sqrt(1/(s * s + EPS));
+	x += scale * in.x;
+	y += scale * in.y;
+}
+
+void disc2( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double sinadd = sin(p[1]), cosadd = cos(p[1]);
+
+	double k = 1;
+	if( p[1] > 2 * PI )
+		k = 1 + p[1] - 2 * PI;
+	else if( p[1] < -2 * PI )
+		k = 1 + p[1] + 2 * PI;
+
+	sinadd *= k;
+	cosadd *= k;
+
+	double dt = p[0] * PI * (in.x + in.y);
+	x += in.weight * in.a/PI * (sin(dt) + cosadd);
+	y += in.weight * in.a/PI * (cos(dt) + sinadd);
+}
+
+void superShape( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double st = .25 * (p[1] * in.t + PI);
+	double t1 = pow(std::abs(sin(st)), p[3]);
+	double t2 = pow(std::abs(cos(st)), p[4]);
+
+	double scale = in.weight * ((p[0] * in.walker->random() + (1 - p[0]) * in.r - p[5]) * pow(t1 + t2, -1/p[2]))/in.r;
+	x += scale * in.x;
+	y += scale * in.y;
+}
+
+void flower( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double scale = in.weight * (in.walker->random() - p[1]) * cos(p[0] * in.t);
+	x += scale * cos(in.t);
+	y += scale * sin(in.t);
+}
+
+void conic( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double scale = in.weight * (in.walker->random() - p[1]) * p[0]/(1 + p[0] * cos(in.t));
+	x += scale * cos(in.t);
+	y += scale * sin(in.t);
+}
+
+void parabola( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double sinR = sin(in.r);
+	x += in.weight * p[0] * sinR * sinR * in.walker->random();
+	y += in.weight * p[1] * cos(in.r) * in.walker->random();
+}
+
+void bent2( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	x += in.weight * ((in.x < 0)? in.x * p[0]: in.x);
+	y += in.weight * ((in.y < 0)? in.y * p[1]: in.y);
+}
+
+void bipolar( const Input& in, double& x, double& y )
+{
+	double x2 = in.x * 2;
+	double by = .5 * atan2(2 * in.y, in.rSq - 1) - .5 * PI * in.parameters[0];
+
+	if( by > PI * .5 )
+		by = -PI * .5 + mod(by - PI * 2, PI);
+	else if( by < -PI * .5 )
+		by = PI * .5 - mod(PI * .5 - by, PI);
+
+	x += in.weight * 2 * PI * .25 * log((in.rSq + x2 + 1)/(in.rSq - x2 + 1));
+	y += in.weight * 2 * PI * by;
+}
+
+void butterfly( const Input& in, double& x, double& y )
+{
+	double wx = in.weight * 1.3029400317411979;
+	double y2 = in.y * 2;
+	double br = wx * sqrt(std::abs(in.y * in.x)/(EPS + in.x * in.x + y2 * y2));
+	x += br * in.x;
+	y += br * y2;
+}
+
+void cell( const Input& in, double& x, double& y )
+{
+	double size = in.parameters[0];
+	double invSize = 1/size;
+
+	int cx = int(floor(in.x * invSize));
+	int cy = int(floor(in.y * invSize));
+
+	double dx = in.x - cx * size;
+	double dy = in.y - cy * size;
+
+	cx = (cx >= 0)? cx * 2: -(2 * cx + 1);
+	cy = (cy >= 0)? cy * 2: -(2 * cy + 1);
+
+	x += in.weight * (dx + cx * size);
+	y += in.weight * (dy + cy * size);
+}
+
+void cpow( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double lnr = .5 * log(in.rSq);
+	double va = 2 * PI/p[2];
+	double vc = p[0]/p[2];
+	double vd = p[1]/p[2];
+	double ang = vc * in.t + vd * lnr + va * floor(p[2] * in.walker->random());
+
+	double scale = in.weight * exp(vc * lnr - vd * in.a);
+	x += scale * cos(ang);
+	y += scale * sin(ang);
+}
+
+void curve( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double xlen = std::max( double(p[2]) * p[2], 1e-20 );
+	double ylen = std::max( double(p[3]) * p[3], 1e-20 );
+
+	x += in.weight * (in.x + p[0] * exp(-in.y * in.y/xlen));
+	y += in.weight * (in.y + p[1] * exp(-in.x * in.x/ylen));
+}
+
+void edisc( const Input& in, double& x, double& y )
+{
+	double tmp = in.rSq + 1;
+	double tmp2 = 2 * in.x;
+	double r1 = sqrt(tmp + tmp2);
+	double r2 = sqrt(tmp - tmp2);
+	double xmax = (r1 + r2) * .5;
+	double a1 = log(xmax + sqrt(xmax - 1));
+	double a2 = -acos(in.x/xmax);
+
+	double scale = in.weight/11.57034632;
+	x += scale * cosh(a2) * cos(a1);
+	y += scale * sinh(a2) * sin(a1) * ((in.y > 0)? -1: 1);
+}
+
+void elliptic( const Input& in, double& x, double& y )
+{
+	double tmp = in.rSq + 1;
+	double x2 = 2 * in.x;
+	double xmax = .5 * (sqrt(tmp + x2) + sqrt(tmp - x2));
+	double ea = in.x/xmax;
+	double eb = 1 - ea * ea;
+	double ssx = xmax - 1;
+
+	eb = (eb < 0)? 0: sqrt(eb);
+	ssx = (ssx < 0)? 0: sqrt(ssx);
+
+	double w = in.weight/(PI * .5);
+	x += w * atan2(ea, eb);
+	y += (in.y > 0)? w * log(xmax + ssx): -w * log(xmax + ssx);
+}
+
+void escher( const Input& in, double& x, double& y )
+{
+	double beta = in.parameters[0];
+	double lnr = .5 * log(in.rSq);
+	double vc = .5 * (1 + cos(beta));
+	double vd = .5 * sin(beta);
+	double n = vc * in.a + vd * lnr;
+
+	double scale = in.weight * exp(vc * lnr - vd * in.a);
+	x += scale * cos(n);
+	y += scale * sin(n);
+}
+
+void polar2( const Input& in, double& x, double& y )
+{
+	x += in.weight/PI * in.t;
+	y += in.weight/PI * .5 * log(in.rSq);
+}
+
+void foci( const Input& in, double& x, double& y )
+{
+	double expx = exp(in.x) * .5;
+	double expnx = .25/expx;
+
+	double scale = in.weight/(expx + expnx - cos(in.y));
+	x += scale * (expx - expnx);
+	y += scale * sin(in.y);
+}
+
+void lazysusan( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double lx = in.x - p[0];
+	double ly = in.y - p[1];
+	double lsr = sqrt(lx * lx + ly * ly);
+
+	if( lsr < in.weight )
+	{
+		double lsa = atan2(ly, lx) + p[2] + p[4] * (in.weight - lsr);
+		lsr = in.weight * lsr;
+		x += lsr * cos(lsa) + p[0];
+		y += lsr * sin(lsa) - p[1];
+	}
+	else
+	{
+		lsr = in.weight * (1 + p[3]/lsr);
+		x += lsr * lx + p[0];
+		y += lsr * ly + p[1];
+	}
+}
+
+void loonie( const Input& in, double& x, double& y )
+{
+	double w2 = in.weight * in.weight;
+	double scale = (in.rSq < w2)? in.weight * sqrt(w2/in.rSq - 1): in.weight;
+	x += scale * in.x;
+	y += scale * in.y;
+}
+
+void scry( const Input& in, double& x, double& y )
+{
+	double scale = 1/(in.r * (in.rSq + 1/(in.weight + EPS)));
+	x += scale * in.x;
+	y += scale * in.y;
+}
+
+/** The fraction GLSL's modf() returns, which keeps the sign of \a value. */
+inline double modfFraction( double value )
+{
+	return value - std::trunc(value);
+}
+
+void modulus( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double ax, ay;
+
+	if( in.x > p[0] )
+		ax = -p[0] + modfFraction(in.x + p[0]);
+	else if( in.x < -p[0] )
+		ax = p[0] - modfFraction(p[0] - in.x);
+	else ax = in.x;
+
+	if( in.y > p[1] )
+		ay = -p[1] + modfFraction(in.y + p[1]);
+	else if( in.y < -p[1] )
+		ay = p[1] - modfFraction(p[1] - in.y);
+	else ay = in.y;
+
+	x += ax * in.weight;
+	y += ay * in.weight;
+}
+
+void stripes( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double roundx = floor(in.x + .5);
+	double offsetx = in.x - roundx;
+
+	x += in.weight * (offsetx * (1 - p[0]) + roundx);
+	y += in.weight * (in.y + offsetx * offsetx * p[1]);
+}
+
+void treeRoot( const Input& in, double& x, double& y )
+{
+	double vx, vy;
+	if( in.walker->random() < .5 )
+	{
+		vx = in.y/SQRT_2 + 1.5;
+		vy = -in.x/SQRT_2 + 1.5;
+	}
+	else
+	{
+		vx = -in.y/SQRT_2 + .5;
+		vy = in.x/SQRT_2 + .5;
+	}
+
+	double scale = in.weight;
+	if( in.walker->random() >= .5 )
+		scale /= (vx - 2) * (vx - 2) + vy * vy;
+
+	x += scale * (vx - 2);
+	y += scale * vy;
+}
+
+void whorl( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double wa = in.a + ((in.r < in.weight)? p[0]: p[1])/(in.weight - in.r);
+	x += in.weight * in.r * cos(wa);
+	y += in.weight * in.r * sin(wa);
+}
+
+void waves2( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	x += in.weight * (in.x + p[0] * sin(in.y * p[2]));
+	y += in.weight * (in.y + p[1] * sin(in.x * p[3]));
+}
+
+void regular( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double rot = (2 * PI)/p[0];
+	double ra = floor(in.walker->random() * p[0]) * rot;
+
+	x += in.weight * (p[1] * cos(ra) * (1 - p[2]) + in.x * p[2]);
+	y += in.weight * (p[1] * sin(ra) * (1 - p[2]) + in.y * p[2]);
+}
+
+void rectangular( const Input& in, double& x, double& y )
+{
+	x += in.weight * in.x * cos(in.y);
+	y += in.weight * in.x * sin(in.y);
+}
+
+void auger( const Input& in, double& x, double& y )
+{
+	const float* p = in.parameters;
+	double s = sin(p[2] * in.x);
+	double t = sin(p[2] * in.y);
+	double dy = in.y + p[1] * (p[3] * s/2 + std::abs(in.y) * s);
+	double dx = in.x + p[1] * (p[3] * t/2 + std::abs(in.x) * t);
+
+	x += in.weight * (in.x + p[0] * (dx - in.x));
+	y += in.weight * dy;
+}
+
+};
+
+const FlameRenderer::Variation FlameRenderer::variationTable_[] =
+{
+	{ "linear", &variations::linear, {} },
+	{ "sinusoidal", &variations::sinusoidal, {} },
+	{ "spherical", &variations::spherical, {} },
+	{ "swirl", &variations::swirl, {} },
+	{ "horseshoe", &variations::horseshoe, {} },
+	{ "polar", &variations::polar, {} },
+	{ "handkerchief", &variations::handkerchief, {} },
+	{ "heart", &variations::heart, {} },
+	{ "disc", &variations::disc, {} },
+	{ "spiral", &variations::spiral, {} },
+	{ "hyperbolic", &variations::hyperbolic, {} },
+	{ "diamond", &variations::diamond, {} },
+	{ "ex", &variations::ex, {} },
+	{ "julia", &variations::julia, {} },
+	{ "bent", &variations::bent, {} },
+	{ "waves", &variations::waves, {} },
+	{ "fisheye", &variations::fisheye, {} },
+	{ "popcorn", &variations::popcorn, {} },
+	{ "exponential", &variations::exponential, {} },
+	{ "power", &variations::power, {} },
+	{ "cosine", &variations::cosine, {} },
+	{ "rings", &variations::rings, {} },
+	{ "fan", &variations::fan, {} },
+	{ "blob", &variations::blob, { "blob_low", "blob_high", "blob_waves" } },
+	{ "pdj", &variations::pdj, { "pdj_a", "pdj_b", "pdj_c", "pdj_d" } },
+	{ "fan2", &variations::fan2, { "fan2_x", "fan2_y" } },
+	{ "rings2", &variations::rings2, { "rings2_val" } },
+	{ "eyefish", &variations::eyefish, {} },
+	{ "bubble", &variations::bubble, {} },
+	{ "cylinder", &variations::cylinder, {} },
+	{ "perspective", &variations::perspective, { "perspective_angle", "perspective_dist" } },
+	{ "julian", &variations::julian, { "julian_power", "julian_dist" } },
+	{ "juliascope", &variations::juliascope, { "juliascope_power", "juliascope_dist" } },
+	{ "ngon", &variations::ngon, { "ngon_sides", "ngon_power", "ngon_circle", "ngon_corners" } },
+	{ "curl", &variations::curl, { "curl_c1", "curl_c2" } },
+	{ "rectangles", &variations::rectangles, { "rectangles_x", "rectangles_y" } },
+	{ "arch", &variations::arch, {} },
+	{ "tangent", &variations::tangent, {} },
+	{ "blade", &variations::blade, {} },
+	{ "secant2", &variations::secant2, {} },
+	{ "twintrian", &variations::twintrian, {} },
+	{ "cross", &variations::cross, {} },
+	{ "disc2", &variations::disc2, { "disc2_rot", "disc2_twist" } },
+	{ "super_shape", &variations::superShape, { "super_shape_rnd", "super_shape_m", "super_shape_n1",
+		"super_shape_n2", "super_shape_n3", "super_shape_holes" } },
+	{ "flower", &variations::flower, { "flower_petals", "flower_holes" } },
+	{ "conic", &variations::conic, { "conic_eccentricity", "conic_holes" } },
+	{ "parabola", &variations::parabola, { "parabola_height", "parabola_width" } },
+	{ "bent2", &variations::bent2, { "bent2_x", "bent2_y" } },
+	{ "bipolar", &variations::bipolar, { "bipolar_shift" } },
+	{ "butterfly", &variations::butterfly, {} },
+	{ "cell", &variations::cell, { "cell_size" } },
+	{ "cpow", &variations::cpow, { "cpow_r", "cpow_i", "cpow_power" } },
+	{ "curve", &variations::curve, { "curve_xamp", "curve_yamp", "curve_xlength", "curve_ylength" } },
+	{ "edisc", &variations::edisc, {} },
+	{ "elliptic", &variations::elliptic, {} },
+	{ "escher", &variations::escher, { "escher_beta" } },
+	{ "polar2", &variations::polar2, {} },
+	{ "foci", &variations::foci, {} },
+	{ "lazysusan", &variations::lazysusan, { "lazysusan_x", "lazysusan_y", "lazysusan_spin",
+		"lazysusan_space", "lazysusan_twist" } },
+	{ "loonie", &variations::loonie, {} },
+	{ "scry", &variations::scry, {} },
+	{ "modulus", &variations::modulus, { "modulus_x", "modulus_y" } },
+	{ "stripes", &variations::stripes, { "stripes_space", "stripes_warp" } },
+	{ "tree_root", &variations::treeRoot, {} },
+	{ "whorl", &variations::whorl, { "whorl_inside", "whorl_outside" } },
+	{ "waves2", &variations::waves2, { "waves2_scalex", "waves2_scaley", "waves2_freqx", "waves2_freqy" } },
+	{ "regular", &variations::regular, { "regular_power", "regular_dist", "regular_speed" } },
+	{ "rectangular", &variations::rectangular, {} },
+	{ "auger", &variations::auger, { "auger_sym", "auger_weight", "auger_freq", "auger_scale" } },
+	{ 0, 0, {} },
+};
+
+FlameRenderer::FlameRenderer()
+: background_(0, 0, 0, 0)
+, fuseIterations_(15)
+{
+	setCamera( vec3(0, 0, 0), vec3(0, 0, 0), vec3(1, 1, 1) );
+}
+
+void FlameRenderer::addVariation( const std::string& name )
+{
+	for( const Variation* variation = variationTable_; variation->name; variation++ )
+		if( name == variation->name )
+		{
+			variations_.push_back( variation );
+			return;
+		}
+
+	printf("FlameRenderer has no native version of the variation %s.\n", name.c_str());
+	exit(1);
+}
+
+void FlameRenderer::addParameter( const std::string& name )
+{
+	parameters_.push_back( name );
+}
+
+namespace
+{
+
+void multiply( double (&matrix)[4][4], const double (&by)[4][4] )
+{
+	double result[4][4];
+	for( int row = 0; row < 4; row++ )
+		for( int column = 0; column < 4; column++ )
+		{
+			result[row][column] = 0;
+			for( int k = 0; k < 4; k++ )
+				result[row][column] += matrix[row][k] * by[k][column];
+		}
+
+	std::copy( &result[0][0], &result[0][0] + 16, &matrix[0][0] );
+}
+
+/** Multiplies \a matrix by a rotation of \a degrees about the axis \a axis, like glRotatef(). */
+void rotate( double (&matrix)[4][4], double degrees, int axis )
+{
+	double angle = degrees * PI/180;
+	double c = cos(angle), s = sin(angle);
+	int i = (axis + 1) % 3, j = (axis + 2) % 3;
+
+	double rotation[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+	rotation[i][i] = c;
+	rotation[i][j] = -s;
+	rotation[j][i] = s;
+	rotation[j][j] = c;
+	multiply( matrix, rotation );
+}
+
+};
+
+void FlameRenderer::setCamera( vec3 translation, vec3 rotation, vec3 scale )
+{
+	double modelView[4][4] =
+	{
+		{ scale.x, 0, 0, scale.x * translation.x },
+		{ 0, scale.y, 0, scale.y * translation.y },
+		{ 0, 0, scale.z, scale.z * translation.z },
+		{ 0, 0, 0, 1 },
+	};
+
+	rotate( modelView, rotation.x, 0 );
+	rotate( modelView, rotation.y, 1 );
+	rotate( modelView, rotation.z, 2 );
+
+	for( int row = 0; row < 3; row++ )
+		for( int column = 0; column < 4; column++ )
+			camera_[row][column] = modelView[row][column];
+}
+
+int FlameRenderer::getWalkerCount() const
+{
+	return int(ThreadPool::shared().size());
+}
+
+void FlameRenderer::readFlame( Program& program )
+{
+	Parameter& matsParameter = program.getParameter("mats");
+	Parameter& varsParameter = program.getParameter("vars");
+	Parameter& varParamParameter = program.getParameter("varParam");
+
+	unsigned int count = std::min( (unsigned int)std::max( int(program.getParameter("matCount")), 0 ), matsParameter.size() );
+	readXforms( matsParameter, program.getParameter("colSpeeds"), program.getParameter("varOffsets"), varsParameter, varParamParameter,
+		count, varsParameter.size(), varParamParameter.size()/matsParameter.size() );
+
+	Engine::DataStorage::Ptr palette = program.getStorage( Program::Input, 1 );
+	Engine::DataStorage::Info info = palette->getInfo();
+	palette_.resize( size_t(info.width) * info.height * 4 );
+	palette->toArray( &palette_[0] );
+}
+
+void FlameRenderer::readFlame( const Flame& flame )
+{
+	unsigned int paramMats = (unsigned int)(parameters_.size() + 15)/16;
+	unsigned int varCount = Flame::MaxXforms * (unsigned int)(variations_.size() + 1);
+
+	std::vector<mat4> mats( Flame::MaxXforms );
+	std::vector<float> colSpeeds( Flame::MaxXforms );
+	std::vector<int> varOffsets( Flame::MaxXforms );
+	std::vector<vec2> vars( varCount );
+	std::vector<mat4> varParams( Flame::MaxXforms * std::max( paramMats, 1u ) );
+
+	int count = flame.writeParameters( &mats[0], &colSpeeds[0], &varOffsets[0], &vars[0], &varParams[0], Flame::MaxXforms, varCount, paramMats );
+	readXforms( &mats[0], &colSpeeds[0], &varOffsets[0], &vars[0], &varParams[0], count, varCount, paramMats );
+
+	palette_.resize( Flame::PaletteSize * 4 );
+	flame.writePalette( &palette_[0], palette_.size() );
+}
+
+void FlameRenderer::readXforms( const mat4* mats, const float* colSpeeds, const int* varOffsets, const vec2* vars, const mat4* varParams,
+	unsigned int count, unsigned int varCount, unsigned int paramMats )
+{
+	xforms_.resize( count );
+	terms_.clear();
+
+	double density = 0;
+	for( unsigned int i = 0; i < count; i++ )
+	{
+		mat4 mat = mats[i];
+		Xform& xform = xforms_[i];
+
+		for( int k = 0; k < 3; k++ )
+		{
+			xform.affine[k] = mat(0, k);
+			xform.affine[k + 3] = mat(1, k);
+			xform.post[k] = mat(2, k);
+			xform.post[k + 3] = mat(3, k);
+		}
+
+		// the xforms are picked by where a random number falls in the running sum of their densities
+		density += mat(3, 3);
+		xform.density = density;
+		xform.color = mat(0, 3);
+		xform.colorSpeed = colSpeeds[i];
+		xform.opacity = mat(1, 3);
+		xform.linear = varOffsets[i] < 0;
+		xform.firstTerm = terms_.size();
+
+		for( unsigned int v = std::max( varOffsets[i], 0 ); !xform.linear && v < varCount && vars[v].x >= 0; v++ )
+		{
+			unsigned int index = (unsigned int)std::floor( vars[v].x );
+			if( index >= variations_.size() )
+			{
+				printf("FlameRenderer has %u variations, so it cannot run variation %u; add them all in VariationTable order.\n",
+					(unsigned int)variations_.size(), index);
+				exit(1);
+			}
+
+			const Variation* variation = variations_[index];
+			Term term;
+			term.function = variation->function;
+			term.weight = vars[v].y;
+
+			for( int k = 0; k < MaxParameters; k++ )
+			{
+				term.parameters[k] = 0;
+				if( !variation->parameters[k] )
+					continue;
+
+				size_t at = std::find( parameters_.begin(), parameters_.end(), variation->parameters[k] ) - parameters_.begin();
+				if( at < parameters_.size() && at/16 < paramMats )
+				{
+					mat4 values = varParams[i * paramMats + at/16];
+					term.parameters[k] = values(at % 16 / 4, at % 4);
+				}
+			}
+
+			terms_.push_back( term );
+		}
+
+		xform.lastTerm = terms_.size();
+	}
+}
+
+void FlameRenderer::walk( Walker& walker, size_t samples, std::vector<double>& histogram, unsigned int width, unsigned int height ) const
+{
+	if( xforms_.empty() || palette_.empty() )
+		return;
+
+	// a gluPerspective() of 45 degrees, as the ThreeD drawing mode sets up, taken straight to pixels
+	double focal = 1/tan(22.5 * PI/180) * height * .5;
+	double densitySum = xforms_.back().density;
+	int paletteSize = int(palette_.size()/4);
+
+	size_t batches = (samples + BatchSize - 1)/BatchSize;
+	size_t steps = samples + batches * fuseIterations_;
+
+	FlameRenderer::Input input;
+	input.walker = &walker;
+
+	double x = 0, y = 0, color = .5;
+	int fuse = -1;
+	size_t left = 0;
+	for( size_t step = 0; step < steps; step++ )
+	{
+		if( fuse < 0 || left == 0 )
+		{
+			x = walker.random() * 2 - 1;
+			y = walker.random() * 2 - 1;
+			color = .5;
+			fuse = fuseIterations_;
+			left = BatchSize;
+		}
+
+		double pick = walker.random() * densitySum;
+		size_t chosen = 0;
+		while( chosen + 1 < xforms_.size() && pick >= xforms_[chosen].density )
+			chosen++;
+		const Xform& xform = xforms_[chosen];
+
+		const double* affine = xform.affine;
+		double px = affine[0] * x + affine[1] * y + affine[2];
+		double py = affine[3] * x + affine[4] * y + affine[5];
+
+		double rx = px, ry = py;
+		if( !xform.linear )
+		{
+			rx = ry = 0;
+			input.x = px;
+			input.y = py;
+			input.rSq = px * px + py * py;
+			input.r = sqrt(input.rSq);
+			input.a = atan(px/py);
+			input.t = atan(py/px);
+			input.affine = affine;
+
+			for( size_t i = xform.firstTerm; i < xform.lastTerm; i++ )
+			{
+				const Term& term = terms_[i];
+				input.weight = term.weight;
+				input.parameters = term.parameters;
+				term.function( input, rx, ry );
+			}
+		}
+
+		const double* post = xform.post;
+		x = post[0] * rx + post[1] * ry + post[2];
+		y = post[3] * rx + post[4] * ry + post[5];
+		color += (xform.color - color) * xform.colorSpeed;
+
+		if( badValue(x) || badValue(y) )
+		{
+			fuse = -1;
+			continue;
+		}
+
+		if( fuse > 0 )
+		{
+			fuse--;
+			continue;
+		}
+		left--;
+
+		double eyeX = camera_[0][0] * x + camera_[0][1] * y + camera_[0][3];
+		double eyeY = camera_[1][0] * x + camera_[1][1] * y + camera_[1][3];
+		double depth = -(camera_[2][0] * x + camera_[2][1] * y + camera_[2][3]);
+		if( depth <= 0.0001 )
+			continue;
+
+		double column = width * .5 + eyeX * focal/depth;
+		double row = height * .5 + eyeY * focal/depth;
+		if( column < 0 || row < 0 || column >= width || row >= height )
+			continue;
+
+		// like flam3, points an xform lands with count for its opacity, so helper xforms at 0 draw nothing
+		if( xform.opacity <= 0 )
+			continue;
+
+		int entry = std::min( std::max( int(color * paletteSize), 0 ), paletteSize - 1 );
+		const float* source = &palette_[size_t(entry) * 4];
+		double* bin = &histogram[(size_t(row) * width + size_t(column)) * 4];
+		bin[0] += source[0] * xform.opacity;
+		bin[1] += source[1] * xform.opacity;
+		bin[2] += source[2] * xform.opacity;
+		bin[3] += source[3] * xform.opacity;
+	}
+}
+
+void FlameRenderer::reduce( size_t size )
+{
+	ThreadPool& pool = ThreadPool::shared();
+	unsigned int chunks = (size + ReduceChunk - 1)/ReduceChunk;
+
+	// each round adds every other remaining histogram into its neighbour, chunk by chunk
+	for( size_t stride = 1; stride < histograms_.size(); stride *= 2 )
+	{
+		std::vector<size_t> targets;
+		for( size_t i = 0; i + stride < histograms_.size(); i += stride * 2 )
+			targets.push_back( i );
+
+		pool.parallelFor( targets.size() * chunks, [&]( unsigned int job )
+		{
+			size_t target = targets[job / chunks];
+			double* into = &histograms_[target][0];
+			const double* from = &histograms_[target + stride][0];
+
+			size_t start = size_t(job % chunks) * ReduceChunk;
+			size_t end = std::min( start + ReduceChunk, size );
+			for( size_t i = start; i < end; i++ )
+				into[i] += from[i];
+		});
+	}
+}
+
+void FlameRenderer::render( Program& program, const Engine::DataStorage::Ptr& output, double samples, int seed )
+{
+	Engine::DataStorage::Info info = output->getInfo();
+	if( info.type != Engine::DataStorage::Float || info.size != 4 )
+	{
+		printf("FlameRenderer can only render into storages of four floats per element.\n");
+		exit(1);
+	}
+
+	readFlame( program );
+	accumulate( info.width, info.height, samples, seed );
+	output_.assign( histograms_[0].begin(), histograms_[0].end() );
+	output->fromArray( &output_[0] );
+}
+
+void FlameRenderer::render( const Flame& flame, std::vector<float>& output, unsigned int width, unsigned int height, double samples, int seed )
+{
+	readFlame( flame );
+	accumulate( width, height, samples, seed );
+	output.assign( histograms_[0].begin(), histograms_[0].end() );
+}
+
+void FlameRenderer::accumulate( unsigned int width, unsigned int height, double samples, int seed )
+{
+	unsigned int walkers = getWalkerCount();
+	size_t size = size_t(width) * height * 4;
+	size_t total = (samples > 0)? size_t(samples): 0;
+	histograms_.resize( walkers );
+
+	ThreadPool::shared().parallelFor( walkers, [&]( unsigned int index )
+	{
+		std::vector<double>& histogram = histograms_[index];
+		histogram.assign( size, 0 );
+
+		// the first histogram ends up holding the sum, so it starts out as the background
+		if( index == 0 )
+			for( size_t i = 0; i < size; i += 4 )
+			{
+				histogram[i] = background_.x;
+				histogram[i + 1] = background_.y;
+				histogram[i + 2] = background_.z;
+				histogram[i + 3] = background_.w;
+			}
+
+		Walker walker( (uint64_t(unsigned(seed)) << 32) ^ (uint64_t(index) * 0x9e3779b97f4a7c15ULL) );
+		walk( walker, total/walkers + (index < total % walkers), histogram, width, height );
+	});
+
+	reduce( size );
+}
@@ -6,6 +6,8 @@
 
 #include "Singleton.hpp"
 
+#include <libcompute.hpp>
+
 char *file2string(const char *path)
 {
 	FILE *fd;
@@ -127,6 +129,8 @@ void GraphicsSystem::init()
 		throw std::exception();
 	}
 
+	// without it GLEW skips the core entry points on core profile contexts
+	glewExperimental = GL_TRUE;
 	glewInit();
 
 	//fontId = DT_LoadFont("images/ConsoleFont.bmp", TRANS_FONT );
@@ -313,6 +317,8 @@ Texture GraphicsSystem::loadTexture( const std::string& filename )
 
 void GraphicsSystem::freeTexture( Texture& texture )
 {
+	// engines may have wrapped the texture with fromTexture and keep framebuffers for it
+	libcompute::Engine::forgetTexture( texture.location );
 	glDeleteTextures( 1, &texture.location );
 	texture.location = 0;
 }
@@ -428,6 +434,14 @@ Texture GraphicsSystem::createBufferTexture( unsigned int width, unsigned int he
 	return bufferTexture;
 }
 
+void GraphicsSystem::updateBufferTexture( const Texture& texture, const void* pixels, bool isFloat )
+{
+	glBindTexture( GL_TEXTURE_2D, texture.location );
+	glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, texture.w, texture.h, GL_RGBA,
+			isFloat? GL_FLOAT: GL_UNSIGNED_BYTE, pixels );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+}
+
 void GraphicsSystem::drawToTexture( Texture texture )
 {
 	if( texture == Texture() )
@@ -0,0 +1,427 @@
+#include "HashLife.hpp"
+
+#include <algorithm>
+
+using namespace libcompute;
+
+HashLife::HashLife()
+: generation_(0)
+, nodeLimit_(1 << 22)
+{
+	rehash( 1 << 16 );
+	setRules( 1 << 3, (1 << 2) | (1 << 3) );
+	root_ = empty(5);
+}
+
+void HashLife::setRules( int birthRules, int liveRules )
+{
+	if( birthRules & 1 )
+		printf("HashLife cannot run rules where cells are born without neighbours; ignoring B0.\n");
+
+	for( int count = 0; count <= 8; count++ )
+	{
+		birth_[count] = (count > 0 && ((birthRules >> count) & 1))? 0xffffffff: 0;
+		live_[count] = ((liveRules >> count) & 1)? 0xffffffff: 0;
+	}
+
+	for( size_t i = 0; i < nodes_.size(); i++ )
+		nodes_[i].result = None;
+}
+
+uint64_t HashLife::hash( const Node& node )
+{
+	uint64_t hash = node.level == 3? node.bits: node.children[0];
+	if( node.level != 3 )
+	{
+		hash = hash * 0x9e3779b97f4a7c15ULL + node.children[1];
+		hash = hash * 0x9e3779b97f4a7c15ULL + node.children[2];
+		hash = hash * 0x9e3779b97f4a7c15ULL + node.children[3];
+	}
+	hash ^= hash >> 29;
+	hash *= 0xbf58476d1ce4e5b9ULL;
+	return hash ^ (hash >> 32);
+}
+
+void HashLife::rehash( size_t size )
+{
+	table_.assign( size, None );
+	size_t mask = size - 1;
+	for( size_t i = 0; i < nodes_.size(); i++ )
+	{
+		size_t slot = hash( nodes_[i] ) & mask;
+		while( table_[slot] != None )
+			slot = (slot + 1) & mask;
+		table_[slot] = Index(i);
+	}
+}
+
+HashLife::Index HashLife::intern( const Node& node )
+{
+	if( (nodes_.size() + 1) * 2 > table_.size() )
+		rehash( table_.size() * 2 );
+
+	size_t mask = table_.size() - 1;
+	size_t slot = hash( node ) & mask;
+	for( ; table_[slot] != None; slot = (slot + 1) & mask )
+	{
+		const Node& other = nodes_[table_[slot]];
+		if( other.level != node.level )
+			continue;
+		if( node.level == 3? other.bits == node.bits:
+			std::equal( node.children, node.children + 4, other.children ) )
+			return table_[slot];
+	}
+
+	table_[slot] = Index(nodes_.size());
+	nodes_.push_back( node );
+	return table_[slot];
+}
+
+HashLife::Index HashLife::leaf( uint64_t bits )
+{
+	Node node;
+	node.bits = bits;
+	node.population = __builtin_popcountll( bits );
+	std::fill( node.children, node.children + 4, None );
+	node.result = None;
+	node.level = 3;
+	node.resultStep = 0;
+	return intern( node );
+}
+
+HashLife::Index HashLife::join( Index northWest, Index northEast, Index southWest, Index southEast )
+{
+	Node node;
+	node.bits = 0;
+	node.population = nodes_[northWest].population + nodes_[northEast].population
+	                + nodes_[southWest].population + nodes_[southEast].population;
+	node.children[NorthWest] = northWest;
+	node.children[NorthEast] = northEast;
+	node.children[SouthWest] = southWest;
+	node.children[SouthEast] = southEast;
+	node.result = None;
+	node.level = nodes_[northWest].level + 1;
+	node.resultStep = 0;
+	return intern( node );
+}
+
+HashLife::Index HashLife::empty( int level )
+{
+	while( int(empty_.size()) <= level )
+	{
+		int next = int(empty_.size());
+		if( next < 3 )
+			empty_.push_back( None );
+		else if( next == 3 )
+			empty_.push_back( leaf(0) );
+		else
+		{
+			Index quadrant = empty_[next - 1];
+			empty_.push_back( join( quadrant, quadrant, quadrant, quadrant ) );
+		}
+	}
+
+	return empty_[level];
+}
+
+HashLife::Index HashLife::centre( Index northWest, Index northEast, Index southWest, Index southEast )
+{
+	if( nodes_[northWest].level > 3 )
+		return join( child( northWest, SouthEast ), child( northEast, SouthWest ),
+		             child( southWest, NorthEast ), child( southEast, NorthWest ) );
+
+	// the centre of four leaves is the inner 4x4 corner of each of them
+	uint64_t quadrants[4] = { nodes_[northWest].bits, nodes_[northEast].bits, nodes_[southWest].bits, nodes_[southEast].bits };
+	uint64_t bits = 0;
+	for( int y = 0; y < 8; y++ )
+	{
+		uint64_t west = quadrants[y < 4? SouthWest: NorthWest];
+		uint64_t east = quadrants[y < 4? SouthEast: NorthEast];
+		int row = (y + 4) % 8;
+		uint64_t line = ((west >> (row * 8 + 4)) & 0xf) | (((east >> (row * 8)) & 0xf) << 4);
+		bits |= line << (y * 8);
+	}
+	return leaf( bits );
+}
+
+HashLife::Index HashLife::centre( Index node )
+{
+	return centre( child( node, NorthWest ), child( node, NorthEast ), child( node, SouthWest ), child( node, SouthEast ) );
+}
+
+HashLife::Index HashLife::expand( Index node )
+{
+	Index border = empty( nodes_[node].level - 1 );
+	return join( join( border, border, border, child( node, NorthWest ) ),
+	             join( border, border, child( node, NorthEast ), border ),
+	             join( border, child( node, SouthWest ), border, border ),
+	             join( child( node, SouthEast ), border, border, border ) );
+}
+
+HashLife::Index HashLife::leafResult( Index node, int generations )
+{
+	// a 16x16 block stepped on rows of bits; every generation the cells
+	// that saw past the edge move in by one, leaving the 8x8 centre for 4
+	uint32_t rows[16];
+	for( int y = 0; y < 16; y++ )
+	{
+		uint64_t west = nodes_[child( node, y < 8? SouthWest: NorthWest )].bits;
+		uint64_t east = nodes_[child( node, y < 8? SouthEast: NorthEast )].bits;
+		int row = y % 8;
+		rows[y] = uint32_t( (west >> (row * 8)) & 0xff ) | (uint32_t( (east >> (row * 8)) & 0xff ) << 8);
+	}
+
+	for( int generation = 0; generation < generations; generation++ )
+	{
+		uint32_t next[16] = { 0 };
+		for( int y = 1; y < 15; y++ )
+		{
+			uint32_t above = rows[y + 1], cell = rows[y], below = rows[y - 1];
+			uint32_t neighbours[8] = { above << 1, above, above >> 1, cell << 1, cell >> 1, below << 1, below, below >> 1 };
+
+			// count the neighbours into four bit planes
+			uint32_t count[4] = { 0, 0, 0, 0 };
+			for( int n = 0; n < 8; n++ )
+			{
+				uint32_t carry = neighbours[n];
+				for( int bit = 0; bit < 4 && carry; bit++ )
+				{
+					uint32_t sum = count[bit] ^ carry;
+					carry &= count[bit];
+					count[bit] = sum;
+				}
+			}
+
+			uint32_t result = 0;
+			for( int n = 0; n <= 8; n++ )
+			{
+				if( !birth_[n] && !live_[n] )
+					continue;
+				uint32_t match = ((n & 1)? count[0]: ~count[0]) & ((n & 2)? count[1]: ~count[1])
+				               & ((n & 4)? count[2]: ~count[2]) & ((n & 8)? count[3]: ~count[3]);
+				result |= match & ((birth_[n] & ~cell) | (live_[n] & cell));
+			}
+			next[y] = result & 0xffff;
+		}
+		std::copy( next, next + 16, rows );
+	}
+
+	uint64_t bits = 0;
+	for( int y = 0; y < 8; y++ )
+		bits |= uint64_t( (rows[y + 4] >> 4) & 0xff ) << (y * 8);
+	return leaf( bits );
+}
+
+HashLife::Index HashLife::result( Index node, int exponent )
+{
+	int level = nodes_[node].level;
+	exponent = std::min( exponent, level - 2 );
+
+	if( nodes_[node].result != None && nodes_[node].resultStep == exponent )
+		return nodes_[node].result;
+
+	Index next;
+	if( nodes_[node].population == 0 )
+		next = empty( level - 1 );
+	else if( level == 4 )
+		next = leafResult( node, 1 << exponent );
+	else
+	{
+		Index northWest = child( node, NorthWest ), northEast = child( node, NorthEast );
+		Index southWest = child( node, SouthWest ), southEast = child( node, SouthEast );
+
+		// nine overlapping blocks of half the size, stepped as far as they can go
+		Index blocks[9] = {
+			northWest,
+			join( child( northWest, NorthEast ), child( northEast, NorthWest ), child( northWest, SouthEast ), child( northEast, SouthWest ) ),
+			northEast,
+			join( child( northWest, SouthWest ), child( northWest, SouthEast ), child( southWest, NorthWest ), child( southWest, NorthEast ) ),
+			centre( node ),
+			join( child( northEast, SouthWest ), child( northEast, SouthEast ), child( southEast, NorthWest ), child( southEast, NorthEast ) ),
+			southWest,
+			join( child( southWest, NorthEast ), child( southEast, NorthWest ), child( southWest, SouthEast ), child( southEast, SouthWest ) ),
+			southEast };
+
+		int first = std::min( exponent, level - 3 );
+		for( int i = 0; i < 9; i++ )
+			blocks[i] = result( blocks[i], first );
+
+		// the four blocks they overlap into are either stepped again, for a
+		// full step, or just have their centres cut out
+		Index quadrants[4];
+		int corners[4] = { 0, 1, 3, 4 };
+		for( int q = 0; q < 4; q++ )
+		{
+			int i = corners[q];
+			if( exponent == level - 2 )
+				quadrants[q] = result( join( blocks[i], blocks[i + 1], blocks[i + 3], blocks[i + 4] ), level - 3 );
+			else
+				quadrants[q] = centre( blocks[i], blocks[i + 1], blocks[i + 3], blocks[i + 4] );
+		}
+
+		next = join( quadrants[0], quadrants[1], quadrants[2], quadrants[3] );
+	}
+
+	nodes_[node].result = next;
+	nodes_[node].resultStep = exponent;
+	return next;
+}
+
+void HashLife::step( int exponent )
+{
+	exponent = std::max( 0, std::min( exponent, int(MaxExponent) ) );
+
+	// the root must be big enough to take the whole step at once, and the
+	// cells have to be in its centre quarter so the step cannot lose any
+	while( nodes_[root_].level < std::max( exponent + 3, 5 ) || nodes_[centre( centre( root_ ) )].population != nodes_[root_].population )
+		root_ = expand( root_ );
+
+	root_ = result( root_, exponent );
+	generation_ += double( uint64_t(1) << exponent );
+
+	if( nodes_.size() > nodeLimit_ )
+		collectGarbage();
+}
+
+void HashLife::collectGarbage()
+{
+	std::vector<char> marked( nodes_.size(), 0 );
+	std::vector<Index> stack( 1, root_ );
+	while( !stack.empty() )
+	{
+		Index node = stack.back();
+		stack.pop_back();
+		if( marked[node] )
+			continue;
+		marked[node] = 1;
+		if( nodes_[node].level > 3 )
+			stack.insert( stack.end(), nodes_[node].children, nodes_[node].children + 4 );
+	}
+
+	// children are always made before their parents, so keeping the order
+	// means every child has already been moved when its parent is
+	std::vector<Index> moved( nodes_.size(), None );
+	size_t kept = 0;
+	for( size_t i = 0; i < nodes_.size(); i++ )
+	{
+		if( !marked[i] )
+			continue;
+
+		Node node = nodes_[i];
+		if( node.level > 3 )
+			for( int q = 0; q < 4; q++ )
+				node.children[q] = moved[node.children[q]];
+		// a result made after its node has not been moved yet, and is dropped
+		node.result = (node.result != None && marked[node.result])? moved[node.result]: None;
+
+		moved[i] = Index(kept);
+		nodes_[kept++] = node;
+	}
+
+	nodes_.resize( kept );
+	root_ = moved[root_];
+	empty_.clear();
+
+	size_t size = 1 << 16;
+	while( size < nodes_.size() * 4 )
+		size *= 2;
+	rehash( size );
+}
+
+double HashLife::getPopulation() const
+{
+	return double(nodes_[root_].population);
+}
+
+HashLife::Index HashLife::build( const std::vector<float>& board, int width, int height, int level, long long x, long long y )
+{
+	long long size = 1LL << level;
+	long long boardLeft = -(width/2), boardBottom = -(height/2);
+	if( x >= boardLeft + width || y >= boardBottom + height || x + size <= boardLeft || y + size <= boardBottom )
+		return empty( level );
+
+	if( level == 3 )
+	{
+		uint64_t bits = 0;
+		for( int j = 0; j < 8; j++ )
+			for( int i = 0; i < 8; i++ )
+			{
+				long long column = x + i - boardLeft, row = y + j - boardBottom;
+				if( column >= 0 && column < width && row >= 0 && row < height && board[(size_t(row) * width + column) * 4] > 0 )
+					bits |= uint64_t(1) << (j * 8 + i);
+			}
+		return leaf( bits );
+	}
+
+	long long half = size/2;
+	Index northWest = build( board, width, height, level - 1, x, y + half );
+	Index northEast = build( board, width, height, level - 1, x + half, y + half );
+	Index southWest = build( board, width, height, level - 1, x, y );
+	Index southEast = build( board, width, height, level - 1, x + half, y );
+	return join( northWest, northEast, southWest, southEast );
+}
+
+void HashLife::setBoard( const Engine::DataStorage::Ptr& storage )
+{
+	Engine::DataStorage::Info info = storage->getInfo();
+	std::vector<float> board( size_t(info.width) * info.height * 4 );
+	storage->toArray( &board[0] );
+
+	int level = 5;
+	while( (1LL << level) < std::max( info.width, info.height ) + 2 )
+		level++;
+
+	root_ = build( board, info.width, info.height, level, -(1LL << (level - 1)), -(1LL << (level - 1)) );
+	generation_ = 0;
+
+	if( nodes_.size() > nodeLimit_ )
+		collectGarbage();
+}
+
+void HashLife::draw( Index node, long long x, long long y, long long left, long long bottom, int width, int height, std::vector<unsigned char>& alive ) const
+{
+	const Node& n = nodes_[node];
+	long long size = 1LL << n.level;
+	if( n.population == 0 || x >= left + width || y >= bottom + height || x + size <= left || y + size <= bottom )
+		return;
+
+	if( n.level == 3 )
+	{
+		for( uint64_t bits = n.bits; bits; bits &= bits - 1 )
+		{
+			int bit = __builtin_ctzll( bits );
+			long long column = x + bit % 8 - left, row = y + bit / 8 - bottom;
+			if( column >= 0 && column < width && row >= 0 && row < height )
+				alive[size_t(row) * width + column] = 1;
+		}
+		return;
+	}
+
+	long long half = size/2;
+	draw( n.children[NorthWest], x, y + half, left, bottom, width, height, alive );
+	draw( n.children[NorthEast], x + half, y + half, left, bottom, width, height, alive );
+	draw( n.children[SouthWest], x, y, left, bottom, width, height, alive );
+	draw( n.children[SouthEast], x + half, y, left, bottom, width, height, alive );
+}
+
+void HashLife::rasterise( const Engine::DataStorage::Ptr& storage, long long left, long long bottom )
+{
+	Engine::DataStorage::Info info = storage->getInfo();
+	std::vector<float> board( size_t(info.width) * info.height * 4 );
+	std::vector<unsigned char> alive( size_t(info.width) * info.height, 0 );
+	storage->toArray( &board[0] );
+
+	long long rootCorner = -(1LL << (nodes_[root_].level - 1));
+	draw( root_, rootCorner, rootCorner, left, bottom, info.width, info.height, alive );
+
+	for( size_t i = 0; i < alive.size(); i++ )
+	{
+		float* element = &board[i * 4];
+		element[0] = alive[i]? std::max( element[0], 0.0f ) + 1: 0;
+		element[1] = 0;
+		element[2] = 0;
+		element[3] = 0;
+	}
+
+	storage->fromArray( &board[0] );
+}
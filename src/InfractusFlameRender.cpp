@@ -0,0 +1,234 @@
+/**
+ * @file InfractusFlameRender.cpp
+ * @brief Renders the flames of flam3 files to images without opening a window.
+ *
+ * Every flame is drawn by FlameRenderer on all the cores of the ThreadPool,
+ * tonemapped like the ifs program does without its density estimation, and
+ * written out before the next one is started, so only one frame is ever
+ * held in memory.
+ */
+
+#include "Flame.hpp"
+#include "FlameRenderer.hpp"
+
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace libcompute;
+
+namespace
+{
+
+struct Options
+{
+	unsigned int width, height;
+	unsigned int oversample;
+	double quality;
+	float brightness, gamma, vibrancy;
+	std::string prefix;
+	std::string variations;
+	std::vector<std::string> files;
+};
+
+void usage( const char* name )
+{
+	printf("usage: %s [options] flames.flam3...\n"
+		"  -s WIDTHxHEIGHT  size of the images (640x480)\n"
+		"  -q QUALITY       points drawn for every pixel (100)\n"
+		"  -x OVERSAMPLE    points are drawn at this many times the size in each direction (1)\n"
+		"  -b BRIGHTNESS    brightness of the log-density tonemapping (4)\n"
+		"  -g GAMMA         gamma applied after it (2.2)\n"
+		"  -V VIBRANCY      how much the gamma follows the density rather than each channel (1)\n"
+		"  -o PREFIX        images are written to PREFIX00000.ppm onwards (flame)\n"
+		"  -v FILE          the variations the flames may use (programs/ifs2/variations.xml)\n", name);
+	exit(1);
+}
+
+Options readOptions( int argc, char** argv )
+{
+	Options options;
+	options.width = 640;
+	options.height = 480;
+	options.oversample = 1;
+	options.quality = 100;
+	options.brightness = 4;
+	options.gamma = 2.2f;
+	options.vibrancy = 1;
+	options.prefix = "flame";
+	options.variations = "programs/ifs2/variations.xml";
+
+	for( int i = 1; i < argc; i++ )
+	{
+		std::string argument = argv[i];
+		if( argument.size() != 2 || argument[0] != '-' )
+		{
+			options.files.push_back( argument );
+			continue;
+		}
+
+		if( i + 1 == argc )
+			usage( argv[0] );
+		const char* value = argv[++i];
+
+		switch( argument[1] )
+		{
+		case 's':
+			if( sscanf( value, "%ux%u", &options.width, &options.height ) != 2 || !options.width || !options.height )
+				usage( argv[0] );
+			break;
+		case 'q': options.quality = atof( value ); break;
+		case 'x': options.oversample = std::max( atoi( value ), 1 ); break;
+		case 'b': options.brightness = atof( value ); break;
+		case 'g': options.gamma = atof( value ); break;
+		case 'V': options.vibrancy = atof( value ); break;
+		case 'o': options.prefix = value; break;
+		case 'v': options.variations = value; break;
+		default: usage( argv[0] );
+		}
+	}
+
+	if( options.files.empty() )
+		usage( argv[0] );
+
+	return options;
+}
+
+/** Adds the variations and parameters of variations.xml, in the order ifs.lua gives them to VariationTable. */
+void loadVariations( const std::string& path, FlameRenderer& renderer )
+{
+	boost::property_tree::ptree tree;
+	try
+	{
+		read_xml( path, tree );
+	}
+	catch( const boost::property_tree::xml_parser_error& error )
+	{
+		printf("Cannot read the variations in %s: %s\n", path.c_str(), error.what());
+		exit(1);
+	}
+
+	const boost::property_tree::ptree none;
+	for( const boost::property_tree::ptree::value_type& variation: tree.get_child("variations") )
+	{
+		std::string name = variation.second.get<std::string>( "<xmlattr>.name", "" );
+		if( name.empty() )
+			continue;
+
+		Flame::addVariation( name );
+		renderer.addVariation( name );
+
+		for( const boost::property_tree::ptree::value_type& parameter: variation.second.get_child( "parameters", none ) )
+		{
+			std::string parameterName = parameter.second.get<std::string>( "<xmlattr>.name" );
+			Flame::addParameter( parameterName );
+			renderer.addParameter( parameterName );
+		}
+	}
+}
+
+/** Sums the buffer into pixels and tonemaps them like density.frag does with no spreading. */
+void tonemap( const std::vector<float>& buffer, std::vector<unsigned char>& image, const Options& options )
+{
+	unsigned int oversample = options.oversample;
+	unsigned int bufferWidth = options.width * oversample;
+
+	double densitySum = 0;
+	for( size_t i = 3; i < buffer.size(); i += 4 )
+		densitySum += buffer[i];
+	double meanDensity = densitySum/(double(options.width) * options.height);
+
+	image.assign( size_t(options.width) * options.height * 3, 0 );
+	if( meanDensity <= 0 )
+		return;
+
+	ThreadPool::shared().parallelFor( options.height, [&]( unsigned int y )
+	{
+		// the buffer grows upwards like a storage, and the image downwards
+		unsigned char* out = &image[size_t(options.height - 1 - y) * options.width * 3];
+
+		for( unsigned int x = 0; x < options.width; x++ )
+		{
+			double pixel[4] = { 0, 0, 0, 0 };
+			for( unsigned int sy = 0; sy < oversample; sy++ )
+				for( unsigned int sx = 0; sx < oversample; sx++ )
+				{
+					const float* bin = &buffer[((size_t(y) * oversample + sy) * bufferWidth + size_t(x) * oversample + sx) * 4];
+					for( int k = 0; k < 4; k++ )
+						pixel[k] += bin[k];
+				}
+
+			if( pixel[3] <= 0 )
+				continue;
+
+			double scale = options.brightness * log( 1.0 + pixel[3]/meanDensity )/pixel[3];
+			double logDensity = pixel[3] * scale;
+			double gammaDensity = pow( logDensity, 1.0/options.gamma );
+
+			for( int k = 0; k < 3; k++ )
+			{
+				double colour = options.vibrancy * pixel[k] * scale * gammaDensity/logDensity
+					+ (1.0 - options.vibrancy) * pow( std::max( pixel[k] * scale, 0.0 ), 1.0/options.gamma );
+				out[x * 3 + k] = (unsigned char)( std::min( std::max( colour, 0.0 ), 1.0 ) * 255 + .5 );
+			}
+		}
+	});
+}
+
+void writeImage( const std::string& path, const std::vector<unsigned char>& image, const Options& options )
+{
+	FILE* file = fopen( path.c_str(), "wb" );
+	if( !file )
+	{
+		printf("Cannot write %s.\n", path.c_str());
+		exit(1);
+	}
+
+	fprintf( file, "P6\n%u %u\n255\n", options.width, options.height );
+	fwrite( &image[0], 1, image.size(), file );
+	fclose( file );
+}
+
+}
+
+int main( int argc, char** argv )
+{
+	Options options = readOptions( argc, argv );
+
+	FlameRenderer renderer;
+	loadVariations( options.variations, renderer );
+	renderer.setBackground( vec4( 0, 0, 0, 0 ) );
+
+	unsigned int bufferWidth = options.width * options.oversample;
+	unsigned int bufferHeight = options.height * options.oversample;
+	double samples = options.quality * options.width * options.height;
+
+	std::vector<float> buffer;
+	std::vector<unsigned char> image;
+	int frame = 0;
+
+	for( size_t f = 0; f < options.files.size(); f++ )
+	{
+		std::vector<Flame> flames = Flame::loadFlam3( options.files[f] );
+		for( size_t i = 0; i < flames.size(); i++, frame++ )
+		{
+			renderer.setCamera( flames[i].getTrans(), vec3( 0, 0, 0 ), vec3( 1, 1, 1 ) );
+			renderer.render( flames[i], buffer, bufferWidth, bufferHeight, samples, frame );
+			tonemap( buffer, image, options );
+
+			char name[16];
+			snprintf( name, sizeof(name), "%05d.ppm", frame );
+			writeImage( options.prefix + name, image, options );
+			printf("%s%s: flame %d of %s\n", options.prefix.c_str(), name, int(i) + 1, options.files[f].c_str());
+		}
+	}
+
+	return 0;
+}
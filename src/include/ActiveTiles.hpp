@@ -0,0 +1,70 @@
+#include <libcompute.hpp>
+
+#include <vector>
+
+/**
+ * @brief Tracks which tiles of a Life-like board can change in the next generation.
+ *
+ * A cell's next state only depends on its neighbourhood, so a tile where no
+ * cell within one cell of it changed last generation will not change in the
+ * next one either: its live cells only grow older.  After every step the
+ * life.changes program marks the tiles that changed, update() reads those
+ * marks back and activates each marked tile and its eight neighbours, wrapping
+ * around the edges like the board does, and the masks are handed to the
+ * programs with setActive(), setIdle() and setActiveGrid().
+ *
+ * So that reading the marks never stalls the GPU, update() only requests
+ * them and uses the ones from a generation earlier, whose copy is done by
+ * then.  A change reaches at most two cells in two generations, which stays
+ * within the eight neighbours as long as tiles are at least two cells wide.
+ */
+class ActiveTiles
+{
+public:
+	/**
+	 * @brief Creates the tiles of a board with every tile active.
+	 * @param width The width of the board.
+	 * @param height The height of the board.
+	 * @param tileSize The side of each tile.
+	 */
+	ActiveTiles( unsigned int width, unsigned int height, unsigned int tileSize );
+
+	/** Marks every tile active, for when the whole board has been replaced. */
+	void reset();
+
+	/**
+	 * @brief Works out the active tiles of the next generation.
+	 * @param changes The output of life.changes, one element per tile, run
+	 *                with setActiveGrid() over the generation just stepped.
+	 *                It is read in the next update(), so must not be written
+	 *                again before then; alternate two storages.
+	 */
+	void update( const libcompute::Engine::DataStorage::Ptr& changes );
+
+	/** Limits a program over the board to the active tiles. */
+	void setActive( libcompute::Program& program ) const;
+
+	/** Limits a program over the board to the tiles that are not active. */
+	void setIdle( libcompute::Program& program ) const;
+
+	/** Limits a program with one output element per tile, like life.changes, to the active tiles. */
+	void setActiveGrid( libcompute::Program& program ) const;
+
+	unsigned int getColumns() const { return mask_.columns; }
+	unsigned int getRows() const { return mask_.rows; }
+	unsigned int getTileSize() const { return mask_.tileSize; }
+
+	/** Gets the number of tiles the next generation steps. */
+	int getActiveCount() const { return activeCount_; }
+
+	/** Gets the number of tiles on the board. */
+	int getTileCount() const { return int(mask_.active.size()); }
+
+private:
+	libcompute::Program::TileMask mask_;
+	int activeCount_;
+
+	/** The marks update() requested last, and the tiles stepped when they were made. */
+	libcompute::Engine::DataStorage::Ptr pending_;
+	std::vector<unsigned char> pendingStepped_;
+};
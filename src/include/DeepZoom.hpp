@@ -0,0 +1,129 @@
+#include <libcompute.hpp>
+#include <boost/multiprecision/cpp_bin_float.hpp>
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Keeps the view of a deep zoom into the Mandelbrot set and its reference orbit.
+ *
+ * Past a scale of about 1e-6 single precision floats can no longer tell
+ * neighbouring pixels apart.  DeepZoom keeps the centre of the view in high
+ * precision and iterates one reference orbit there.  The perturb programs then
+ * only iterate each pixel's small offset from that orbit, which fits in a float
+ * (GLSL, down to about 1e-30) or a double (CPU, down to about 1e-300).
+ *
+ * The orbit does not have to start at the centre, so panning keeps it until
+ * the view has moved well away from it, and the perturb programs are told
+ * where the centre is from it instead.  It is iterated with only as many bits
+ * as the depth of the view needs, since that is most of its cost.
+ *
+ * The transform program should map the screen to the unit plane, with y in
+ * [-1,1], and the perturb program multiplies by scale/2 itself.  The reference
+ * orbit is written to the perturb program's second input, ReferenceWidth
+ * elements per row.  Each element holds the real and imaginary parts split
+ * into a float and the float remainder, so the CPU can get most of a double
+ * back.
+ */
+class DeepZoom
+{
+public:
+	/** Numbers with about 330 decimal digits, enough to place a view 1e-300 across. */
+	typedef boost::multiprecision::number<boost::multiprecision::cpp_bin_float<1100, boost::multiprecision::digit_base_2> > Real;
+
+	/** The number of reference orbit elements in each row of the reference storage. */
+	static const int ReferenceWidth = 1024;
+
+	/** Creates a view of the whole set. */
+	DeepZoom();
+
+	/**
+	 * @brief Moves the centre of the view.
+	 * @param x The real part, as a decimal string so it can be exact.
+	 * @param y The imaginary part, as a decimal string.
+	 */
+	void setCenter( const std::string& x, const std::string& y );
+
+	/** Gets the real part of the centre of the view as a decimal string. */
+	std::string getCenterX() const;
+
+	/** Gets the imaginary part of the centre of the view as a decimal string. */
+	std::string getCenterY() const;
+
+	/**
+	 * @brief Moves the view.
+	 * @param dx The distance to move along the real axis.
+	 * @param dy The distance to move along the imaginary axis.
+	 *
+	 * The offsets are small compared to the centre but are added in full
+	 * precision, so panning works at any depth.
+	 */
+	void pan( double dx, double dy );
+
+	/**
+	 * @brief Scales the view around its centre.
+	 * @param factor The factor to multiply the height of the view by.
+	 */
+	void zoom( double factor );
+
+	/** Gets the height of the view in the complex plane. */
+	double getScale() const { return scale_; }
+
+	/** Sets the height of the view in the complex plane. */
+	void setScale( double scale ) { scale_ = scale; }
+
+	/**
+	 * @brief Gets the mantissa of half the height of the view.
+	 *
+	 * Float parameters cannot hold numbers below about 1e-38, so the perturb
+	 * programs take half the scale as a mantissa and a power of two.
+	 */
+	float getHalfScaleMantissa() const;
+
+	/** Gets the power of two that getHalfScaleMantissa() is multiplied by. */
+	int getHalfScaleExponent() const;
+
+	/**
+	 * @brief Iterates the reference orbit at the centre of the view, if the old one no longer does.
+	 * @param maxIterations The number of iterations the perturb program will run.
+	 * @param escapeRadius The escape radius of the perturb program.
+	 * @return True if the orbit was iterated again and needs to be written.
+	 *
+	 * The old orbit is kept while it is within RebaseDistance of the centre,
+	 * on the unit plane, and was iterated precisely enough for the scale.
+	 * The orbit starts at 0 and stops early if its point itself escapes.
+	 */
+	bool updateReference( int maxIterations, float escapeRadius );
+
+	/** Gets the real part of the centre of the view less the point of the reference orbit, on the unit plane. */
+	float getReferenceOffsetX() const;
+
+	/** Gets the imaginary part of the centre of the view less the point of the reference orbit, on the unit plane. */
+	float getReferenceOffsetY() const;
+
+	/** Gets the number of elements in the reference orbit. */
+	int getReferenceLength() const { return referenceLength_; }
+
+	/** Gets the number of storage rows needed to hold a reference orbit of \a maxIterations elements. */
+	static int getReferenceRows( int maxIterations );
+
+	/**
+	 * @brief Writes the reference orbit to a storage.
+	 * @param storage A float storage ReferenceWidth wide and at least getReferenceRows() high.
+	 */
+	void writeReference( const libcompute::Engine::DataStorage::Ptr& storage );
+
+private:
+	Real centerX_;
+	Real centerY_;
+	double scale_;
+
+	Real referenceX_;
+	Real referenceY_;
+	bool referenceDirty_;
+	int referenceBits_;
+	int referenceIterations_;
+	float referenceRadius_;
+	int referenceLength_;
+	std::vector<float> reference_;
+};
@@ -0,0 +1,256 @@
+#include <libcompute.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One function of a flame: an affine transform, the variations run on
+ * its result and a post transform, with the colour it blends points towards.
+ *
+ * The variations and their parameters are held by their index in
+ * VariationTable, which Flame::addVariation() and Flame::addParameter() are
+ * told about before any xform is made.
+ */
+class Xform
+{
+public:
+	/** Creates an xform with identity transforms, no variations and no density. */
+	Xform();
+
+	/** Gets the affine transform, in the first two rows of a mat4 as AffineMatrix:toMat4() lays it out. */
+	libcompute::mat4 getAffine() const;
+	void setAffine( libcompute::mat4 affine );
+
+	/** Gets the post transform, laid out like getAffine(). */
+	libcompute::mat4 getPost() const;
+	void setPost( libcompute::mat4 post );
+
+	float getVariationWeight( const std::string& name ) const;
+	void setVariationWeight( const std::string& name, float weight );
+	bool hasVariation( const std::string& name ) const;
+
+	float getParameter( const std::string& name ) const;
+	void setParameter( const std::string& name, float value );
+
+	float getColor() const { return color_; }
+	void setColor( float color ) { color_ = color; }
+
+	float getColorSpeed() const { return colorSpeed_; }
+	void setColorSpeed( float speed ) { colorSpeed_ = speed; }
+
+	float getOpacity() const { return opacity_; }
+	void setOpacity( float opacity ) { opacity_ = opacity; }
+
+	float getDensity() const { return density_; }
+	void setDensity( float density ) { density_ = density; }
+
+	/** Scales the variation weights so they sum to one. */
+	void normalizeVariations();
+
+private:
+	friend class Flame;
+
+	float affine_[6];
+	float post_[6];
+	float color_;
+	float colorSpeed_;
+	float density_;
+	float opacity_;
+	std::vector<float> variations_;
+	std::vector<float> parameters_;
+};
+
+/**
+ * @brief A flame the ifs program can draw, and what it is interpolated from.
+ *
+ * The xforms are kept as structure of arrays: every coefficient, variation
+ * weight and parameter has a row holding its value for all MaxXforms
+ * xforms, and the rows of xforms past getXformCount() hold the values of a
+ * default Xform.  That makes interpolating flames with different numbers of
+ * xforms one SIMD pass over two blocks of floats, with the missing xforms
+ * fading in and out at no density, and lets writeParameters() write every
+ * parameter of the ifs program straight into its arrays.
+ *
+ * The editing helpers that only run when a flame is made, like
+ * randomizePallette() and addSymmetry(), stay in Flame.lua.
+ */
+class Flame
+{
+public:
+	/** Creates a flame with no xforms, a black palette and no translation. */
+	Flame();
+
+	/** The most xforms a flame holds, the size of the arrays of the ifs program. */
+	static const int MaxXforms = 12;
+
+	/** The number of entries of the palette. */
+	static const int PaletteSize = 512;
+
+	/**
+	 * @brief Adds the next variation of VariationTable.
+	 * @param name The name of the variation in variations.xml.
+	 */
+	static void addVariation( const std::string& name );
+
+	/**
+	 * @brief Adds the next variation parameter of VariationTable.
+	 * @param name The name of the parameter in variations.xml.
+	 */
+	static void addParameter( const std::string& name );
+
+	static bool isVariation( const std::string& name ) { return variationIndexes_.count( name ) > 0; }
+	static bool isParameter( const std::string& name ) { return parameterIndexes_.count( name ) > 0; }
+
+	/** Gets the variations added so far, in VariationTable order. */
+	static const std::vector<std::string>& getVariations() { return variations_; }
+
+	/** Gets the parameters added so far, in VariationTable order. */
+	static const std::vector<std::string>& getParameters() { return parameters_; }
+
+	int getXformCount() const { return count_; }
+
+	/** Appends a copy of \a xform. */
+	void addXform( const Xform& xform );
+
+	/** Gets a copy of xform \a index, counting from zero. */
+	Xform getXform( int index ) const;
+
+	/** Replaces xform \a index, counting from zero, with a copy of \a xform. */
+	void setXform( int index, const Xform& xform );
+
+	/** Removes xform \a index, counting from zero, moving the later ones down. */
+	void removeXform( int index );
+
+	libcompute::vec3 getTrans() const { return trans_; }
+	void setTrans( libcompute::vec3 trans ) { trans_ = trans; }
+
+	libcompute::vec4 getPaletteEntry( int index ) const;
+	void setPaletteEntry( int index, libcompute::vec4 colour );
+
+	/** Gets a number that changes whenever the palette does, so it is only uploaded when it needs to be. */
+	unsigned long getPaletteId() const { return paletteId_; }
+
+	float getDensitySum() const;
+
+	/**
+	 * @brief Gets the variations the ifs program has to run for this flame.
+	 * @return The indexes, from zero, of the variations any xform has a
+	 * weight for, apart from xforms that are only linear.
+	 */
+	std::vector<int> getVariationSet() const;
+
+	/** Scales the densities of the xforms so they sum to \a to. */
+	void normalizeDensities( float to );
+
+	/**
+	 * @brief Turns the xforms that change colour, as ifs.lua does every frame.
+	 *
+	 * The post transforms turn by \a degrees and the affine transforms the
+	 * other way, with the direction flipping from one such xform to the next.
+	 */
+	void spin( float degrees );
+
+	/**
+	 * @brief Becomes the blend of two flames, xforms, palette and all.
+	 * @param start The flame at \a weight one.
+	 * @param end The flame at \a weight zero.
+	 * @param weight How much of \a start to take.
+	 */
+	void interpolate( const Flame& start, const Flame& end, float weight );
+
+	/** The handles of the ifs program parameters writeParameters() fills, resolved once per program. */
+	struct ProgramHandles
+	{
+		ProgramHandles( libcompute::Program& program );
+
+		libcompute::Program::ParameterHandle mats;
+		libcompute::Program::ParameterHandle colSpeeds;
+		libcompute::Program::ParameterHandle varOffsets;
+		libcompute::Program::ParameterHandle vars;
+		libcompute::Program::ParameterHandle varParam;
+		libcompute::Program::ParameterHandle matCount;
+		libcompute::Program::ParameterHandle densitySum;
+	};
+
+	/**
+	 * @brief Writes the xforms into the parameters of the ifs program.
+	 * @param handles The handles of \a program, kept with it so every frame
+	 *                skips looking the parameters up by name.
+	 *
+	 * Fills matCount, densitySum, mats, colSpeeds, varOffsets, vars and
+	 * varParam in place, with varParam holding as many mat4s per xform as
+	 * it has room for.
+	 */
+	void writeParameters( libcompute::Program& program, const ProgramHandles& handles ) const;
+
+	/**
+	 * @brief Writes the xforms into arrays laid out like the parameters of the ifs program.
+	 *
+	 * Each mat4 holds the affine and post transforms in its first three
+	 * columns, and the colour, opacity and density in the last.
+	 *
+	 * @param matCount The size of \a mats, \a colSpeeds and \a varOffsets.
+	 * @param varCount The size of \a vars.
+	 * @param paramMats The number of mat4s of \a varParams for each xform.
+	 * @return The number of xforms written.
+	 */
+	int writeParameters( libcompute::mat4* mats, float* colSpeeds, int* varOffsets, libcompute::vec2* vars, libcompute::mat4* varParams,
+		unsigned int matCount, unsigned int varCount, unsigned int paramMats ) const;
+
+	/** Writes the palette, clamped to [0, 1], into the first entries of \a storage. */
+	void writePalette( const libcompute::Engine::DataStorage::Ptr& storage ) const;
+
+	/** Writes at most \a size floats of the palette, clamped to [0, 1], into \a values. */
+	void writePalette( float* values, size_t size ) const;
+
+	/**
+	 * @brief Reads the flames of a flam3 file.
+	 *
+	 * Variations and parameters are matched to the ones added by name, and
+	 * the 256 colours of the palette are stretched over PaletteSize entries.
+	 * The centre and scale become the translation that shows the same part
+	 * of the plane at \a size, since the flame has no camera of its own.
+	 * Final xforms, variations that have not been added and xforms past
+	 * MaxXforms are skipped with a warning.
+	 */
+	static std::vector<Flame> loadFlam3( const std::string& path );
+
+	/**
+	 * @brief Writes flames as a flam3 file.
+	 * @param width The width of the images the file asks for.
+	 * @param height The height of the images the file asks for, which sets the scale.
+	 */
+	static void saveFlam3( const std::string& path, const std::vector<Flame>& flames, int width, int height );
+
+private:
+	enum Field
+	{
+		AffineField = 0,
+		PostField = 6,
+		ColorField = 12,
+		ColorSpeedField,
+		DensityField,
+		OpacityField,
+		VariationField
+	};
+
+	static std::vector<std::string> variations_;
+	static std::vector<std::string> parameters_;
+	static std::map<std::string, int> variationIndexes_;
+	static std::map<std::string, int> parameterIndexes_;
+	static unsigned long nextPaletteId_;
+
+	friend class Xform;
+
+	int count_;
+	std::vector<float> values_;
+	std::vector<float> palette_;
+	libcompute::vec3 trans_;
+	unsigned long paletteId_;
+
+	float* row( int field ) { return &values_[size_t(field) * MaxXforms]; }
+	const float* row( int field ) const { return &values_[size_t(field) * MaxXforms]; }
+	int parameterField() const { return VariationField + int(variations_.size()); }
+	void clearXform( int index );
+};
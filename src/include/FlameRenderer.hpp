@@ -0,0 +1,146 @@
+#include <libcompute.hpp>
+
+#include <string>
+#include <vector>
+
+class Flame;
+
+/**
+ * @brief Renders the flame held by the ifs program with the chaos game on the CPU.
+ *
+ * Instead of advancing a texture of particles and splatting them as points,
+ * every thread of the shared ThreadPool runs its own walker through the
+ * xforms and accumulates the palette colour of every point it lands on into
+ * a private RGBA histogram, whose alpha counts the points like the additive
+ * splat does.  Once every walker is done the histograms are summed in a
+ * parallel tree reduction and the result replaces the histogram buffer
+ * that ifs.lua tonemaps.  The histograms hold doubles, as flam3's do, so
+ * the bright bins of long renders keep counting where floats would stop
+ * at 2^24 points.
+ *
+ * The flame is read straight from the parameters and palette storage that
+ * Flame:pushToProgram() fills in, so both renderers draw the same flame.
+ * The variations are native ports of variations.xml, looked up by name in
+ * the order VariationTable holds them.  They follow the GLSL as written, so
+ * both renderers agree, except where the GLSL does not say what it means,
+ * where they follow flam3.
+ */
+class FlameRenderer
+{
+public:
+	FlameRenderer();
+
+	/**
+	 * @brief Adds the next variation of VariationTable.
+	 * @param name The name of the variation in variations.xml.
+	 */
+	void addVariation( const std::string& name );
+
+	/**
+	 * @brief Adds the next variation parameter of VariationTable.
+	 * @param name The name of the parameter in variations.xml.
+	 */
+	void addParameter( const std::string& name );
+
+	/**
+	 * @brief Sets the view the flame is drawn with, like the ThreeD drawing mode of ifs.lua.
+	 * @param translation The translation applied after \a scale.
+	 * @param rotation The angles in degrees the flame is turned by about the x, y and z axes, in that order.
+	 * @param scale The scale applied first.
+	 */
+	void setCamera( libcompute::vec3 translation, libcompute::vec3 rotation, libcompute::vec3 scale );
+
+	/** Sets the value the buffer holds where no points land. */
+	void setBackground( libcompute::vec4 background ) { background_ = background; }
+
+	/** Sets the iterations each walker runs before it starts drawing points. */
+	void setFuseIterations( int iterations ) { fuseIterations_ = iterations; }
+
+	/**
+	 * @brief Renders the flame.
+	 * @param program The ifs program, after Flame:pushToProgram().
+	 * @param output The buffer to render into, four floats per element.
+	 * @param samples The number of points to draw.
+	 * @param seed The seed of the walkers; equal seeds render equal buffers on the same number of threads.
+	 */
+	void render( libcompute::Program& program, const libcompute::Engine::DataStorage::Ptr& output, double samples, int seed );
+
+	/**
+	 * @brief Renders a flame without the ifs program, for rendering offline.
+	 * @param flame The flame, made after the variations were added to Flame.
+	 * @param output Replaced by the buffer, \a width by \a height elements of four floats.
+	 */
+	void render( const Flame& flame, std::vector<float>& output, unsigned int width, unsigned int height, double samples, int seed );
+
+	/** Gets the number of walkers, and histograms, render() uses. */
+	int getWalkerCount() const;
+
+	/** The most parameters a variation reads. */
+	static const int MaxParameters = 6;
+
+	struct Walker;
+
+	/** A point before a variation, with the values every variation in variations.xml can read. */
+	struct Input
+	{
+		double x, y; ///< The point after the affine transform
+		double r, rSq; ///< Its length and squared length
+		double a, t; ///< atan(x/y) and atan(y/x), as flame_pass() works them out
+		double weight; ///< The weight of the variation
+		const double* affine; ///< The affine coefficients aa to af
+		const float* parameters; ///< The parameters of the variation, in variations.xml order
+		Walker* walker; ///< The walker, for variations that use random numbers
+	};
+
+	typedef void (*VariationFunction)( const Input& input, double& x, double& y );
+
+private:
+	struct Variation
+	{
+		const char* name;
+		VariationFunction function;
+		const char* parameters[MaxParameters];
+	};
+
+	struct Term
+	{
+		VariationFunction function;
+		double weight;
+		float parameters[MaxParameters];
+	};
+
+	struct Xform
+	{
+		double affine[6];
+		double post[6];
+		double color;
+		double colorSpeed;
+		double opacity;
+		double density;
+		bool linear;
+		size_t firstTerm, lastTerm;
+	};
+
+	static const Variation variationTable_[];
+
+	std::vector<const Variation*> variations_;
+	std::vector<std::string> parameters_;
+
+	double camera_[3][4];
+	libcompute::vec4 background_;
+	int fuseIterations_;
+
+	std::vector<Xform> xforms_;
+	std::vector<Term> terms_;
+	std::vector<float> palette_;
+	std::vector<std::vector<double> > histograms_;
+	std::vector<float> output_;
+
+	void readFlame( libcompute::Program& program );
+	void readFlame( const Flame& flame );
+	void readXforms( const libcompute::mat4* mats, const float* colSpeeds, const int* varOffsets, const libcompute::vec2* vars,
+		const libcompute::mat4* varParams, unsigned int count, unsigned int varCount, unsigned int paramMats );
+	void accumulate( unsigned int width, unsigned int height, double samples, int seed );
+	void walk( Walker& walker, size_t samples, std::vector<double>& histogram, unsigned int width, unsigned int height ) const;
+	void reduce( size_t size );
+};
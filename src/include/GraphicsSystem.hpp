@@ -309,6 +309,14 @@ public:
 
 	Texture createBufferTexture( unsigned int width = 0, unsigned int height = 0 );
 
+	/**
+	 * @brief Copies pixels from host memory into a texture made by createBufferTexture().
+	 * @param texture The texture to copy into.
+	 * @param pixels RGBA pixel data with the same dimensions as \a texture.
+	 * @param isFloat True if \a pixels holds floats, false if it holds bytes.
+	 */
+	void updateBufferTexture( const Texture& texture, const void* pixels, bool isFloat = true );
+
 	/**
 	 * @brief Returns a SDL_Surface in the screen's format.
 	 * @param w The requested width of the surface.
@@ -0,0 +1,122 @@
+#include <libcompute.hpp>
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @brief Runs a Life-like rule with HashLife, on a universe without edges.
+ *
+ * The universe is a quadtree whose nodes are hash-consed, so every distinct
+ * block of cells exists once however often it repeats.  A node of side 2^k
+ * remembers its centre 2^(k-2) generations later once that has been worked
+ * out, which lets step() jump a power of two generations at a time and makes
+ * repetitive boards cost little more than their distinct blocks.
+ *
+ * Leaves are 8x8 blocks packed into a word.  The universe is centred on the
+ * origin: a root of level k covers -2^(k-1) to 2^(k-1) on both axes, with y
+ * growing upwards like the rows of a storage.
+ *
+ * Rules where cells are born with no neighbours would fill the empty
+ * universe, so they are not supported, and neither are death states.
+ */
+class HashLife
+{
+public:
+	/** Creates an empty universe running Conway's Life. */
+	HashLife();
+
+	/**
+	 * @brief Sets the rule, which forgets every step worked out so far.
+	 * @param birthRules Bit n is set if dead cells with n live neighbours are born.
+	 *                   Bit 0 cannot be run, and callers should refuse such rules.
+	 * @param liveRules Bit n is set if live cells with n live neighbours survive.
+	 */
+	void setRules( int birthRules, int liveRules );
+
+	/**
+	 * @brief Replaces the universe with a float board, centred on the origin.
+	 * @param storage A board like the ones life.frag steps; the live cells are
+	 *                the ones with a positive first component.
+	 */
+	void setBoard( const libcompute::Engine::DataStorage::Ptr& storage );
+
+	/**
+	 * @brief Advances the universe.
+	 * @param exponent The power of two generations to advance, from 0 to MaxExponent.
+	 */
+	void step( int exponent );
+
+	/**
+	 * @brief Draws a window of the universe into a float board.
+	 * @param storage The board to draw into, which sets the size of the window.
+	 * @param left The universe column drawn into the first column of the board.
+	 * @param bottom The universe row drawn into the first row of the board.
+	 *
+	 * Like life.frag, each live cell gets the age the board held for it plus
+	 * one and each dead cell 0, so life.color can colour the board unchanged.
+	 */
+	void rasterise( const libcompute::Engine::DataStorage::Ptr& storage, long long left, long long bottom );
+
+	/** Gets the number of generations run since the last setBoard(). */
+	double getGeneration() const { return generation_; }
+
+	/** Gets the number of live cells. */
+	double getPopulation() const;
+
+	/** Gets the number of nodes in the node table. */
+	int getNodeCount() const { return int(nodes_.size()); }
+
+	/** Sets the number of nodes above which step() collects garbage. */
+	void setNodeLimit( int limit ) { nodeLimit_ = limit; }
+
+	/** Drops every node the universe no longer uses, along with the steps remembered for them. */
+	void collectGarbage();
+
+	/** The largest power of two step() advances by at once. */
+	static const int MaxExponent = 48;
+
+private:
+	typedef uint32_t Index;
+	static const Index None = 0xffffffff;
+
+	enum Quadrant { NorthWest, NorthEast, SouthWest, SouthEast };
+
+	struct Node
+	{
+		uint64_t bits; ///< The cells of a leaf, bit y * 8 + x
+		uint64_t population; ///< The number of live cells
+		Index children[4]; ///< The quadrants of a branch, in Quadrant order
+		Index result; ///< The centre some generations later, or None
+		int8_t level; ///< The node is 2^level cells across; leaves are level 3
+		int8_t resultStep; ///< The power of two generations result is ahead by
+	};
+
+	std::vector<Node> nodes_;
+	std::vector<Index> table_;
+	std::vector<Index> empty_;
+
+	Index root_;
+	double generation_;
+	size_t nodeLimit_;
+
+	uint32_t birth_[9];
+	uint32_t live_[9];
+
+	static uint64_t hash( const Node& node );
+	Index intern( const Node& node );
+	void rehash( size_t size );
+
+	Index leaf( uint64_t bits );
+	Index join( Index northWest, Index northEast, Index southWest, Index southEast );
+	Index empty( int level );
+	Index child( Index node, Quadrant quadrant ) const { return nodes_[node].children[quadrant]; }
+	Index centre( Index northWest, Index northEast, Index southWest, Index southEast );
+	Index centre( Index node );
+	Index expand( Index node );
+
+	Index result( Index node, int exponent );
+	Index leafResult( Index node, int generations );
+
+	Index build( const std::vector<float>& board, int width, int height, int level, long long x, long long y );
+	void draw( Index node, long long x, long long y, long long left, long long bottom, int width, int height, std::vector<unsigned char>& alive ) const;
+};
@@ -71,6 +71,60 @@ Parameter parameterAt( Parameter* const parameter, unsigned int index )
 	return (*parameter)[index];
 }
 
+// the handle versions are for parameters set every frame: they make no
+// Parameter userdata and look no names up
+
+template<typename T> Parameter::ParameterType parameterTypeOf();
+template<> Parameter::ParameterType parameterTypeOf<int>() { return Parameter::Int; }
+template<> Parameter::ParameterType parameterTypeOf<float>() { return Parameter::Float; }
+template<> Parameter::ParameterType parameterTypeOf<vec2>() { return Parameter::Vec2; }
+template<> Parameter::ParameterType parameterTypeOf<vec3>() { return Parameter::Vec3; }
+template<> Parameter::ParameterType parameterTypeOf<vec4>() { return Parameter::Vec4; }
+template<> Parameter::ParameterType parameterTypeOf<mat3>() { return Parameter::Mat3; }
+template<> Parameter::ParameterType parameterTypeOf<mat4>() { return Parameter::Mat4; }
+
+/** Gets the Parameter behind \a handle, which has to hold \a T since the setters write it as one. */
+template<typename T> Parameter& typedParameter( Program* const program, Program::ParameterHandle handle )
+{
+	Parameter& parameter = program->getParameter( handle );
+	if( parameter.type() != parameterTypeOf<T>() )
+	{
+		printf("Parameter %s is a %s, not a %s.\n", parameter.name().c_str(),
+			Parameter::nameFromType( parameter.type() ).c_str(), Parameter::nameFromType( parameterTypeOf<T>() ).c_str());
+		exit(1);
+	}
+	return parameter;
+}
+
+template<typename T> T programGet( Program* const program, Program::ParameterHandle handle )
+{
+	return T(typedParameter<T>( program, handle ));
+}
+
+template<typename T> void programSet( Program* const program, Program::ParameterHandle handle, T value )
+{
+	typedParameter<T>( program, handle ) = value;
+}
+
+/** Sets element \a index, from zero like Parameter.at, of an array parameter. */
+template<typename T> void programSetAt( Program* const program, Program::ParameterHandle handle, unsigned int index, T value )
+{
+	typedParameter<T>( program, handle ).setElement( index, value );
+}
+
+/** Copies the values of a Lua array into an array parameter, from element \a offset on. */
+template<typename T> void programSetArray( Program* const program, Program::ParameterHandle handle, sol::table values, unsigned int offset )
+{
+	Parameter& parameter = typedParameter<T>( program, handle );
+	if( offset >= parameter.size() )
+		return;
+
+	unsigned int count = std::min( (unsigned int) values.size(), parameter.size() - offset );
+	T* array = parameter;
+	for( unsigned int i = 0; i < count; i++ )
+		array[offset + i] = values.get<T>( i + 1 );
+}
+
 std::string vectorAt( std::vector<std::string>* const vec, unsigned int index )
 {
 	return vec->at(index);
@@ -86,6 +140,12 @@ template<typename T> void matSet( T* const mat, int r, int c, float val )
 	(*mat)(r,c) = val;
 }
 
+std::tuple<float, float> splitDoubleSingle( double value )
+{
+	float hi = float(value);
+	return std::make_tuple( hi, float(value - hi) );
+}
+
 Engine::DataStorage& getStorageVal( Program* const program, Program::StorageLocation location, unsigned int index )
 {
 	return *(program->getStorage( location, index ));
@@ -116,11 +176,53 @@ void dataStorageCopyFromArray( Engine::DataStorage* const storage, void* value )
 Texture dataStorageToTexture( Engine::DataStorage* const storage )
 {
 	Texture texture;
-	texture.location = storage->getDataStorage();
 	Engine::DataStorage::Info info = storage->getInfo();
 	texture.w = info.width;
 	texture.h = info.height;
-	return texture;
+
+	if( storage->getType() == "GLSLComputeEngine" )
+	{
+		texture.location = storage->getDataStorage();
+		return texture;
+	}
+
+	// storages kept in host memory are mirrored into a texture every time
+	// they are drawn; the storage owns its mirror, so the texture goes with it
+	static std::vector<unsigned char> staging;
+
+	GraphicsSystem& graphicsSystem = Singleton<GraphicsSystem>::instance();
+	std::shared_ptr<Texture> mirror = std::static_pointer_cast<Texture>( storage->getAttachment() );
+	if( !mirror || mirror->w != texture.w || mirror->h != texture.h )
+	{
+		mirror = std::shared_ptr<Texture>( new Texture( graphicsSystem.createBufferTexture( texture.w, texture.h ) ),
+			[]( Texture* mirror )
+			{
+				Singleton<GraphicsSystem>::instance().freeTexture( *mirror );
+				delete mirror;
+			});
+		storage->setAttachment( mirror );
+	}
+
+	size_t count = size_t(texture.w) * texture.h * 4;
+	bool isFloat = info.type != Engine::DataStorage::Byte;
+	staging.resize( count * (isFloat? sizeof(float): 1) );
+	storage->toArray( &staging[0] );
+
+	// textures take no ints, so they are converted in place to the floats they hold
+	if( info.type == Engine::DataStorage::Int )
+	{
+		for( size_t i = 0; i < count; i++ )
+		{
+			int value;
+			memcpy( &value, &staging[i * sizeof(int)], sizeof(int) );
+			float converted = float(value);
+			memcpy( &staging[i * sizeof(float)], &converted, sizeof(float) );
+		}
+	}
+
+	graphicsSystem.updateBufferTexture( *mirror, &staging[0], isFloat );
+
+	return *mirror;
 }
 
 typedef unsigned char ubyte;
@@ -11,6 +11,11 @@
 #include "ConfigSystem.hpp"
 #include "LoggingSystem.hpp"
 #include "FileSystem.hpp"
+#include "DeepZoom.hpp"
+#include "HashLife.hpp"
+#include "FlameRenderer.hpp"
+#include "Flame.hpp"
+#include "ActiveTiles.hpp"
 
 
 #include "InfractusProgram.hpp"
@@ -79,6 +84,7 @@ public:
 
 		state["ticks"] = &SDL_GetTicks;
 		state["loadImage"] = &loadImage;
+		state["splitDoubleSingle"] = &splitDoubleSingle;
 
 #define ARRAY1D_DEFINE(T)\
 	class_<Array1D<T> >("Array1D" #T)\
@@ -171,10 +177,35 @@ public:
 		engine_ut["Minimum"] = sol::var(Engine::Minimum);
 		engine_ut["Maximum"] = sol::var(Engine::Maximum);
 		engine_ut["Sum"] = sol::var(Engine::Sum);
+		engine_ut["requestStatistics"] = &Engine::requestStatistics;
+		engine_ut["collectStatistics"] = &Engine::collectStatistics;
+
+		auto stats_ut = state.new_usertype<Engine::Statistics>("Statistics", sol::no_constructor);
+		stats_ut["ready"] = &Engine::Statistics::ready;
+		stats_ut["minimum"] = &Engine::Statistics::minimum;
+		stats_ut["maximum"] = &Engine::Statistics::maximum;
+		stats_ut["histogramMin"] = &Engine::Statistics::histogramMin;
+		stats_ut["histogramMax"] = &Engine::Statistics::histogramMax;
+		stats_ut["count"] = &Engine::Statistics::count;
+		stats_ut["getBin"] = &Engine::Statistics::getBin;
+		stats_ut["Bins"] = sol::var(Engine::Statistics::Bins);
+
+		engine_ut["getProgramCacheCounts"] = &Engine::getProgramCacheCounts;
+		engine_ut["setAsynchronous"] = &Engine::setAsynchronous;
+		engine_ut["isAsynchronous"] = &Engine::isAsynchronous;
+
+		auto completion_ut = state.new_usertype<Engine::Completion>("Completion", sol::no_constructor);
+		completion_ut["isComplete"] = &Engine::Completion::isComplete;
+		completion_ut["wait"] = &Engine::Completion::wait;
+
+		auto cache_ut = state.new_usertype<Engine::ProgramCacheCounts>("ProgramCacheCounts", sol::no_constructor);
+		cache_ut["hits"] = &Engine::ProgramCacheCounts::hits;
+		cache_ut["misses"] = &Engine::ProgramCacheCounts::misses;
 
 		auto ds_ut = state.new_usertype<Engine::DataStorage>("DataStorage", sol::no_constructor);
 		ds_ut["copyToArray"] = &dataStorageCopyToArray;
 		ds_ut["copyFromArray"] = &dataStorageCopyFromArray;
+		ds_ut["fillRandomSparse"] = &Engine::DataStorage::fillRandomSparse;
 		ds_ut["toTexture"] = &dataStorageToTexture;
 
 		auto param_ut = state.new_usertype<Parameter>("Parameter", sol::no_constructor);
@@ -205,6 +236,11 @@ public:
 		pm_ut["loadPlugin"] = &PluginManager::loadPlugin;
 		pm_ut["instance"] = &Singleton<PluginManager>::instance;
 
+		auto kr_ut = state.new_usertype<KernelRegistry>("KernelRegistry", sol::no_constructor);
+		kr_ut["instance"] = &KernelRegistry::instance;
+		kr_ut["hasKernel"] = &KernelRegistry::hasKernel;
+		kr_ut["getKernelNames"] = &KernelRegistry::getKernelNames;
+
 		auto prog_ut = state.new_usertype<Program>("Program", sol::call_constructor,
 			sol::constructors<Program()>());
 
@@ -216,17 +252,157 @@ public:
 		prog_ut["unbindEngine"] = &Program::unbindEngine;
 		prog_ut["allocateStorage"] = &Program::allocateStorage;
 		prog_ut["run"] = &Program::run;
+		prog_ut["setRunRegion"] = &Program::setRunRegion;
+		prog_ut["clearRunRegion"] = &Program::clearRunRegion;
+		prog_ut["hasRunRegion"] = &Program::hasRunRegion;
+		prog_ut["clearActiveTiles"] = &Program::clearActiveTiles;
+		prog_ut["hasActiveTiles"] = &Program::hasActiveTiles;
 		prog_ut["addParameter"] = &Program::addParameter;
 		prog_ut["addParameterArray"] = &Program::addParameterArray;
-		prog_ut["getParameter"] = &Program::getParameter;
+		prog_ut["getParameter"] = sol::resolve<Parameter&( const std::string& )>( &Program::getParameter );
+		prog_ut["getParameterHandle"] = &Program::getParameterHandle;
+		prog_ut["getInt"] = &programGet<int>;
+		prog_ut["setInt"] = &programSet<int>;
+		prog_ut["getFloat"] = &programGet<float>;
+		prog_ut["setFloat"] = &programSet<float>;
+		prog_ut["setVec2"] = &programSet<vec2>;
+		prog_ut["setVec3"] = &programSet<vec3>;
+		prog_ut["setVec4"] = &programSet<vec4>;
+		prog_ut["setMat3"] = &programSet<mat3>;
+		prog_ut["setMat4"] = &programSet<mat4>;
+		prog_ut["setIntAt"] = &programSetAt<int>;
+		prog_ut["setFloatAt"] = &programSetAt<float>;
+		prog_ut["setVec2At"] = &programSetAt<vec2>;
+		prog_ut["setIntArray"] = &programSetArray<int>;
+		prog_ut["setFloatArray"] = &programSetArray<float>;
+		prog_ut["setVec2Array"] = &programSetArray<vec2>;
 		prog_ut["getParameterNames"] = &Program::getParameterNames;
 		prog_ut["swapInputOutput"] = &Program::swapInputOutput;
 		prog_ut["setProgramLocationFile"] = &Program::setProgramLocationFile;
 		prog_ut["setProgramLocationMemoryString"] = &programSetLocationMemoryString;
+		prog_ut["setProgramLocationKernel"] = &Program::setProgramLocationKernel;
 		prog_ut["getStorageVal"] = &getStorageVal;
+		prog_ut["getPrecision"] = &Program::getPrecision;
+		prog_ut["setPrecision"] = &Program::setPrecision;
+		prog_ut["Single"] = sol::var(Program::Single);
+		prog_ut["DoubleSingle"] = sol::var(Program::DoubleSingle);
 		prog_ut["input"] = sol::var(Program::Input);
 		prog_ut["output"] = sol::var(Program::Output);
 
+		auto dz_ut = state.new_usertype<DeepZoom>("DeepZoom", sol::call_constructor,
+			sol::constructors<DeepZoom()>());
+		dz_ut["setCenter"] = &DeepZoom::setCenter;
+		dz_ut["getCenterX"] = &DeepZoom::getCenterX;
+		dz_ut["getCenterY"] = &DeepZoom::getCenterY;
+		dz_ut["pan"] = &DeepZoom::pan;
+		dz_ut["zoom"] = &DeepZoom::zoom;
+		dz_ut["getScale"] = &DeepZoom::getScale;
+		dz_ut["setScale"] = &DeepZoom::setScale;
+		dz_ut["getHalfScaleMantissa"] = &DeepZoom::getHalfScaleMantissa;
+		dz_ut["getHalfScaleExponent"] = &DeepZoom::getHalfScaleExponent;
+		dz_ut["updateReference"] = &DeepZoom::updateReference;
+		dz_ut["getReferenceLength"] = &DeepZoom::getReferenceLength;
+		dz_ut["getReferenceOffsetX"] = &DeepZoom::getReferenceOffsetX;
+		dz_ut["getReferenceOffsetY"] = &DeepZoom::getReferenceOffsetY;
+		dz_ut["getReferenceRows"] = &DeepZoom::getReferenceRows;
+		dz_ut["writeReference"] = &DeepZoom::writeReference;
+		dz_ut["ReferenceWidth"] = sol::var(DeepZoom::ReferenceWidth);
+
+		auto hl_ut = state.new_usertype<HashLife>("HashLife", sol::call_constructor,
+			sol::constructors<HashLife()>());
+		hl_ut["setRules"] = &HashLife::setRules;
+		hl_ut["setBoard"] = &HashLife::setBoard;
+		hl_ut["step"] = &HashLife::step;
+		hl_ut["rasterise"] = &HashLife::rasterise;
+		hl_ut["getGeneration"] = &HashLife::getGeneration;
+		hl_ut["getPopulation"] = &HashLife::getPopulation;
+		hl_ut["getNodeCount"] = &HashLife::getNodeCount;
+		hl_ut["setNodeLimit"] = &HashLife::setNodeLimit;
+		hl_ut["collectGarbage"] = &HashLife::collectGarbage;
+		hl_ut["MaxExponent"] = sol::var(HashLife::MaxExponent);
+
+		auto at_ut = state.new_usertype<ActiveTiles>("ActiveTiles", sol::call_constructor,
+			sol::constructors<ActiveTiles(unsigned int, unsigned int, unsigned int)>());
+		at_ut["reset"] = &ActiveTiles::reset;
+		at_ut["update"] = &ActiveTiles::update;
+		at_ut["setActive"] = &ActiveTiles::setActive;
+		at_ut["setIdle"] = &ActiveTiles::setIdle;
+		at_ut["setActiveGrid"] = &ActiveTiles::setActiveGrid;
+		at_ut["getColumns"] = &ActiveTiles::getColumns;
+		at_ut["getRows"] = &ActiveTiles::getRows;
+		at_ut["getTileSize"] = &ActiveTiles::getTileSize;
+		at_ut["getActiveCount"] = &ActiveTiles::getActiveCount;
+		at_ut["getTileCount"] = &ActiveTiles::getTileCount;
+
+		auto fr_ut = state.new_usertype<FlameRenderer>("FlameRenderer", sol::call_constructor,
+			sol::constructors<FlameRenderer()>());
+		fr_ut["addVariation"] = &FlameRenderer::addVariation;
+		fr_ut["addParameter"] = &FlameRenderer::addParameter;
+		fr_ut["setCamera"] = &FlameRenderer::setCamera;
+		fr_ut["setBackground"] = &FlameRenderer::setBackground;
+		fr_ut["setFuseIterations"] = &FlameRenderer::setFuseIterations;
+		fr_ut["render"] = &FlameRenderer::render;
+		fr_ut["getWalkerCount"] = &FlameRenderer::getWalkerCount;
+
+		auto xf_ut = state.new_usertype<Xform>("Xform", sol::call_constructor,
+			sol::constructors<Xform()>());
+		xf_ut["getAffine"] = &Xform::getAffine;
+		xf_ut["setAffine"] = &Xform::setAffine;
+		xf_ut["getPost"] = &Xform::getPost;
+		xf_ut["setPost"] = &Xform::setPost;
+		xf_ut["getVariationWeight"] = &Xform::getVariationWeight;
+		xf_ut["setVariationWeight"] = &Xform::setVariationWeight;
+		xf_ut["hasVariation"] = &Xform::hasVariation;
+		xf_ut["getParameter"] = &Xform::getParameter;
+		xf_ut["setParameter"] = &Xform::setParameter;
+		xf_ut["getColor"] = &Xform::getColor;
+		xf_ut["setColor"] = &Xform::setColor;
+		xf_ut["getColorSpeed"] = &Xform::getColorSpeed;
+		xf_ut["setColorSpeed"] = &Xform::setColorSpeed;
+		xf_ut["getOpacity"] = &Xform::getOpacity;
+		xf_ut["setOpacity"] = &Xform::setOpacity;
+		xf_ut["getDensity"] = &Xform::getDensity;
+		xf_ut["setDensity"] = &Xform::setDensity;
+		xf_ut["normalizeVariations"] = &Xform::normalizeVariations;
+		xf_ut["clone"] = []( const Xform& xform ) { return Xform(xform); };
+
+		state.new_usertype<Flame::ProgramHandles>("FlameHandles", sol::call_constructor,
+			sol::constructors<Flame::ProgramHandles(Program&)>());
+
+		// Lua counts xforms and palette entries from one, like the tables Flame.lua used to hold
+		auto fl_ut = state.new_usertype<Flame>("Flame", sol::call_constructor,
+			sol::constructors<Flame()>());
+		fl_ut["addVariation"] = &Flame::addVariation;
+		fl_ut["addParameter"] = &Flame::addParameter;
+		fl_ut["getXformCount"] = &Flame::getXformCount;
+		fl_ut["addXform"] = &Flame::addXform;
+		fl_ut["getXform"] = []( const Flame& flame, int index ) { return flame.getXform( index - 1 ); };
+		fl_ut["setXform"] = []( Flame& flame, int index, const Xform& xform ) { flame.setXform( index - 1, xform ); };
+		fl_ut["removeXform"] = []( Flame& flame, int index ) { flame.removeXform( index - 1 ); };
+		fl_ut["getTrans"] = &Flame::getTrans;
+		fl_ut["setTrans"] = &Flame::setTrans;
+		fl_ut["getPaletteEntry"] = []( const Flame& flame, int index ) { return flame.getPaletteEntry( index - 1 ); };
+		fl_ut["setPaletteEntry"] = []( Flame& flame, int index, vec4 colour ) { flame.setPaletteEntry( index - 1, colour ); };
+		fl_ut["getPaletteId"] = &Flame::getPaletteId;
+		fl_ut["getDensitySum"] = &Flame::getDensitySum;
+		fl_ut["getVariationSet"] = []( const Flame& flame ) { return sol::as_table( flame.getVariationSet() ); };
+		fl_ut["normalizeDensities"] = []( Flame& flame, sol::optional<float> to ) { flame.normalizeDensities( to.value_or(1.0f) ); };
+		fl_ut["spin"] = &Flame::spin;
+		fl_ut["interpolate"] = &Flame::interpolate;
+		fl_ut["writeParameters"] = sol::resolve<void( Program&, const Flame::ProgramHandles& ) const>( &Flame::writeParameters );
+		fl_ut["writePalette"] = &Flame::writePalette;
+		fl_ut["clone"] = []( const Flame& flame ) { return Flame(flame); };
+		fl_ut["loadFlam3"] = []( const std::string& path ) { return sol::as_table( Flame::loadFlam3( path ) ); };
+		fl_ut["saveFlam3"] = []( const std::string& path, sol::table flames, int width, int height )
+		{
+			std::vector<Flame> list;
+			for( size_t i = 1; i <= flames.size(); i++ )
+				list.push_back( flames.get<Flame>( i ) );
+			Flame::saveFlam3( path, list, width, height );
+		};
+		fl_ut["MaxXforms"] = sol::var(Flame::MaxXforms);
+		fl_ut["PaletteSize"] = sol::var(Flame::PaletteSize);
+
 		auto si_ut = state.new_usertype<ScreenInfo>("ScreenInfo", sol::no_constructor);
 		si_ut["w"] = sol::readonly(&ScreenInfo::w);
 		si_ut["h"] = sol::readonly(&ScreenInfo::h);